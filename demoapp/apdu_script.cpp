@@ -0,0 +1,179 @@
+/*******************************************************************************
+ * APDU Script Implementation
+ *******************************************************************************/
+
+#include "apdu_script.hpp"
+#include "log.hpp"
+#include "tcl_transport.hpp"
+#include <QDebug>
+#include <QElapsedTimer>
+
+static const uint16_t SW_OK = 0x9000;
+static const uint16_t SW_END_OF_FILE = 0x6282;
+static const uint16_t SW_WRONG_OFFSET = 0x6B00;
+
+// Limits GET RESPONSE / wrong Le retries per APDU
+static const int MAX_FOLLOW_UPS = 8;
+
+ApduScript ApduScript::parse(const QString &name, const QStringList &entries)
+{
+    ApduScript script;
+    script.name = name;
+
+    foreach (const QString &entry, entries)
+    {
+        QStringList parts = entry.trimmed().split(':');
+        if (parts.isEmpty() || parts[0].isEmpty())
+            continue;
+
+        Step step;
+        step.apdu = QByteArray::fromHex(parts[0].toLatin1());
+        if (step.apdu.size() < 4 || step.apdu.size() * 2 != parts[0].size())
+        {
+            qDebug() << "APDU script" << name << ": invalid APDU" << entry;
+            continue;
+        }
+
+        QString flags = parts.size() > 1 ? parts[1] : QString();
+        step.readLoop = flags.contains('r');
+        step.keep = step.readLoop || flags.contains('d');
+        script.steps.append(step);
+    }
+
+    return script;
+}
+
+// One APDU, following 61xx with GET RESPONSE and 6Cxx with the exact Le.
+// data collects the response bytes without the final status word.
+static bool exchange(TclTransport &transport, QByteArray apdu, QByteArray &data, uint16_t &sw,
+                     ApduScript::Result &result)
+{
+    QByteArray response;
+    data.clear();
+
+    for (int i = 0; i < MAX_FOLLOW_UPS; i++)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        if (!transport.transmit(apdu, response))
+        {
+            result.error = transport.error();
+            return false;
+        }
+
+        int n = response.size();
+        sw = (uint16_t)(((uint8_t)response[n - 2] << 8) | (uint8_t)response[n - 1]);
+
+        ApduScript::Timing timing;
+        timing.ins = (uint8_t)apdu[1];
+        timing.sw = sw;
+        timing.frames = transport.lastFrames();
+        timing.us = timer.nsecsElapsed() / 1000;
+        result.timings.append(timing);
+        result.frames += timing.frames;
+
+        data.append(response.constData(), n - 2);
+
+        uint8_t sw1 = sw >> 8;
+        if (sw1 == 0x61)
+        {
+            const char getResponse[] = {apdu[0], (char)0xC0, 0x00, 0x00, (char)(sw & 0xFF)};
+            apdu = QByteArray(getResponse, sizeof(getResponse));
+            continue;
+        }
+        if (sw1 == 0x6C && apdu.size() >= 5)
+        {
+            apdu[apdu.size() - 1] = (char)(sw & 0xFF);
+            continue;
+        }
+        return true;
+    }
+
+    result.error = "Too many APDU follow-ups";
+    return false;
+}
+
+static bool readBinary(TclTransport &transport, const QByteArray &apdu, ApduScript::Result &result)
+{
+    // Le no larger than one frame: no response chaining, one round trip per read
+    int le = apdu.size() >= 5 && (uint8_t)apdu[4] != 0 ? (uint8_t)apdu[4] : 256;
+    le = qMin(le, transport.maxResponseInFrame() - 2);
+
+    QByteArray command = apdu.left(4);
+    command.append((char)(le & 0xFF));
+    int offset = (((uint8_t)apdu[2] & 0x7F) << 8) | (uint8_t)apdu[3];
+    QByteArray data;
+    uint16_t sw;
+
+    while (offset <= 0x7FFF)
+    {
+        command[2] = (char)(offset >> 8);
+        command[3] = (char)(offset & 0xFF);
+        if (!exchange(transport, command, data, sw, result))
+            return false;
+
+        if (sw == SW_WRONG_OFFSET)
+            break;
+        if (sw != SW_OK && sw != SW_END_OF_FILE)
+        {
+            result.error = QString("READ BINARY at offset %1 failed, SW %2").arg(offset).arg(sw, 4, 16, QChar('0'));
+            return false;
+        }
+
+        result.data.append(data);
+        offset += data.size();
+        if (sw == SW_END_OF_FILE || data.size() < le)
+            break;
+    }
+
+    return true;
+}
+
+bool ApduScript::run(TclTransport &transport, Result &result) const
+{
+    QElapsedTimer timer;
+    timer.start();
+    QByteArray data;
+    uint16_t sw;
+
+    for (int i = 0; i < steps.size(); i++)
+    {
+        const Step &step = steps[i];
+
+        if (step.readLoop)
+        {
+            if (!readBinary(transport, step.apdu, result))
+                return false;
+            continue;
+        }
+
+        if (!exchange(transport, step.apdu, data, sw, result))
+            return false;
+
+        if (sw != SW_OK)
+        {
+            result.notPresent = i == 0;
+            result.error = QString("%1: APDU %2 failed, SW %3")
+                               .arg(name)
+                               .arg(i + 1)
+                               .arg(sw, 4, 16, QChar('0'));
+            return false;
+        }
+
+        if (step.keep)
+            result.data.append(data);
+    }
+
+    result.elapsedUs = timer.nsecsElapsed() / 1000;
+
+#if DEMOAPP_LOG_LEVEL <= 0
+    foreach (const Timing &t, result.timings)
+    {
+        uint8_t sw[2] = {(uint8_t)(t.sw >> 8), (uint8_t)t.sw};
+        LOG_TRACE("APDU INS {} SW {} : {} frames, {} us", Log::Hex(&t.ins, 1), Log::Hex(sw, 2), t.frames, t.us);
+    }
+#endif
+    LOG_DEBUG("APDU script {} : {} APDUs, {} frames, {} bytes in {} us", name, result.timings.size(), result.frames,
+              result.data.size(), result.elapsedUs);
+    return true;
+}
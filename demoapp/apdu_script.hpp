@@ -0,0 +1,62 @@
+/*******************************************************************************
+ * APDU Script - scripted command sequence for one card application
+ *
+ * A script is a list of hex APDUs in card_config.ini [ApduScripts]:
+ *   ndef=00A4040007D276000085010100, 00A4000C02E104, 00B0000000:r
+ * The first APDU selects the application; a card that refuses it does not
+ * carry the application and the next script is tried. Step flags:
+ *   :r  READ BINARY loop from P1-P2 until the end of the file, with Le sized
+ *       so every response fits one frame
+ *   :d  keep the response data of a single APDU
+ * Every APDU exchange is timed for profiling.
+ *******************************************************************************/
+
+#ifndef APDU_SCRIPT_HPP
+#define APDU_SCRIPT_HPP
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <cstdint>
+
+class TclTransport;
+
+struct ApduScript
+{
+    struct Step
+    {
+        QByteArray apdu;
+        bool readLoop = false;
+        bool keep = false;
+    };
+
+    struct Timing
+    {
+        uint8_t ins = 0;
+        uint16_t sw = 0;
+        int frames = 0; // T=CL blocks exchanged, WTX and chaining included
+        qint64 us = 0;
+    };
+
+    struct Result
+    {
+        QByteArray data;
+        QVector<Timing> timings;
+        QString error;
+        bool notPresent = false; // Application SELECT refused
+        int frames = 0;
+        qint64 elapsedUs = 0;
+    };
+
+    QString name;
+    QVector<Step> steps;
+
+    bool isEmpty() const { return steps.isEmpty(); }
+
+    bool run(TclTransport &transport, Result &result) const;
+
+    static ApduScript parse(const QString &name, const QStringList &entries);
+};
+
+#endif // APDU_SCRIPT_HPP
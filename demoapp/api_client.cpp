@@ -1,49 +1,169 @@
 #include "api_client.hpp"
 #include "config.hpp"
+#include "log.hpp"
+#include "tap_metrics.hpp"
 #include <QDateTime>
+#include <QStringList>
+#include <QElapsedTimer>
 #include <QDebug>
 #include <cstring>
+#include <future>
+#include <memory>
+#include <poll.h>
 
-ApiClient::ApiClient() : curl(nullptr)
+// Longest wait between warm-up attempts while the server cannot be reached
+static const int WARM_UP_MAX_BACKOFF_MS = 30000;
+
+// Single requests after the server answered a batch 404/405/501, doubled per
+// rejection up to the maximum, before the batch endpoint is tried again
+static const qint64 BATCH_RETRY_MIN_MS = 60000;
+static const qint64 BATCH_RETRY_MAX_MS = 3600000;
+
+ApiClient::ApiClient()
+    : _verifyBlocking(false), _batchRetryAtMs(0), _batchBackoffMs(0),
+      _auditor(&signatureHelper), _warmUp(false), _warmUpBackoffMs(0), _warmingUp(false)
 {
+    _batchClock.start();
     curl_global_init(CURL_GLOBAL_DEFAULT);
-    curl = curl_easy_init();
 }
 
 ApiClient::~ApiClient()
 {
-    if (curl)
-    {
-        curl_easy_cleanup(curl);
-    }
+    // Cancels the requests in flight, their callbacks run before this
+    _engine.stop();
+    _auditor.stop();
     curl_global_cleanup();
 }
 
 bool ApiClient::initialize()
 {
-    Config &config = Config::instance();
+    Config::Snapshot snapshot;
+    const Config &config = *snapshot;
 
     // Load certificates
-    if (!signatureHelper.loadPrivateCertificate(config.privateCertPath, config.certPassword))
+    if (!signatureHelper.loadPrivateCertificate(config.privateCertPath, config.certPassword, config.signAlgorithm))
     {
         qDebug() << "Failed to load private certificate";
         return false;
     }
 
-    if (!signatureHelper.loadPublicCertificate(config.publicCertPath))
+    if (!signatureHelper.loadPublicCertificate(config.publicCertPath, config.verifyAlgorithm))
     {
         qDebug() << "Public certificate encountered an error";
         return false;
     }
 
-    qDebug() << "API Client initialized successfully";
+    // Deferred: responses are verified on the audit thread after the result
+    // is shown. Blocking: a response that does not verify fails the tap.
+    _verifyBlocking = config.verifyMode.compare("blocking", Qt::CaseInsensitive) == 0;
+    if (_verifyBlocking)
+        _auditor.stop();
+    else
+        _auditor.start(config.verifyQueueDepth);
+
+    startEngine(config);
+    _warmUp = config.apiWarmUp;
+
+    qDebug() << "API Client initialized successfully, response verification" << (_verifyBlocking ? "blocking" : "deferred");
     return true;
 }
 
-size_t ApiClient::writeCallback(void *contents, size_t size, size_t nmemb, void *userp)
+void ApiClient::startEngine(const Config &config)
+{
+    // Does nothing once running, maxConnections is a startup setting
+    _engine.start(config.apiMaxConnections, [this](CURL *handle)
+                  { configureConnection(handle); });
+}
+
+void ApiClient::configureConnection(CURL *handle)
+{
+    if (!handle)
+        return;
+
+    Config::Snapshot snapshot;
+    const Config &config = *snapshot;
+
+    // A request is written in one go, Nagle would only hold its tail back
+    curl_easy_setopt(handle, CURLOPT_TCP_NODELAY, 1L);
+
+    // Keep-alive probes hold NAT and firewall state open on the idle
+    // connection and show a dead peer before a tap finds it
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPIDLE, (long)config.apiKeepAliveIdleS);
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPINTVL, (long)config.apiKeepAliveIntervalS);
+
+    // Chunked responses are decoded before they reach the parser
+    curl_easy_setopt(handle, CURLOPT_HTTP_TRANSFER_DECODING, 1L);
+
+#if LIBCURL_VERSION_NUM >= 0x074100
+    // curl drops connections idle for 118 s by default, the server decides here
+    curl_easy_setopt(handle, CURLOPT_MAXAGE_CONN, 86400L);
+#endif
+}
+
+bool ApiClient::connectionAlive()
+{
+    curl_socket_t socket = _engine.lastSocket();
+    if (socket == CURL_SOCKET_BAD)
+        return false;
+
+    // Nothing is due on an idle keep-alive connection: readable means the
+    // server closed it (EOF) or reset it
+    struct pollfd pfd;
+    pfd.fd = socket;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, 0) == 0;
+}
+
+void ApiClient::keepWarm()
 {
-    ((QString *)userp)->append((char *)contents);
-    return size * nmemb;
+    // The last warm-up's callback hands the back-off over with _warmingUp
+    if (!_warmUp || _warmingUp.load(std::memory_order_acquire) || _engine.inFlight() > 0 || connectionAlive())
+        return;
+    if (_warmUpBackoffMs > 0 && !_warmUpFailed.hasExpired(_warmUpBackoffMs))
+        return;
+
+    Config::Snapshot snapshot;
+    const Config &config = *snapshot;
+    startEngine(config);
+
+    // Any answer will do, even 404/405: what matters is the connection the
+    // engine keeps for the next tap. CONNECT_ONLY connections are not reused.
+    // A tap posted while it is still connecting cancels it and takes the
+    // connection slot, the warm-up never delays a tap.
+    HttpEngine::Request request;
+    request.url = config.requestTemplate.url();
+    request.head = true;
+    request.timeoutMs = config.apiWarmUpTimeoutMs;
+    request.preemptible = true;
+    int warmCheckMs = config.apiWarmCheckMs;
+
+    _warmingUp = true;
+    bool posted = _engine.post(request, [this, warmCheckMs](const HttpEngine::Result &result)
+                               {
+                                   if (result.code == CURLE_OK)
+                                   {
+                                       _warmUpBackoffMs = 0;
+                                       TapMetrics::record(TapMetrics::HttpWarmUp, result.elapsedUs);
+                                       LOG_DEBUG("API connection warmed up in {} us", result.elapsedUs);
+                                   }
+                                   else if (result.code == CURLE_ABORTED_BY_CALLBACK)
+                                   {
+                                       // Gave way to a tap or the engine stopped, the server was not at fault
+                                       LOG_DEBUG("API warm-up cancelled after {} us", result.elapsedUs);
+                                   }
+                                   else
+                                   {
+                                       // Server unreachable, do not try again every check
+                                       _warmUpBackoffMs = qBound(warmCheckMs, _warmUpBackoffMs * 2, WARM_UP_MAX_BACKOFF_MS);
+                                       _warmUpFailed.start();
+                                       LOG_DEBUG("API warm-up failed: {}, next try in {} ms",
+                                                 curl_easy_strerror(result.code), _warmUpBackoffMs);
+                                   }
+                                   _warmingUp.store(false, std::memory_order_release); });
+    if (!posted)
+        _warmingUp = false;
 }
 
 qint64 ApiClient::getCurrentTimestamp()
@@ -51,249 +171,397 @@ qint64 ApiClient::getCurrentTimestamp()
     return QDateTime::currentMSecsSinceEpoch();
 }
 
-QString ApiClient::buildRequestPayload(const QString &cardNumber, const QString &cardData, double amount)
+ApiClient::Request ApiClient::buildCardTap(const QString &cardNumber, const QString &cardData, double amount)
 {
-    Config &config = Config::instance();
+    TapMetrics::PhaseTimer timer(TapMetrics::BuildPayload);
     qint64 timestamp = getCurrentTimestamp();
-    QString readableTime = QDateTime::fromMSecsSinceEpoch(timestamp).toString("yyyy-MM-dd HH:mm:ss");
-    qDebug() << "Current time:" << readableTime;
-
-    QString transactionId = QString("afcs-tom%1").arg(timestamp);
-
-    // Prepare JSON manually to preserve order
-    QString dataString = QString(
-                             "{"
-                             "\"amount\": %1,"
-                             "\"cardData\": \"%2\","
-                             "\"fareMediaCode\": \"%3\","
-                             "\"cardNumber\": \"%4\","
-                             "\"entryTime\": \"%5\","
-                             "\"stationCode\": \"%6\","
-                             "\"tapChannel\": \"%7\","
-                             "\"cardTypeId\": %8,"
-                             "\"requestTime\": \"%5\","
-                             "\"reservedField1\": \"\","
-                             "\"reservedField2\": \"\","
-                             "\"reservedField3\": \"\","
-                             "\"transactionId\": \"%9\""
-                             "}")
-                             .arg(amount)
-                             .arg(cardData)
-                             .arg(config.fareMediaCode)
-                             .arg(cardNumber)
-                             .arg(readableTime)
-                             .arg(config.stationCode)
-                             .arg(config.tapChannel)
-                             .arg(config.cardTypeId)
-                             .arg(transactionId);
-
-    // Sign the compact data string
-    QString alg = "SHA1withRSA";
-    QString signature = signatureHelper.signData(dataString, alg);
-
-    // Build full JSON request manually
-    QString requestJson = QString(
-                              "{\"data\": %1, \"signature\": \"%2\"}")
-                              .arg(dataString, signature);
-
-    qDebug().noquote() << "Request Body:\n"
-                       << requestJson;
-    return requestJson;
+    Request request;
+    Config::Snapshot config;
+    config->requestTemplate.fill(request.data, cardNumber, cardData, amount, timestamp);
+    request.transactionId = RequestTemplate::transactionId(timestamp);
+    LOG_TRACE("Request data: {}", request.data);
+    return request;
+}
+
+void ApiClient::signRequest(Request &request)
+{
+    // Sign the compact data string with the [Certificate] signAlgorithm
+    QByteArray signature;
+    {
+        TapMetrics::PhaseTimer timer(TapMetrics::Sign);
+        signature = signatureHelper.signData(request.data);
+    }
+
+    RequestTemplate::wrap(request.body, request.data, signature);
+    LOG_TRACE("Request body ({} bytes): {}", request.body.size(), request.body);
+}
+
+ApiClient::Request ApiClient::prepareCardTap(const QString &cardNumber, const QString &cardData, double amount)
+{
+    Request request = buildCardTap(cardNumber, cardData, amount);
+    signRequest(request);
+    return request;
 }
 
 ApiClient::Response ApiClient::sendCardTap(const QString &cardNumber, const QString &cardData, double amount)
+{
+    return send(prepareCardTap(cardNumber, cardData, amount));
+}
+
+ApiClient::Response ApiClient::failure(const QString &message, int statusCode)
 {
     Response response;
     response.success = false;
-    response.statusCode = 0;
+    response.statusCode = statusCode;
+    response.message = message;
+    return response;
+}
 
-    if (!curl)
+// URL, headers and timeout of one snapshot. Tap requests count into the HTTP
+// metrics, journal replays are not part of any tap's latency.
+bool ApiClient::post(bool batch, const QByteArray &body, bool tap, const HttpEngine::Callback &callback)
+{
+    Config::Snapshot snapshot;
+    const Config &config = *snapshot;
+    startEngine(config);
+
+    const RequestTemplate &compiled = config.requestTemplate;
+    HttpEngine::Request request;
+    request.url = batch ? compiled.batchUrl() : compiled.url();
+    request.body = body;
+    request.headers = compiled.headerLines();
+    request.timeoutMs = config.apiTimeout;
+    LOG_DEBUG("Sending to API: {}", request.url);
+
+    if (!tap)
+        return _engine.post(request, callback);
+    return _engine.post(request, [this, callback](const HttpEngine::Result &result)
+                        {
+                            recordTransfer(result);
+                            callback(result); });
+}
+
+ApiClient::Response ApiClient::toResponse(const HttpEngine::Result &result)
+{
+    if (result.code != CURLE_OK)
     {
-        response.message = "cURL not initialized";
+        Response response = failure(QString("Network error: %1").arg(curl_easy_strerror(result.code)));
+        LOG_WARNING("{}", response.message);
         return response;
     }
+    return parseResponse(result.httpCode, result.body);
+}
 
-    Config &config = Config::instance();
-    QString responseString;
-
-    // Build request payload
-    QString jsonPayload = buildRequestPayload(cardNumber, cardData, amount);
-    QByteArray jsonBytes = jsonPayload.toUtf8();
+ApiClient::Response ApiClient::send(const Request &request)
+{
+    // Shared with the callback, which may still be returning when this does
+    std::shared_ptr<std::promise<Response>> done = std::make_shared<std::promise<Response>>();
+    std::future<Response> result = done->get_future();
+    if (!sendAsync(request, [done](const Response &response)
+                   { done->set_value(response); }))
+        return failure("HTTP engine not running");
+    return result.get();
+}
 
-    qDebug() << "Sending to API:" << config.apiUrl;
+bool ApiClient::sendAsync(const Request &request, const ResponseCallback &callback)
+{
+    // Taps built for a batch are signed only when they go out alone
+    if (request.body.isEmpty())
+    {
+        Request signedRequest = request;
+        signRequest(signedRequest);
+        return sendAsync(signedRequest, callback);
+    }
 
-    // Setup cURL
-    curl_easy_setopt(curl, CURLOPT_URL, config.apiUrl.toStdString().c_str());
-    curl_easy_setopt(curl, CURLOPT_POST, 1L);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, jsonBytes.constData());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, jsonBytes.size());
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, config.apiTimeout / 1000);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &responseString);
+    return post(false, request.body, true, [this, callback](const HttpEngine::Result &result)
+                { callback(toResponse(result)); });
+}
 
-    // IMPORTANT: Tell cURL to handle chunked encoding automatically
-    curl_easy_setopt(curl, CURLOPT_HTTP_TRANSFER_DECODING, 1L);
+ApiClient::Response ApiClient::replay(const QByteArray &body)
+{
+    std::shared_ptr<std::promise<Response>> done = std::make_shared<std::promise<Response>>();
+    std::future<Response> response = done->get_future();
+    if (!post(false, body, false, [this, done](const HttpEngine::Result &result)
+              { done->set_value(toResponse(result)); }))
+        return failure("HTTP engine not running");
+    return response.get();
+}
 
-    // Setup headers
-    struct curl_slist *headers = NULL;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    headers = curl_slist_append(headers, "Accept: application/json");
+QVector<ApiClient::Response> ApiClient::sendBatch(const QVector<Request> &requests)
+{
+    std::shared_ptr<std::promise<QVector<Response>>> done = std::make_shared<std::promise<QVector<Response>>>();
+    std::future<QVector<Response>> result = done->get_future();
+    if (!sendBatchAsync(requests, [done](const QVector<Response> &responses)
+                        { done->set_value(responses); }))
+        return QVector<Response>(requests.size(), failure("HTTP engine not running"));
+    return result.get();
+}
 
-    // Use dynamic values from Config
-    headers = curl_slist_append(headers, QString("Device: %1").arg(config.deviceName).toStdString().c_str());
-    headers = curl_slist_append(headers, QString("Afcs-Code: %1").arg(config.deviceCode).toStdString().c_str());
-    headers = curl_slist_append(headers, QString("Version-Number: %1").arg(config.deviceVersion).toStdString().c_str());
-    headers = curl_slist_append(headers, QString("Agent-Code: %1").arg(config.agentCode).toStdString().c_str());
-    headers = curl_slist_append(headers, QString("Cashier-Code: %1").arg(config.cashierName).toStdString().c_str());
+bool ApiClient::sendBatchAsync(const QVector<Request> &requests, const BatchCallback &callback)
+{
+    if (requests.size() <= 1 || !batchSupported())
+        return sendEachAsync(requests, callback);
+
+    // One envelope and one signature for every tap: {"items": [data, ...]}
+    Request batch;
+    int size = 16;
+    for (int i = 0; i < requests.size(); i++)
+        size += requests[i].data.size() + 1;
+    batch.data.reserve(size);
+    batch.data += "{\"items\": [";
+    for (int i = 0; i < requests.size(); i++)
+    {
+        if (i > 0)
+            batch.data += ',';
+        batch.data += requests[i].data;
+    }
+    batch.data += "]}";
+    signRequest(batch);
 
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    return post(true, batch.body, true, [this, requests, callback](const HttpEngine::Result &result)
+                {
+                    if (result.code != CURLE_OK)
+                    {
+                        callback(QVector<Response>(requests.size(), toResponse(result)));
+                        return;
+                    }
+
+                    ResponseParser parser;
+                    parser.parse(result.body);
+                    QVector<Response> responses;
+                    if (parseBatchResponse(result.httpCode, parser, requests, responses))
+                    {
+                        _batchBackoffMs = 0;
+                        callback(responses);
+                        return;
+                    }
+
+                    // The server does not know the batch endpoint, so none of
+                    // these taps was taken. Single requests for a while, then
+                    // the endpoint is tried again in case the server was
+                    // upgraded or only restarting.
+                    _batchBackoffMs = qBound(BATCH_RETRY_MIN_MS, _batchBackoffMs * 2, BATCH_RETRY_MAX_MS);
+                    _batchRetryAtMs = _batchClock.elapsed() + _batchBackoffMs;
+                    LOG_WARNING("Server rejected a batch of {} taps (HTTP {}), sending taps one by one for {} s",
+                                requests.size(), result.httpCode, _batchBackoffMs / 1000);
+                    if (!sendEachAsync(requests, callback))
+                        callback(QVector<Response>(requests.size(), failure("HTTP engine not running"))); });
+}
 
-    // Perform request
-    CURLcode res = curl_easy_perform(curl);
+// One request per tap, called back once all of them are in
+bool ApiClient::sendEachAsync(const QVector<Request> &requests, const BatchCallback &callback)
+{
+    struct Gather
+    {
+        QVector<Response> responses;
+        std::atomic<int> left;
+    };
+    std::shared_ptr<Gather> gather = std::make_shared<Gather>();
+    gather->responses.resize(requests.size());
+    gather->left = requests.size();
+    if (requests.isEmpty())
+    {
+        callback(gather->responses);
+        return true;
+    }
 
-    if (res == CURLE_OK)
+    for (int i = 0; i < requests.size(); i++)
     {
-        long httpCode = 0;
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode);
-        response.statusCode = httpCode;
-
-        // Clean up response string - remove any chunked encoding artifacts
-        // Find the last '}' which should be the end of actual JSON
-        int lastBrace = responseString.lastIndexOf('}');
-        if (lastBrace != -1 && lastBrace < responseString.length() - 1)
+        ResponseCallback done = [gather, i, callback](const Response &response)
         {
-            qDebug() << "Trimming extra data from response. Original length:" << responseString.length();
-            responseString = responseString.left(lastBrace + 1);
-            qDebug() << "Cleaned length:" << responseString.length();
-        }
-
-        qDebug() << "API Response [" << httpCode << "]:" << responseString;
-
-        // Parse JSON response
-        QJsonDocument doc = QJsonDocument::fromJson(responseString.toUtf8());
-        if (doc.isObject())
+            gather->responses[i] = response;
+            if (--gather->left == 0)
+                callback(gather->responses);
+        };
+        if (!sendAsync(requests[i], done))
         {
-            QJsonObject root = doc.object();
+            // Engine stopped: nothing posted from here on calls back
+            if (i == 0)
+                return false;
+            for (int j = i; j < requests.size(); j++)
+                gather->responses[j] = failure("HTTP engine not running");
+            if ((gather->left -= requests.size() - i) == 0)
+                callback(gather->responses);
+            return true;
+        }
+    }
+    return true;
+}
 
-            // Extract signature
-            QString respSignature = root.value("signature").toString();
+void ApiClient::fillResponse(Response &response, const ResponseParser &parser, const ResponseParser::Fields &fields)
+{
+    response.status = QString::fromUtf8(fields.status);
+    response.statusCodeStr = QString::fromUtf8(fields.statusCode);
+    response.message = QString::fromUtf8(fields.message);
+    response.transactionId = QString::fromUtf8(fields.transactionId);
 
-            // CRITICAL: Extract the exact "data" JSON string from raw response
-            QString dataJsonStr = extractDataJson(responseString);
+    // Only the card's own object goes through QJsonDocument
+    QByteArray fareMediaTap = parser.fareMediaTap(fields);
+    response.fareMediaTap = fareMediaTap.isEmpty() ? QJsonObject() : QJsonDocument::fromJson(fareMediaTap).object();
 
-            if (!dataJsonStr.isEmpty() && !respSignature.isEmpty())
-            {
-                qDebug() << "Extracted data JSON:" << dataJsonStr;
-                qDebug() << "Signature:" << respSignature;
+    // Check if successful (AS status and 2101 code)
+    response.success = (fields.status == "AS" && fields.statusCode == "2101");
+}
 
-                // Verify signature
-                bool signatureValid = signatureHelper.verifySignature(dataJsonStr, respSignature);
-                qDebug() << "Signature verification:" << (signatureValid ? "VALID" : "INVALID");
+bool ApiClient::checkSignature(const QString &transactionId, const QByteArray &data, const QByteArray &signature,
+                               qint64 &verifyUs)
+{
+    // Blocking mode also refuses a response without a signature
+    bool hasSignature = !data.isEmpty() && !signature.isEmpty();
+    bool signatureValid = hasSignature || !_verifyBlocking;
+    verifyUs = 0;
+    if (hasSignature)
+    {
+        LOG_TRACE("Signed data: {}", data);
+        LOG_TRACE("Signature: {}", signature);
 
-                if (!signatureValid)
-                {
-                    qWarning() << "WARNING: Signature verification failed!";
-                    // Continue processing anyway for now
-                }
-            }
+        if (_verifyBlocking)
+        {
+            QElapsedTimer timer;
+            timer.start();
+            signatureValid = signatureHelper.verifySignature(data, signature);
+            verifyUs = timer.nsecsElapsed() / 1000;
+            TapMetrics::record(TapMetrics::VerifySignature, verifyUs);
+        }
+        else
+        {
+            // data points into the parser's buffer, the auditor keeps a copy
+            _auditor.submit(transactionId, QByteArray(data.constData(), data.size()), signature);
+        }
+    }
 
-            // Extract data object for business logic
-            QJsonObject dataObj = root.value("data").toObject();
+    if (!signatureValid)
+        _auditor.recordFailure(transactionId, QByteArray(data.constData(), data.size()), signature);
+    return signatureValid;
+}
 
-            // Extract response data
-            response.status = dataObj.value("status").toString();
-            response.statusCodeStr = dataObj.value("statusCode").toString();
-            response.message = dataObj.value("message").toString();
-            response.transactionId = dataObj.value("transactionId").toString();
-            response.fareMediaTap = dataObj.value("fareMediaTap").toObject();
-            response.fullData = dataObj;
+ApiClient::Response ApiClient::parseResponse(long httpCode, const QByteArray &body)
+{
+    ResponseParser parser;
+    parser.parse(body);
+    return parseResponse(httpCode, parser);
+}
 
-            // Check if successful (AS status and 2101 code)
-            response.success = (response.status == "AS" && response.statusCodeStr == "2101");
+ApiClient::Response ApiClient::parseResponse(long httpCode, const ResponseParser &parser)
+{
+    Response response;
+    response.success = false;
+    response.statusCode = httpCode;
+    LOG_DEBUG("API response [{}] ({} bytes): {}", httpCode, parser.body().size(), parser.body());
+
+    // The body was scanned as it arrived, blocking verification is timed on its own
+    QElapsedTimer parseTimer;
+    parseTimer.start();
+    qint64 verifyUs = 0;
+    if (parser.isComplete() && parser.isObject())
+    {
+        fillResponse(response, parser, parser.dataFields());
 
-            qDebug() << "Status:" << response.status;
-            qDebug() << "Status Code:" << response.statusCodeStr;
-            qDebug() << "Message:" << response.message;
-            qDebug() << "Transaction ID:" << response.transactionId;
-        }
-        else
+        // Checked against the "data" bytes exactly as the server sent them
+        if (!checkSignature(response.transactionId, parser.data(), parser.signature(), verifyUs))
         {
-            response.message = "Invalid JSON response";
+            if (response.success)
+                response.message = "Response signature is invalid";
+            response.success = false;
         }
+        TapMetrics::record(TapMetrics::ParseResponse, parseTimer.nsecsElapsed() / 1000 - verifyUs);
+
+        LOG_INFO("Status {} code {} transaction {}: {}", response.status, response.statusCodeStr,
+                 response.transactionId, response.message);
     }
     else
     {
-        response.message = QString("Network error: %1").arg(curl_easy_strerror(res));
-        qDebug() << response.message;
+        response.message = "Invalid JSON response";
     }
 
-    curl_slist_free_all(headers);
     return response;
 }
 
-// Add this helper function to your ApiClient class
-QString ApiClient::extractDataJson(const QString &responseStr)
+bool ApiClient::parseBatchResponse(long httpCode, const ResponseParser &parser, const QVector<Request> &requests,
+                                   QVector<Response> &responses)
 {
-    int dataStart = responseStr.indexOf("\"data\":");
-    if (dataStart == -1)
-    {
-        return QString();
-    }
+    // Servers without the batch endpoint
+    if (httpCode == 404 || httpCode == 405 || httpCode == 501)
+        return false;
 
-    dataStart += 7; // Skip past "data":
+    LOG_DEBUG("API batch response [{}] ({} bytes): {}", httpCode, parser.body().size(), parser.body());
 
-    // Skip whitespace
-    while (dataStart < responseStr.length() && responseStr[dataStart].isSpace())
+    QElapsedTimer parseTimer;
+    parseTimer.start();
+
+    Response failed;
+    failed.success = false;
+    failed.statusCode = httpCode;
+    if (!parser.isComplete() || !parser.isObject())
     {
-        dataStart++;
+        failed.message = "Invalid JSON response";
+        responses = QVector<Response>(requests.size(), failed);
+        return true;
     }
-
-    // Find the matching closing brace for the data object
-    int braceCount = 0;
-    int dataEnd = dataStart;
-    bool inString = false;
-    bool escapeNext = false;
-
-    for (int i = dataStart; i < responseStr.length(); i++)
+    if (!parser.hasResults())
     {
-        QChar c = responseStr[i];
-
-        if (escapeNext)
-        {
-            escapeNext = false;
-            continue;
-        }
-
-        if (c == '\\')
-        {
-            escapeNext = true;
-            continue;
-        }
+        // An error envelope or a server error. The server may have taken some
+        // of the taps, so none is sent again: each fails with its message.
+        const ResponseParser::Fields &envelope = parser.dataFields();
+        failed.status = QString::fromUtf8(envelope.status);
+        failed.statusCodeStr = QString::fromUtf8(envelope.statusCode);
+        failed.message = envelope.message.isEmpty() ? QString("No results in the batch response")
+                                                    : QString::fromUtf8(envelope.message);
+        LOG_WARNING("Batch of {} taps failed (HTTP {}): {}", requests.size(), httpCode, failed.message);
+        responses = QVector<Response>(requests.size(), failed);
+        return true;
+    }
 
-        if (c == '"')
+    // One signature covers the whole result list
+    QStringList transactionIds;
+    for (int i = 0; i < requests.size(); i++)
+        transactionIds << requests[i].transactionId;
+    qint64 verifyUs = 0;
+    bool signatureValid = checkSignature(transactionIds.join(','), parser.data(), parser.signature(), verifyUs);
+
+    // Results come back in item order, each echoing its transaction ID
+    const QVector<ResponseParser::Fields> &results = parser.results();
+    responses.reserve(requests.size());
+    for (int i = 0; i < requests.size(); i++)
+    {
+        Response response = failed;
+        if (i >= results.size() || QString::fromUtf8(results[i].transactionId) != requests[i].transactionId)
         {
-            inString = !inString;
-            continue;
+            response.message = "No result for this tap in the batch response";
         }
-
-        if (!inString)
+        else
         {
-            if (c == '{')
+            fillResponse(response, parser, results[i]);
+            if (!signatureValid)
             {
-                braceCount++;
-            }
-            if (c == '}')
-            {
-                braceCount--;
-                if (braceCount == 0)
-                {
-                    dataEnd = i + 1;
-                    break;
-                }
+                if (response.success)
+                    response.message = "Response signature is invalid";
+                response.success = false;
             }
         }
+        LOG_INFO("Batch item {}/{} status {} code {} transaction {}: {}", i + 1, requests.size(), response.status,
+                 response.statusCodeStr, requests[i].transactionId, response.message);
+        responses.append(response);
     }
+    TapMetrics::record(TapMetrics::ParseResponse, parseTimer.nsecsElapsed() / 1000 - verifyUs);
+    return true;
+}
+
+void ApiClient::recordTransfer(const HttpEngine::Result &result)
+{
+    TapMetrics::record(TapMetrics::Http, result.elapsedUs);
+    if (result.code != CURLE_OK)
+        return;
 
-    // Extract the exact data JSON string
-    return responseStr.mid(dataStart, dataEnd - dataStart);
-}
\ No newline at end of file
+    // Taps that found the connection warm skip DNS, connect and TLS
+    TapMetrics::increment(result.reused ? TapMetrics::HttpReused : TapMetrics::HttpConnects);
+    if (!result.reused)
+    {
+        TapMetrics::record(TapMetrics::HttpDns, result.dnsUs);
+        TapMetrics::record(TapMetrics::HttpConnect, result.connectUs);
+    }
+    if (result.tlsUs > 0)
+        TapMetrics::record(TapMetrics::HttpTls, result.tlsUs);
+    if (result.firstByteUs > 0)
+        TapMetrics::record(TapMetrics::HttpFirstByte, result.firstByteUs);
+}
@@ -5,9 +5,17 @@
 #include <QByteArray>
 #include <QJsonObject>
 #include <QJsonDocument>
-#include <curl/curl.h>
+#include <QVector>
+#include <QElapsedTimer>
+#include <atomic>
+#include <functional>
+#include "http_engine.hpp"
+#include "response_auditor.hpp"
+#include "response_parser.hpp"
 #include "signature_helper.hpp"
 
+class Config;
+
 class ApiClient
 {
 public:
@@ -17,26 +25,108 @@ public:
     struct Response
     {
         bool success;
-        int statusCode;
+        int statusCode;        // HTTP status, 0 when the server was not reached
         QString status;        // "AS" for success, "AF" for failure
         QString statusCodeStr; // "2101" for success, others for failure
         QString message;
         QString transactionId;
         QJsonObject fareMediaTap;
-        QJsonObject fullData;
     };
 
+    // One tap. body is the signed request, empty for a tap built for a batch.
+    struct Request
+    {
+        QByteArray body;
+        QByteArray data; // Compact data object as UTF-8, the text that gets signed
+        QString transactionId;
+    };
+
+    // Every request goes through one HttpEngine, which keeps the connections
+    // for all of them: taps, batches, journal replays and the warm-up. The
+    // blocking calls wait for the engine, never from one of its callbacks.
     bool initialize();
     Response sendCardTap(const QString &cardNumber, const QString &cardData, double amount = 750.0);
 
+    // sendCardTap() split in two so the pipeline can sign one tap while the
+    // previous one is on the wire. Safe to call from different threads.
+    Request prepareCardTap(const QString &cardNumber, const QString &cardData, double amount = 750.0);
+    Response send(const Request &request);
+
+    // send() without waiting: returns at once and calls back on the HTTP
+    // engine thread once the response is parsed. Up to [API] maxConnections
+    // requests are on the wire at a time, completions come in any order.
+    // Returns false, without calling back, after the client was destroyed.
+    typedef std::function<void(const Response &response)> ResponseCallback;
+    bool sendAsync(const Request &request, const ResponseCallback &callback);
+
+    // Fills in request.body, for taps built unsigned
+    void signRequest(Request &request);
+
+    // Sends a signed request body again, e.g. from the offline journal.
+    // Waits for the response, not counted as a tap in the metrics.
+    Response replay(const QByteArray &body);
+
+    // Opens a connection ahead of the next tap when the server has closed
+    // the last one, with a HEAD request to the API URL. Returns at once,
+    // cheap when the connection is still up. A tap sent before it has
+    // connected cancels it. Call between taps.
+    void keepWarm();
+
+    // Batch mode: taps are built unsigned and sent together in one envelope
+    // with a single signature,
+    //   {"data": {"items": [data, ...]}, "signature": "..."}
+    // answered by {"data": {"results": [{transactionId, status, ...}, ...]},
+    // "signature": "..."} with results in item order. A server that answers
+    // 404/405/501 gets single requests for a back-off period, after which the
+    // batch endpoint is tried again. Any other answer without "results" fails
+    // every tap of the batch, none is sent a second time.
+    Request buildCardTap(const QString &cardNumber, const QString &cardData, double amount = 750.0);
+    QVector<Response> sendBatch(const QVector<Request> &requests);
+    bool batchSupported() const { return _batchClock.elapsed() >= _batchRetryAtMs; }
+
+    // sendBatch() without waiting, called back on the HTTP engine thread with
+    // one response per request, in request order
+    typedef std::function<void(const QVector<Response> &responses)> BatchCallback;
+    bool sendBatchAsync(const QVector<Request> &requests, const BatchCallback &callback);
+
+    // Response handling of send() once the body is in: field extraction and
+    // the signature check or its hand-off to the auditor. The body was parsed
+    // as it arrived. Public for the host benchmarks.
+    Response parseResponse(long httpCode, const ResponseParser &parser);
+    Response parseResponse(long httpCode, const QByteArray &body);
+
 private:
-    CURL *curl;
     SignatureHelper signatureHelper;
+    bool _verifyBlocking;     // [Certificate] verifyMode=blocking
+
+    // Batch endpoint back-off: single requests until _batchClock reaches
+    // _batchRetryAtMs
+    std::atomic<qint64> _batchRetryAtMs;
+    qint64 _batchBackoffMs;   // HTTP engine thread only
+    QElapsedTimer _batchClock;
+
+    ResponseAuditor _auditor; // Deferred verification, uses signatureHelper
+    HttpEngine _engine;       // Started by initialize() or the first request
+
+    bool _warmUp;             // [API] warmUp
+    int _warmUpBackoffMs;     // After failed warm-ups, doubled per failure
+    QElapsedTimer _warmUpFailed;
+    std::atomic<bool> _warmingUp;
 
-    static size_t writeCallback(void *contents, size_t size, size_t nmemb, void *userp);
-    QString buildRequestPayload(const QString &cardNumber, const QString &cardData, double amount);
+    void configureConnection(CURL *handle);
+    void startEngine(const Config &config);
+    bool connectionAlive();
+    void recordTransfer(const HttpEngine::Result &result);
+    bool post(bool batch, const QByteArray &body, bool tap, const HttpEngine::Callback &callback);
+    bool sendEachAsync(const QVector<Request> &requests, const BatchCallback &callback);
+    static Response failure(const QString &message, int statusCode = 0);
+    Response toResponse(const HttpEngine::Result &result);
+    void fillResponse(Response &response, const ResponseParser &parser, const ResponseParser::Fields &fields);
+    bool checkSignature(const QString &transactionId, const QByteArray &data, const QByteArray &signature,
+                        qint64 &verifyUs);
+    bool parseBatchResponse(long httpCode, const ResponseParser &parser, const QVector<Request> &requests,
+                            QVector<Response> &responses);
     qint64 getCurrentTimestamp();
-    QString extractDataJson(const QString &responseStr);
 };
 
 #endif // API_CLIENT_HPP
\ No newline at end of file
@@ -0,0 +1,184 @@
+/*******************************************************************************
+ * Benchmark Harness and Entry Point
+ *******************************************************************************/
+
+#include "benchmark.hpp"
+#include "codec.hpp"
+#include <QCoreApplication>
+#include <QMap>
+#include <QStringList>
+#include <atomic>
+#include <cstdio>
+#include <openssl/crypto.h>
+#include <openssl/opensslv.h>
+
+#ifdef __GLIBC__
+// malloc and friends replaced by counting wrappers around glibc's own, Qt
+// and operator new allocate through them as well
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *pointer, size_t size);
+
+static std::atomic<qint64> allocationCount(0);
+
+extern "C" void *malloc(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+
+qint64 Benchmark::allocations()
+{
+    return allocationCount.load(std::memory_order_relaxed);
+}
+#else
+qint64 Benchmark::allocations()
+{
+    return -1;
+}
+#endif
+
+// Name -> function, sorted so the output order is stable across builds
+static QMap<QString, Benchmark::Function> &registry()
+{
+    static QMap<QString, Benchmark::Function> benchmarks;
+    return benchmarks;
+}
+
+Benchmark::Registration::Registration(const char *name, Function function)
+{
+    registry().insert(QString::fromLatin1(name), function);
+}
+
+Benchmark::Run::Run(qint64 minTimeNs)
+    : _minTimeNs(minTimeNs), _ops(0), _totalNs(0), _allocations(0), _bytesPerOp(0)
+{
+}
+
+void Benchmark::Run::addBatch(qint64 ns, qint64 ops, qint64 allocations)
+{
+    _ops += ops;
+    _totalNs += ns;
+    _allocations += allocations;
+    _nsPerOp.record((uint64_t)(ns / ops));
+}
+
+void Benchmark::Run::counter(const char *name, double value)
+{
+    _counters.append(qMakePair(QByteArray(name), value));
+}
+
+QByteArray Benchmark::Run::toJson(const QString &name) const
+{
+    char buffer[512];
+    if (!_error.isEmpty())
+    {
+        int n = snprintf(buffer, sizeof(buffer), "{\"name\":\"%s\",\"error\":\"%s\"}", name.toLatin1().constData(),
+                         _error.toLatin1().constData());
+        return QByteArray(buffer, n);
+    }
+
+    double mean = meanNs();
+    int n = snprintf(buffer, sizeof(buffer),
+                     "{\"name\":\"%s\",\"iterations\":%lld,\"ns_per_op\":%.1f,\"p50_ns\":%llu,\"p99_ns\":%llu,"
+                     "\"max_ns\":%llu,\"ops_per_s\":%.1f",
+                     name.toLatin1().constData(), (long long)_ops, mean,
+                     (unsigned long long)_nsPerOp.quantileUs(0.5), (unsigned long long)_nsPerOp.quantileUs(0.99),
+                     (unsigned long long)_nsPerOp.maxUs(), mean > 0 ? 1e9 / mean : 0.0);
+    QByteArray json(buffer, n);
+
+    if (_bytesPerOp > 0 && mean > 0)
+    {
+        n = snprintf(buffer, sizeof(buffer), ",\"mb_per_s\":%.1f", _bytesPerOp * 1e3 / mean);
+        json.append(buffer, n);
+    }
+    if (allocations() >= 0 && _ops > 0)
+    {
+        n = snprintf(buffer, sizeof(buffer), ",\"allocs_per_op\":%.2f", (double)_allocations / _ops);
+        json.append(buffer, n);
+    }
+    for (int i = 0; i < _counters.size(); i++)
+    {
+        n = snprintf(buffer, sizeof(buffer), ",\"%s\":%.6g", _counters[i].first.constData(), _counters[i].second);
+        json.append(buffer, n);
+    }
+    json.append('}');
+    return json;
+}
+
+// scanCard() and friends qDebug on every call, keep the console readable
+static void quietMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    Q_UNUSED(context);
+    if (type != QtDebugMsg && type != QtInfoMsg)
+        fprintf(stderr, "%s\n", message.toLocal8Bit().constData());
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: benchmarks [--filter <substring>] [--min-time-ms <ms>] [--list] [--verbose]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+
+    QString filter;
+    qint64 minTimeMs = 300;
+    bool list = false;
+    bool verbose = false;
+    for (int i = 1; i < args.size(); i++)
+    {
+        if (args[i] == "--filter" && i + 1 < args.size())
+            filter = args[++i];
+        else if (args[i] == "--min-time-ms" && i + 1 < args.size())
+            minTimeMs = args[++i].toLongLong();
+        else if (args[i] == "--list")
+            list = true;
+        else if (args[i] == "--verbose")
+            verbose = true;
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+
+    // Diagnostics go to stderr, results alone to stdout
+    if (!verbose)
+        qInstallMessageHandler(quietMessageHandler);
+    if (!list)
+        printf("{\"context\":{\"codec_kernel\":\"%s\",\"openssl\":\"%s\"}}\n", Codec::kernelName(),
+               OpenSSL_version(OPENSSL_VERSION));
+
+    QMap<QString, Benchmark::Function>::const_iterator it;
+    for (it = registry().constBegin(); it != registry().constEnd(); ++it)
+    {
+        if (!filter.isEmpty() && !it.key().contains(filter))
+            continue;
+        if (list)
+        {
+            printf("%s\n", it.key().toLatin1().constData());
+            continue;
+        }
+
+        Benchmark::Run run(minTimeMs * 1000000);
+        it.value()(run);
+        printf("%s\n", run.toJson(it.key()).constData());
+        fflush(stdout);
+    }
+    return 0;
+}
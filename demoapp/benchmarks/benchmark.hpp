@@ -0,0 +1,123 @@
+/*******************************************************************************
+ * Benchmark - minimal harness for the host microbenchmarks
+ *
+ *   BENCHMARK(hexCodec, "codec/hex/codec/64")
+ *   {
+ *       run.setBytesPerOp(64);
+ *       run.measure([&] { Codec::toHex(in, 64, out); });
+ *   }
+ *
+ * measure() sizes batches to at least ~50 us, repeats them for --min-time-ms
+ * and records one ns/op sample per batch. Each benchmark prints one JSON
+ * object per line: name, iterations, mean/p50/p99/max ns per op, throughput,
+ * heap allocations per op and any counters the benchmark added.
+ *
+ * allocs_per_op counts malloc, calloc and realloc calls of the whole process
+ * during the timed batches, threads the op hands work to included. Counted on
+ * glibc only, the field is left out elsewhere.
+ *******************************************************************************/
+
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QVector>
+#include <functional>
+#include "latency_histogram.hpp"
+
+namespace Benchmark
+{
+    class Run
+    {
+    public:
+        explicit Run(qint64 minTimeNs);
+
+        template <typename F>
+        void measure(F op)
+        {
+            // Double the batch until it is long enough to time, calibration
+            // batches double as warm-up
+            qint64 batch = 1;
+            while (true)
+            {
+                QElapsedTimer timer;
+                timer.start();
+                for (qint64 i = 0; i < batch; i++)
+                    op();
+                if (timer.nsecsElapsed() >= MIN_BATCH_NS || batch >= MAX_BATCH)
+                    break;
+                batch *= 2;
+            }
+
+            QElapsedTimer total;
+            total.start();
+            int batches = 0;
+            while (total.nsecsElapsed() < _minTimeNs || batches < MIN_BATCHES)
+            {
+                qint64 allocations0 = allocations();
+                QElapsedTimer timer;
+                timer.start();
+                for (qint64 i = 0; i < batch; i++)
+                    op();
+                addBatch(timer.nsecsElapsed(), batch, allocations() - allocations0);
+                batches++;
+            }
+        }
+
+        // Adds mb_per_s to the output
+        void setBytesPerOp(qint64 bytes) { _bytesPerOp = bytes; }
+
+        // Mean ns per op of what was measured so far, for derived counters
+        double meanNs() const { return _ops > 0 ? (double)_totalNs / _ops : 0.0; }
+
+        // Extra numeric field of the output line, e.g. RF commands per read
+        void counter(const char *name, double value);
+
+        // Setup failed, the output line carries the error instead of timings
+        void fail(const QString &error) { _error = error; }
+
+        // One JSON object, no trailing newline
+        QByteArray toJson(const QString &name) const;
+
+    private:
+        static const qint64 MIN_BATCH_NS = 50000;
+        static const qint64 MAX_BATCH = 1 << 24;
+        static const int MIN_BATCHES = 5;
+
+        void addBatch(qint64 ns, qint64 ops, qint64 allocations);
+
+        qint64 _minTimeNs;
+        qint64 _ops;
+        qint64 _totalNs;
+        qint64 _allocations;
+        qint64 _bytesPerOp;
+        LatencyHistogram _nsPerOp; // Histogram units are ns here
+        QVector<QPair<QByteArray, double>> _counters;
+        QString _error;
+    };
+
+    // Heap allocations of the process so far, -1 where they are not counted
+    qint64 allocations();
+
+    typedef std::function<void(Run &run)> Function;
+
+    struct Registration
+    {
+        Registration(const char *name, Function function);
+    };
+
+    // Keeps a result observable so the computation is not optimized away
+    template <typename T>
+    inline void keep(const T &value)
+    {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+}
+
+#define BENCHMARK(function, name)                                                        \
+    static void function(Benchmark::Run &run);                                           \
+    static Benchmark::Registration function##Registration(name, function);               \
+    static void function(Benchmark::Run &run)
+
+#endif // BENCHMARK_HPP
@@ -0,0 +1,27 @@
+#----------------------------------------------------------------------------------
+# Host microbenchmarks of the demoapp core, one JSON object per line on stdout:
+#
+#   benchmarks [--filter <substring>] [--min-time-ms <ms>] [--list] [--verbose]
+#----------------------------------------------------------------------------------
+
+TARGET      = benchmarks
+TEMPLATE    = app
+QT         -= gui
+CONFIG     += console
+CONFIG     -= app_bundle
+
+include(../core.pri)
+
+# Static core library built by ../core.pro in the parent build directory
+LIBS           = -L$$OUT_PWD/.. -ldemoapp_core $$LIBS
+PRE_TARGETDEPS += $$OUT_PWD/../libdemoapp_core.a
+
+SOURCES    += benchmark.cpp \
+    codec_benchmarks.cpp \
+    crypto_benchmarks.cpp \
+    journal_benchmarks.cpp \
+    mock_api_server.cpp \
+    reader_benchmarks.cpp
+
+HEADERS    += benchmark.hpp \
+    mock_api_server.hpp
@@ -0,0 +1,190 @@
+/*******************************************************************************
+ * Codec Benchmarks - Codec against the code it replaced
+ *
+ * legacy_* are verbatim copies of the old CardReader::bytesToHex (one
+ * QString::arg per byte) and SignatureHelper base64 (an OpenSSL BIO chain per
+ * call), kept here as the baseline.
+ *******************************************************************************/
+
+#include "benchmark.hpp"
+#include "card_reader.hpp"
+#include "codec.hpp"
+#include <QByteArray>
+#include <openssl/bio.h>
+#include <openssl/buffer.h>
+#include <openssl/evp.h>
+
+static QString legacyBytesToHex(const uchar *data, int length)
+{
+    QString hex;
+    for (int i = 0; i < length; i++)
+    {
+        hex += QString("%1").arg(data[i], 2, 16, QChar('0')).toUpper();
+    }
+    return hex;
+}
+
+static QString legacyToBase64(const unsigned char *data, int length)
+{
+    BIO *b64 = BIO_new(BIO_f_base64());
+    BIO *bio = BIO_new(BIO_s_mem());
+    bio = BIO_push(b64, bio);
+
+    BIO_set_flags(bio, BIO_FLAGS_BASE64_NO_NL);
+    BIO_write(bio, data, length);
+    BIO_flush(bio);
+
+    BUF_MEM *bufferPtr;
+    BIO_get_mem_ptr(bio, &bufferPtr);
+
+    QString result = QString::fromLatin1(bufferPtr->data, bufferPtr->length);
+    BIO_free_all(bio);
+
+    return result;
+}
+
+static QByteArray legacyFromBase64(const QString &base64)
+{
+    QString cleanSignature = base64;
+    cleanSignature.remove('\n').remove('\r').remove(' ');
+    QByteArray input = cleanSignature.toLatin1();
+
+    BIO *b64 = BIO_new(BIO_f_base64());
+    BIO *bio = BIO_new_mem_buf(input.data(), input.length());
+    bio = BIO_push(b64, bio);
+
+    BIO_set_flags(bio, BIO_FLAGS_BASE64_NO_NL);
+
+    QByteArray output;
+    output.resize(input.length());
+
+    int decodedLength = BIO_read(bio, output.data(), output.size());
+    BIO_free_all(bio);
+
+    output.resize(decodedLength);
+    return output;
+}
+
+static QByteArray testBytes(int length)
+{
+    QByteArray bytes(length, Qt::Uninitialized);
+    for (int i = 0; i < length; i++)
+        bytes[i] = (char)(i * 37 + 11);
+    return bytes;
+}
+
+/*******************************************************************************
+ * Hex: 7-byte UID, 48-byte card image (three blocks), 1 KB image
+ *******************************************************************************/
+
+static void hexCodec(Benchmark::Run &run, int length)
+{
+    QByteArray in = testBytes(length);
+    QByteArray out(Codec::hexLength(length), Qt::Uninitialized);
+    run.setBytesPerOp(length);
+    run.measure([&]
+                {
+                    Codec::toHex((const uint8_t *)in.constData(), length, out.data());
+                    Benchmark::keep(out); });
+}
+
+static void hexBytesToHex(Benchmark::Run &run, int length)
+{
+    QByteArray in = testBytes(length);
+    run.setBytesPerOp(length);
+    run.measure([&]
+                {
+                    QString hex = CardReader::bytesToHex((const uchar *)in.constData(), length);
+                    Benchmark::keep(hex); });
+}
+
+static void hexLegacy(Benchmark::Run &run, int length)
+{
+    QByteArray in = testBytes(length);
+    run.setBytesPerOp(length);
+    run.measure([&]
+                {
+                    QString hex = legacyBytesToHex((const uchar *)in.constData(), length);
+                    Benchmark::keep(hex); });
+}
+
+BENCHMARK(hexCodec7, "codec/hex/codec/7") { hexCodec(run, 7); }
+BENCHMARK(hexCodec48, "codec/hex/codec/48") { hexCodec(run, 48); }
+BENCHMARK(hexCodec1024, "codec/hex/codec/1024") { hexCodec(run, 1024); }
+BENCHMARK(hexBytesToHex7, "codec/hex/bytes_to_hex/7") { hexBytesToHex(run, 7); }
+BENCHMARK(hexBytesToHex48, "codec/hex/bytes_to_hex/48") { hexBytesToHex(run, 48); }
+BENCHMARK(hexBytesToHex1024, "codec/hex/bytes_to_hex/1024") { hexBytesToHex(run, 1024); }
+BENCHMARK(hexLegacy7, "codec/hex/legacy/7") { hexLegacy(run, 7); }
+BENCHMARK(hexLegacy48, "codec/hex/legacy/48") { hexLegacy(run, 48); }
+BENCHMARK(hexLegacy1024, "codec/hex/legacy/1024") { hexLegacy(run, 1024); }
+
+BENCHMARK(hexScalar1024, "codec/hex/scalar/1024")
+{
+    QByteArray in = testBytes(1024);
+    QByteArray out(Codec::hexLength(1024), Qt::Uninitialized);
+    run.setBytesPerOp(1024);
+    run.measure([&]
+                {
+                    Codec::toHexScalar((const uint8_t *)in.constData(), 1024, out.data());
+                    Benchmark::keep(out); });
+}
+
+/*******************************************************************************
+ * Base64: 256 bytes is an RSA-2048 signature
+ *******************************************************************************/
+
+BENCHMARK(base64EncodeCodec, "codec/base64/encode/codec/256")
+{
+    QByteArray in = testBytes(256);
+    QByteArray out(Codec::base64Length(256), Qt::Uninitialized);
+    run.setBytesPerOp(256);
+    run.measure([&]
+                {
+                    Codec::toBase64((const uint8_t *)in.constData(), 256, out.data());
+                    Benchmark::keep(out); });
+}
+
+BENCHMARK(base64EncodeScalar, "codec/base64/encode/scalar/256")
+{
+    QByteArray in = testBytes(256);
+    QByteArray out(Codec::base64Length(256), Qt::Uninitialized);
+    run.setBytesPerOp(256);
+    run.measure([&]
+                {
+                    Codec::toBase64Scalar((const uint8_t *)in.constData(), 256, out.data());
+                    Benchmark::keep(out); });
+}
+
+BENCHMARK(base64EncodeLegacy, "codec/base64/encode/legacy_bio/256")
+{
+    QByteArray in = testBytes(256);
+    run.setBytesPerOp(256);
+    run.measure([&]
+                {
+                    QString b64 = legacyToBase64((const unsigned char *)in.constData(), 256);
+                    Benchmark::keep(b64); });
+}
+
+BENCHMARK(base64DecodeCodec, "codec/base64/decode/codec/256")
+{
+    QByteArray in = testBytes(256);
+    QByteArray b64(Codec::base64Length(256), Qt::Uninitialized);
+    Codec::toBase64((const uint8_t *)in.constData(), 256, b64.data());
+    QByteArray out(Codec::base64DecodedMaxLength(b64.size()), Qt::Uninitialized);
+    run.setBytesPerOp(256);
+    run.measure([&]
+                {
+                    int n = Codec::fromBase64(b64.constData(), b64.size(), (uint8_t *)out.data());
+                    Benchmark::keep(n); });
+}
+
+BENCHMARK(base64DecodeLegacy, "codec/base64/decode/legacy_bio/256")
+{
+    QByteArray in = testBytes(256);
+    QString b64 = legacyToBase64((const unsigned char *)in.constData(), 256);
+    run.setBytesPerOp(256);
+    run.measure([&]
+                {
+                    QByteArray out = legacyFromBase64(b64);
+                    Benchmark::keep(out); });
+}
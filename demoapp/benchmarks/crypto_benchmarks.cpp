@@ -0,0 +1,590 @@
+/*******************************************************************************
+ * Crypto and API Benchmarks - signing, verification, payload build and
+ * response parsing
+ *
+ * Throwaway RSA-2048, P-256 and Ed25519 keys with self-signed certificates are
+ * generated once and written as the PKCS#12 / PEM pairs SignatureHelper loads
+ * on the device. ops_per_s of crypto/sign/* is signs per second.
+ *
+ * api/taps_per_s/* submit taps to a MockApiServer on loopback, so they include
+ * the HTTP round trip and the server signing its responses. The same goes for
+ * api/requests_per_s/*, blocking send() against sendAsync() with N requests
+ * kept in flight.
+ *******************************************************************************/
+
+#include "api_client.hpp"
+#include "benchmark.hpp"
+#include "codec.hpp"
+#include "config.hpp"
+#include "mock_api_server.hpp"
+#include "request_template.hpp"
+#include "response_parser.hpp"
+#include "signature_helper.hpp"
+#include "tap_metrics.hpp"
+#include <QDateTime>
+#include <QSemaphore>
+#include <QTemporaryDir>
+#include <atomic>
+#include <cstdio>
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/pkcs12.h>
+#include <openssl/x509.h>
+
+static const char KEY_PASSWORD[] = "benchmark";
+
+// Typical signed request data and server response "data" object
+static const char REQUEST_DATA[] =
+    "{\"amount\": 750,\"cardData\": \"0102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F20"
+    "2122232425262728292A2B2C2D2E2F30\",\"fareMediaCode\": \"NCD01\",\"cardNumber\": \"04080A1B2C3D4E\","
+    "\"entryTime\": \"2024-05-01 08:00:00\",\"stationCode\": \"VKZ123\",\"tapChannel\": \"One\",\"cardTypeId\": 1,"
+    "\"requestTime\": \"2024-05-01 08:00:00\",\"reservedField1\": \"\",\"reservedField2\": \"\","
+    "\"reservedField3\": \"\",\"transactionId\": \"afcs-tom1714550400000\"}";
+
+static const char RESPONSE_DATA[] =
+    "{\"status\":\"AS\",\"statusCode\":\"2101\",\"message\":\"Transaction successful\","
+    "\"transactionId\":\"afcs-tom1714550400000\",\"fareMediaTap\":{\"cardNumber\":\"04080A1B2C3D4E\","
+    "\"balance\":12500,\"fare\":750,\"entryTime\":\"2024-05-01 08:00:00\",\"stationCode\":\"VKZ123\"}}";
+
+struct TestKeys
+{
+    QTemporaryDir dir;
+    QString pfxPath;
+    QString pemPath;
+    bool ok = false;
+};
+
+enum KeyType
+{
+    KeyRsa2048 = 0,
+    KeyP256,
+    KeyEd25519,
+    KEY_TYPE_COUNT
+};
+
+static EVP_PKEY *generateKey(KeyType type)
+{
+    static const int ids[KEY_TYPE_COUNT] = {EVP_PKEY_RSA, EVP_PKEY_EC, EVP_PKEY_ED25519};
+    EVP_PKEY *pkey = nullptr;
+    EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new_id(ids[type], nullptr);
+    bool ok = ctx && EVP_PKEY_keygen_init(ctx) == 1;
+    if (ok && type == KeyRsa2048)
+        ok = EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048) == 1;
+    if (ok && type == KeyP256)
+        ok = EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx, NID_X9_62_prime256v1) == 1;
+    if (ok)
+        ok = EVP_PKEY_keygen(ctx, &pkey) == 1;
+    EVP_PKEY_CTX_free(ctx);
+    return ok ? pkey : nullptr;
+}
+
+static bool writeKeys(TestKeys &keys, KeyType type)
+{
+    EVP_PKEY *pkey = generateKey(type);
+    if (!pkey)
+        return false;
+
+    X509 *cert = X509_new();
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 86400);
+    X509_set_pubkey(cert, pkey);
+    X509_NAME *name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *)"demoapp benchmark", -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    X509_sign(cert, pkey, type == KeyEd25519 ? nullptr : EVP_sha256()); // EdDSA takes no digest
+
+    PKCS12 *p12 = PKCS12_create(KEY_PASSWORD, "demoapp", pkey, cert, nullptr, 0, 0, 0, 0, 0);
+    bool ok = p12 != nullptr;
+
+    FILE *pfx = ok ? fopen(keys.pfxPath.toLocal8Bit().constData(), "wb") : nullptr;
+    ok = pfx && i2d_PKCS12_fp(pfx, p12) == 1;
+    if (pfx)
+        fclose(pfx);
+
+    FILE *pem = ok ? fopen(keys.pemPath.toLocal8Bit().constData(), "wb") : nullptr;
+    ok = pem && PEM_write_X509(pem, cert) == 1;
+    if (pem)
+        fclose(pem);
+
+    PKCS12_free(p12);
+    X509_free(cert);
+    EVP_PKEY_free(pkey);
+    return ok;
+}
+
+static const TestKeys &testKeys(KeyType type = KeyRsa2048)
+{
+    static TestKeys keys[KEY_TYPE_COUNT];
+    static bool generated[KEY_TYPE_COUNT] = {};
+    if (!generated[type])
+    {
+        generated[type] = true;
+        keys[type].pfxPath = keys[type].dir.filePath("private.pfx");
+        keys[type].pemPath = keys[type].dir.filePath("public.pem");
+        keys[type].ok = keys[type].dir.isValid() && writeKeys(keys[type], type);
+    }
+    return keys[type];
+}
+
+static bool loadHelper(SignatureHelper &helper, Benchmark::Run &run, KeyType type = KeyRsa2048,
+                       const char *algorithm = "SHA1withRSA")
+{
+    const TestKeys &keys = testKeys(type);
+    if (!keys.ok || !helper.loadPrivateCertificate(keys.pfxPath, KEY_PASSWORD, algorithm) ||
+        !helper.loadPublicCertificate(keys.pemPath, algorithm))
+    {
+        run.fail("test key setup failed");
+        return false;
+    }
+    return true;
+}
+
+static bool initializeClient(ApiClient &client, Benchmark::Run &run, const char *verifyMode = "deferred")
+{
+    const TestKeys &keys = testKeys();
+    Config config = *Config::Snapshot();
+    config.privateCertPath = keys.pfxPath;
+    config.publicCertPath = keys.pemPath;
+    config.certPassword = KEY_PASSWORD;
+    config.verifyMode = verifyMode;
+    Config::publish(config);
+    if (!keys.ok || !client.initialize())
+    {
+        run.fail("test key setup failed");
+        return false;
+    }
+    return true;
+}
+
+// Mean of a phase histogram over the samples recorded since a snapshot
+static double phaseMeanNs(TapMetrics::Phase phase, uint64_t count0, uint64_t sum0)
+{
+    const LatencyHistogram &h = TapMetrics::histogram(phase);
+    uint64_t n = h.count() - count0;
+    return n > 0 ? (h.sumUs() - sum0) * 1000.0 / n : 0.0;
+}
+
+/*******************************************************************************
+ * SignatureHelper
+ *******************************************************************************/
+
+// The signing path before contexts were cached: parse the algorithm, create,
+// initialize and free an EVP_MD_CTX and malloc the signature on every call
+static QString legacySign(EVP_PKEY *key, const QString &data, const QString &algorithm)
+{
+    const EVP_MD *md = nullptr;
+    if (algorithm.compare("SHA1withRSA", Qt::CaseInsensitive) == 0)
+        md = EVP_sha1();
+    else if (algorithm.compare("SHA256withRSA", Qt::CaseInsensitive) == 0)
+        md = EVP_sha256();
+    else
+        return QString();
+
+    QByteArray dataBytes = data.toUtf8();
+    size_t sigLen = 0;
+    EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
+    EVP_DigestSignInit(mdctx, nullptr, md, nullptr, key);
+    EVP_DigestSignUpdate(mdctx, dataBytes.data(), dataBytes.size());
+    EVP_DigestSignFinal(mdctx, nullptr, &sigLen);
+    unsigned char *sig = (unsigned char *)OPENSSL_malloc(sigLen);
+    EVP_DigestSignFinal(mdctx, sig, &sigLen);
+    QByteArray signature(Codec::base64Length((int)sigLen), Qt::Uninitialized);
+    Codec::toBase64(sig, (int)sigLen, signature.data());
+    OPENSSL_free(sig);
+    EVP_MD_CTX_free(mdctx);
+    return QString::fromLatin1(signature);
+}
+
+static void sign(Benchmark::Run &run, KeyType type, const char *algorithm)
+{
+    SignatureHelper helper;
+    if (!loadHelper(helper, run, type, algorithm))
+        return;
+
+    QString data = QString::fromLatin1(REQUEST_DATA);
+    run.setBytesPerOp(data.size());
+    run.measure([&]
+                {
+                    QString signature = helper.signData(data);
+                    Benchmark::keep(signature); });
+}
+
+static void verify(Benchmark::Run &run, KeyType type, const char *algorithm)
+{
+    SignatureHelper helper;
+    if (!loadHelper(helper, run, type, algorithm))
+        return;
+
+    QString data = QString::fromLatin1(RESPONSE_DATA);
+    QString signature = helper.signData(data);
+    if (!helper.verifySignature(data, signature))
+    {
+        run.fail("signature does not verify");
+        return;
+    }
+
+    run.setBytesPerOp(data.size());
+    run.measure([&]
+                {
+                    bool valid = helper.verifySignature(data, signature);
+                    Benchmark::keep(valid); });
+}
+
+BENCHMARK(signSha1, "crypto/sign/sha1_rsa2048") { sign(run, KeyRsa2048, "SHA1withRSA"); }
+BENCHMARK(signSha256, "crypto/sign/sha256_rsa2048") { sign(run, KeyRsa2048, "SHA256withRSA"); }
+BENCHMARK(signEcdsa, "crypto/sign/sha256_ecdsa_p256") { sign(run, KeyP256, "SHA256withECDSA"); }
+BENCHMARK(signEd25519, "crypto/sign/ed25519") { sign(run, KeyEd25519, "Ed25519"); }
+BENCHMARK(verifySha1, "crypto/verify/sha1_rsa2048") { verify(run, KeyRsa2048, "SHA1withRSA"); }
+BENCHMARK(verifySha256, "crypto/verify/sha256_rsa2048") { verify(run, KeyRsa2048, "SHA256withRSA"); }
+BENCHMARK(verifyEcdsa, "crypto/verify/sha256_ecdsa_p256") { verify(run, KeyP256, "SHA256withECDSA"); }
+BENCHMARK(verifyEd25519, "crypto/verify/ed25519") { verify(run, KeyEd25519, "Ed25519"); }
+
+BENCHMARK(signLegacy, "crypto/sign/sha1_rsa2048_legacy")
+{
+    const TestKeys &keys = testKeys(KeyRsa2048);
+    FILE *pfx = keys.ok ? fopen(keys.pfxPath.toLocal8Bit().constData(), "rb") : nullptr;
+    PKCS12 *p12 = pfx ? d2i_PKCS12_fp(pfx, nullptr) : nullptr;
+    if (pfx)
+        fclose(pfx);
+    EVP_PKEY *key = nullptr;
+    X509 *cert = nullptr;
+    if (!p12 || !PKCS12_parse(p12, KEY_PASSWORD, &key, &cert, nullptr))
+    {
+        PKCS12_free(p12);
+        run.fail("test key setup failed");
+        return;
+    }
+    PKCS12_free(p12);
+    X509_free(cert);
+
+    QString data = QString::fromLatin1(REQUEST_DATA);
+    QString algorithm = "SHA1withRSA";
+    run.setBytesPerOp(data.size());
+    run.measure([&]
+                {
+                    QString signature = legacySign(key, data, algorithm);
+                    Benchmark::keep(signature); });
+    EVP_PKEY_free(key);
+}
+
+/*******************************************************************************
+ * ApiClient
+ *******************************************************************************/
+
+BENCHMARK(buildPayload, "api/build_payload")
+{
+    ApiClient client;
+    if (!initializeClient(client, run))
+        return;
+
+    QString uid = "04080A1B2C3D4E";
+    QString cardData = "0102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F202122232425262728292A2B2C2D2E2F30";
+    const LatencyHistogram &h = TapMetrics::histogram(TapMetrics::BuildPayload);
+    uint64_t count0 = h.count(), sum0 = h.sumUs();
+
+    run.measure([&]
+                {
+                    ApiClient::Request request = client.prepareCardTap(uid, cardData);
+                    Benchmark::keep(request); });
+    run.counter("excluding_sign_ns", phaseMeanNs(TapMetrics::BuildPayload, count0, sum0));
+}
+
+// An RSA-2048 signature in base64, for the excluding_sign pair below
+static const int SIGNATURE_LENGTH = 344;
+
+// What a request cost before the request template, apart from signing: the
+// QString::arg chain for the data, the body wrapped around it, and the header
+// list rebuilt by every post()
+static QByteArray legacyBuildPayload(const QString &cardNumber, const QString &cardData, double amount,
+                                     const QString &signature)
+{
+    Config::Snapshot snapshot;
+    const Config &config = *snapshot;
+    qint64 timestamp = QDateTime::currentMSecsSinceEpoch();
+    QString readableTime = QDateTime::fromMSecsSinceEpoch(timestamp).toString("yyyy-MM-dd HH:mm:ss");
+    QString transactionId = QString("afcs-tom%1").arg(timestamp);
+    QString data = QString("{"
+                           "\"amount\": %1,"
+                           "\"cardData\": \"%2\","
+                           "\"fareMediaCode\": \"%3\","
+                           "\"cardNumber\": \"%4\","
+                           "\"entryTime\": \"%5\","
+                           "\"stationCode\": \"%6\","
+                           "\"tapChannel\": \"%7\","
+                           "\"cardTypeId\": %8,"
+                           "\"requestTime\": \"%5\","
+                           "\"reservedField1\": \"\","
+                           "\"reservedField2\": \"\","
+                           "\"reservedField3\": \"\","
+                           "\"transactionId\": \"%9\""
+                           "}")
+                       .arg(amount)
+                       .arg(cardData)
+                       .arg(config.fareMediaCode)
+                       .arg(cardNumber)
+                       .arg(readableTime)
+                       .arg(config.stationCode)
+                       .arg(config.tapChannel)
+                       .arg(config.cardTypeId)
+                       .arg(transactionId);
+    QByteArray body = QString("{\"data\": %1, \"signature\": \"%2\"}").arg(data, signature).toUtf8();
+
+    QList<QByteArray> headerLines;
+    headerLines << "Content-Type: application/json"
+                << "Accept: application/json"
+                << QString("Device: %1").arg(config.deviceName).toUtf8()
+                << QString("Afcs-Code: %1").arg(config.deviceCode).toUtf8()
+                << QString("Version-Number: %1").arg(config.deviceVersion).toUtf8()
+                << QString("Agent-Code: %1").arg(config.agentCode).toUtf8()
+                << QString("Cashier-Code: %1").arg(config.cashierName).toUtf8();
+    curl_slist *headers = nullptr;
+    for (int i = 0; i < headerLines.size(); i++)
+        headers = curl_slist_append(headers, headerLines[i].constData());
+    Benchmark::keep(headers);
+    curl_slist_free_all(headers);
+    return body;
+}
+
+// Data, body and headers of one request with a fixed signature, so that
+// allocs_per_op is the payload's alone
+BENCHMARK(buildPayloadExcludingSign, "api/build_payload/excluding_sign")
+{
+    ApiClient client;
+    if (!initializeClient(client, run))
+        return;
+
+    QString uid = "04080A1B2C3D4E";
+    QString cardData = "0102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F202122232425262728292A2B2C2D2E2F30";
+    QByteArray signature(SIGNATURE_LENGTH, 'A');
+    run.measure([&]
+                {
+                    ApiClient::Request request = client.buildCardTap(uid, cardData);
+                    RequestTemplate::wrap(request.body, request.data, signature);
+                    Benchmark::keep(request); });
+}
+
+BENCHMARK(buildPayloadExcludingSignLegacy, "api/build_payload/excluding_sign_legacy")
+{
+    QString uid = "04080A1B2C3D4E";
+    QString cardData = "0102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F202122232425262728292A2B2C2D2E2F30";
+    QString signature(SIGNATURE_LENGTH, QLatin1Char('A'));
+    run.measure([&]
+                {
+                    QByteArray body = legacyBuildPayload(uid, cardData, 750.0, signature);
+                    Benchmark::keep(body); });
+}
+
+static QByteArray signedResponse(Benchmark::Run &run)
+{
+    SignatureHelper helper;
+    if (!loadHelper(helper, run))
+        return QByteArray();
+
+    QString data = QString::fromLatin1(RESPONSE_DATA);
+    return QString("{\"data\": %1, \"signature\": \"%2\"}").arg(data, helper.signData(data)).toUtf8();
+}
+
+// Deferred mode hands verification to the audit thread, blocking mode
+// verifies inline; excluding_verify_ns is the parse alone in both
+static void parseResponse(Benchmark::Run &run, const char *verifyMode)
+{
+    ApiClient client;
+    if (!initializeClient(client, run, verifyMode))
+        return;
+    QByteArray body = signedResponse(run);
+    if (body.isEmpty())
+        return;
+    if (!client.parseResponse(200, body).success)
+    {
+        run.fail("response does not parse");
+        return;
+    }
+
+    const LatencyHistogram &h = TapMetrics::histogram(TapMetrics::ParseResponse);
+    uint64_t count0 = h.count(), sum0 = h.sumUs();
+    run.setBytesPerOp(body.size());
+    run.measure([&]
+                {
+                    ApiClient::Response response = client.parseResponse(200, body);
+                    Benchmark::keep(response); });
+    run.counter("excluding_verify_ns", phaseMeanNs(TapMetrics::ParseResponse, count0, sum0));
+}
+
+BENCHMARK(parseResponseDeferred, "api/parse_response") { parseResponse(run, "deferred"); }
+BENCHMARK(parseResponseBlocking, "api/parse_response_blocking") { parseResponse(run, "blocking"); }
+
+// The streaming parse alone, as curl hands the body over: whole, or in
+// chunks_64 the worst case of small TCP segments
+static void responseParser(Benchmark::Run &run, int chunkSize)
+{
+    QByteArray body = signedResponse(run);
+    if (body.isEmpty())
+        return;
+
+    ResponseParser parser;
+    run.setBytesPerOp(body.size());
+    run.measure([&]
+                {
+                    parser.reset();
+                    for (int i = 0; i < body.size(); i += chunkSize)
+                        parser.feed(body.constData() + i, qMin(chunkSize, body.size() - i));
+                    Benchmark::keep(parser.data()); });
+    if (!parser.isComplete() || parser.dataFields().status != "AS")
+        run.fail("response does not parse");
+}
+
+BENCHMARK(responseParserWhole, "api/response_parser") { responseParser(run, 1 << 20); }
+BENCHMARK(responseParserChunks, "api/response_parser/chunks_64") { responseParser(run, 64); }
+
+/*******************************************************************************
+ * Tap submission
+ *******************************************************************************/
+
+// One op submits `taps` taps as one batch, taps_per_s is taps end to end:
+// build, sign, POST, server response and parse
+static void tapsPerSecond(Benchmark::Run &run, int taps, bool batchSupported)
+{
+    SignatureHelper serverSigner;
+    if (!loadHelper(serverSigner, run))
+        return;
+    MockApiServer server(&serverSigner);
+    if (!server.start(batchSupported))
+    {
+        run.fail("mock server did not start");
+        return;
+    }
+
+    Config saved = *Config::Snapshot();
+    Config config = saved;
+    config.apiUrl = server.url();
+    config.batchUrl.clear();
+    Config::publish(config);
+
+    ApiClient client;
+    if (initializeClient(client, run))
+    {
+        QString uid = "04080A1B2C3D4E";
+        QString cardData = "0102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F202122232425262728292A2B2C2D2E2F30";
+        QVector<ApiClient::Request> requests(taps);
+        auto submit = [&]() -> QVector<ApiClient::Response>
+        {
+            for (int i = 0; i < taps; i++)
+                requests[i] = client.buildCardTap(uid, cardData);
+            return client.sendBatch(requests);
+        };
+
+        // Also settles the fallback before timing starts
+        QVector<ApiClient::Response> responses = submit();
+        bool ok = responses.size() == taps;
+        for (int i = 0; ok && i < taps; i++)
+            ok = responses[i].success;
+        if (!ok)
+        {
+            run.fail("mock server rejected the taps");
+        }
+        else
+        {
+            quint64 requests0 = server.requests();
+            qint64 ops = 0;
+            run.measure([&]
+                        {
+                            QVector<ApiClient::Response> responses = submit();
+                            Benchmark::keep(responses);
+                            ops++; });
+            run.counter("taps_per_s", run.meanNs() > 0 ? taps * 1e9 / run.meanNs() : 0.0);
+            run.counter("http_requests_per_op", (double)(server.requests() - requests0) / ops);
+        }
+    }
+
+    Config::publish(saved);
+}
+
+BENCHMARK(tapsBatch1, "api/taps_per_s/batch_1") { tapsPerSecond(run, 1, true); }
+BENCHMARK(tapsBatch8, "api/taps_per_s/batch_8") { tapsPerSecond(run, 8, true); }
+BENCHMARK(tapsBatch32, "api/taps_per_s/batch_32") { tapsPerSecond(run, 32, true); }
+BENCHMARK(tapsBatch8Fallback, "api/taps_per_s/batch_8_fallback") { tapsPerSecond(run, 8, false); }
+
+/*******************************************************************************
+ * Asynchronous requests
+ *******************************************************************************/
+
+// Sustained requests per second of one pre-signed tap: inFlight 0 sends them
+// one after the other with send(), otherwise sendAsync() keeps inFlight
+// requests on the wire and every op waits for one to complete and posts the
+// next. Request signing is not measured, response parsing is.
+static void requestsPerSecond(Benchmark::Run &run, int inFlight)
+{
+    SignatureHelper serverSigner;
+    if (!loadHelper(serverSigner, run))
+        return;
+    MockApiServer server(&serverSigner);
+    if (!server.start(true))
+    {
+        run.fail("mock server did not start");
+        return;
+    }
+
+    Config saved = *Config::Snapshot();
+    Config config = saved;
+    config.apiUrl = server.url();
+    config.apiMaxConnections = qMax(1, inFlight);
+    Config::publish(config);
+
+    {
+        ApiClient client;
+        if (initializeClient(client, run))
+        {
+            ApiClient::Request request = client.prepareCardTap("04080A1B2C3D4E", "0102030405060708");
+            if (inFlight == 0)
+            {
+                std::atomic<int> failures(0);
+                run.measure([&]
+                            {
+                                if (!client.send(request).success)
+                                    failures++; });
+                if (failures > 0)
+                    run.fail("mock server rejected the requests");
+            }
+            else
+            {
+                QSemaphore completed;
+                std::atomic<int> failures(0);
+                ApiClient::ResponseCallback callback = [&](const ApiClient::Response &response)
+                {
+                    if (!response.success)
+                        failures++;
+                    completed.release();
+                };
+                auto submit = [&]()
+                {
+                    if (!client.sendAsync(request, callback))
+                    {
+                        failures++;
+                        completed.release();
+                    }
+                };
+
+                for (int i = 0; i < inFlight; i++)
+                    submit();
+                run.measure([&]
+                            {
+                                completed.acquire();
+                                submit(); });
+                completed.acquire(inFlight);
+                if (failures > 0)
+                    run.fail("mock server rejected the requests");
+            }
+            run.counter("requests_per_s", run.meanNs() > 0 ? 1e9 / run.meanNs() : 0.0);
+        }
+    }
+
+    Config::publish(saved);
+}
+
+BENCHMARK(requestsBlocking, "api/requests_per_s/blocking") { requestsPerSecond(run, 0); }
+BENCHMARK(requestsAsync1, "api/requests_per_s/async_1") { requestsPerSecond(run, 1); }
+BENCHMARK(requestsAsync4, "api/requests_per_s/async_4") { requestsPerSecond(run, 4); }
+BENCHMARK(requestsAsync16, "api/requests_per_s/async_16") { requestsPerSecond(run, 16); }
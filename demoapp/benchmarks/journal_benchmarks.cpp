@@ -0,0 +1,34 @@
+/*******************************************************************************
+ * Journal Benchmarks - storing a tap while the server is unreachable
+ *
+ * journal/append is what the send stage pays per offline tap: CRC and copy
+ * into the mapped journal, with the sync thread flushing every 10 ms in the
+ * background and a drain thread taking records off as the server would. The
+ * journal is sized so appends never outrun the flushes.
+ *******************************************************************************/
+
+#include "benchmark.hpp"
+#include "tap_journal.hpp"
+#include <QTemporaryDir>
+
+BENCHMARK(journalAppend, "journal/append")
+{
+    QTemporaryDir dir;
+    TapJournal journal;
+    if (!dir.isValid() || !journal.open(dir.filePath("tap_journal.bin"), 64 * 1024 * 1024, 10))
+    {
+        run.fail("journal setup failed");
+        return;
+    }
+    journal.startDrain([](const QByteArray &) { return true; }, 1, 1);
+
+    // A typical signed single-tap request body
+    QByteArray body(900, 'x');
+    bool ok = true;
+    run.setBytesPerOp(body.size());
+    run.measure([&]
+                { ok &= journal.append(body); });
+    journal.close();
+    if (!ok)
+        run.fail("journal full");
+}
@@ -0,0 +1,257 @@
+/*******************************************************************************
+ * Mock API Server Implementation
+ *******************************************************************************/
+
+#include "mock_api_server.hpp"
+#include "signature_helper.hpp"
+#include <QDebug>
+#include <QStringList>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// How often the blocked loops look at the stop flag
+static const int POLL_INTERVAL_MS = 100;
+
+static const char RESULT_TEMPLATE[] =
+    "{\"status\":\"AS\",\"statusCode\":\"2101\",\"message\":\"Transaction successful\","
+    "\"transactionId\":\"%1\",\"fareMediaTap\":{\"cardNumber\":\"04080A1B2C3D4E\","
+    "\"balance\":12500,\"fare\":750,\"stationCode\":\"VKZ123\"}}";
+
+MockApiServer::MockApiServer(SignatureHelper *signer)
+    : _signer(signer), _batchSupported(true), _listenFd(-1), _port(0), _running(false), _requests(0)
+{
+}
+
+MockApiServer::~MockApiServer()
+{
+    stop();
+}
+
+bool MockApiServer::start(bool batchSupported)
+{
+    if (_running)
+        return true;
+
+    _batchSupported = batchSupported;
+    _listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (_listenFd < 0)
+    {
+        qDebug() << "Failed to create mock server socket:" << strerror(errno);
+        return false;
+    }
+
+    // Port 0, the kernel picks a free one
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (bind(_listenFd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(_listenFd, 64) != 0 ||
+        getsockname(_listenFd, (struct sockaddr *)&address, &length) != 0)
+    {
+        qDebug() << "Failed to listen on the mock server socket:" << strerror(errno);
+        close(_listenFd);
+        _listenFd = -1;
+        return false;
+    }
+
+    _port = ntohs(address.sin_port);
+    _running = true;
+    _thread = std::thread(&MockApiServer::run, this);
+    return true;
+}
+
+void MockApiServer::stop()
+{
+    if (!_running)
+        return;
+
+    _running = false;
+    if (_thread.joinable())
+        _thread.join();
+    for (size_t i = 0; i < _connections.size(); i++)
+        _connections[i].join();
+    _connections.clear();
+
+    close(_listenFd);
+    _listenFd = -1;
+}
+
+QString MockApiServer::url() const
+{
+    return QString("http://127.0.0.1:%1/tap").arg(_port);
+}
+
+void MockApiServer::run()
+{
+    while (_running)
+    {
+        struct pollfd pfd;
+        pfd.fd = _listenFd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, POLL_INTERVAL_MS) <= 0)
+            continue;
+
+        int client = accept4(_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0)
+            continue;
+
+        // Responses go out in one send, no need to wait for more to coalesce
+        int one = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        _connections.push_back(std::thread([this, client]
+                                           {
+                                               serve(client);
+                                               close(client); }));
+    }
+}
+
+static bool sendAll(int fd, const QByteArray &data)
+{
+    const char *p = data.constData();
+    int left = data.size();
+    while (left > 0)
+    {
+        ssize_t sent = send(fd, p, left, MSG_NOSIGNAL);
+        if (sent <= 0)
+        {
+            if (sent < 0 && errno == EINTR)
+                continue;
+            return false;
+        }
+        p += sent;
+        left -= (int)sent;
+    }
+    return true;
+}
+
+// Value of a header line in the request head, case-insensitive name
+static QByteArray headerValue(const QByteArray &head, const char *name)
+{
+    QByteArray lower = head.toLower();
+    QByteArray key = QByteArray("\r\n") + QByteArray(name).toLower() + ':';
+    int start = lower.indexOf(key);
+    if (start < 0)
+        return QByteArray();
+    start += key.size();
+    int end = head.indexOf("\r\n", start);
+    return head.mid(start, (end < 0 ? head.size() : end) - start).trimmed();
+}
+
+void MockApiServer::serve(int fd)
+{
+    // Keep-alive: requests are answered in turn until the client hangs up
+    QByteArray buffer;
+    char chunk[16384];
+    bool continueSent = false;
+    while (_running)
+    {
+        int headEnd = buffer.indexOf("\r\n\r\n");
+        if (headEnd >= 0)
+        {
+            QByteArray head = buffer.left(headEnd);
+            int bodyLength = headerValue(head, "Content-Length").toInt();
+            int bodyStart = headEnd + 4;
+
+            // curl holds larger bodies back until it hears 100 Continue
+            if (!continueSent && buffer.size() == bodyStart && bodyLength > 0 &&
+                headerValue(head, "Expect").toLower() == "100-continue")
+            {
+                if (!sendAll(fd, "HTTP/1.1 100 Continue\r\n\r\n"))
+                    return;
+                continueSent = true;
+            }
+
+            if (buffer.size() >= bodyStart + bodyLength)
+            {
+                int lineEnd = head.indexOf("\r\n");
+                QList<QByteArray> requestLine = head.left(lineEnd < 0 ? head.size() : lineEnd).split(' ');
+                QByteArray path = requestLine.size() > 1 ? requestLine[1] : QByteArray();
+                QByteArray body = buffer.mid(bodyStart, bodyLength);
+                buffer.remove(0, bodyStart + bodyLength);
+                continueSent = false;
+
+                _requests++;
+                if (!sendAll(fd, respond(path, body)))
+                    return;
+                continue;
+            }
+        }
+
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, POLL_INTERVAL_MS) <= 0)
+            continue;
+        ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+        if (received <= 0)
+        {
+            if (received < 0 && errno == EINTR)
+                continue;
+            return;
+        }
+        buffer.append(chunk, (int)received);
+    }
+}
+
+// Transaction IDs of the taps in a request body, in order
+static QStringList transactionIds(const QByteArray &body)
+{
+    QStringList ids;
+    static const QByteArray key("\"transactionId\"");
+    int pos = 0;
+    while ((pos = body.indexOf(key, pos)) >= 0)
+    {
+        int start = body.indexOf('"', pos + key.size()) + 1;
+        int end = start > 0 ? body.indexOf('"', start) : -1;
+        if (end < 0)
+            break;
+        ids << QString::fromLatin1(body.mid(start, end - start));
+        pos = end + 1;
+    }
+    return ids;
+}
+
+QByteArray MockApiServer::respond(const QByteArray &path, const QByteArray &body)
+{
+    QStringList ids = transactionIds(body);
+    QByteArray response;
+    if (path == "/tap" && ids.size() == 1)
+    {
+        response = signedResponse(QString::fromLatin1(RESULT_TEMPLATE).arg(ids[0]));
+    }
+    else if (path == "/tap/batch" && _batchSupported && !ids.isEmpty())
+    {
+        QString data = "{\"results\":[";
+        for (int i = 0; i < ids.size(); i++)
+        {
+            if (i > 0)
+                data += ',';
+            data += QString::fromLatin1(RESULT_TEMPLATE).arg(ids[i]);
+        }
+        data += "]}";
+        response = signedResponse(data);
+    }
+
+    if (response.isEmpty())
+        return QByteArray("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+
+    QByteArray message;
+    message.reserve(response.size() + 96);
+    message.append("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: ");
+    message.append(QByteArray::number(response.size()));
+    message.append("\r\n\r\n");
+    message.append(response);
+    return message;
+}
+
+QByteArray MockApiServer::signedResponse(const QString &data)
+{
+    return QString("{\"data\": %1, \"signature\": \"%2\"}").arg(data, _signer->signData(data)).toUtf8();
+}
@@ -0,0 +1,54 @@
+/*******************************************************************************
+ * Mock API Server - local stand-in for the fare media tap endpoint
+ *
+ * HTTP/1.1 with keep-alive on 127.0.0.1, a thread per connection:
+ *   POST /tap        single tap, answers a signed success for its transaction
+ *   POST /tap/batch  batch envelope, one signed result per item (404 when
+ *                    started without batch support, to exercise the fallback)
+ * Responses are signed like the real server's, so ApiClient parses and
+ * verifies them exactly as in production.
+ *******************************************************************************/
+
+#ifndef MOCK_API_SERVER_HPP
+#define MOCK_API_SERVER_HPP
+
+#include <QByteArray>
+#include <QString>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+class SignatureHelper;
+
+class MockApiServer
+{
+public:
+    // signer must have a private key loaded and outlive the server
+    explicit MockApiServer(SignatureHelper *signer);
+    ~MockApiServer();
+
+    bool start(bool batchSupported);
+    void stop();
+
+    // Base URL of the single tap endpoint, e.g. http://127.0.0.1:40123/tap
+    QString url() const;
+
+    quint64 requests() const { return _requests; }
+
+private:
+    void run();
+    void serve(int fd);
+    QByteArray respond(const QByteArray &path, const QByteArray &body);
+    QByteArray signedResponse(const QString &data);
+
+    SignatureHelper *_signer;
+    bool _batchSupported;
+    int _listenFd;
+    quint16 _port;
+    std::thread _thread;
+    std::vector<std::thread> _connections; // Accept thread only
+    std::atomic<bool> _running;
+    std::atomic<quint64> _requests;
+};
+
+#endif // MOCK_API_SERVER_HPP
@@ -0,0 +1,156 @@
+/*******************************************************************************
+ * Reader Benchmarks - card reads against the simulated coupler
+ *
+ * The plain variants run with zero RF latency and measure the host-side cost
+ * of a read. The _rf variants use the coupler_sim.ini latencies, so their
+ * ns_per_op approximates the tap time on the real reader.
+ *******************************************************************************/
+
+#include "benchmark.hpp"
+#include "card_reader.hpp"
+#include "config.hpp"
+#include "iso15693_reader.hpp"
+#include "simulated_coupler.hpp"
+#include "ultralight_reader.hpp"
+
+static const int FOREVER_MS = 1000000000;
+
+static void setRfLatency(SimulatedCoupler &coupler)
+{
+    coupler.setLatency(SimulatedCoupler::CmdSearch, 4000);
+    coupler.setLatency(SimulatedCoupler::CmdLoadKey, 3000);
+    coupler.setLatency(SimulatedCoupler::CmdAuthenticate, 6000);
+    coupler.setLatency(SimulatedCoupler::CmdReadBlock, 5000);
+    coupler.setLatency(SimulatedCoupler::CmdExchange, 3000);
+    coupler.setExchangeByteTime(300);
+    coupler.setTclByteTime(80);
+}
+
+// One card that never leaves the field
+static void placeCard(SimulatedCoupler &coupler, SimulatedCoupler::Card card, bool rf)
+{
+    card.arrivalMs = 0;
+    card.dwellMs = FOREVER_MS;
+    coupler.addCard(card);
+    if (rf)
+        setRfLatency(coupler);
+    coupler.open();
+}
+
+/*******************************************************************************
+ * ISO15693: Read Multiple Blocks against Read Single Block
+ *******************************************************************************/
+
+static void iso15693(Benchmark::Run &run, int maxBlocksPerRead, bool rf)
+{
+    SimulatedCoupler coupler;
+    SimulatedCoupler::Card card;
+    card.com = 9;
+    card.atr = QByteArray::fromHex("0102030405A004E0");
+    card.blockSize = 4;
+    card.blockCount = 28;
+    placeCard(coupler, card, rf);
+
+    Iso15693Reader reader(&coupler, maxBlocksPerRead);
+    Iso15693Reader::Result result;
+    if (!reader.read(result))
+    {
+        run.fail(result.error);
+        return;
+    }
+
+    run.setBytesPerOp(result.data.size());
+    run.measure([&]
+                {
+                    Iso15693Reader::Result r;
+                    reader.read(r);
+                    Benchmark::keep(r); });
+    run.counter("commands", result.commands);
+}
+
+BENCHMARK(iso15693Single, "reader/iso15693/single") { iso15693(run, 1, false); }
+BENCHMARK(iso15693Multi, "reader/iso15693/multi") { iso15693(run, 32, false); }
+BENCHMARK(iso15693SingleRf, "reader/iso15693/single_rf") { iso15693(run, 1, true); }
+BENCHMARK(iso15693MultiRf, "reader/iso15693/multi_rf") { iso15693(run, 32, true); }
+
+/*******************************************************************************
+ * Ultralight / NTAG216: FAST_READ against the four-page READ loop
+ *******************************************************************************/
+
+static void ultralight(Benchmark::Run &run, bool fastRead, bool rf)
+{
+    SimulatedCoupler coupler;
+    SimulatedCoupler::Card card;
+    card.com = 5;
+    card.atr = QByteArray::fromHex("04045566778899");
+    card.version = QByteArray::fromHex("0004040201001303");
+    placeCard(coupler, card, rf);
+
+    UltralightReader reader(&coupler, 64, fastRead);
+    UltralightReader::Result result;
+    if (!reader.read(result))
+    {
+        run.fail(result.error);
+        return;
+    }
+
+    run.setBytesPerOp(result.data.size());
+    run.measure([&]
+                {
+                    UltralightReader::Result r;
+                    reader.read(r);
+                    Benchmark::keep(r); });
+    run.counter("commands", result.commands);
+    run.counter("pages", result.pages);
+}
+
+BENCHMARK(ultralightRead, "reader/ultralight/read") { ultralight(run, false, false); }
+BENCHMARK(ultralightFastRead, "reader/ultralight/fast_read") { ultralight(run, true, false); }
+BENCHMARK(ultralightReadRf, "reader/ultralight/read_rf") { ultralight(run, false, true); }
+BENCHMARK(ultralightFastReadRf, "reader/ultralight/fast_read_rf") { ultralight(run, true, true); }
+
+/*******************************************************************************
+ * Full scanCard() of a MIFARE Classic 1K: detect, authenticate, read plan
+ *******************************************************************************/
+
+static void scanClassic(Benchmark::Run &run, bool rf)
+{
+    Config config = *Config::Snapshot();
+    config.classic1KPlan = ReadPlan::parse(QStringList() << "1:4-6" << "2", config.keyA, 16);
+    Config::publish(config);
+
+    SimulatedCoupler *coupler = new SimulatedCoupler();
+    SimulatedCoupler::Card card;
+    card.com = 5;
+    card.atr = QByteArray::fromHex("04080A1B2C3D4E");
+    card.arrivalMs = 0;
+    card.dwellMs = FOREVER_MS;
+    coupler->addCard(card);
+    if (rf)
+        setRfLatency(*coupler);
+
+    CardReader reader(coupler);
+    if (!reader.initialize())
+    {
+        run.fail("simulated coupler did not initialize");
+        return;
+    }
+    quint64 commands = coupler->stats().commands();
+    CardReader::CardData data = reader.scanCard(1);
+    if (!data.success)
+    {
+        run.fail(data.errorMessage);
+        return;
+    }
+    commands = coupler->stats().commands() - commands;
+
+    run.setBytesPerOp(data.rawData.size());
+    run.measure([&]
+                {
+                    CardReader::CardData d = reader.scanCard(1);
+                    Benchmark::keep(d); });
+    run.counter("commands", commands);
+}
+
+BENCHMARK(classicTap, "reader/tap/classic1k") { scanClassic(run, false); }
+BENCHMARK(classicTapRf, "reader/tap/classic1k_rf") { scanClassic(run, true); }
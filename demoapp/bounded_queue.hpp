@@ -0,0 +1,119 @@
+/*******************************************************************************
+ * Bounded Queue - blocking FIFO with back-pressure between pipeline stages
+ *******************************************************************************/
+
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QQueue>
+#include <QWaitCondition>
+
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(int capacity = 1) : _capacity(qMax(1, capacity)), _closed(false) {}
+
+    void setCapacity(int capacity)
+    {
+        QMutexLocker lock(&_mutex);
+        _capacity = qMax(1, capacity);
+        _notFull.wakeAll();
+    }
+
+    // Blocks while the queue is full. Returns false once the queue is closed.
+    bool push(const T &item)
+    {
+        QMutexLocker lock(&_mutex);
+        while (!_closed && _items.size() >= _capacity)
+            _notFull.wait(&_mutex);
+        if (_closed)
+            return false;
+        _items.enqueue(item);
+        _notEmpty.wakeOne();
+        return true;
+    }
+
+    // Never blocks. Returns false when the queue is full or closed.
+    bool tryPush(const T &item)
+    {
+        QMutexLocker lock(&_mutex);
+        if (_closed || _items.size() >= _capacity)
+            return false;
+        _items.enqueue(item);
+        _notEmpty.wakeOne();
+        return true;
+    }
+
+    // Blocks while the queue is empty. Returns false once closed and drained.
+    bool pop(T &item)
+    {
+        QMutexLocker lock(&_mutex);
+        while (!_closed && _items.isEmpty())
+            _notEmpty.wait(&_mutex);
+        if (_items.isEmpty())
+            return false;
+        item = _items.dequeue();
+        _notFull.wakeOne();
+        return true;
+    }
+
+    // As pop(), but gives up after timeoutMs
+    bool popFor(T &item, int timeoutMs)
+    {
+        QMutexLocker lock(&_mutex);
+        QElapsedTimer timer;
+        timer.start();
+        while (!_closed && _items.isEmpty())
+        {
+            qint64 left = timeoutMs - timer.elapsed();
+            if (left <= 0 || !_notEmpty.wait(&_mutex, (unsigned long)left))
+                break;
+        }
+        if (_items.isEmpty())
+            return false;
+        item = _items.dequeue();
+        _notFull.wakeOne();
+        return true;
+    }
+
+    void close()
+    {
+        QMutexLocker lock(&_mutex);
+        _closed = true;
+        _notEmpty.wakeAll();
+        _notFull.wakeAll();
+    }
+
+    void reopen()
+    {
+        QMutexLocker lock(&_mutex);
+        _items.clear();
+        _closed = false;
+    }
+
+    bool isClosed() const
+    {
+        QMutexLocker lock(&_mutex);
+        return _closed;
+    }
+
+    int size() const
+    {
+        QMutexLocker lock(&_mutex);
+        return _items.size();
+    }
+
+private:
+    mutable QMutex _mutex;
+    QWaitCondition _notEmpty;
+    QWaitCondition _notFull;
+    QQueue<T> _items;
+    int _capacity;
+    bool _closed;
+};
+
+#endif // BOUNDED_QUEUE_HPP
@@ -3,67 +3,168 @@
  *******************************************************************************/
 
 #include "card_reader.hpp"
+#include "codec.hpp"
 #include "config.hpp"
+#include "iso15693_reader.hpp"
+#include "log.hpp"
+#include "simulated_coupler.hpp"
+#include "tap_metrics.hpp"
+#include "tcl_transport.hpp"
+#include "ultralight_reader.hpp"
+#ifndef DEMOAPP_HOST_BUILD
+#include "hardware_coupler.hpp"
+#endif
 #include <unistd.h>
 #include <cstdio>
 #include <sstream>
 #include <iomanip>
 #include <cstring>
 #include <QDebug>
+#include <QElapsedTimer>
 
-using namespace als::Utils;
+static PollScheduler::Settings pollSettings(const Config &config)
+{
+    PollScheduler::Settings polling;
+    polling.minIntervalMs = config.pollMinIntervalMs;
+    polling.maxIntervalMs = config.pollMaxIntervalMs;
+    polling.activeWindowMs = config.pollActiveWindowMs;
+    polling.backoff = config.pollBackoff;
+    return polling;
+}
 
-CardReader::CardReader() : _initialized(false) {}
+// What preloadKeys() puts into the reader slots: the slot range and the keys
+// of both Classic plans
+static QByteArray keyLayout(const Config &config)
+{
+    QByteArray layout = QByteArray::number(config.keySlotBase) + ':' + QByteArray::number(config.keySlotCount);
+    const ReadPlan *plans[] = {&config.classic1KPlan, &config.classic4KPlan};
+    for (int p = 0; p < 2; p++)
+    {
+        layout += ';';
+        foreach (const ReadPlan::Sector &sector, plans[p]->sectors)
+            layout.append((const char *)sector.key, 6);
+    }
+    return layout;
+}
+
+CardReader::CardReader()
+    : _initialized(false), _stopRequested(false), _config(nullptr), _generation(0),
+      _keysLoaded(false), _keyLoadsSaved(0),
+      _readCommandUs(0), _ultralightSavedUs(0)
+{
+    registerDefaultHandlers();
+}
+
+CardReader::CardReader(CouplerBackend *backend)
+    : _backend(backend), _initialized(false), _stopRequested(false), _config(nullptr), _generation(0),
+      _keysLoaded(false), _keyLoadsSaved(0), _readCommandUs(0), _ultralightSavedUs(0)
+{
+    registerDefaultHandlers();
+}
+
+void CardReader::registerDefaultHandlers()
+{
+    // Innovatron has no handler yet and fails as not implemented
+    registerHandler(CardFamily::MifareClassic1K, [this](CardData &card)
+                    { return processMifareClassic(_config->classic1KPlan, card); });
+    registerHandler(CardFamily::MifareClassic4K, [this](CardData &card)
+                    { return processMifareClassic(_config->classic4KPlan, card); });
+    registerHandler(CardFamily::MifareUltralight, [this](CardData &card)
+                    { return processMifareUL(card); });
+    registerHandler(CardFamily::Iso14443_4, [this](CardData &card)
+                    { return processIso14443_4(card); });
+    registerHandler(CardFamily::Iso15693, [this](CardData &card)
+                    { return processIso15693(card); });
+}
+
+void CardReader::registerHandler(CardFamily family, CardHandler handler)
+{
+    _handlers[(int)family] = handler;
+}
 
 CardReader::~CardReader()
 {
     shutdown();
 }
 
-bool CardReader::initialize()
+CouplerBackend *CardReader::createBackend()
 {
-    setbuf(stdout, NULL);
+    Config::Snapshot snapshot;
+    const Config &config = *snapshot;
 
-    if (!File::Exists(COUPLER_LINK) && symlink(COUPLER_TTY, COUPLER_LINK) == -1)
+    if (config.readerBackend.compare("simulator", Qt::CaseInsensitive) == 0)
     {
-        qDebug() << "Failed to create symlink to coupler device\n";
-        return 1;
+        SimulatedCoupler *simulator = new SimulatedCoupler();
+        if (!config.simulatorScript.isEmpty())
+            simulator->loadScript(config.simulatorScript);
+        return simulator;
     }
 
-    // Turn on the coupler (for CDB4v2 devices)
-    File::WriteInt32(COUPLER_POWER, 1);
-    if (!_ext.Init(COUPLER_TTY))
-    {
-        qDebug() << "Error initializing coupler tty serial port";
-        File::WriteInt32(COUPLER_POWER, 0);
+#ifdef DEMOAPP_HOST_BUILD
+    qDebug() << "Reader backend" << config.readerBackend << "not available in host builds";
+    return nullptr;
+#else
+    return new HardwareCoupler();
+#endif
+}
+
+bool CardReader::initialize()
+{
+    Config::Snapshot snapshot;
+    const Config &config = *snapshot;
+    setbuf(stdout, NULL);
+
+    if (!_backend)
+        _backend.reset(createBackend());
+
+    if (!_backend)
         return false;
-    }
 
-    if (!_coupler.Init(&_ext))
+    _config = &config;
+    _generation = config.generation;
+    _keyLayout = keyLayout(config);
+    _poller.configure(pollSettings(config));
+
+    qDebug() << "Opening" << _backend->name() << "coupler backend";
+    if (!_backend->open())
     {
-        qDebug() << "Error initializing coupler";
-        File::WriteInt32(COUPLER_POWER, 0);
+        qDebug() << "Error opening coupler backend";
         return false;
     }
 
     if (!waitForReady(90000))
     {
         qDebug() << "Coupler not ready after 90 seconds";
-        File::WriteInt32(COUPLER_POWER, 0);
+        _backend->close();
         return false;
     }
 
+    // Keys stay in the reader until the next coupler reset
+    preloadKeys();
+
     _initialized = true;
     qDebug() << "Card reader initialized successfully";
     return true;
 }
 
+void CardReader::requestStop()
+{
+    _stopRequested = true;
+    _poller.interrupt();
+}
+
+void CardReader::clearStopRequest()
+{
+    _stopRequested = false;
+    _poller.clearInterrupt();
+}
+
 void CardReader::shutdown()
 {
     if (_initialized)
     {
         qDebug() << "Shutting down coupler...";
-        File::WriteInt32(COUPLER_POWER, 0);
+        _backend->close();
         _initialized = false;
     }
 }
@@ -72,265 +173,434 @@ bool CardReader::waitForReady(unsigned int millisecondsTimeout)
 {
     qDebug() << "Waiting for coupler to be ready...";
 
-    uint16 atrLen;
+    uint16_t atrLen;
     uchar atr[256];
-    sCARD_Search search;
-    unsigned char com;
-    uint8 options = 0;
-    unsigned long long t_end = Time::GetMilliSeconds() + millisecondsTimeout;
-
-    memset(&search, 0, sizeof(search));
-
-    while (Time::GetMilliSeconds() < t_end)
+    CardSearchMask search;
+    uint8_t com;
+    QElapsedTimer timer;
+    timer.start();
+
+    // Boot takes seconds, start at 20 ms and back off to a quarter second
+    PollScheduler::Settings settings;
+    settings.minIntervalMs = 20;
+    settings.maxIntervalMs = 250;
+    settings.activeWindowMs = 0;
+    PollScheduler poller(settings);
+
+    // requestStop() ends the wait at the next poll, startup runs this on its
+    // own thread and shutdown must not sit out the full timeout
+    while (!_stopRequested && timer.elapsed() < (qint64)millisecondsTimeout)
     {
-        if (_coupler.SearchCardExt(search, 1, 1, &com, &atrLen, atr, options) == RCSC_Ok)
+        bool ready = _backend->searchCard(search, 1, 1, &com, &atrLen, atr);
+        if (ready)
         {
-            qDebug() << "Coupler is ready!";
+            qDebug() << "Coupler is ready after" << timer.elapsed() << "ms";
             return true;
         }
-        usleep(20000);
+        poller.wait(poller.onPoll(false));
     }
 
-    qDebug() << "Timeout waiting for coupler to be ready";
+    qDebug() << (_stopRequested ? "Stopped waiting for coupler" : "Timeout waiting for coupler to be ready");
     return false;
 }
 
 QString CardReader::bytesToHex(const uchar *data, int length)
 {
-    QString hex;
-    for (int i = 0; i < length; i++)
+    // UIDs and single blocks encode on the stack
+    char buffer[Codec::hexLength(64)];
+    if (length <= 64)
     {
-        hex += QString("%1").arg(data[i], 2, 16, QChar('0')).toUpper();
+        Codec::toHex(data, length, buffer);
+        return QString::fromLatin1(buffer, Codec::hexLength(length));
     }
-    return hex;
+
+    QByteArray hex(Codec::hexLength(length), Qt::Uninitialized);
+    Codec::toHex(data, length, hex.data());
+    return QString::fromLatin1(hex);
 }
 
-bool CardReader::authenticateAndRead(Coupler *coupler, const uint8_t *keyA, int sector,
-                                     int startBlock, int endBlock, QByteArray &outData)
+bool CardReader::authenticateAndRead(const ReadPlan::Sector &plan, uint8_t keyIndex, bool loadKey, char *outData)
 {
-    CouplerMiFARE *mifareCoupler = (CouplerMiFARE *)coupler;
     uchar ucStatus, ucType;
     uchar serialNumber[7];
-    int16 result;
+    bool result;
 
-    // Load key into reader
-    qDebug() << "Loading authentication key...";
-    result = mifareCoupler->LoadReaderKeyIndex(0xFF, (uint8 *)keyA, &ucStatus);
-    if (result != RCSC_Ok || ucStatus != 0)
+    // Load key into reader, sectors sharing a key reuse the loaded one
+    if (loadKey)
     {
-        qDebug() << "Failed to load key: result=" << result << ", status=" << ucStatus;
+        LOG_DEBUG("Loading authentication key into slot {}", keyIndex);
+        {
+            TapMetrics::PhaseTimer timer(TapMetrics::KeyLoad);
+            result = _backend->loadReaderKey(keyIndex, plan.key, &ucStatus);
+        }
+        if (!result || ucStatus != 0)
+        {
+            LOG_WARNING("Failed to load key: result={}, status={}", result, ucStatus);
+            emit authenticationFailed();
+            return false;
+        }
+    }
+
+    // Authenticate sector
+    LOG_DEBUG("Authenticating sector {} with key slot {}", plan.sector, keyIndex);
+    {
+        TapMetrics::PhaseTimer timer(TapMetrics::Authenticate);
+        result = _backend->authenticate(plan.sector, 0x0A, keyIndex, &ucType, serialNumber, &ucStatus);
+    }
+    if (!result || ucStatus != 0)
+    {
+        LOG_WARNING("Authentication failed: result={}, status={}", result, ucStatus);
         emit authenticationFailed();
         return false;
     }
-    else
+
+    // Read data blocks straight into the card buffer
+    LOG_DEBUG("Authenticated, reading blocks {} to {}", plan.firstBlock, plan.lastBlock);
+    for (int block = plan.firstBlock; block <= plan.lastBlock; block++)
     {
-        qDebug() << "LoadReaderKeyIndex result:" << result << ", status:" << ucStatus;
-        qDebug() << "Loaded Authentication Key...";
+        uchar *data = (uchar *)outData + (block - plan.firstBlock) * 16;
+
+        {
+            TapMetrics::PhaseTimer timer(TapMetrics::ReadBlock);
+            result = _backend->readBlock(block, data, &ucStatus);
+        }
+        if (!result || ucStatus != 0)
+        {
+            LOG_WARNING("Failed to read block {}: result={}, status={}", block, result, ucStatus);
+            return false;
+        }
+
+        LOG_TRACE("Block {} : {}", block, Log::Hex(data, 16));
     }
 
-    // Authenticate sector
-    qDebug() << "Authenticating sector: " << sector << "with key:" << bytesToHex(keyA, 6);
-    result = mifareCoupler->Authenticate(sector, 0x0A, 0xFF, &ucType, serialNumber, &ucStatus);
-    if (result != RCSC_Ok || ucStatus != 0)
+    return true;
+}
+
+bool CardReader::processMifareClassic(const ReadPlan &plan, CardData &card)
+{
+    if (plan.isEmpty())
     {
-        qDebug() << "Authentication failed: result=" << result << ", status=" << ucStatus;
-        emit authenticationFailed();
+        card.errorMessage = "No read plan configured";
+        LOG_WARNING("{} for {}", card.errorMessage, card.cardType);
         return false;
     }
 
-    qDebug() << "Authentication successful!";
+    if (!_keysLoaded)
+        preloadKeys();
+
+    // One session: preloaded keys are used from their slot, others are loaded
+    // into the volatile slot only when the key changes. One authentication per
+    // sector, one read per data block.
+    card.rawData.resize(plan.blockCount() * 16);
+    const uint8_t *loadedKey = nullptr;
+    const uint8_t *previousKey = nullptr;
+    int saved = 0;
 
-    // Read blocks
-    qDebug() << "Preparing to reading block" << startBlock << "to" << endBlock;
-    for (int block = startBlock; block <= endBlock; block++)
+    foreach (int index, plan.order)
     {
-        uchar data[16];
-        qDebug() << QString("Reading block %1...").arg(block);
+        const ReadPlan::Sector &sector = plan.sectors[index];
+        bool keyChanged = !previousKey || memcmp(previousKey, sector.key, 6) != 0;
+        QByteArray key((const char *)sector.key, 6);
+        uint8_t keyIndex = VOLATILE_KEY_SLOT;
+        bool loadKey = false;
+
+        if (_keySlots.contains(key))
+        {
+            keyIndex = _keySlots.value(key);
+            if (keyChanged)
+                saved++;
+        }
+        else
+        {
+            loadKey = !loadedKey || memcmp(loadedKey, sector.key, 6) != 0;
+            loadedKey = sector.key;
+        }
+        previousKey = sector.key;
 
-        result = mifareCoupler->ReadBlock(block, data, &ucStatus);
-        if (result != RCSC_Ok || ucStatus != 0)
+        if (!authenticateAndRead(sector, keyIndex, loadKey, card.rawData.data() + sector.offset))
         {
-            qDebug() << "Failed to read block" << block << ": result=" << result << ", status=" << ucStatus;
+            card.errorMessage = "Authentication or read failed";
+            card.rawData.clear();
+            card.sectors.clear();
             return false;
         }
 
-        outData.append((char *)data, sizeof(data));
-        qDebug() << "Block" << block << ":" << bytesToHex(data, sizeof(data));
+        SectorSpan span;
+        span.offset = sector.offset;
+        span.length = (sector.lastBlock - sector.firstBlock + 1) * 16;
+        card.sectors.insert(sector.sector, span);
     }
 
+    _keyLoadsSaved += saved;
+    LOG_DEBUG("Preloaded keys saved {} round trips this tap, {} total", saved, _keyLoadsSaved);
     return true;
 }
 
-bool CardReader::processMifareClassic(Coupler *coupler, QByteArray &outData)
+bool CardReader::preloadKeys()
 {
-    Config &config = Config::instance();
-    return authenticateAndRead(coupler, config.keyA, config.sector,
-                               config.startBlock, config.endBlock, outData);
+    const Config &config = *_config;
+    _keySlots.clear();
+
+    // Once per coupler reset or key change, not per tap: a key that does not
+    // load stays out of the slots and is loaded per tap like a surplus key
+    _keysLoaded = true;
+    bool allLoaded = true;
+
+    QList<const ReadPlan *> plans;
+    plans << &config.classic1KPlan << &config.classic4KPlan;
+
+    int next = 0;
+    foreach (const ReadPlan *plan, plans)
+    {
+        foreach (const ReadPlan::Sector &sector, plan->sectors)
+        {
+            QByteArray key((const char *)sector.key, 6);
+            if (_keySlots.contains(key))
+                continue;
+
+            if (next >= config.keySlotCount)
+            {
+                LOG_WARNING("Out of reader key slots, sector {} key is loaded per tap", sector.sector);
+                continue;
+            }
+
+            uint8_t slot = (uint8_t)(config.keySlotBase + next);
+            uchar ucStatus;
+            if (!_backend->loadReaderKey(slot, sector.key, &ucStatus) || ucStatus != 0)
+            {
+                LOG_WARNING("Failed to preload key into slot {}, status={}, sector {} key is loaded per tap", slot,
+                            ucStatus, sector.sector);
+                allLoaded = false;
+                continue;
+            }
+
+            _keySlots.insert(key, slot);
+            next++;
+        }
+    }
+
+    LOG_INFO("Preloaded {} authentication keys into reader slots", _keySlots.size());
+    return allLoaded;
 }
 
-bool CardReader::processMifareUL(Coupler *coupler, QByteArray &outData)
+bool CardReader::processIso14443_4(CardData &card)
 {
-    CouplerMiFARE *mifareCoupler = (CouplerMiFARE *)coupler;
-    uchar data[16], ucStatus;
+    const Config &config = *_config;
+    TclTransport transport(_backend.get(), config.iso14443MaxBitRate);
 
-    // Ultralight doesn't need authentication
-    for (int page = 0; page < 16; page += 4)
+    if (!transport.activate())
+    {
+        card.errorMessage = transport.error();
+        return false;
+    }
+
+    // First application whose SELECT the card accepts
+    foreach (const ApduScript &script, config.apduScripts)
     {
-        emit readProgress(QString("Reading pages %1-%2...").arg(page).arg(page + 3));
+        ApduScript::Result result;
+        if (script.run(transport, result))
+        {
+            card.rawData = result.data;
+            transport.deselect();
+            return true;
+        }
 
-        int16 result = mifareCoupler->ReadBlock(page, data, &ucStatus);
-        if (result != RCSC_Ok || ucStatus != 0)
+        if (!result.notPresent)
         {
-            qDebug() << "Failed to read pages" << page << "-" << (page + 3);
+            card.errorMessage = result.error;
+            transport.deselect();
             return false;
         }
+    }
+
+    transport.deselect();
+    card.errorMessage = "No known application on the card";
+    LOG_DEBUG("{}", card.errorMessage);
+    return false;
+}
 
-        outData.append((char *)data, sizeof(data));
-        qDebug() << "Pages" << page << "-" << (page + 3) << ":" << bytesToHex(data, sizeof(data));
+bool CardReader::processIso15693(CardData &card)
+{
+    Iso15693Reader reader(_backend.get(), _config->iso15693MaxBlocksPerRead);
+    Iso15693Reader::Result tag;
+
+    if (!reader.read(tag))
+    {
+        card.errorMessage = tag.error;
+        return false;
     }
 
+    card.cardUid = bytesToHex((const uchar *)tag.uid.constData(), tag.uid.size());
+    card.rawData = tag.data;
+    return true;
+}
+
+bool CardReader::processMifareUL(CardData &card)
+{
+    const Config &config = *_config;
+    UltralightReader reader(_backend.get(), config.ultralightMaxPagesPerRead, config.ultralightFastRead);
+    UltralightReader::Result tag;
+
+    // Ultralight doesn't need authentication
+    if (!reader.read(tag))
+    {
+        card.errorMessage = tag.error;
+        return false;
+    }
+    card.rawData = tag.data;
+
+    // READ time is measured whenever the loop runs (fastRead=false or a
+    // fallback), until then this tap's average command time stands in
+    if (tag.readCommandUs > 0)
+        _readCommandUs = _readCommandUs == 0 ? tag.readCommandUs : (_readCommandUs * 7 + tag.readCommandUs) / 8;
+    qint64 readCommandUs = _readCommandUs > 0 ? _readCommandUs : tag.elapsedUs / qMax(1, tag.commands);
+    qint64 savedUs = readCommandUs * tag.legacyCommands - tag.elapsedUs;
+    _ultralightSavedUs += savedUs;
+
+    LOG_DEBUG("Four-page READ loop needs {} commands, FAST_READ saved about {} us this tap, {} us total",
+              tag.legacyCommands, savedUs, _ultralightSavedUs);
     return true;
 }
 
+void CardReader::applyConfig(const Config &config)
+{
+    _generation = config.generation;
+
+    PollScheduler::Settings polling = pollSettings(config);
+    const PollScheduler::Settings &previous = _poller.settings();
+    if (polling.minIntervalMs != previous.minIntervalMs || polling.maxIntervalMs != previous.maxIntervalMs ||
+        polling.activeWindowMs != previous.activeWindowMs || polling.backoff != previous.backoff)
+        _poller.configure(polling);
+
+    // Loaded into the slots again by the next Classic read
+    QByteArray keys = keyLayout(config);
+    if (keys != _keyLayout)
+    {
+        _keyLayout = keys;
+        _keysLoaded = false;
+    }
+    LOG_INFO("Reading with configuration {}", config.generation);
+}
+
 CardReader::CardData CardReader::scanCard(unsigned int timeoutSeconds)
 {
+    // A reloaded configuration applies from this tap on, and to all of it
+    Config::Snapshot snapshot;
+    const Config &config = *snapshot;
+    _config = &config;
+    if (config.generation != _generation)
+        applyConfig(config);
     CardData result;
     result.success = false;
 
-    qDebug() << "Waiting for card... (timeout:" << timeoutSeconds << "seconds)";
+    LOG_DEBUG("Waiting for card... (timeout: {} seconds)", timeoutSeconds);
     emit readProgress("Waiting for card...");
 
-    uint64_t t_max = Time::GetMilliSeconds() + timeoutSeconds * 1000;
+    QElapsedTimer timer;
+    timer.start();
 
-    while (Time::GetMilliSeconds() < t_max)
+    while (!_stopRequested && timer.elapsed() < (qint64)timeoutSeconds * 1000)
     {
-        sCARD_Search search;
-        unsigned char com;
-        uint8 options = SEARCH_OPT_MAX_SPEED;
+        CardSearchMask search;
+        uint8_t com;
         unsigned char atr[256];
-        uint16 atrLen;
-
-        memset(&search, 0, sizeof(search));
-        memset(&search, 0, sizeof(search));
-
-        search.MIFARE = 1;
-        search.ISOA = 1;
-        search.ISOB = 1;
-        search.INNO = 1;
-        search.TICK = 1;
-        search.SRX = 1;
-
-        if (_coupler.SearchCardExt(search, 1, 100, &com, &atrLen, atr, options) != RCSC_Ok)
+        uint16_t atrLen;
+
+        search.mifare = true;
+        search.isoA = true;
+        search.isoB = true;
+        search.inno = true;
+        search.tick = true;
+        search.srx = true;
+
+        QElapsedTimer searchTimer;
+        searchTimer.start();
+        bool ok = _backend->searchCard(search, 1, config.searchTimeout, &com, &atrLen, atr);
+        if (!ok || com == CouplerBackend::COM_NO_CARD)
+        {
+            if (ok)
+                _failedCard.clear();
+            _poller.wait(_poller.onPoll(false));
             continue;
+        }
 
-        if (com == 0x6F)
+        // A card that just failed is not read again until it leaves the
+        // field, polled at the idle back-off rather than at full speed
+        QByteArray card = QByteArray(1, (char)com) + QByteArray((const char *)atr, atrLen);
+        if (card == _failedCard)
+        {
+            _poller.wait(_poller.onPoll(false));
             continue;
+        }
+        TapMetrics::record(TapMetrics::Detect, searchTimer.nsecsElapsed() / 1000);
+
+        _poller.onPoll(true);
+        LOG_DEBUG("Polling: {}", _poller.report(_backend->stats().commands()));
 
         // Get card UID
         if (atrLen >= 4)
         {
             result.cardUid = bytesToHex(atr, qMin((int)atrLen, 7));
-            qDebug() << "Card UID:" << result.cardUid;
+            LOG_INFO("Card UID: {}", result.cardUid);
         }
 
-        if (com == 5 && atr[1] == 0x08)
-        {
-            qDebug() << "Found MIFARE Classic 1K card";
-            result.cardType = "MIFARE Classic 1K";
-
-            if (processMifareClassic(&_coupler, result.rawData))
-            {
-                result.success = true;
-                emit cardDetected(result.cardType);
-                emit scanComplete(true, "Card read successfully");
-            }
-            else
-            {
-                result.errorMessage = "Authentication or read failed";
-                emit scanComplete(false, result.errorMessage);
-            }
-            return result;
-        }
-        else if (com == 5 && atr[1] == 0x09)
+        int type = findCardType(com, atr, atrLen);
+        if (type < 0)
         {
-            qDebug() << "Found MIFARE Classic 4K card";
-            result.cardType = "MIFARE Classic 4K";
-            emit cardDetected(result.cardType);
-
-            if (processMifareClassic(&_coupler, result.rawData))
-            {
-                result.success = true;
-                emit scanComplete(true, "Card read successfully");
-            }
-            else
-            {
-                result.errorMessage = "Authentication or read failed";
-                emit scanComplete(false, result.errorMessage);
-            }
+            result.errorMessage = QString("Unsupported card (com=%1, SAK=%2)")
+                                      .arg(com)
+                                      .arg(atrLen > 1 ? atr[1] : 0, 2, 16, QChar('0'));
+            LOG_INFO("{}", result.errorMessage);
+            _failedCard = card;
+            emit scanComplete(false, result.errorMessage);
             return result;
         }
-        else if (com == 5 && atr[1] == 0x04)
-        {
-            qDebug() << "Found MIFARE Ultralight card";
-            result.cardType = "MIFARE Ultralight";
-            emit cardDetected(result.cardType);
 
-            if (processMifareUL(&_coupler, result.rawData))
-            {
-                result.success = true;
-                emit scanComplete(true, "Card read successfully");
-            }
-            else
-            {
-                result.errorMessage = "Read failed";
-                emit scanComplete(false, result.errorMessage);
-            }
-            return result;
-        }
+        const CardTypeEntry &entry = CARD_TYPES[type];
+        result.cardType = entry.name;
+        LOG_DEBUG("Found {} card", entry.name);
+        emit cardDetected(result.cardType);
 
-        else if (com == 8)
+        const CardHandler &handler = _handlers[(int)entry.family];
+        if (!handler)
         {
-            qDebug() << "Found ISO14443-4 card (Simulated read)";
-            result.cardType = "ISO14443-4";
-            emit cardDetected(result.cardType);
-
-            // Simulate some card data
-            QByteArray fakeData = QByteArray::fromHex("112233445566778899AABBCCDDEEFF");
-            result.rawData = fakeData;
-            result.cardUid = "4645454545";
-
-            // Simulate successful read
-            result.success = true;
-            emit scanComplete(true, "Card read successfully (simulated)");
-
+            result.errorMessage = QString("%1 card processing not implemented").arg(entry.name);
+            _failedCard = card;
+            emit scanComplete(false, result.errorMessage);
             return result;
         }
 
-        else if (com == 9)
+        QElapsedTimer handlerTimer;
+        handlerTimer.start();
+        result.success = handler(result);
+        qint64 elapsedUs = handlerTimer.nsecsElapsed() / 1000;
+
+        HandlerStats &stats = _handlerStats[(int)entry.family];
+        stats.count++;
+        stats.totalUs += elapsedUs;
+        stats.maxUs = qMax(stats.maxUs, elapsedUs);
+        if (!result.success)
+            stats.failures++;
+        LOG_DEBUG("{} handler took {} us (avg {} us over {} cards)", entry.name, elapsedUs,
+                  stats.totalUs / (qint64)stats.count, stats.count);
+
+        if (result.success)
         {
-            qDebug() << "Found ISO15693 card";
-            result.cardType = "ISO15693";
-            emit cardDetected(result.cardType);
-
-            result.errorMessage = "ISO15693 card processing not implemented";
-            emit scanComplete(false, result.errorMessage);
-            return result;
+            emit scanComplete(true, "Card read successfully");
         }
-
-        else if (com == 3 && atr[7] == 1)
+        else
         {
-            qDebug() << "Found Innovatron card";
-            result.cardType = "Innovatron";
-            emit cardDetected(result.cardType);
-
-            result.errorMessage = "Innovatron card processing not implemented";
+            if (result.errorMessage.isEmpty())
+                result.errorMessage = "Read failed";
+            _failedCard = card;
             emit scanComplete(false, result.errorMessage);
-            return result;
         }
-
-        usleep(100000); // 100ms delay
+        return result;
     }
 
-    _coupler.Reset();
+
+    LOG_DEBUG("Polling: {}", _poller.report(_backend->stats().commands()));
+    _backend->reset();
+    _keysLoaded = false;
     return result;
 }
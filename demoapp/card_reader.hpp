@@ -7,14 +7,28 @@
 
 #include <QString>
 #include <QObject>
-#include <coupler.hpp>
-#include <libals.h>
+#include <QMap>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include "card_types.hpp"
+#include "coupler_backend.hpp"
+#include "poll_scheduler.hpp"
+#include "read_plan.hpp"
+
+class Config;
 
 class CardReader : public QObject
 {
     Q_OBJECT
 
 public:
+    struct SectorSpan
+    {
+        int offset; // Byte offset in rawData
+        int length;
+    };
+
     struct CardData
     {
         bool success;
@@ -22,9 +36,23 @@ public:
         QString cardUid;
         QString cardType;
         QByteArray rawData;
+        QMap<int, SectorSpan> sectors; // MIFARE Classic sector -> span of rawData
+    };
+
+    // Reads one detected card into CardData, returns false and sets
+    // errorMessage on failure
+    typedef std::function<bool(CardData &card)> CardHandler;
+
+    struct HandlerStats
+    {
+        quint64 count = 0;
+        quint64 failures = 0;
+        qint64 totalUs = 0;
+        qint64 maxUs = 0;
     };
 
     CardReader();
+    explicit CardReader(CouplerBackend *backend);
     ~CardReader();
 
     bool initialize();
@@ -32,6 +60,26 @@ public:
     bool waitForReady(unsigned int millisecondsTimeout);
     CardData scanCard(unsigned int timeoutSeconds);
 
+    // Make a running scanCard() return at its next poll. Thread-safe.
+    void requestStop();
+    void clearStopRequest();
+
+    CouplerBackend *backend() const { return _backend.get(); }
+
+    // Key load round trips avoided by preloading keys into reader slots
+    quint64 keyLoadsSaved() const { return _keyLoadsSaved; }
+
+    // Ultralight read time saved by FAST_READ over the four-page READ loop
+    qint64 ultralightSavedUs() const { return _ultralightSavedUs; }
+
+    // Uppercase hex, e.g. for card UIDs
+    static QString bytesToHex(const uchar *data, int length);
+
+    // Replace or add the handler for a card family from CARD_TYPES.
+    // Register before scanning starts, the table is not locked.
+    void registerHandler(CardFamily family, CardHandler handler);
+    const HandlerStats &handlerStats(CardFamily family) const { return _handlerStats[(int)family]; }
+
 signals:
     void cardDetected(QString cardType);
     void authenticationFailed();
@@ -39,19 +87,37 @@ signals:
     void scanComplete(bool success, QString message);
 
 private:
-    bool authenticateAndRead(Coupler *coupler, const uint8_t *keyA, int sector,
-                             int startBlock, int endBlock, QByteArray &outData);
-    bool processMifareClassic(Coupler *coupler, QByteArray &outData);
-    bool processMifareUL(Coupler *coupler, QByteArray &outData);
-    QString bytesToHex(const uchar *data, int length);
-
-    Coupler _coupler;
-    CouplerExternalDependencies _ext;
+    bool authenticateAndRead(const ReadPlan::Sector &plan, uint8_t keyIndex, bool loadKey, char *outData);
+    bool preloadKeys();
+    bool processMifareClassic(const ReadPlan &plan, CardData &card);
+    bool processMifareUL(CardData &card);
+    bool processIso14443_4(CardData &card);
+    bool processIso15693(CardData &card);
+    void registerDefaultHandlers();
+    void applyConfig(const Config &config);
+    CouplerBackend *createBackend();
+
+    std::unique_ptr<CouplerBackend> _backend;
     bool _initialized;
+    std::atomic<bool> _stopRequested;
+    PollScheduler _poller;
+    const Config *_config; // Pinned by initialize() or scanCard(), only valid inside them
+    quint64 _generation;   // Of the Config the poller and key slots were set up from
+    QByteArray _keyLayout;
+
+    CardHandler _handlers[CARD_FAMILY_COUNT];
+    HandlerStats _handlerStats[CARD_FAMILY_COUNT];
 
-    static constexpr const char *COUPLER_TTY = "/dev/aep/coupler_tty";
-    static constexpr const char *COUPLER_POWER = "/dev/aep/coupler_power";
-    static constexpr const char *COUPLER_LINK = "/dev/ttyCOUPLER";
+    QMap<QByteArray, uint8_t> _keySlots; // Preloaded key -> reader slot
+    bool _keysLoaded;
+    quint64 _keyLoadsSaved;
+    QByteArray _failedCard; // com + ATR of the last failed read, until it leaves
+    qint64 _readCommandUs; // Measured Ultralight READ time, 0 until one ran
+    qint64 _ultralightSavedUs;
+
+    static const uint8_t VOLATILE_KEY_SLOT = 0xFF;
 };
 
+Q_DECLARE_METATYPE(CardReader::CardData)
+
 #endif // CARD_READER_HPP
@@ -0,0 +1,77 @@
+/*******************************************************************************
+ * Card Types - compile-time classification table
+ *
+ * Maps the coupler protocol ("com") and one ATR byte (SAK for ISO14443-A) to a
+ * card family. New families get a row here and a handler registered on the
+ * CardReader, the scan loop itself does not change.
+ *
+ * There is no ATQA column: the MIFARE answer of SearchCardExt as this reader
+ * uses it carries the SAK at atr[1] but no ATQA at a known offset, and the SAK
+ * alone tells the families below apart. A family that needs ATQA (DESFire vs
+ * Plus) adds the column once its position in the answer is known.
+ *******************************************************************************/
+
+#ifndef CARD_TYPES_HPP
+#define CARD_TYPES_HPP
+
+#include <cstdint>
+
+enum class CardFamily : int
+{
+    MifareClassic1K = 0,
+    MifareClassic4K,
+    MifareUltralight,
+    Iso14443_4,
+    Iso15693,
+    Innovatron,
+    Count
+};
+
+static const int CARD_FAMILY_COUNT = (int)CardFamily::Count;
+
+struct CardTypeEntry
+{
+    uint8_t com;      // Protocol reported by SearchCardExt
+    bool matchAtr;    // Also compare one ATR byte
+    uint8_t atrIndex; // Byte to compare (1 = SAK for MIFARE)
+    uint8_t atrValue;
+    CardFamily family;
+    const char *name;
+};
+
+static constexpr CardTypeEntry CARD_TYPES[] = {
+    {5, true, 1, 0x08, CardFamily::MifareClassic1K, "MIFARE Classic 1K"},
+    {5, true, 1, 0x09, CardFamily::MifareClassic4K, "MIFARE Classic 4K"},
+    {5, true, 1, 0x04, CardFamily::MifareUltralight, "MIFARE Ultralight"},
+    {8, false, 0, 0x00, CardFamily::Iso14443_4, "ISO14443-4"},
+    {9, false, 0, 0x00, CardFamily::Iso15693, "ISO15693"},
+    {3, true, 7, 0x01, CardFamily::Innovatron, "Innovatron"},
+};
+
+static constexpr int CARD_TYPE_COUNT = sizeof(CARD_TYPES) / sizeof(CARD_TYPES[0]);
+
+constexpr bool cardTypeMatches(const CardTypeEntry &entry, uint8_t com, const uint8_t *atr, uint16_t atrLen)
+{
+    return entry.com == com &&
+           (!entry.matchAtr || (entry.atrIndex < atrLen && atr[entry.atrIndex] == entry.atrValue));
+}
+
+// Index into CARD_TYPES, -1 for an unknown card
+constexpr int findCardType(uint8_t com, const uint8_t *atr, uint16_t atrLen, int index = 0)
+{
+    return index >= CARD_TYPE_COUNT ? -1
+           : cardTypeMatches(CARD_TYPES[index], com, atr, atrLen)
+               ? index
+               : findCardType(com, atr, atrLen, index + 1);
+}
+
+namespace CardTypeChecks
+{
+    static constexpr uint8_t CLASSIC_4K_ATR[] = {0x04, 0x09, 0x00, 0x00};
+    static constexpr uint8_t UNKNOWN_ATR[] = {0x04, 0x20, 0x00, 0x00};
+    static_assert(findCardType(5, CLASSIC_4K_ATR, 4) == 1, "Classic 4K must classify by SAK");
+    static_assert(findCardType(5, UNKNOWN_ATR, 4) == -1, "Unknown SAK must not match");
+    static_assert(findCardType(9, UNKNOWN_ATR, 0) == 4, "ISO15693 matches on protocol only");
+}
+
+#endif // CARD_TYPES_HPP
@@ -0,0 +1,313 @@
+/*******************************************************************************
+ * Codec Implementation
+ *******************************************************************************/
+
+#include "codec.hpp"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CODEC_NEON
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define CODEC_SSE2
+#include <emmintrin.h>
+#ifdef __SSSE3__
+#define CODEC_SSSE3
+#include <tmmintrin.h>
+#endif
+#endif
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+static const char BASE64_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Base64 character -> sextet, or one of the markers below
+static const int8_t B64_INVALID = -1;
+static const int8_t B64_SPACE = -2;
+static const int8_t B64_PAD = -3;
+
+struct Base64DecodeTable
+{
+    int8_t value[256];
+
+    Base64DecodeTable()
+    {
+        for (int i = 0; i < 256; i++)
+            value[i] = B64_INVALID;
+        for (int i = 0; i < 64; i++)
+            value[(uint8_t)BASE64_ALPHABET[i]] = (int8_t)i;
+        value[(uint8_t)'='] = B64_PAD;
+        value[(uint8_t)' '] = value[(uint8_t)'\t'] = value[(uint8_t)'\r'] = value[(uint8_t)'\n'] = B64_SPACE;
+    }
+};
+
+static const Base64DecodeTable BASE64_DECODE;
+
+static int hexNibble(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+/*******************************************************************************
+ * SIMD kernels - each returns the number of input bytes it consumed, the
+ * scalar code finishes the rest
+ *******************************************************************************/
+
+#if defined(CODEC_SSE2)
+
+static inline __m128i hexDigitsSse2(__m128i nibbles)
+{
+    // '0' + n, plus 7 more for 'A'-'F'
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('A' - '9' - 1));
+    return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+}
+
+static int toHexSimd(const uint8_t *in, int length, char *out)
+{
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    int i = 0;
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i hi = hexDigitsSse2(_mm_and_si128(_mm_srli_epi16(v, 4), mask));
+        __m128i lo = hexDigitsSse2(_mm_and_si128(v, mask));
+        _mm_storeu_si128((__m128i *)(out + i * 2), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *)(out + i * 2 + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+    return i;
+}
+
+#ifdef CODEC_SSSE3
+static int toBase64Simd(const uint8_t *in, int length, char *out)
+{
+    // 16-byte loads of which 12 are used: three bytes per 32-bit lane, split
+    // into four sextets with two multiplies (W. Mula's method), then mapped
+    // to the alphabet arithmetically
+    int i = 0;
+    for (; i + 16 <= length; i += 12)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+        v = _mm_shuffle_epi8(v, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+        __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+        __m128i t1 = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+        __m128i idx = _mm_or_si128(t0, t1);
+
+        // 'A'+i below 26, 'a'+i-26 below 52, '0'+i-52 below 62, then '+' and '/'
+        __m128i offset = _mm_set1_epi8(65);
+        offset = _mm_add_epi8(offset, _mm_and_si128(_mm_cmpgt_epi8(idx, _mm_set1_epi8(25)), _mm_set1_epi8(6)));
+        offset = _mm_sub_epi8(offset, _mm_and_si128(_mm_cmpgt_epi8(idx, _mm_set1_epi8(51)), _mm_set1_epi8(75)));
+        offset = _mm_sub_epi8(offset, _mm_and_si128(_mm_cmpeq_epi8(idx, _mm_set1_epi8(62)), _mm_set1_epi8(15)));
+        offset = _mm_sub_epi8(offset, _mm_and_si128(_mm_cmpeq_epi8(idx, _mm_set1_epi8(63)), _mm_set1_epi8(12)));
+        _mm_storeu_si128((__m128i *)(out + i / 3 * 4), _mm_add_epi8(idx, offset));
+    }
+    return i;
+}
+#else
+static int toBase64Simd(const uint8_t *, int, char *)
+{
+    // SSE2 has no byte shuffle, the scalar table loop is as fast
+    return 0;
+}
+#endif
+
+#elif defined(CODEC_NEON)
+
+static inline uint8x16_t hexDigitsNeon(uint8x16_t nibbles)
+{
+    uint8x16_t letters = vandq_u8(vcgtq_u8(nibbles, vdupq_n_u8(9)), vdupq_n_u8('A' - '9' - 1));
+    return vaddq_u8(vaddq_u8(nibbles, vdupq_n_u8('0')), letters);
+}
+
+static int toHexSimd(const uint8_t *in, int length, char *out)
+{
+    int i = 0;
+    for (; i + 16 <= length; i += 16)
+    {
+        uint8x16_t v = vld1q_u8(in + i);
+        uint8x16x2_t digits;
+        digits.val[0] = hexDigitsNeon(vshrq_n_u8(v, 4));
+        digits.val[1] = hexDigitsNeon(vandq_u8(v, vdupq_n_u8(0x0F)));
+        vst2q_u8((uint8_t *)out + i * 2, digits);
+    }
+    return i;
+}
+
+static inline uint8x16_t base64CharsNeon(uint8x16_t idx)
+{
+    // 'A'+i below 26, 'a'+i-26 below 52, '0'+i-52 below 62, then '+' and '/'
+    uint8x16_t offset = vdupq_n_u8(65);
+    offset = vaddq_u8(offset, vandq_u8(vcgtq_u8(idx, vdupq_n_u8(25)), vdupq_n_u8(6)));
+    offset = vsubq_u8(offset, vandq_u8(vcgtq_u8(idx, vdupq_n_u8(51)), vdupq_n_u8(75)));
+    offset = vsubq_u8(offset, vandq_u8(vceqq_u8(idx, vdupq_n_u8(62)), vdupq_n_u8(15)));
+    offset = vsubq_u8(offset, vandq_u8(vceqq_u8(idx, vdupq_n_u8(63)), vdupq_n_u8(12)));
+    return vaddq_u8(idx, offset);
+}
+
+static int toBase64Simd(const uint8_t *in, int length, char *out)
+{
+    // De-interleaving load: val[0..2] hold bytes 0, 1 and 2 of 16 triplets
+    const uint8x16_t sextet = vdupq_n_u8(0x3F);
+    int i = 0;
+    for (; i + 48 <= length; i += 48)
+    {
+        uint8x16x3_t v = vld3q_u8(in + i);
+        uint8x16x4_t chars;
+        chars.val[0] = base64CharsNeon(vshrq_n_u8(v.val[0], 2));
+        chars.val[1] = base64CharsNeon(vandq_u8(vorrq_u8(vshlq_n_u8(v.val[0], 4), vshrq_n_u8(v.val[1], 4)), sextet));
+        chars.val[2] = base64CharsNeon(vandq_u8(vorrq_u8(vshlq_n_u8(v.val[1], 2), vshrq_n_u8(v.val[2], 6)), sextet));
+        chars.val[3] = base64CharsNeon(vandq_u8(v.val[2], sextet));
+        vst4q_u8((uint8_t *)out + i / 3 * 4, chars);
+    }
+    return i;
+}
+
+#else
+
+static int toHexSimd(const uint8_t *, int, char *) { return 0; }
+static int toBase64Simd(const uint8_t *, int, char *) { return 0; }
+
+#endif
+
+/*******************************************************************************
+ * Public API
+ *******************************************************************************/
+
+void Codec::toHexScalar(const uint8_t *in, int length, char *out)
+{
+    for (int i = 0; i < length; i++)
+    {
+        out[i * 2] = HEX_DIGITS[in[i] >> 4];
+        out[i * 2 + 1] = HEX_DIGITS[in[i] & 0x0F];
+    }
+}
+
+void Codec::toHex(const uint8_t *in, int length, char *out)
+{
+    int done = toHexSimd(in, length, out);
+    toHexScalar(in + done, length - done, out + done * 2);
+}
+
+int Codec::fromHex(const char *in, int length, uint8_t *out)
+{
+    if (length % 2 != 0)
+        return -1;
+
+    for (int i = 0; i < length; i += 2)
+    {
+        int hi = hexNibble(in[i]);
+        int lo = hexNibble(in[i + 1]);
+        if (hi < 0 || lo < 0)
+            return -1;
+        out[i / 2] = (uint8_t)((hi << 4) | lo);
+    }
+    return length / 2;
+}
+
+int Codec::toBase64Scalar(const uint8_t *in, int length, char *out)
+{
+    char *p = out;
+    int i = 0;
+    for (; i + 3 <= length; i += 3)
+    {
+        uint32_t triple = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+        *p++ = BASE64_ALPHABET[(triple >> 18) & 0x3F];
+        *p++ = BASE64_ALPHABET[(triple >> 12) & 0x3F];
+        *p++ = BASE64_ALPHABET[(triple >> 6) & 0x3F];
+        *p++ = BASE64_ALPHABET[triple & 0x3F];
+    }
+
+    if (i < length)
+    {
+        uint32_t triple = in[i] << 16;
+        if (i + 1 < length)
+            triple |= in[i + 1] << 8;
+        *p++ = BASE64_ALPHABET[(triple >> 18) & 0x3F];
+        *p++ = BASE64_ALPHABET[(triple >> 12) & 0x3F];
+        *p++ = i + 1 < length ? BASE64_ALPHABET[(triple >> 6) & 0x3F] : '=';
+        *p++ = '=';
+    }
+
+    return (int)(p - out);
+}
+
+int Codec::toBase64(const uint8_t *in, int length, char *out)
+{
+    int done = toBase64Simd(in, length, out);
+    return done / 3 * 4 + toBase64Scalar(in + done, length - done, out + done / 3 * 4);
+}
+
+int Codec::fromBase64(const char *in, int length, uint8_t *out)
+{
+    uint32_t quad = 0;
+    int count = 0;
+    int pad = 0;
+    int n = 0;
+
+    for (int i = 0; i < length; i++)
+    {
+        int8_t v = BASE64_DECODE.value[(uint8_t)in[i]];
+        if (v == B64_SPACE)
+            continue;
+
+        if (v == B64_PAD)
+        {
+            // Padding only completes the final quad
+            if (count < 2 || ++pad > 2)
+                return -1;
+            quad <<= 6;
+        }
+        else if (v < 0 || pad > 0)
+        {
+            return -1;
+        }
+        else
+        {
+            quad = (quad << 6) | (uint32_t)v;
+        }
+
+        if (++count == 4)
+        {
+            out[n++] = (uint8_t)(quad >> 16);
+            if (pad < 2)
+                out[n++] = (uint8_t)(quad >> 8);
+            if (pad < 1)
+                out[n++] = (uint8_t)quad;
+            count = 0;
+            quad = 0;
+            if (pad > 0)
+                pad = 3; // Anything but whitespace after padding is an error
+        }
+    }
+
+    if (pad > 0 && pad < 3)
+        return -1;
+
+    // Unpadded tail
+    if (count == 1)
+        return -1;
+    if (count == 2)
+        out[n++] = (uint8_t)(quad >> 4);
+    if (count == 3)
+    {
+        out[n++] = (uint8_t)(quad >> 10);
+        out[n++] = (uint8_t)(quad >> 2);
+    }
+    return n;
+}
+
+const char *Codec::kernelName()
+{
+#if defined(CODEC_NEON)
+    return "neon";
+#elif defined(CODEC_SSSE3)
+    return "ssse3";
+#elif defined(CODEC_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,43 @@
+/*******************************************************************************
+ * Codec - hex and base64 into caller-provided buffers
+ *
+ * No allocation and no terminator: callers size the output with the *Length
+ * helpers and wrap it in a QString or QByteArray themselves. Encoders use
+ * SSE2/SSSE3 or NEON kernels when the compiler targets them and fall back to
+ * table-driven scalar code for the tail and on other CPUs.
+ *******************************************************************************/
+
+#ifndef CODEC_HPP
+#define CODEC_HPP
+
+#include <cstdint>
+
+namespace Codec
+{
+    constexpr int hexLength(int bytes) { return bytes * 2; }
+    constexpr int base64Length(int bytes) { return (bytes + 2) / 3 * 4; }
+    constexpr int base64DecodedMaxLength(int chars) { return chars / 4 * 3 + 3; }
+
+    // Uppercase hex, writes exactly hexLength(length) characters
+    void toHex(const uint8_t *in, int length, char *out);
+
+    // Either case, returns the bytes written or -1 on an odd length or a
+    // non-hex character
+    int fromHex(const char *in, int length, uint8_t *out);
+
+    // Standard alphabet with padding, returns base64Length(length)
+    int toBase64(const uint8_t *in, int length, char *out);
+
+    // Skips whitespace (line-wrapped PEM style input), returns the bytes
+    // written or -1 on invalid input
+    int fromBase64(const char *in, int length, uint8_t *out);
+
+    // Scalar kernels, kept callable for benchmarks and cross-checks
+    void toHexScalar(const uint8_t *in, int length, char *out);
+    int toBase64Scalar(const uint8_t *in, int length, char *out);
+
+    // "sse2", "ssse3", "neon" or "scalar"
+    const char *kernelName();
+}
+
+#endif // CODEC_HPP
@@ -0,0 +1,157 @@
+/*******************************************************************************
+ * Config Implementation - snapshot publishing and reclamation
+ *
+ * Each reader thread owns a hazard slot. A pin writes the snapshot it is about
+ * to use into the slot and checks the snapshot is still current afterwards,
+ * retrying if it was replaced in between. publish() swaps in the new snapshot
+ * and frees every replaced one that no slot holds; pinned ones wait for the
+ * next publish(). Threads beyond MAX_READERS share an overflow count, and
+ * nothing is freed while one of them holds a pin.
+ *******************************************************************************/
+
+#include "config.hpp"
+#include <QMutex>
+#include <QVector>
+#include <atomic>
+
+namespace
+{
+    const int MAX_READERS = 64;
+
+    struct Reader
+    {
+        std::atomic<bool> claimed;
+        std::atomic<const Config *> pinned;
+    };
+
+    // Static storage, starts out unclaimed and empty
+    Reader readers[MAX_READERS];
+    std::atomic<int> overflowPins(0);
+    std::atomic<int> retiredCount(0);
+
+    // Pins of one thread: its slot, claimed on first use and given back when
+    // the thread ends
+    struct ThreadPins
+    {
+        Reader *reader;
+        const Config *config;
+        int depth;
+
+        ThreadPins() : reader(nullptr), config(nullptr), depth(0)
+        {
+            for (int i = 0; i < MAX_READERS && !reader; i++)
+            {
+                bool unclaimed = false;
+                if (readers[i].claimed.compare_exchange_strong(unclaimed, true))
+                    reader = &readers[i];
+            }
+        }
+
+        ~ThreadPins()
+        {
+            if (reader)
+                reader->claimed.store(false, std::memory_order_release);
+        }
+    };
+
+    thread_local ThreadPins pins;
+
+    const Config *defaults()
+    {
+        Config *config = new Config();
+        config->requestTemplate.compile(*config);
+        return config;
+    }
+
+    std::atomic<const Config *> &current()
+    {
+        static std::atomic<const Config *> snapshot(defaults());
+        return snapshot;
+    }
+
+    bool isPinned(const Config *config)
+    {
+        for (int i = 0; i < MAX_READERS; i++)
+        {
+            if (readers[i].pinned.load() == config)
+                return true;
+        }
+        return false;
+    }
+}
+
+Config::Snapshot::Snapshot()
+{
+    ThreadPins &thread = pins;
+    if (thread.depth++ > 0)
+    {
+        _config = thread.config;
+        return;
+    }
+
+    std::atomic<const Config *> &snapshot = current();
+    const Config *config;
+    if (thread.reader)
+    {
+        const Config *announced;
+        config = snapshot.load();
+        do
+        {
+            announced = config;
+            thread.reader->pinned.store(announced);
+            config = snapshot.load();
+        } while (config != announced);
+    }
+    else
+    {
+        overflowPins.fetch_add(1);
+        config = snapshot.load();
+    }
+    thread.config = config;
+    _config = config;
+}
+
+Config::Snapshot::~Snapshot()
+{
+    ThreadPins &thread = pins;
+    if (--thread.depth > 0)
+        return;
+
+    if (thread.reader)
+        thread.reader->pinned.store(nullptr, std::memory_order_release);
+    else
+        overflowPins.fetch_sub(1, std::memory_order_release);
+    thread.config = nullptr;
+}
+
+quint64 Config::publish(const Config &config)
+{
+    static QMutex mutex; // Between writers, readers never take it
+    static QVector<const Config *> retired;
+    QMutexLocker lock(&mutex);
+
+    std::atomic<const Config *> &snapshot = current();
+    Config *next = new Config(config);
+    next->generation = snapshot.load()->generation + 1;
+    next->requestTemplate.compile(*next);
+    quint64 generation = next->generation;
+    retired.append(snapshot.exchange(next));
+
+    if (overflowPins.load() == 0)
+    {
+        for (int i = retired.size() - 1; i >= 0; i--)
+        {
+            if (isPinned(retired[i]))
+                continue;
+            delete retired[i];
+            retired.remove(i);
+        }
+    }
+    retiredCount = retired.size();
+    return generation;
+}
+
+int Config::retiredSnapshots()
+{
+    return retiredCount;
+}
@@ -5,17 +5,115 @@
 #include <QSettings>
 #include <QFile>
 #include <QDebug>
+#include "apdu_script.hpp"
+#include "read_plan.hpp"
+#include "request_template.hpp"
 
+#define CONFIG_FILE "/home/dart/program-files/card_config.ini"
+
+// Host builds have no AEP coupler, default them to the simulator
+#ifdef DEMOAPP_HOST_BUILD
+#define DEFAULT_READER_BACKEND "simulator"
+#else
+#define DEFAULT_READER_BACKEND "hardware"
+#endif
+
+// One immutable snapshot of card_config.ini, replaced whole by a reload.
+// Readers pin the current snapshot with a Config::Snapshot, which takes no
+// lock and keeps that snapshot alive until it goes out of scope. Pin once per
+// tap and read everything from it, a reload then shows at the next tap.
 class Config
 {
 public:
-    static Config &instance()
+    // Pins the current snapshot on the calling thread. Pins nested on one
+    // thread share the outermost one, so a whole tap sees the same snapshot.
+    // Released on the thread that took it, not handed to another.
+    class Snapshot
+    {
+    public:
+        Snapshot();
+        ~Snapshot();
+
+        const Config &operator*() const { return *_config; }
+        const Config *operator->() const { return _config; }
+
+    private:
+        Snapshot(const Snapshot &);
+        Snapshot &operator=(const Snapshot &);
+
+        const Config *_config;
+    };
+
+    // Makes a copy of config, with its request template compiled, the current
+    // snapshot and returns its generation. Replaced snapshots are freed once
+    // no reader has them pinned.
+    static quint64 publish(const Config &config);
+
+    // Replaced snapshots publish() could not free yet, they were still pinned
+    static int retiredSnapshots();
+
+    // Loads filename into a new snapshot and publishes it; the current one
+    // stays when the file is missing
+    static bool reload(const QString &filename = CONFIG_FILE)
     {
-        static Config instance;
-        return instance;
+        Config config;
+        if (!config.load(filename))
+            return false;
+        publish(config);
+        return true;
+    }
+
+    // Built-in defaults, load() fills in the file
+    Config()
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            keyA[i] = 0xFF;
+        }
+        sector = 1;
+        startBlock = 4;
+        endBlock = 7;
+        keySlotBase = 0;
+        keySlotCount = 16;
+        iso15693MaxBlocksPerRead = 32;
+        ultralightFastRead = true;
+        ultralightMaxPagesPerRead = 64;
+        iso14443MaxBitRate = 848;
+        cardTypeId = 1;
+        apiTimeout = 30000;
+        apiWarmUp = true;
+        apiWarmCheckMs = 1000;
+        apiWarmUpTimeoutMs = 2000;
+        apiKeepAliveIdleS = 30;
+        apiKeepAliveIntervalS = 10;
+        apiMaxConnections = 4;
+        pipelineDepth = 2;
+        batchMaxTaps = 1;
+        batchWindowMs = 50;
+        journalMaxKB = 4096;
+        journalSyncIntervalMs = 200;
+        journalRetryMinMs = 1000;
+        journalRetryMaxMs = 30000;
+        debounceTtlMs = 10000;
+        debounceMaxEntries = 64;
+        debounceShortCircuit = false;
+        readerBackend = DEFAULT_READER_BACKEND;
+        pollMinIntervalMs = 10;
+        pollMaxIntervalMs = 150;
+        pollActiveWindowMs = 3000;
+        pollBackoff = 1.5;
+        searchTimeout = 1;
+        logMaxFileKB = 4096;
+        logConsole = false;
+        logLevel = 1;
+        signAlgorithm = "SHA1withRSA";
+        verifyAlgorithm = "SHA1withRSA";
+        verifyMode = "deferred";
+        verifyQueueDepth = 64;
+        generation = 0;
     }
 
-    bool load(const QString &filename = "/home/dart/program-files/card_config.ini")
+    bool load(const QString &filename = CONFIG_FILE)
     {
         if (!QFile::exists(filename))
         {
@@ -25,11 +123,46 @@ public:
 
         qDebug() << "Config file found in from:" << filename;
         QSettings settings(filename, QSettings::IniFormat);
+        fileName = filename;
 
         // API Settings
         settings.beginGroup("API");
         apiUrl = settings.value("url", "http://192.168.8.116:2601/api/third-party/faremedia/fare-media-tap").toString();
         apiTimeout = settings.value("timeout", 30000).toInt();
+        apiWarmUp = settings.value("warmUp", true).toBool();
+        apiWarmCheckMs = qMax(10, settings.value("warmCheckMs", 1000).toInt());
+        apiWarmUpTimeoutMs = settings.value("warmUpTimeoutMs", 2000).toInt();
+        apiKeepAliveIdleS = settings.value("keepAliveIdleS", 30).toInt();
+        apiKeepAliveIntervalS = settings.value("keepAliveIntervalS", 10).toInt();
+        apiMaxConnections = qMax(1, settings.value("maxConnections", 4).toInt());
+        settings.endGroup();
+
+        // Tap pipeline
+        settings.beginGroup("Pipeline");
+        pipelineDepth = settings.value("depth", 2).toInt();
+        settings.endGroup();
+
+        // Batched tap submission
+        settings.beginGroup("Batch");
+        batchMaxTaps = qMax(1, settings.value("maxTaps", 1).toInt());
+        batchWindowMs = settings.value("windowMs", 50).toInt();
+        batchUrl = settings.value("url", "").toString();
+        settings.endGroup();
+
+        // Offline tap journal
+        settings.beginGroup("Journal");
+        journalPath = settings.value("path", "/home/dart/program-files/tap_journal.bin").toString();
+        journalMaxKB = settings.value("maxKB", 4096).toInt();
+        journalSyncIntervalMs = settings.value("syncIntervalMs", 200).toInt();
+        journalRetryMinMs = settings.value("retryMinMs", 1000).toInt();
+        journalRetryMaxMs = settings.value("retryMaxMs", 30000).toInt();
+        settings.endGroup();
+
+        // Duplicate tap suppression
+        settings.beginGroup("Debounce");
+        debounceTtlMs = settings.value("ttlMs", 10000).toInt();
+        debounceMaxEntries = settings.value("maxEntries", 64).toInt();
+        debounceShortCircuit = settings.value("mode", "suppress").toString().compare("shortCircuit", Qt::CaseInsensitive) == 0;
         settings.endGroup();
 
         // Certificate Settings
@@ -37,6 +170,10 @@ public:
         privateCertPath = settings.value("privateCertPath", "/home/dart/program-files/afcsPrivateCertificate.pfx").toString();
         publicCertPath = settings.value("publicCertPath", "/home/dart/program-files/afcsPublic116.pfx").toString();
         certPassword = settings.value("password", "Nyapula@3411").toString();
+        signAlgorithm = settings.value("signAlgorithm", "SHA1withRSA").toString();
+        verifyAlgorithm = settings.value("verifyAlgorithm", "SHA1withRSA").toString();
+        verifyMode = settings.value("verifyMode", "deferred").toString();
+        verifyQueueDepth = settings.value("verifyQueueDepth", 64).toInt();
         settings.endGroup();
 
         // Card Authentication
@@ -53,6 +190,72 @@ public:
         sector = settings.value("sector", 1).toInt();
         startBlock = settings.value("startBlock", 4).toInt();
         endBlock = settings.value("endBlock", 7).toInt();
+        keySlotBase = settings.value("keySlotBase", 0).toInt();
+        keySlotCount = settings.value("keySlotCount", 16).toInt();
+        settings.endGroup();
+
+        // ISO15693 vicinity tags
+        settings.beginGroup("ISO15693");
+        iso15693MaxBlocksPerRead = settings.value("maxBlocksPerRead", 32).toInt();
+        settings.endGroup();
+
+        // Ultralight / NTAG
+        settings.beginGroup("Ultralight");
+        ultralightFastRead = settings.value("fastRead", true).toBool();
+        ultralightMaxPagesPerRead = settings.value("maxPagesPerRead", 64).toInt();
+        settings.endGroup();
+
+        // ISO14443-4 cards: bit rate cap and the application scripts to try
+        settings.beginGroup("ISO14443");
+        iso14443MaxBitRate = settings.value("maxBitRate", 848).toInt();
+        QStringList applications = settings.value("applications", "ndef").toStringList();
+        settings.endGroup();
+
+        settings.beginGroup("ApduScripts");
+        apduScripts.clear();
+        foreach (const QString &application, applications)
+        {
+            ApduScript script = ApduScript::parse(application.trimmed(), settings.value(application.trimmed()).toStringList());
+            if (script.isEmpty())
+                qDebug() << "No APDU script for application" << application;
+            else
+                apduScripts.append(script);
+        }
+        settings.endGroup();
+
+        // Read plans per card type, defaulting to the single [Card] range
+        QString legacyPlan = QString("%1:%2-%3").arg(sector).arg(startBlock).arg(endBlock);
+        settings.beginGroup("ReadPlan");
+        classic1KPlan = ReadPlan::parse(settings.value("classic1K", legacyPlan).toStringList(), keyA, 16);
+        classic4KPlan = ReadPlan::parse(settings.value("classic4K", legacyPlan).toStringList(), keyA, 40);
+        settings.endGroup();
+
+        // Reader backend
+        settings.beginGroup("Reader");
+        readerBackend = settings.value("backend", DEFAULT_READER_BACKEND).toString();
+        simulatorScript = settings.value("simulatorScript", "/home/dart/program-files/coupler_sim.ini").toString();
+        settings.endGroup();
+
+        // Card presence polling
+        settings.beginGroup("Polling");
+        pollMinIntervalMs = settings.value("minIntervalMs", 10).toUInt();
+        pollMaxIntervalMs = settings.value("maxIntervalMs", 150).toUInt();
+        pollActiveWindowMs = settings.value("activeWindowMs", 3000).toUInt();
+        pollBackoff = settings.value("backoff", 1.5).toDouble();
+        searchTimeout = settings.value("searchTimeout", 1).toUInt();
+        settings.endGroup();
+
+        // Logging
+        settings.beginGroup("Logging");
+        logFile = settings.value("file", "/home/dart/program-files/demoapp.log").toString();
+        logMaxFileKB = settings.value("maxFileKB", 4096).toInt();
+        logConsole = settings.value("console", false).toBool();
+        logLevel = settings.value("level", 1).toInt();
+        settings.endGroup();
+
+        // Metrics
+        settings.beginGroup("Metrics");
+        metricsSocket = settings.value("socket", "/tmp/demoapp-metrics.sock").toString();
         settings.endGroup();
 
         // Device Info
@@ -76,6 +279,8 @@ public:
         msgSuccess = settings.value("success", "Kadi imesomwa vizuri!").toString();
         msgApiError = settings.value("apiError", "Tatizo la kuwasiliana!").toString();
         msgProcessing = settings.value("processing", "Inaendelea...").toString();
+        msgDuplicate = settings.value("duplicate", "Kadi imeshasomwa!").toString();
+        msgQueued = settings.value("queued", "Kadi imehifadhiwa!").toString();
         settings.endGroup();
 
         qDebug() << "Config loaded successfully";
@@ -85,17 +290,76 @@ public:
     // API Settings
     QString apiUrl;
     int apiTimeout;
+    bool apiWarmUp;         // Connection opened while waiting for a card
+    int apiWarmCheckMs;
+    int apiWarmUpTimeoutMs;
+    int apiKeepAliveIdleS;  // TCP keep-alive probes
+    int apiKeepAliveIntervalS;
+    int apiMaxConnections;  // Asynchronous requests on the wire at once
+
+    // Pipeline Settings
+    int pipelineDepth;
+
+    // Batch Settings
+    int batchMaxTaps; // 1 = one request per tap
+    int batchWindowMs;
+    QString batchUrl; // Empty: apiUrl + "/batch"
+
+    // Journal Settings
+    QString journalPath; // Empty: no offline journal
+    int journalMaxKB;
+    int journalSyncIntervalMs;
+    int journalRetryMinMs;
+    int journalRetryMaxMs;
+
+    // Debounce Settings
+    int debounceTtlMs;
+    int debounceMaxEntries;
+    bool debounceShortCircuit;
 
     // Certificate Settings
     QString privateCertPath;
     QString publicCertPath;
     QString certPassword;
+    QString signAlgorithm;
+    QString verifyAlgorithm;
+    QString verifyMode; // deferred or blocking
+    int verifyQueueDepth;
 
     // Card Settings
     uint8_t keyA[6];
     int sector;
     int startBlock;
     int endBlock;
+    int keySlotBase;
+    int keySlotCount;
+    ReadPlan classic1KPlan;
+    ReadPlan classic4KPlan;
+    int iso15693MaxBlocksPerRead;
+    bool ultralightFastRead;
+    int ultralightMaxPagesPerRead;
+    int iso14443MaxBitRate;
+    QList<ApduScript> apduScripts;
+
+    // Reader Settings
+    QString readerBackend;
+    QString simulatorScript;
+
+    // Polling Settings
+    unsigned int pollMinIntervalMs;
+    unsigned int pollMaxIntervalMs;
+    unsigned int pollActiveWindowMs;
+    double pollBackoff;
+    unsigned int searchTimeout;
+
+    // Logging Settings
+    QString logFile;
+    int logMaxFileKB;
+    bool logConsole;
+    int logLevel;
+
+    // Metrics Settings
+    QString metricsSocket;
 
     // Device Info
     QString deviceName;
@@ -115,19 +379,15 @@ public:
     QString msgSuccess;
     QString msgApiError;
     QString msgProcessing;
+    QString msgDuplicate;
+    QString msgQueued;
 
-private:
-    Config()
-    {
-        for (int i = 0; i < 6; i++)
-        {
-            keyA[i] = 0xFF;
-        }
-        sector = 1;
-        startBlock = 4;
-        endBlock = 7;
-        cardTypeId = 1;
-    }
+    QString fileName;   // Loaded from, empty for the built-in defaults
+    quint64 generation; // 0 for the built-in defaults, +1 per publish()
+
+    // Compiled by publish() from the fields above, so a request takes its
+    // URL, headers and payload parts from one snapshot
+    RequestTemplate requestTemplate;
 };
 
 #endif // CONFIG_HPP
@@ -0,0 +1,156 @@
+/*******************************************************************************
+ * Config Watcher Implementation
+ *******************************************************************************/
+
+#include "config_watcher.hpp"
+#include "config.hpp"
+#include <QDebug>
+#include <QFileInfo>
+#include <QSocketNotifier>
+#include <QStringList>
+#include <QTimer>
+#include <cerrno>
+#include <cstring>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// Saving one file is several events, and a copy over the network longer still
+static const int SETTLE_MS = 200;
+
+// Settings the running app took at startup that differ between two snapshots
+static QStringList restartOnly(const Config &before, const Config &after)
+{
+    QStringList keys;
+#define RESTART_ONLY(key, field)     \
+    if (before.field != after.field) \
+        keys << key
+
+    RESTART_ONLY("[API] warmUp", apiWarmUp);
+    RESTART_ONLY("[API] warmCheckMs", apiWarmCheckMs);
+    RESTART_ONLY("[API] keepAliveIdleS", apiKeepAliveIdleS);
+    RESTART_ONLY("[API] keepAliveIntervalS", apiKeepAliveIntervalS);
+    RESTART_ONLY("[API] maxConnections", apiMaxConnections);
+    RESTART_ONLY("[Pipeline] depth", pipelineDepth);
+    RESTART_ONLY("[Batch] maxTaps", batchMaxTaps);
+    RESTART_ONLY("[Batch] windowMs", batchWindowMs);
+    RESTART_ONLY("[Journal] path", journalPath);
+    RESTART_ONLY("[Journal] maxKB", journalMaxKB);
+    RESTART_ONLY("[Journal] syncIntervalMs", journalSyncIntervalMs);
+    RESTART_ONLY("[Journal] retryMinMs", journalRetryMinMs);
+    RESTART_ONLY("[Journal] retryMaxMs", journalRetryMaxMs);
+    RESTART_ONLY("[Debounce] ttlMs", debounceTtlMs);
+    RESTART_ONLY("[Debounce] maxEntries", debounceMaxEntries);
+    RESTART_ONLY("[Debounce] mode", debounceShortCircuit);
+    RESTART_ONLY("[Certificate] privateCertPath", privateCertPath);
+    RESTART_ONLY("[Certificate] publicCertPath", publicCertPath);
+    RESTART_ONLY("[Certificate] password", certPassword);
+    RESTART_ONLY("[Certificate] signAlgorithm", signAlgorithm);
+    RESTART_ONLY("[Certificate] verifyAlgorithm", verifyAlgorithm);
+    RESTART_ONLY("[Certificate] verifyMode", verifyMode);
+    RESTART_ONLY("[Certificate] verifyQueueDepth", verifyQueueDepth);
+    RESTART_ONLY("[Reader] backend", readerBackend);
+    RESTART_ONLY("[Reader] simulatorScript", simulatorScript);
+    RESTART_ONLY("[Logging] file", logFile);
+    RESTART_ONLY("[Logging] maxFileKB", logMaxFileKB);
+    RESTART_ONLY("[Logging] console", logConsole);
+    RESTART_ONLY("[Metrics] socket", metricsSocket);
+
+#undef RESTART_ONLY
+    return keys;
+}
+
+ConfigWatcher::ConfigWatcher(QObject *parent)
+    : QObject(parent), _fd(-1), _notifier(nullptr), _settle(new QTimer(this))
+{
+    _settle->setSingleShot(true);
+    _settle->setInterval(SETTLE_MS);
+    connect(_settle, &QTimer::timeout, this, &ConfigWatcher::reload);
+}
+
+ConfigWatcher::~ConfigWatcher()
+{
+    stop();
+}
+
+bool ConfigWatcher::start(const QString &fileName)
+{
+    if (isRunning())
+        return true;
+
+    QFileInfo info(fileName);
+    _fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_fd < 0)
+    {
+        qDebug() << "Failed to create inotify instance:" << strerror(errno);
+        return false;
+    }
+
+    // Written in place, or written elsewhere and renamed over it
+    QByteArray directory = info.absolutePath().toLocal8Bit();
+    if (inotify_add_watch(_fd, directory.constData(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        qDebug() << "Failed to watch" << info.absolutePath() << ":" << strerror(errno);
+        close(_fd);
+        _fd = -1;
+        return false;
+    }
+
+    _fileName = info.absoluteFilePath();
+    _name = info.fileName().toLocal8Bit();
+    _notifier = new QSocketNotifier(_fd, QSocketNotifier::Read, this);
+    connect(_notifier, SIGNAL(activated(int)), this, SLOT(onEvents()));
+    qDebug() << "Reloading configuration when" << _fileName << "changes";
+    return true;
+}
+
+void ConfigWatcher::stop()
+{
+    if (!isRunning())
+        return;
+
+    delete _notifier;
+    _notifier = nullptr;
+    _settle->stop();
+    close(_fd);
+    _fd = -1;
+}
+
+void ConfigWatcher::onEvents()
+{
+    // Events carry the name of the file within the directory
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+    ssize_t length;
+    while ((length = read(_fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (char *p = buffer; p < buffer + length;)
+        {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            if (event->len > 0 && _name == event->name)
+                changed = true;
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    // Restarted by every event, the file is read once they stop
+    if (changed)
+        _settle->start();
+}
+
+void ConfigWatcher::reload()
+{
+    Config::Snapshot before;
+    Config next;
+    if (!next.load(_fileName))
+    {
+        qDebug() << "Keeping configuration" << before->generation;
+        return;
+    }
+
+    QStringList restart = restartOnly(*before, next);
+    quint64 generation = Config::publish(next);
+    qDebug() << "Configuration" << generation << "loaded, taps use it from the next one";
+    if (!restart.isEmpty())
+        qDebug() << "Changed, takes effect after a restart:" << restart.join(", ");
+    emit reloaded(generation);
+}
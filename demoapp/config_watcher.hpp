@@ -0,0 +1,55 @@
+/*******************************************************************************
+ * Config Watcher - reloads card_config.ini when it changes on disk
+ *
+ *   inotify on the directory ──QSocketNotifier──> settle timer
+ *                                                   └─> load, Config::publish() ──> reloaded()
+ *
+ * The directory is watched rather than the file, so an editor that writes a
+ * new file and renames it over the old one is seen as well. Events are given
+ * SETTLE_MS to end before the file is parsed into a new snapshot; a file that
+ * is missing at that point keeps the current one.
+ *
+ * Works on the event loop of the thread that owns it. Settings only read at
+ * startup (certificates, reader backend, pipeline, journal, log file, ...)
+ * are reported when they change and wait for the next start.
+ *******************************************************************************/
+
+#ifndef CONFIG_WATCHER_HPP
+#define CONFIG_WATCHER_HPP
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+
+class QSocketNotifier;
+class QTimer;
+
+class ConfigWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ConfigWatcher(QObject *parent = nullptr);
+    ~ConfigWatcher();
+
+    bool start(const QString &fileName);
+    void stop();
+    bool isRunning() const { return _fd >= 0; }
+
+signals:
+    // A new snapshot is current
+    void reloaded(quint64 generation);
+
+private slots:
+    void onEvents();
+    void reload();
+
+private:
+    QString _fileName;
+    QByteArray _name; // Of the file within the watched directory
+    int _fd;
+    QSocketNotifier *_notifier;
+    QTimer *_settle;
+};
+
+#endif // CONFIG_WATCHER_HPP
@@ -0,0 +1,120 @@
+#----------------------------------------------------------------------------------
+# Core of the demoapp: card reading, signing, HTTP, codecs and metrics.
+# No widgets and, in host builds, no AEP SDK. Shared by demoapp.pro,
+# core.pro (static library), the host unit tests and the host benchmarks.
+#----------------------------------------------------------------------------------
+
+# Host builds (x86 or CONFIG+=host) run against the simulated coupler only
+x86|host {
+  CONFIG   += host
+  DEFINES  += DEMOAPP_HOST_BUILD
+}
+
+QT         += core
+CONFIG     += c++11 link_pkgconfig
+
+# Debug and trace logging compiled out of release builds (see log.hpp)
+CONFIG(release, debug|release): DEFINES += DEMOAPP_LOG_LEVEL=2
+
+INCLUDEPATH += $$PWD
+DEPENDPATH  += $$PWD
+
+CORE_SOURCES = \
+    $$PWD/api_client.cpp \
+    $$PWD/apdu_script.cpp \
+    $$PWD/card_reader.cpp \
+    $$PWD/codec.cpp \
+    $$PWD/config.cpp \
+    $$PWD/config_watcher.cpp \
+    $$PWD/http_engine.cpp \
+    $$PWD/iso15693_reader.cpp \
+    $$PWD/latency_histogram.cpp \
+    $$PWD/log.cpp \
+    $$PWD/metrics_server.cpp \
+    $$PWD/poll_scheduler.cpp \
+    $$PWD/read_plan.cpp \
+    $$PWD/request_template.cpp \
+    $$PWD/response_auditor.cpp \
+    $$PWD/response_parser.cpp \
+    $$PWD/signature_helper.cpp \
+    $$PWD/simulated_coupler.cpp \
+    $$PWD/startup.cpp \
+    $$PWD/tap_cache.cpp \
+    $$PWD/tap_journal.cpp \
+    $$PWD/tap_metrics.cpp \
+    $$PWD/tap_pipeline.cpp \
+    $$PWD/tcl_transport.cpp \
+    $$PWD/ultralight_reader.cpp
+
+CORE_HEADERS = \
+    $$PWD/api_client.hpp \
+    $$PWD/apdu_script.hpp \
+    $$PWD/bounded_queue.hpp \
+    $$PWD/card_reader.hpp \
+    $$PWD/card_types.hpp \
+    $$PWD/codec.hpp \
+    $$PWD/config.hpp \
+    $$PWD/config_watcher.hpp \
+    $$PWD/coupler_backend.hpp \
+    $$PWD/http_engine.hpp \
+    $$PWD/iso15693_reader.hpp \
+    $$PWD/latency_histogram.hpp \
+    $$PWD/log.hpp \
+    $$PWD/metrics_server.hpp \
+    $$PWD/poll_scheduler.hpp \
+    $$PWD/read_plan.hpp \
+    $$PWD/request_template.hpp \
+    $$PWD/response_auditor.hpp \
+    $$PWD/response_parser.hpp \
+    $$PWD/scanworker.hpp \
+    $$PWD/signature_helper.hpp \
+    $$PWD/simulated_coupler.hpp \
+    $$PWD/spsc_queue.hpp \
+    $$PWD/startup.hpp \
+    $$PWD/tap_cache.hpp \
+    $$PWD/tap_journal.hpp \
+    $$PWD/tap_metrics.hpp \
+    $$PWD/tap_pipeline.hpp \
+    $$PWD/tcl_transport.hpp \
+    $$PWD/ultralight_reader.hpp
+
+!host {
+  CORE_SOURCES += $$PWD/hardware_coupler.cpp
+  CORE_HEADERS += $$PWD/hardware_coupler.hpp
+
+  CONFIG(debug, debug|release) {
+    PKGCONFIG  += coupler-debug
+  } else {
+    PKGCONFIG  += coupler
+  }
+}
+
+host {
+  # Distribution curl and OpenSSL
+  PKGCONFIG += libcurl openssl
+} else {
+  # Library paths
+  LIBS_PATH = /opt/aep-cdb4v2
+
+  # Include paths
+  INCLUDEPATH += $$LIBS_PATH/curl/include
+  INCLUDEPATH += $$LIBS_PATH/openssl/include
+  INCLUDEPATH += $$LIBS_PATH/json-c/usr/local/include
+  INCLUDEPATH += $$LIBS_PATH/yaml-cpp/usr/local/include
+
+  # Library linking - order matters!
+  # Link curl first
+  LIBS += -L$$LIBS_PATH/curl/lib -lcurl
+
+  # Link OpenSSL libraries (crypto and ssl)
+  LIBS += -L$$LIBS_PATH/openssl/lib -lcrypto -lssl
+
+  # Link json-c
+  LIBS += -L$$LIBS_PATH/json-c/usr/local/lib -ljson-c
+
+  # Link yaml-cpp
+  LIBS += -L$$LIBS_PATH/yaml-cpp/usr/local/lib -lyaml-cpp
+}
+
+# Add system libraries that OpenSSL/curl might need
+LIBS += -ldl -lpthread
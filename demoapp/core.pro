@@ -0,0 +1,13 @@
+#----------------------------------------------------------------------------------
+# Static library of the demoapp core, linked by the host tests and benchmarks
+#----------------------------------------------------------------------------------
+
+TARGET      = demoapp_core
+TEMPLATE    = lib
+CONFIG     += staticlib
+QT         -= gui
+
+include(core.pri)
+
+SOURCES    += $$CORE_SOURCES
+HEADERS    += $$CORE_HEADERS
@@ -0,0 +1,150 @@
+/*******************************************************************************
+ * Coupler Backend - abstraction over the contactless coupler
+ *
+ * CardReader only talks to this interface. The hardware backend wraps the AEP
+ * SDK Coupler on /dev/aep/coupler_tty, the simulated backend replays a scripted
+ * field so the whole tap pipeline can run on a plain Linux box.
+ *******************************************************************************/
+
+#ifndef COUPLER_BACKEND_HPP
+#define COUPLER_BACKEND_HPP
+
+#include <QByteArray>
+#include <cstdint>
+
+// Protocols to look for during a card search (mirrors sCARD_Search)
+struct CardSearchMask
+{
+    bool mifare = false;
+    bool isoA = false;
+    bool isoB = false;
+    bool inno = false;
+    bool tick = false;
+    bool srx = false;
+};
+
+// Command counters kept for every backend, used to report serial traffic
+struct CouplerStats
+{
+    uint64_t searches = 0;
+    uint64_t cardsFound = 0;
+    uint64_t keyLoads = 0;
+    uint64_t authentications = 0;
+    uint64_t blockReads = 0;
+    uint64_t exchanges = 0;
+    uint64_t failures = 0;
+    uint64_t resets = 0;
+
+    uint64_t commands() const
+    {
+        return searches + keyLoads + authentications + blockReads + exchanges + resets;
+    }
+};
+
+class CouplerBackend
+{
+public:
+    // "com" value reported by a search when the field is empty
+    static const uint8_t COM_NO_CARD = 0x6F;
+    // "com" of an ISO14443-4 card
+    static const uint8_t COM_ISO14443_4 = 0x08;
+
+    virtual ~CouplerBackend() {}
+
+    virtual const char *name() const = 0;
+    virtual bool open() = 0;
+    virtual void close() = 0;
+
+    // Every command returns false on a transport error. Card level errors are
+    // reported through *status (0 = OK), like the SDK calls they wrap.
+    bool searchCard(const CardSearchMask &mask, uint8_t forget, uint8_t timeout,
+                    uint8_t *com, uint16_t *atrLen, uint8_t *atr)
+    {
+        _stats.searches++;
+        bool ok = doSearchCard(mask, forget, timeout, com, atrLen, atr);
+        if (!ok)
+            _stats.failures++;
+        else if (*com != COM_NO_CARD)
+            _stats.cardsFound++;
+        return ok;
+    }
+
+    bool loadReaderKey(uint8_t keyIndex, const uint8_t *key, uint8_t *status)
+    {
+        _stats.keyLoads++;
+        return count(doLoadReaderKey(keyIndex, key, status), status);
+    }
+
+    bool authenticate(uint8_t sector, uint8_t keyType, uint8_t keyIndex,
+                      uint8_t *cardType, uint8_t *serialNumber, uint8_t *status)
+    {
+        _stats.authentications++;
+        return count(doAuthenticate(sector, keyType, keyIndex, cardType, serialNumber, status), status);
+    }
+
+    bool readBlock(uint8_t block, uint8_t *data, uint8_t *status)
+    {
+        _stats.blockReads++;
+        return count(doReadBlock(block, data, status), status);
+    }
+
+    // Raw frame exchange with the card in the field (ISO15693 requests,
+    // ISO14443 frames). The coupler adds and checks the CRC. *rxLen holds the
+    // buffer size on input and the response length on output.
+    bool transceive(const uint8_t *tx, uint16_t txLen, uint8_t *rx, uint16_t *rxLen)
+    {
+        _stats.exchanges++;
+        bool ok = doTransceive(tx, txLen, rx, rxLen);
+        if (!ok)
+            _stats.failures++;
+        return ok;
+    }
+
+    void reset()
+    {
+        _stats.resets++;
+        doReset();
+    }
+
+    // True when the search itself activates ISO14443-4 cards (RATS, PPS) and
+    // transceive() carries whole APDUs, the coupler running the block
+    // protocol. False when transceive() exchanges raw frames and the host
+    // runs T=CL on top.
+    virtual bool activatesIsoDep() const { return false; }
+
+    // ATS of the ISO14443-4 card the last search activated, TL first. Empty
+    // when the search did not activate one.
+    virtual QByteArray isoDepAts() const { return QByteArray(); }
+
+    // ISO14443-4 bit rates the coupler can switch to after a PPS, as the
+    // highest divisor of 106 kbit/s (1, 2, 4 or 8). ds = card to reader,
+    // dr = reader to card. With activatesIsoDep() the coupler negotiates
+    // itself, up to this divisor.
+    virtual int maxBitRateDivisor() const { return 1; }
+    virtual bool setBitRate(int ds, int dr) { return ds == 1 && dr == 1; }
+
+    const CouplerStats &stats() const { return _stats; }
+    void resetStats() { _stats = CouplerStats(); }
+
+protected:
+    virtual bool doSearchCard(const CardSearchMask &mask, uint8_t forget, uint8_t timeout,
+                              uint8_t *com, uint16_t *atrLen, uint8_t *atr) = 0;
+    virtual bool doLoadReaderKey(uint8_t keyIndex, const uint8_t *key, uint8_t *status) = 0;
+    virtual bool doAuthenticate(uint8_t sector, uint8_t keyType, uint8_t keyIndex,
+                                uint8_t *cardType, uint8_t *serialNumber, uint8_t *status) = 0;
+    virtual bool doReadBlock(uint8_t block, uint8_t *data, uint8_t *status) = 0;
+    virtual bool doTransceive(const uint8_t *tx, uint16_t txLen, uint8_t *rx, uint16_t *rxLen) = 0;
+    virtual void doReset() = 0;
+
+private:
+    bool count(bool ok, const uint8_t *status)
+    {
+        if (!ok || *status != 0)
+            _stats.failures++;
+        return ok;
+    }
+
+    CouplerStats _stats;
+};
+
+#endif // COUPLER_BACKEND_HPP
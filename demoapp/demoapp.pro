@@ -14,27 +14,19 @@ unix {
     QMAKE_LFLAGS += -Wl,--enable-new-dtags
 }
 
-x86 {
-  error("Impossible to build for architecture $$SDL_ARCH")
+# Card reading, signing and HTTP; pulls in the coupler and host settings
+include(core.pri)
+
+host {
+  message("Building for host with the simulated coupler")
 }
 
 TARGET      = demoapp
 TEMPLATE    = app
-QT         += core gui widgets concurrent
+QT         += core gui widgets
 CONFIG     += cmdline
-CONFIG     += link_pkgconfig
-CONFIG     += c++11
-SOURCES    += main.cpp mainwindow.cpp \
-    api_client.cpp \
-    card_reader.cpp \
-    signature_helper.cpp
-
-HEADERS    += mainwindow.h \
-    api_client.hpp \
-    card_reader.hpp \
-    config.hpp \
-    scanworker.hpp \
-    signature_helper.hpp
+SOURCES    += main.cpp mainwindow.cpp $$CORE_SOURCES
+HEADERS    += mainwindow.h $$CORE_HEADERS
 
 FORMS      += mainwindow.ui
 
@@ -42,36 +34,12 @@ AEP-CDB4V2 {
     message("Building AEP-CDB4V2")
 }
 
-# Library paths
-LIBS_PATH = /opt/aep-cdb4v2
-
-# Include paths
-INCLUDEPATH += $$LIBS_PATH/curl/include
-INCLUDEPATH += $$LIBS_PATH/openssl/include
-INCLUDEPATH += $$LIBS_PATH/json-c/usr/local/include
-INCLUDEPATH += $$LIBS_PATH/yaml-cpp/usr/local/include
-
-# Library linking - order matters!
-# Link curl first
-LIBS += -L$$LIBS_PATH/curl/lib -lcurl
-
-# Link OpenSSL libraries (crypto and ssl)
-LIBS += -L$$LIBS_PATH/openssl/lib -lcrypto -lssl
-
-# Link json-c
-LIBS += -L$$LIBS_PATH/json-c/usr/local/lib -ljson-c
-
-# Link yaml-cpp
-LIBS += -L$$LIBS_PATH/yaml-cpp/usr/local/lib -lyaml-cpp
-
-# Add system libraries that OpenSSL/curl might need
-LIBS += -ldl -lpthread
-
-
-CONFIG(debug, debug|release) {
-  PKGCONFIG  += als-debug coupler-debug
-} else {
-  PKGCONFIG  += als coupler
+!host {
+  CONFIG(debug, debug|release) {
+    PKGCONFIG  += als-debug
+  } else {
+    PKGCONFIG  += als
+  }
 }
 
 # Default rules for deployment.
@@ -80,8 +48,9 @@ INSTALLS += target
 
 # Install config file
 config.path = /home/dart/program-files
-config.files = card_config.ini
+config.files = card_config.ini coupler_sim.ini
 INSTALLS += config
 
 DISTFILES += \
-    card_config.ini
+    card_config.ini \
+    coupler_sim.ini
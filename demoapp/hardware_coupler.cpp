@@ -0,0 +1,132 @@
+/*******************************************************************************
+ * Hardware Coupler Implementation
+ *******************************************************************************/
+
+#include "hardware_coupler.hpp"
+#include <unistd.h>
+#include <cstring>
+#include <QDebug>
+
+using namespace als::Utils;
+
+HardwareCoupler::HardwareCoupler() : _powered(false) {}
+
+HardwareCoupler::~HardwareCoupler()
+{
+    close();
+}
+
+bool HardwareCoupler::open()
+{
+    if (!File::Exists(COUPLER_LINK) && symlink(COUPLER_TTY, COUPLER_LINK) == -1)
+    {
+        qDebug() << "Failed to create symlink to coupler device";
+        return false;
+    }
+
+    // Turn on the coupler (for CDB4v2 devices)
+    File::WriteInt32(COUPLER_POWER, 1);
+    _powered = true;
+
+    if (!_ext.Init(COUPLER_TTY))
+    {
+        qDebug() << "Error initializing coupler tty serial port";
+        close();
+        return false;
+    }
+
+    if (!_coupler.Init(&_ext))
+    {
+        qDebug() << "Error initializing coupler";
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void HardwareCoupler::close()
+{
+    if (_powered)
+    {
+        File::WriteInt32(COUPLER_POWER, 0);
+        _powered = false;
+    }
+}
+
+bool HardwareCoupler::doSearchCard(const CardSearchMask &mask, uint8_t forget, uint8_t timeout,
+                                   uint8_t *com, uint16_t *atrLen, uint8_t *atr)
+{
+    sCARD_Search search;
+    memset(&search, 0, sizeof(search));
+
+    search.MIFARE = mask.mifare;
+    search.ISOA = mask.isoA;
+    search.ISOB = mask.isoB;
+    search.INNO = mask.inno;
+    search.TICK = mask.tick;
+    search.SRX = mask.srx;
+
+    uint8 options = (mask.mifare || mask.isoA || mask.isoB) ? SEARCH_OPT_MAX_SPEED : 0;
+    uint16 len = 0;
+    unsigned char c = COM_NO_CARD;
+
+    bool ok = _coupler.SearchCardExt(search, forget, timeout, &c, &len, atr, options) == RCSC_Ok;
+    *com = c;
+    *atrLen = len;
+
+    // The answer of an activated ISO14443-4 card ends with its ATS, whose
+    // first byte (TL) is its own length
+    _ats.clear();
+    for (int i = 0; ok && c == COM_ISO14443_4 && i < len; i++)
+    {
+        if (atr[i] == len - i)
+        {
+            _ats = QByteArray((const char *)atr + i, len - i);
+            break;
+        }
+    }
+    return ok;
+}
+
+bool HardwareCoupler::doLoadReaderKey(uint8_t keyIndex, const uint8_t *key, uint8_t *status)
+{
+    uchar ucStatus = 0xFF;
+    int16 result = mifare()->LoadReaderKeyIndex(keyIndex, (uint8 *)key, &ucStatus);
+    *status = ucStatus;
+    return result == RCSC_Ok;
+}
+
+bool HardwareCoupler::doAuthenticate(uint8_t sector, uint8_t keyType, uint8_t keyIndex,
+                                     uint8_t *cardType, uint8_t *serialNumber, uint8_t *status)
+{
+    uchar ucStatus = 0xFF;
+    uchar ucType = 0;
+    int16 result = mifare()->Authenticate(sector, keyType, keyIndex, &ucType, serialNumber, &ucStatus);
+    *cardType = ucType;
+    *status = ucStatus;
+    return result == RCSC_Ok;
+}
+
+bool HardwareCoupler::doReadBlock(uint8_t block, uint8_t *data, uint8_t *status)
+{
+    uchar ucStatus = 0xFF;
+    int16 result = mifare()->ReadBlock(block, data, &ucStatus);
+    *status = ucStatus;
+    return result == RCSC_Ok;
+}
+
+bool HardwareCoupler::doTransceive(const uint8_t *tx, uint16_t txLen, uint8_t *rx, uint16_t *rxLen)
+{
+    // ISOCommand forwards the frame to the card selected by the last search,
+    // for an ISO14443-4 card the frame is an APDU
+    uint16 len = *rxLen;
+    int16 result = _coupler.ISOCommand((uint8 *)tx, txLen, rx, &len);
+    *rxLen = len;
+    return result == RCSC_Ok;
+}
+
+void HardwareCoupler::doReset()
+{
+    _coupler.Reset();
+}
@@ -0,0 +1,52 @@
+/*******************************************************************************
+ * Hardware Coupler - AEP SDK coupler on the CDB4V2 serial port
+ *******************************************************************************/
+
+#ifndef HARDWARE_COUPLER_HPP
+#define HARDWARE_COUPLER_HPP
+
+#include "coupler_backend.hpp"
+#include <coupler.hpp>
+#include <libals.h>
+
+class HardwareCoupler : public CouplerBackend
+{
+public:
+    HardwareCoupler();
+    ~HardwareCoupler();
+
+    const char *name() const override { return "hardware"; }
+    bool open() override;
+    void close() override;
+
+    // SearchCardExt activates ISO14443-4 cards and negotiates the bit rate
+    // with SEARCH_OPT_MAX_SPEED (up to 848 kbit/s), ISOCommand then takes
+    // whole APDUs and runs the block protocol itself
+    bool activatesIsoDep() const override { return true; }
+    QByteArray isoDepAts() const override { return _ats; }
+    int maxBitRateDivisor() const override { return 8; }
+
+protected:
+    bool doSearchCard(const CardSearchMask &mask, uint8_t forget, uint8_t timeout,
+                      uint8_t *com, uint16_t *atrLen, uint8_t *atr) override;
+    bool doLoadReaderKey(uint8_t keyIndex, const uint8_t *key, uint8_t *status) override;
+    bool doAuthenticate(uint8_t sector, uint8_t keyType, uint8_t keyIndex,
+                        uint8_t *cardType, uint8_t *serialNumber, uint8_t *status) override;
+    bool doReadBlock(uint8_t block, uint8_t *data, uint8_t *status) override;
+    bool doTransceive(const uint8_t *tx, uint16_t txLen, uint8_t *rx, uint16_t *rxLen) override;
+    void doReset() override;
+
+private:
+    CouplerMiFARE *mifare() { return (CouplerMiFARE *)&_coupler; }
+
+    Coupler _coupler;
+    CouplerExternalDependencies _ext;
+    bool _powered;
+    QByteArray _ats; // Of the ISO14443-4 card found by the last search
+
+    static constexpr const char *COUPLER_TTY = "/dev/aep/coupler_tty";
+    static constexpr const char *COUPLER_POWER = "/dev/aep/coupler_power";
+    static constexpr const char *COUPLER_LINK = "/dev/ttyCOUPLER";
+};
+
+#endif // HARDWARE_COUPLER_HPP
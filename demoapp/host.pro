@@ -0,0 +1,15 @@
+#----------------------------------------------------------------------------------
+# Host build of the non-hardware code: core library, unit tests and benchmarks
+#
+#   mkdir build-host && cd build-host
+#   qmake ../host.pro CONFIG+=host CONFIG+=release && make
+#   make check
+#   ./benchmarks/benchmarks > results.jsonl
+#----------------------------------------------------------------------------------
+
+TEMPLATE    = subdirs
+
+SUBDIRS     = core tests benchmarks
+core.file   = core.pro
+tests.depends = core
+benchmarks.depends = core
@@ -0,0 +1,428 @@
+/*******************************************************************************
+ * Http Engine Implementation
+ *******************************************************************************/
+
+#include "http_engine.hpp"
+#include "log.hpp"
+#include <QDebug>
+#include <QSocketNotifier>
+#include <QTimer>
+
+struct HttpEngine::Transfer
+{
+    CURL *handle = nullptr;
+    curl_slist *headers = nullptr;
+    Request request;
+    Callback callback;
+    Result result;
+    QElapsedTimer clock;
+};
+
+HttpEngine::HttpEngine()
+    : _timer(new QTimer(this)), _multi(nullptr), _running(false), _inFlight(0), _lastSocket(CURL_SOCKET_BAD)
+{
+    _timer->setSingleShot(true);
+    connect(_timer, &QTimer::timeout, this, &HttpEngine::onTimeout);
+
+    // Everything below runs on the engine thread, the timer moves along
+    moveToThread(&_thread);
+}
+
+HttpEngine::~HttpEngine()
+{
+    stop();
+}
+
+void HttpEngine::start(int maxConnections, const HandleSetup &setup)
+{
+    QMutexLocker lock(&_mutex);
+    if (_running)
+        return;
+
+    _multi = curl_multi_init();
+    if (!_multi)
+    {
+        qDebug() << "Failed to create the curl multi handle";
+        return;
+    }
+    curl_multi_setopt(_multi, CURLMOPT_SOCKETFUNCTION, socketCallback);
+    curl_multi_setopt(_multi, CURLMOPT_SOCKETDATA, this);
+    curl_multi_setopt(_multi, CURLMOPT_TIMERFUNCTION, timerCallback);
+    curl_multi_setopt(_multi, CURLMOPT_TIMERDATA, this);
+
+    // Transfers beyond the limit wait in curl for a connection to free up,
+    // the connections are kept for the transfers after them
+    long connections = qMax(1, maxConnections);
+#if LIBCURL_VERSION_NUM >= 0x071e00
+    curl_multi_setopt(_multi, CURLMOPT_MAX_HOST_CONNECTIONS, connections);
+#endif
+    curl_multi_setopt(_multi, CURLMOPT_MAXCONNECTS, connections);
+
+    _setup = setup;
+    _running = true;
+    _thread.start();
+    qDebug() << "HTTP engine started with" << connections << "connections";
+}
+
+void HttpEngine::stop()
+{
+    {
+        QMutexLocker lock(&_mutex);
+        if (!_running)
+            return;
+        _running = false;
+    }
+
+    // No post() gets through any more, shutdown() cancels what did
+    QMetaObject::invokeMethod(this, "shutdown", Qt::BlockingQueuedConnection);
+    _thread.quit();
+    _thread.wait();
+}
+
+bool HttpEngine::post(const Request &request, const Callback &callback)
+{
+    Transfer *transfer = new Transfer;
+    transfer->request = request;
+    transfer->callback = callback;
+    transfer->clock.start();
+
+    QMutexLocker lock(&_mutex);
+    if (!_running)
+    {
+        delete transfer;
+        return false;
+    }
+
+    // One wake-up for everything posted until the engine thread gets to it
+    _inFlight++;
+    _pending.append(transfer);
+    if (_pending.size() == 1)
+        QMetaObject::invokeMethod(this, "addPending", Qt::QueuedConnection);
+    return true;
+}
+
+void HttpEngine::addPending()
+{
+    QVector<Transfer *> pending;
+    {
+        QMutexLocker lock(&_mutex);
+        pending.swap(_pending);
+    }
+
+    bool normal = false;
+    for (int i = 0; i < pending.size() && !normal; i++)
+        normal = !pending[i]->request.preemptible;
+    if (normal)
+        preempt();
+
+    for (int i = 0; i < pending.size(); i++)
+    {
+        Transfer *transfer = pending[i];
+        if (normal && transfer->request.preemptible)
+        {
+            finish(transfer, CURLE_ABORTED_BY_CALLBACK);
+            continue;
+        }
+
+        CURL *handle = nullptr;
+        if (!_idleHandles.isEmpty())
+        {
+            handle = _idleHandles.takeLast();
+        }
+        else
+        {
+            handle = curl_easy_init();
+            if (handle && _setup)
+                _setup(handle);
+        }
+        if (!handle)
+        {
+            finish(transfer, CURLE_FAILED_INIT);
+            continue;
+        }
+        transfer->handle = handle;
+
+        const Request &request = transfer->request;
+        for (int h = 0; h < request.headers.size(); h++)
+            transfer->headers = curl_slist_append(transfer->headers, request.headers[h].constData());
+
+        curl_easy_setopt(handle, CURLOPT_URL, request.url.constData());
+        curl_easy_setopt(handle, CURLOPT_NOBODY, request.head ? 1L : 0L);
+        if (request.head || request.body.isEmpty())
+        {
+            curl_easy_setopt(handle, CURLOPT_HTTPGET, 1L);
+        }
+        else
+        {
+            // The body stays in the transfer until it is called back
+            curl_easy_setopt(handle, CURLOPT_POST, 1L);
+            curl_easy_setopt(handle, CURLOPT_POSTFIELDS, request.body.constData());
+            curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE, (long)request.body.size());
+        }
+        curl_easy_setopt(handle, CURLOPT_HTTPHEADER, transfer->headers);
+        curl_easy_setopt(handle, CURLOPT_TIMEOUT_MS, request.timeoutMs);
+        curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, writeCallback);
+        curl_easy_setopt(handle, CURLOPT_WRITEDATA, transfer);
+        curl_easy_setopt(handle, CURLOPT_PRIVATE, transfer);
+
+        CURLMcode code = curl_multi_add_handle(_multi, handle);
+        if (code != CURLM_OK)
+        {
+            LOG_WARNING("HTTP engine could not add a transfer: {}", curl_multi_strerror(code));
+            finish(transfer, CURLE_FAILED_INIT);
+            continue;
+        }
+        _active.insert(transfer);
+    }
+}
+
+void HttpEngine::preempt()
+{
+    // Once connected, the answer is a round trip away and the connection is
+    // kept for the transfer behind it. Cancelling would close it.
+    QList<Transfer *> active = _active.values();
+    for (int i = 0; i < active.size(); i++)
+    {
+        Transfer *transfer = active[i];
+        if (transfer->request.preemptible && !connected(transfer->handle))
+        {
+            LOG_DEBUG("HTTP engine cancels a preemptible transfer after {} us", transfer->clock.nsecsElapsed() / 1000);
+            finish(transfer, CURLE_ABORTED_BY_CALLBACK);
+        }
+    }
+}
+
+void HttpEngine::shutdown()
+{
+    QVector<Transfer *> pending;
+    {
+        QMutexLocker lock(&_mutex);
+        pending.swap(_pending);
+    }
+    for (int i = 0; i < pending.size(); i++)
+        finish(pending[i], CURLE_ABORTED_BY_CALLBACK);
+
+    // finish() takes each transfer out of _active
+    QList<Transfer *> active = _active.values();
+    for (int i = 0; i < active.size(); i++)
+        finish(active[i], CURLE_ABORTED_BY_CALLBACK);
+
+    // Closes the kept connections, curl removes their watches on the way
+    curl_multi_cleanup(_multi);
+    _multi = nullptr;
+    _timer->stop();
+    while (!_watches.isEmpty())
+        removeWatch(_watches.begin().key());
+
+    for (int i = 0; i < _idleHandles.size(); i++)
+        curl_easy_cleanup(_idleHandles[i]);
+    _idleHandles.clear();
+    qDebug() << "HTTP engine stopped";
+}
+
+int HttpEngine::socketCallback(CURL *handle, curl_socket_t socket, int what, void *engine, void *socketData)
+{
+    Q_UNUSED(handle);
+    Q_UNUSED(socketData);
+    ((HttpEngine *)engine)->watchSocket(socket, what);
+    return 0;
+}
+
+int HttpEngine::timerCallback(CURLM *multi, long timeoutMs, void *engine)
+{
+    Q_UNUSED(multi);
+    // -1 cancels the timeout; 0 means at once, left to the event loop since
+    // curl must not be re-entered from here
+    QTimer *timer = ((HttpEngine *)engine)->_timer;
+    if (timeoutMs < 0)
+        timer->stop();
+    else
+        timer->start((int)timeoutMs);
+    return 0;
+}
+
+size_t HttpEngine::writeCallback(char *data, size_t size, size_t nmemb, void *transfer)
+{
+    ((Transfer *)transfer)->result.body.append(data, (int)(size * nmemb));
+    return size * nmemb;
+}
+
+void HttpEngine::watchSocket(curl_socket_t socket, int what)
+{
+    if (what == CURL_POLL_REMOVE)
+    {
+        removeWatch(socket);
+        return;
+    }
+
+    SocketWatch &watch = _watches[socket];
+    bool wantRead = what == CURL_POLL_IN || what == CURL_POLL_INOUT;
+    bool wantWrite = what == CURL_POLL_OUT || what == CURL_POLL_INOUT;
+
+    if (wantRead && !watch.read)
+    {
+        watch.read = new QSocketNotifier(socket, QSocketNotifier::Read, this);
+        connect(watch.read, SIGNAL(activated(int)), this, SLOT(onReadable(int)));
+    }
+    if (watch.read)
+        watch.read->setEnabled(wantRead);
+
+    if (wantWrite && !watch.write)
+    {
+        watch.write = new QSocketNotifier(socket, QSocketNotifier::Write, this);
+        connect(watch.write, SIGNAL(activated(int)), this, SLOT(onWritable(int)));
+    }
+    if (watch.write)
+        watch.write->setEnabled(wantWrite);
+}
+
+void HttpEngine::removeWatch(curl_socket_t socket)
+{
+    SocketWatch watch = _watches.take(socket);
+
+    // Possibly called from inside the notifier's own activated()
+    if (watch.read)
+    {
+        watch.read->setEnabled(false);
+        watch.read->deleteLater();
+    }
+    if (watch.write)
+    {
+        watch.write->setEnabled(false);
+        watch.write->deleteLater();
+    }
+}
+
+void HttpEngine::onReadable(int socket)
+{
+    socketAction(socket, CURL_CSELECT_IN);
+}
+
+void HttpEngine::onWritable(int socket)
+{
+    socketAction(socket, CURL_CSELECT_OUT);
+}
+
+void HttpEngine::onTimeout()
+{
+    socketAction(CURL_SOCKET_TIMEOUT, 0);
+}
+
+void HttpEngine::socketAction(curl_socket_t socket, int events)
+{
+    if (!_multi)
+        return;
+
+    int running = 0;
+    CURLMcode code = curl_multi_socket_action(_multi, socket, events, &running);
+    if (code != CURLM_OK)
+        LOG_WARNING("HTTP engine socket action failed: {}", curl_multi_strerror(code));
+    collectFinished();
+}
+
+void HttpEngine::collectFinished()
+{
+    CURLMsg *message;
+    int left = 0;
+    while ((message = curl_multi_info_read(_multi, &left)) != nullptr)
+    {
+        if (message->msg != CURLMSG_DONE)
+            continue;
+
+        Transfer *transfer = nullptr;
+        curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, (char **)&transfer);
+        if (transfer)
+            finish(transfer, message->data.result);
+    }
+}
+
+void HttpEngine::finish(Transfer *transfer, CURLcode code)
+{
+    Result &result = transfer->result;
+    result.code = code;
+    result.elapsedUs = transfer->clock.nsecsElapsed() / 1000;
+
+    CURL *handle = transfer->handle;
+    if (handle)
+    {
+        if (code == CURLE_OK)
+        {
+            long connects = 0;
+            curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &result.httpCode);
+            curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &connects);
+            result.reused = connects == 0;
+            readTimings(handle, result);
+
+            // Still attached to the connection until the handle is removed
+            curl_socket_t socket = CURL_SOCKET_BAD;
+#if LIBCURL_VERSION_NUM >= 0x072d00
+            curl_easy_getinfo(handle, CURLINFO_ACTIVESOCKET, &socket);
+#else
+            long lastSocket = -1;
+            if (curl_easy_getinfo(handle, CURLINFO_LASTSOCKET, &lastSocket) == CURLE_OK)
+                socket = (curl_socket_t)lastSocket;
+#endif
+            _lastSocket = socket;
+        }
+
+        // The connection goes back to the multi handle's cache, the easy
+        // handle to the idle list with its setup options kept
+        _active.remove(transfer);
+        curl_multi_remove_handle(_multi, handle);
+        curl_easy_setopt(handle, CURLOPT_HTTPHEADER, nullptr);
+        curl_easy_setopt(handle, CURLOPT_POSTFIELDS, nullptr);
+        curl_easy_setopt(handle, CURLOPT_PRIVATE, nullptr);
+        _idleHandles.append(handle);
+    }
+    curl_slist_free_all(transfer->headers);
+
+    // Counted down first, so a callback that posts again sees the slot free
+    _inFlight--;
+    if (transfer->callback)
+        transfer->callback(result);
+    delete transfer;
+}
+
+bool HttpEngine::connected(CURL *handle)
+{
+    // Pre-transfer time is set once DNS, connect and TLS are all done
+#if LIBCURL_VERSION_NUM >= 0x073d00
+    curl_off_t pretransfer = 0;
+    curl_easy_getinfo(handle, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+#else
+    double pretransfer = 0;
+    curl_easy_getinfo(handle, CURLINFO_PRETRANSFER_TIME, &pretransfer);
+#endif
+    return pretransfer > 0;
+}
+
+void HttpEngine::readTimings(CURL *handle, Result &result)
+{
+    // curl reports each phase as time since the start of the transfer
+#if LIBCURL_VERSION_NUM >= 0x073d00
+    curl_off_t dns = 0, connect = 0, tls = 0, firstByte = 0;
+    curl_easy_getinfo(handle, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+    curl_easy_getinfo(handle, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(handle, CURLINFO_APPCONNECT_TIME_T, &tls);
+    curl_easy_getinfo(handle, CURLINFO_STARTTRANSFER_TIME_T, &firstByte);
+#else
+    double dnsS = 0, connectS = 0, tlsS = 0, firstByteS = 0;
+    curl_easy_getinfo(handle, CURLINFO_NAMELOOKUP_TIME, &dnsS);
+    curl_easy_getinfo(handle, CURLINFO_CONNECT_TIME, &connectS);
+    curl_easy_getinfo(handle, CURLINFO_APPCONNECT_TIME, &tlsS);
+    curl_easy_getinfo(handle, CURLINFO_STARTTRANSFER_TIME, &firstByteS);
+    qint64 dns = dnsS * 1e6, connect = connectS * 1e6, tls = tlsS * 1e6, firstByte = firstByteS * 1e6;
+#endif
+
+    // A reused connection reports zero for the phases it skipped
+    if (connect > 0)
+    {
+        result.dnsUs = dns;
+        result.connectUs = connect - dns;
+    }
+    if (tls > 0)
+        result.tlsUs = tls - connect;
+    if (firstByte > 0)
+        result.firstByteUs = firstByte - qMax((qint64)connect, (qint64)tls);
+}
@@ -0,0 +1,147 @@
+/*******************************************************************************
+ * Http Engine - non-blocking HTTP on curl multi, driven by a Qt event loop
+ *
+ *   any thread ──post()──> pending ──queued call──> engine thread: curl_multi
+ *                                                     │ QSocketNotifier, QTimer
+ *                                                     └──> callback(Result)
+ *
+ * Transfers run side by side on one thread of their own, nothing blocks on the
+ * network: curl says which sockets to watch and when its next timeout is due,
+ * the engine thread's event loop does the waiting. Up to maxConnections run at
+ * once per host, later ones wait in curl for a free connection, and finished
+ * connections stay open for the next transfer.
+ *
+ * A preemptible transfer, e.g. a connection warm-up, gives way to the others:
+ * posting a normal one cancels those still connecting, so it gets their
+ * connection slot at once.
+ *
+ * Callbacks run on the engine thread, one at a time, and must not block.
+ * stop() cancels whatever is still queued or in flight: each of those
+ * callbacks runs once more with CURLE_ABORTED_BY_CALLBACK before it returns.
+ *******************************************************************************/
+
+#ifndef HTTP_ENGINE_HPP
+#define HTTP_ENGINE_HPP
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QThread>
+#include <QVector>
+#include <atomic>
+#include <curl/curl.h>
+#include <functional>
+
+class QSocketNotifier;
+class QTimer;
+
+class HttpEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Request
+    {
+        QByteArray url;
+        QByteArray body;           // POSTed, a GET when empty
+        bool head = false;         // HEAD instead, body ignored
+        QList<QByteArray> headers; // "Name: value"
+        long timeoutMs = 0;        // Whole transfer, 0 = none
+        bool preemptible = false;  // Cancelled by a normal transfer while connecting
+    };
+
+    struct Result
+    {
+        CURLcode code = CURLE_OK;  // CURLE_ABORTED_BY_CALLBACK when cancelled
+        long httpCode = 0;
+        QByteArray body;
+        qint64 elapsedUs = 0;      // From post(), waiting for a connection included
+        bool reused = false;       // Sent on an already open connection
+
+        // Phases of the transfer, 0 for those a reused connection skipped
+        qint64 dnsUs = 0;
+        qint64 connectUs = 0;
+        qint64 tlsUs = 0;
+        qint64 firstByteUs = 0;    // Request sent to first response byte
+    };
+
+    typedef std::function<void(const Result &result)> Callback;
+    typedef std::function<void(CURL *handle)> HandleSetup;
+
+    // Create on a thread with an event loop or none at all; the engine runs
+    // on its own thread either way
+    HttpEngine();
+    ~HttpEngine();
+
+    // Starts the engine thread, does nothing when it runs already. setup is
+    // applied to every easy handle, e.g. for socket options.
+    void start(int maxConnections, const HandleSetup &setup = HandleSetup());
+
+    // Cancels queued and in-flight transfers and joins the engine thread.
+    // Not from a callback.
+    void stop();
+
+    bool isRunning() const { return _running; }
+
+    // Thread-safe and never blocks on the network. Returns false, without
+    // calling back, when the engine is not running.
+    bool post(const Request &request, const Callback &callback);
+
+    // Posted and not called back yet
+    int inFlight() const { return _inFlight; }
+
+    // Connection of the last completed transfer, CURL_SOCKET_BAD when none.
+    // Only for a liveness check, it may be closed or in use again by now.
+    curl_socket_t lastSocket() const { return _lastSocket; }
+
+private slots:
+    void onReadable(int socket);
+    void onWritable(int socket);
+    void onTimeout();
+
+private:
+    struct Transfer;
+
+    // Notifiers of one socket curl wants watched
+    struct SocketWatch
+    {
+        QSocketNotifier *read = nullptr;
+        QSocketNotifier *write = nullptr;
+    };
+
+    static int socketCallback(CURL *handle, curl_socket_t socket, int what, void *engine, void *socketData);
+    static int timerCallback(CURLM *multi, long timeoutMs, void *engine);
+    static size_t writeCallback(char *data, size_t size, size_t nmemb, void *transfer);
+
+    // Engine thread only
+    Q_INVOKABLE void addPending();
+    Q_INVOKABLE void shutdown();
+    void watchSocket(curl_socket_t socket, int what);
+    void removeWatch(curl_socket_t socket);
+    void socketAction(curl_socket_t socket, int events);
+    void collectFinished();
+    void preempt();
+    void finish(Transfer *transfer, CURLcode code);
+    static bool connected(CURL *handle);
+    static void readTimings(CURL *handle, Result &result);
+
+    QThread _thread;
+    QTimer *_timer;                         // curl's next timeout
+    CURLM *_multi;
+    HandleSetup _setup;
+    QHash<curl_socket_t, SocketWatch> _watches;
+    QSet<Transfer *> _active;               // Added to _multi
+    QVector<CURL *> _idleHandles;           // Easy handles for the next transfers
+
+    QMutex _mutex;                          // _pending and starting/stopping
+    QVector<Transfer *> _pending;           // Posted, not added to _multi yet
+    std::atomic<bool> _running;
+    std::atomic<int> _inFlight;
+    std::atomic<curl_socket_t> _lastSocket;
+};
+
+#endif // HTTP_ENGINE_HPP
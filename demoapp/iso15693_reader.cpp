@@ -0,0 +1,139 @@
+/*******************************************************************************
+ * ISO15693 Reader Implementation
+ *******************************************************************************/
+
+#include "iso15693_reader.hpp"
+#include "log.hpp"
+#include <QElapsedTimer>
+#include <cstring>
+
+// Request flags: high data rate, inventory + one slot, addressed
+static const uint8_t FLAG_HIGH_RATE = 0x02;
+static const uint8_t FLAG_INVENTORY = 0x04;
+static const uint8_t FLAG_ONE_SLOT = 0x20;
+static const uint8_t FLAG_ADDRESSED = 0x20;
+
+static const uint8_t CMD_INVENTORY = 0x01;
+static const uint8_t CMD_READ_SINGLE = 0x20;
+static const uint8_t CMD_READ_MULTIPLE = 0x23;
+static const uint8_t CMD_SYSTEM_INFO = 0x2B;
+
+Iso15693Reader::Iso15693Reader(CouplerBackend *backend, int maxBlocksPerRead)
+    : _backend(backend), _maxBlocksPerRead(qBound(1, maxBlocksPerRead, 256))
+{
+    memset(_uid, 0, sizeof(_uid));
+}
+
+bool Iso15693Reader::exchange(const uint8_t *tx, uint16_t txLen, uint16_t *rxLen, Result &result)
+{
+    *rxLen = RX_BUFFER_SIZE;
+    result.commands++;
+    if (!_backend->transceive(tx, txLen, _rx, rxLen) || *rxLen < 1)
+        return false;
+
+    // Response flags bit 0 = error, the error code follows
+    if (_rx[0] & 0x01)
+    {
+        LOG_DEBUG("ISO15693 command {} error code {}", tx[1], *rxLen > 1 ? _rx[1] : 0);
+        return false;
+    }
+    return true;
+}
+
+bool Iso15693Reader::readBlocks(int first, int count, char *out, Result &result)
+{
+    uint8_t tx[13];
+    uint16_t n = 0;
+    tx[n++] = FLAG_HIGH_RATE | FLAG_ADDRESSED;
+    tx[n++] = count > 1 ? CMD_READ_MULTIPLE : CMD_READ_SINGLE;
+    memcpy(tx + n, _uid, 8);
+    n += 8;
+    tx[n++] = (uint8_t)first;
+    if (count > 1)
+        tx[n++] = (uint8_t)(count - 1);
+
+    uint16_t rxLen;
+    if (!exchange(tx, n, &rxLen, result))
+        return false;
+
+    int expected = count * result.blockSize;
+    if (rxLen < 1 + expected)
+        return false;
+
+    memcpy(out, _rx + 1, expected);
+    return true;
+}
+
+bool Iso15693Reader::read(Result &result)
+{
+    QElapsedTimer timer;
+    timer.start();
+    uint16_t rxLen;
+
+    // Inventory: flags, DSFID, UID (LSB first)
+    const uint8_t inventory[] = {FLAG_HIGH_RATE | FLAG_INVENTORY | FLAG_ONE_SLOT, CMD_INVENTORY, 0x00};
+    if (!exchange(inventory, sizeof(inventory), &rxLen, result) || rxLen < 10)
+    {
+        result.error = "ISO15693 inventory failed";
+        return false;
+    }
+    memcpy(_uid, _rx + 2, 8);
+    result.uid.resize(8);
+    for (int i = 0; i < 8; i++)
+        result.uid[i] = (char)_uid[7 - i];
+
+    // System information: flags, info flags, UID, [DSFID], [AFI], [memory size]
+    uint8_t info[10] = {FLAG_HIGH_RATE | FLAG_ADDRESSED, CMD_SYSTEM_INFO};
+    memcpy(info + 2, _uid, 8);
+    if (!exchange(info, sizeof(info), &rxLen, result) || rxLen < 10)
+    {
+        result.error = "ISO15693 system information failed";
+        return false;
+    }
+
+    uint8_t infoFlags = _rx[1];
+    int p = 10;
+    if (infoFlags & 0x01)
+        p++; // DSFID
+    if (infoFlags & 0x02)
+        p++; // AFI
+    if (!(infoFlags & 0x04) || rxLen < p + 2)
+    {
+        result.error = "ISO15693 tag does not report its memory size";
+        return false;
+    }
+    result.blockCount = _rx[p] + 1;
+    result.blockSize = (_rx[p + 1] & 0x1F) + 1;
+
+    // As many blocks per command as the tag, the setting and our frame allow
+    int chunk = qMin(_maxBlocksPerRead, (RX_BUFFER_SIZE - 1) / result.blockSize);
+    chunk = qMax(1, qMin(chunk, result.blockCount));
+
+    result.data.resize(result.blockCount * result.blockSize);
+    int block = 0;
+    while (block < result.blockCount)
+    {
+        int count = qMin(chunk, result.blockCount - block);
+        if (readBlocks(block, count, result.data.data() + block * result.blockSize, result))
+        {
+            block += count;
+            continue;
+        }
+
+        if (chunk == 1)
+        {
+            result.error = QString("ISO15693 read of block %1 failed").arg(block);
+            result.data.clear();
+            return false;
+        }
+
+        // Tag limit is lower than assumed, halve and keep the smaller chunk
+        chunk = qMax(1, chunk / 2);
+        LOG_DEBUG("ISO15693 read multiple rejected, retrying with {} blocks per command", chunk);
+    }
+
+    result.elapsedUs = timer.nsecsElapsed() / 1000;
+    LOG_DEBUG("ISO15693 read {} blocks of {} bytes in {} commands, {} us", result.blockCount, result.blockSize,
+              result.commands, result.elapsedUs);
+    return true;
+}
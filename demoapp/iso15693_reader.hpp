@@ -0,0 +1,48 @@
+/*******************************************************************************
+ * ISO15693 Reader - vicinity tag memory dump
+ *
+ * Inventory, Get System Information for the block size and count, then Read
+ * Multiple Blocks in as few commands as the tag and the frame size allow.
+ * Falls back to smaller chunks and finally Read Single Block when the tag
+ * rejects a request.
+ *******************************************************************************/
+
+#ifndef ISO15693_READER_HPP
+#define ISO15693_READER_HPP
+
+#include <QByteArray>
+#include <QString>
+#include "coupler_backend.hpp"
+
+class Iso15693Reader
+{
+public:
+    struct Result
+    {
+        QByteArray uid;   // MSB first
+        QByteArray data;  // Whole user memory
+        QString error;
+        int blockSize = 0;
+        int blockCount = 0;
+        int commands = 0; // RF exchanges used
+        qint64 elapsedUs = 0;
+    };
+
+    // maxBlocksPerRead = 1 forces Read Single Block (benchmark baseline)
+    Iso15693Reader(CouplerBackend *backend, int maxBlocksPerRead);
+
+    bool read(Result &result);
+
+private:
+    static const int RX_BUFFER_SIZE = 256;
+
+    bool exchange(const uint8_t *tx, uint16_t txLen, uint16_t *rxLen, Result &result);
+    bool readBlocks(int first, int count, char *out, Result &result);
+
+    CouplerBackend *_backend;
+    int _maxBlocksPerRead;
+    uint8_t _uid[8];
+    uint8_t _rx[RX_BUFFER_SIZE];
+};
+
+#endif // ISO15693_READER_HPP
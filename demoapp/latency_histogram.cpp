@@ -0,0 +1,84 @@
+/*******************************************************************************
+ * Latency Histogram Implementation
+ *******************************************************************************/
+
+#include "latency_histogram.hpp"
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+int LatencyHistogram::bucketIndex(uint64_t us)
+{
+    if (us > MAX_US)
+        us = MAX_US;
+    if (us < 2 * SUB_BUCKETS)
+        return (int)us;
+
+    // Top SUB_BUCKET_BITS + 1 bits select the bucket
+    int shift = 63 - __builtin_clzll(us) - SUB_BUCKET_BITS;
+    return shift * SUB_BUCKETS + (int)(us >> shift);
+}
+
+uint64_t LatencyHistogram::bucketLowerUs(int index)
+{
+    if (index < 2 * SUB_BUCKETS)
+        return (uint64_t)index;
+    int shift = index / SUB_BUCKETS - 1;
+    return (uint64_t)(index - shift * SUB_BUCKETS) << shift;
+}
+
+uint64_t LatencyHistogram::bucketWidthUs(int index)
+{
+    return index < 2 * SUB_BUCKETS ? 1 : 1ULL << (index / SUB_BUCKETS - 1);
+}
+
+void LatencyHistogram::record(uint64_t us)
+{
+    _buckets[bucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sumUs.fetch_add(us, std::memory_order_relaxed);
+
+    uint64_t max = _maxUs.load(std::memory_order_relaxed);
+    while (us > max && !_maxUs.compare_exchange_weak(max, us, std::memory_order_relaxed))
+    {
+    }
+}
+
+uint64_t LatencyHistogram::quantileUs(double q) const
+{
+    // Buckets and count are read without a snapshot, a concurrent record()
+    // can shift the result by one sample at most
+    uint64_t total = count();
+    if (total == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)(q * (double)total + 0.5);
+    if (rank < 1)
+        rank = 1;
+    if (rank > total)
+        rank = total;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++)
+    {
+        seen += _buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+        {
+            // Middle of the bucket, never above the largest sample
+            uint64_t value = bucketLowerUs(i) + bucketWidthUs(i) / 2;
+            return value < maxUs() ? value : maxUs();
+        }
+    }
+    return maxUs();
+}
+
+void LatencyHistogram::reset()
+{
+    for (int i = 0; i < BUCKETS; i++)
+        _buckets[i].store(0, std::memory_order_relaxed);
+    _count.store(0, std::memory_order_relaxed);
+    _sumUs.store(0, std::memory_order_relaxed);
+    _maxUs.store(0, std::memory_order_relaxed);
+}
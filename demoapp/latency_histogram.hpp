@@ -0,0 +1,47 @@
+/*******************************************************************************
+ * Latency Histogram - lock-free HDR-style histogram of microsecond latencies
+ *
+ * Log-linear buckets: exact below 64 us, then 32 sub-buckets per power of two
+ * (about 3% resolution) up to MAX_US. Recording is a few relaxed atomic
+ * increments, so any thread may record while another one reads quantiles.
+ *******************************************************************************/
+
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <atomic>
+#include <cstdint>
+
+class LatencyHistogram
+{
+public:
+    static const int SUB_BUCKET_BITS = 5;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const uint64_t MAX_US = (1ULL << 27) - 1; // ~134 s, larger values are clamped
+    static const int BUCKETS = (27 - SUB_BUCKET_BITS) * SUB_BUCKETS + SUB_BUCKETS;
+
+    LatencyHistogram();
+
+    void record(uint64_t us);
+
+    uint64_t count() const { return _count.load(std::memory_order_relaxed); }
+    uint64_t sumUs() const { return _sumUs.load(std::memory_order_relaxed); }
+    uint64_t maxUs() const { return _maxUs.load(std::memory_order_relaxed); }
+
+    // Value at quantile q (0..1) to within the bucket resolution, 0 when empty
+    uint64_t quantileUs(double q) const;
+
+    void reset();
+
+    static int bucketIndex(uint64_t us);
+    static uint64_t bucketLowerUs(int index);
+    static uint64_t bucketWidthUs(int index);
+
+private:
+    std::atomic<uint64_t> _buckets[BUCKETS];
+    std::atomic<uint64_t> _count;
+    std::atomic<uint64_t> _sumUs;
+    std::atomic<uint64_t> _maxUs;
+};
+
+#endif // LATENCY_HISTOGRAM_HPP
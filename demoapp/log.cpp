@@ -0,0 +1,433 @@
+/*******************************************************************************
+ * Log Implementation
+ *******************************************************************************/
+
+#include "log.hpp"
+#include "codec.hpp"
+#include <QFile>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <mutex>
+#include <thread>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+    // Bounded MPMC ring (D. Vyukov): each cell carries a sequence number that
+    // tells producers and the consumer whose turn it is, no locks involved
+    const uint64_t RING_SIZE = 2048; // Power of two, ~1 MB of records
+
+    struct alignas(64) Cell
+    {
+        std::atomic<uint64_t> sequence;
+        Log::Record record;
+    };
+
+    struct Ring
+    {
+        Ring() : enqueue(0), dequeue(0)
+        {
+            for (uint64_t i = 0; i < RING_SIZE; i++)
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        Cell cells[RING_SIZE];
+        alignas(64) std::atomic<uint64_t> enqueue;
+        alignas(64) uint64_t dequeue; // Writer thread only
+    };
+
+    const char LEVEL_NAMES[] = "TDIWE";
+
+    Ring ring;
+    std::atomic<int> minLevel(DEMOAPP_LOG_LEVEL);
+    std::atomic<quint64> droppedRecords(0);
+    quint64 reportedDrops = 0; // Writer thread only
+
+    std::thread writer;
+    std::mutex writerMutex;
+    std::condition_variable writerWake;
+    bool writerStop = false;
+    FILE *logFile = nullptr;
+    QString logPath;
+    qint64 logMaxBytes = 0;
+    bool logConsole = false;
+
+    // Writer wakes this often, the most a crash can lose
+    const int FLUSH_INTERVAL_MS = 20;
+
+    uint32_t currentThreadId()
+    {
+        static thread_local uint32_t id = (uint32_t)syscall(SYS_gettid);
+        return id;
+    }
+
+    int64_t nowNs()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+
+    // Appends to a fixed line buffer, truncating at the end
+    struct Line
+    {
+        char text[4096];
+        int length = 0;
+
+        void append(const char *s, int n)
+        {
+            n = qMin(n, (int)sizeof(text) - length);
+            memcpy(text + length, s, n);
+            length += n;
+        }
+        void append(const char *s) { append(s, (int)strlen(s)); }
+    };
+
+    void formatArg(Line &line, uint8_t type, const char *&p)
+    {
+        char number[32];
+        switch (type)
+        {
+        case Log::ArgInt:
+        {
+            int64_t v;
+            memcpy(&v, p, sizeof(v));
+            p += sizeof(v);
+            line.append(number, snprintf(number, sizeof(number), "%lld", (long long)v));
+            break;
+        }
+        case Log::ArgUInt:
+        {
+            uint64_t v;
+            memcpy(&v, p, sizeof(v));
+            p += sizeof(v);
+            line.append(number, snprintf(number, sizeof(number), "%llu", (unsigned long long)v));
+            break;
+        }
+        case Log::ArgDouble:
+        {
+            double v;
+            memcpy(&v, p, sizeof(v));
+            p += sizeof(v);
+            line.append(number, snprintf(number, sizeof(number), "%g", v));
+            break;
+        }
+        default:
+        {
+            uint16_t n;
+            memcpy(&n, p, sizeof(n));
+            p += sizeof(n);
+            if (type == Log::ArgString)
+            {
+                line.append(p, n);
+            }
+            else
+            {
+                char hex[Codec::hexLength(Log::PAYLOAD_SIZE)];
+                Codec::toHex((const uint8_t *)p, n, hex);
+                line.append(hex, Codec::hexLength(n));
+            }
+            p += n;
+            break;
+        }
+        }
+    }
+
+    void format(const Log::Record &r, Line &line)
+    {
+        time_t seconds = (time_t)(r.timeNs / 1000000000LL);
+        struct tm local;
+        localtime_r(&seconds, &local);
+        char prefix[64];
+        int n = (int)strftime(prefix, sizeof(prefix), "%Y-%m-%d %H:%M:%S", &local);
+        n += snprintf(prefix + n, sizeof(prefix) - n, ".%03d %c %u ", (int)(r.timeNs / 1000000 % 1000),
+                      LEVEL_NAMES[qMin((int)r.level, 4)], r.thread);
+        line.append(prefix, n);
+
+        // "{}" takes the next argument, missing arguments stay as "{}"
+        const char *p = r.payload;
+        int arg = 0;
+        for (const char *f = r.format; *f; f++)
+        {
+            if (f[0] == '{' && f[1] == '}' && arg < r.argCount)
+            {
+                formatArg(line, r.types[arg++], p);
+                f++;
+                continue;
+            }
+            line.append(f, 1);
+        }
+
+        if (r.truncated)
+            line.append(" [truncated]");
+        line.append("\n", 1);
+    }
+
+    void rotate()
+    {
+        if (!logFile || logMaxBytes <= 0 || ftell(logFile) < logMaxBytes)
+            return;
+
+        fclose(logFile);
+        QString previous = logPath + ".1";
+        QFile::remove(previous);
+        QFile::rename(logPath, previous);
+        logFile = fopen(logPath.toLocal8Bit().constData(), "a");
+    }
+
+    // Drains everything published so far, returns the records written
+    int drain()
+    {
+        int written = 0;
+        Line line;
+
+        while (true)
+        {
+            Cell &cell = ring.cells[ring.dequeue & (RING_SIZE - 1)];
+            if (cell.sequence.load(std::memory_order_acquire) != ring.dequeue + 1)
+                break;
+
+            line.length = 0;
+            format(cell.record, line);
+            cell.sequence.store(ring.dequeue + RING_SIZE, std::memory_order_release);
+            ring.dequeue++;
+
+            if (logFile)
+                fwrite(line.text, 1, line.length, logFile);
+            if (logConsole)
+                fwrite(line.text, 1, line.length, stderr);
+            written++;
+        }
+
+        quint64 dropped = droppedRecords.load(std::memory_order_relaxed);
+        if (dropped > reportedDrops)
+        {
+            fprintf(logFile ? logFile : stderr, "-- %llu log records dropped, ring full\n",
+                    (unsigned long long)(dropped - reportedDrops));
+            reportedDrops = dropped;
+            written++;
+        }
+
+        if (written > 0 && logFile)
+        {
+            fflush(logFile);
+            rotate();
+        }
+        return written;
+    }
+
+    void writerLoop()
+    {
+        std::unique_lock<std::mutex> lock(writerMutex);
+        while (!writerStop)
+        {
+            lock.unlock();
+            drain();
+            lock.lock();
+            writerWake.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS));
+        }
+        lock.unlock();
+        drain();
+    }
+}
+
+void Log::Record::addScalar(ArgType type, const void *v, int size)
+{
+    if (argCount >= MAX_ARGS || payloadSize + size > PAYLOAD_SIZE)
+    {
+        truncated = true;
+        return;
+    }
+    types[argCount++] = type;
+    memcpy(payload + payloadSize, v, size);
+    payloadSize += size;
+}
+
+void Log::Record::addBytes(ArgType type, const void *data, int length)
+{
+    int room = PAYLOAD_SIZE - payloadSize - (int)sizeof(uint16_t);
+    if (argCount >= MAX_ARGS || room < 0)
+    {
+        truncated = true;
+        return;
+    }
+
+    uint16_t n = (uint16_t)qMax(0, qMin(length, room));
+    types[argCount++] = type;
+    memcpy(payload + payloadSize, &n, sizeof(n));
+    memcpy(payload + payloadSize + sizeof(n), data, n);
+    payloadSize += sizeof(n) + n;
+    if (n < length)
+        truncated = true;
+}
+
+void Log::Record::add(const QString &s)
+{
+    // UTF-8 straight into the slot, no temporary QByteArray. Truncation ends
+    // on a whole character.
+    int room = PAYLOAD_SIZE - payloadSize - (int)sizeof(uint16_t);
+    if (argCount >= MAX_ARGS || room < 0)
+    {
+        truncated = true;
+        return;
+    }
+
+    const ushort *p = s.utf16();
+    const ushort *end = p + s.size();
+    char *out = payload + payloadSize + sizeof(uint16_t);
+    int n = 0;
+    while (p < end)
+    {
+        uint code = *p;
+        if (code < 0x80)
+        {
+            if (n + 1 > room)
+                break;
+            out[n++] = (char)code;
+            p++;
+            continue;
+        }
+
+        // Surrogate pairs join up, a lone half becomes U+FFFD
+        int units = 1;
+        if (code >= 0xD800 && code < 0xDC00 && p + 1 < end && p[1] >= 0xDC00 && p[1] < 0xE000)
+        {
+            code = 0x10000 + ((code - 0xD800) << 10) + (p[1] - 0xDC00);
+            units = 2;
+        }
+        else if (code >= 0xD800 && code < 0xE000)
+            code = 0xFFFD;
+
+        int length = code < 0x800 ? 2 : code < 0x10000 ? 3 : 4;
+        if (n + length > room)
+            break;
+        if (length == 2)
+            out[n++] = (char)(0xC0 | (code >> 6));
+        else if (length == 3)
+        {
+            out[n++] = (char)(0xE0 | (code >> 12));
+            out[n++] = (char)(0x80 | ((code >> 6) & 0x3F));
+        }
+        else
+        {
+            out[n++] = (char)(0xF0 | (code >> 18));
+            out[n++] = (char)(0x80 | ((code >> 12) & 0x3F));
+            out[n++] = (char)(0x80 | ((code >> 6) & 0x3F));
+        }
+        out[n++] = (char)(0x80 | (code & 0x3F));
+        p += units;
+    }
+
+    uint16_t length = (uint16_t)n;
+    types[argCount++] = ArgString;
+    memcpy(payload + payloadSize, &length, sizeof(length));
+    payloadSize += sizeof(length) + n;
+    if (p < end)
+        truncated = true;
+}
+
+bool Log::claim(Level level, Slot &slot)
+{
+    if ((int)level < minLevel.load(std::memory_order_relaxed))
+        return false;
+
+    uint64_t position = ring.enqueue.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true)
+    {
+        cell = &ring.cells[position & (RING_SIZE - 1)];
+        uint64_t sequence = cell->sequence.load(std::memory_order_acquire);
+        int64_t diff = (int64_t)sequence - (int64_t)position;
+        if (diff == 0)
+        {
+            if (ring.enqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // Writer behind by a whole ring
+            droppedRecords.fetch_add(1, std::memory_order_relaxed);
+            writerWake.notify_one();
+            return false;
+        }
+        else
+        {
+            position = ring.enqueue.load(std::memory_order_relaxed);
+        }
+    }
+
+    Record &r = cell->record;
+    r.timeNs = nowNs();
+    r.thread = currentThreadId();
+    r.level = level;
+    r.argCount = 0;
+    r.truncated = false;
+    r.payloadSize = 0;
+
+    slot.record = &r;
+    slot.position = position;
+    return true;
+}
+
+void Log::commit(const Slot &slot)
+{
+    ring.cells[slot.position & (RING_SIZE - 1)].sequence.store(slot.position + 1, std::memory_order_release);
+
+    // Errors go out straight away
+    if (slot.record->level >= Error)
+        writerWake.notify_one();
+}
+
+bool Log::start(const QString &path, qint64 maxFileBytes, bool console)
+{
+    if (writer.joinable())
+        return true;
+
+    logPath = path;
+    logMaxBytes = maxFileBytes;
+    logConsole = console;
+
+    if (!path.isEmpty())
+    {
+        logFile = fopen(path.toLocal8Bit().constData(), "a");
+        if (!logFile)
+            fprintf(stderr, "Cannot open log file %s, logging to the console\n", path.toLocal8Bit().constData());
+    }
+    if (!logFile)
+        logConsole = true;
+
+    writerStop = false;
+    writer = std::thread(writerLoop);
+    return logFile != nullptr;
+}
+
+void Log::stop()
+{
+    if (!writer.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        writerStop = true;
+    }
+    writerWake.notify_one();
+    writer.join();
+
+    if (logFile)
+    {
+        fclose(logFile);
+        logFile = nullptr;
+    }
+}
+
+void Log::setLevel(Level level)
+{
+    minLevel.store(qBound(DEMOAPP_LOG_LEVEL, (int)level, (int)Error), std::memory_order_relaxed);
+}
+
+quint64 Log::dropped()
+{
+    return droppedRecords.load(std::memory_order_relaxed);
+}
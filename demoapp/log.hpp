@@ -0,0 +1,182 @@
+/*******************************************************************************
+ * Log - low-overhead structured logging for the tap hot path
+ *
+ *   LOG_DEBUG("Block {} : {}", block, Log::Hex(data, 16));
+ *
+ * Levels below DEMOAPP_LOG_LEVEL compile to nothing, their arguments are not
+ * evaluated. Enabled records copy their raw arguments (integers, strings,
+ * byte spans) into a fixed-size slot of a lock-free ring; formatting, hex
+ * dumps and file I/O happen on a background writer thread. The writer
+ * flushes every few milliseconds and keeps one rotated file, so the last
+ * seconds before an incident are on disk.
+ *
+ * Producers never block: when the ring is full the record is dropped and
+ * counted.
+ *******************************************************************************/
+
+#ifndef LOG_HPP
+#define LOG_HPP
+
+#include <QByteArray>
+#include <QString>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// 0 trace, 1 debug, 2 info, 3 warning, 4 error. Release builds set 2.
+#ifndef DEMOAPP_LOG_LEVEL
+#define DEMOAPP_LOG_LEVEL 1
+#endif
+
+namespace Log
+{
+    enum Level : uint8_t
+    {
+        Trace = 0,
+        Debug,
+        Info,
+        Warning,
+        Error
+    };
+
+    // Byte span formatted as uppercase hex by the writer
+    struct Hex
+    {
+        Hex(const void *d, int n) : data(d), length(n) {}
+        explicit Hex(const QByteArray &bytes) : data(bytes.constData()), length(bytes.size()) {}
+        const void *data;
+        int length;
+    };
+
+    enum ArgType : uint8_t
+    {
+        ArgInt,
+        ArgUInt,
+        ArgDouble,
+        ArgString,
+        ArgHex
+    };
+
+    static const int MAX_ARGS = 8;
+    static const int PAYLOAD_SIZE = 448;
+
+    struct Record
+    {
+        int64_t timeNs;
+        const char *format; // String literal, formatted by the writer
+        uint32_t thread;
+        uint8_t level;
+        uint8_t argCount;
+        bool truncated;
+        uint16_t payloadSize;
+        uint8_t types[MAX_ARGS];
+        char payload[PAYLOAD_SIZE];
+
+        // Encoders, values that do not fit are truncated
+        void add(int64_t v) { addScalar(ArgInt, &v, sizeof(v)); }
+        void add(uint64_t v) { addScalar(ArgUInt, &v, sizeof(v)); }
+        void add(double v) { addScalar(ArgDouble, &v, sizeof(v)); }
+        void add(const char *s) { addBytes(ArgString, s, s ? (int)strlen(s) : 0); }
+        void add(const QByteArray &b) { addBytes(ArgString, b.constData(), b.size()); }
+        void add(const Hex &h) { addBytes(ArgHex, h.data, h.length); }
+        void add(const QString &s);
+
+        void addScalar(ArgType type, const void *v, int size);
+        void addBytes(ArgType type, const void *data, int length);
+    };
+
+    // Route every arithmetic type to one of the three scalar encoders
+    template <typename T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type encode(Record &r, T v) { r.add((double)v); }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type encode(Record &r, T v)
+    {
+        r.add((int64_t)v);
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type encode(Record &r, T v)
+    {
+        r.add((uint64_t)v);
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_enum<T>::value>::type encode(Record &r, T v) { r.add((int64_t)v); }
+
+    template <typename T>
+    typename std::enable_if<!std::is_arithmetic<T>::value && !std::is_enum<T>::value>::type encode(Record &r, const T &v)
+    {
+        r.add(v);
+    }
+
+    // Claimed ring slot, published by commit()
+    struct Slot
+    {
+        Record *record;
+        uint64_t position;
+    };
+
+    bool claim(Level level, Slot &slot);
+    void commit(const Slot &slot);
+
+    inline void encodeAll(Record &) {}
+
+    template <typename T, typename... Rest>
+    inline void encodeAll(Record &r, const T &first, const Rest &...rest)
+    {
+        encode(r, first);
+        encodeAll(r, rest...);
+    }
+
+    template <typename... Args>
+    void write(Level level, const char *format, const Args &...args)
+    {
+        Slot slot;
+        if (!claim(level, slot))
+            return;
+        slot.record->format = format;
+        encodeAll(*slot.record, args...);
+        commit(slot);
+    }
+
+    // Writer thread. Records logged before start() wait in the ring.
+    // maxFileBytes = 0 disables rotation.
+    bool start(const QString &path, qint64 maxFileBytes, bool console);
+    void stop();
+
+    // Runtime floor on top of the compile-time level
+    void setLevel(Level level);
+
+    quint64 dropped();
+}
+
+// Disabled levels expand to an empty statement
+#define LOG_NOTHING() \
+    do                \
+    {                 \
+    } while (0)
+
+#if DEMOAPP_LOG_LEVEL <= 0
+#define LOG_TRACE(...) Log::write(Log::Trace, __VA_ARGS__)
+#else
+#define LOG_TRACE(...) LOG_NOTHING()
+#endif
+
+#if DEMOAPP_LOG_LEVEL <= 1
+#define LOG_DEBUG(...) Log::write(Log::Debug, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) LOG_NOTHING()
+#endif
+
+#if DEMOAPP_LOG_LEVEL <= 2
+#define LOG_INFO(...) Log::write(Log::Info, __VA_ARGS__)
+#else
+#define LOG_INFO(...) LOG_NOTHING()
+#endif
+
+#define LOG_WARNING(...) Log::write(Log::Warning, __VA_ARGS__)
+#define LOG_ERROR(...) Log::write(Log::Error, __VA_ARGS__)
+
+#endif // LOG_HPP
@@ -3,17 +3,21 @@
 #include <QDebug>
 #include <QProcess>
 
+#ifndef DEMOAPP_HOST_BUILD
 #include <libals.h>
+#endif
 #include "mainwindow.h"
 #include "card_reader.hpp"
 #include <cstdio>
 
 int main(int argc, char *argv[])
 {
+#ifndef DEMOAPP_HOST_BUILD
     // Suspend splash screen
     als::SplashScreen::Suspend();
 
     als::QtApp::SetupEnvironment(als::QtApp::AppType::WIDGET);
+#endif
 
     // CardReader reader;
     // if (!reader.initialize())
@@ -1,76 +1,114 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "config.hpp"
+#include "log.hpp"
 #include <QDebug>
-#include <QThread>
-#include <QtConcurrent/QtConcurrent>
+#include <QElapsedTimer>
 
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), ui(new Ui::MainWindow), initialized(false)
+    : QMainWindow(parent), ui(new Ui::MainWindow), startup(new Startup(this)), scanWorker(nullptr),
+      reader(nullptr), pipeline(nullptr), initialized(false), firstTapSeen(false)
 {
     ui->setupUi(this);
 
-    // Load configuration
-    Config &config = Config::instance();
-    if (!config.load())
-    {
-        showErrorScreen("Configuration file not found!");
-        return;
-    }
+    // Timers first, the error screen needs resetTimer from the first failure on
+    scanTimer = new QTimer(this);
+    connect(scanTimer, &QTimer::timeout, this, &MainWindow::startScanning);
 
-    // Initialize card reader
-    if (!reader.initialize())
-    {
-        showErrorScreen("Failed to initialize card reader!");
-        return;
-    }
+    resetTimer = new QTimer(this);
+    resetTimer->setSingleShot(true);
+    connect(resetTimer, &QTimer::timeout, this, &MainWindow::resetToScanScreen);
 
-    // Initialize API client
-    if (!apiClient.initialize())
+    // Load configuration, everything else depends on it
+    QElapsedTimer configTimer;
+    configTimer.start();
+    bool configLoaded = Config::reload();
+    startup->complete(Startup::StageConfig, configLoaded, configTimer.elapsed());
+    if (!configLoaded)
     {
-        showErrorScreen("Failed to initialize API client!");
+        showErrorScreen("Configuration file not found!");
         return;
     }
+    Config::Snapshot snapshot;
+    const Config &config = *snapshot;
 
-    initialized = true;
+    // Edits to the file are picked up by the next tap, no restart
+    connect(&configWatcher, &ConfigWatcher::reloaded, this, &MainWindow::onConfigReloaded);
+    configWatcher.start(config.fileName);
 
-    // Connect signals
-    connect(&reader, &CardReader::cardDetected, this, &MainWindow::onCardDetected);
-    connect(&reader, &CardReader::authenticationFailed, this, &MainWindow::onAuthenticationFailed);
-    connect(&reader, &CardReader::readProgress, this, &MainWindow::onReadProgress);
-    connect(&reader, &CardReader::scanComplete, this, &MainWindow::onScanComplete);
+    // Hot path logging goes through the ring, the writer owns the file
+    Log::start(config.logFile, (qint64)config.logMaxFileKB * 1024, config.logConsole);
+    Log::setLevel((Log::Level)config.logLevel);
 
-    // Setup timers
-    scanTimer = new QTimer(this);
-    connect(scanTimer, &QTimer::timeout, this, &MainWindow::startScanning);
+    if (!config.metricsSocket.isEmpty())
+        metricsServer.start(config.metricsSocket);
 
-    resetTimer = new QTimer(this);
-    resetTimer->setSingleShot(true);
-    connect(resetTimer, &QTimer::timeout, this, &MainWindow::resetToScanScreen);
+    // The worker owns the reader and runs it on its own long-lived thread
+    scanWorker = new ScanWorker(config.pipelineDepth);
+    reader = scanWorker->reader();
+    scanWorker->moveToThread(&readerThread);
+    connect(&readerThread, &QThread::started, scanWorker, &ScanWorker::startScanning);
 
-    // Start scanning
-    showScanScreen();
-    QTimer::singleShot(1000, this, &MainWindow::startScanning);
+    // Connect signals
+    connect(reader, &CardReader::cardDetected, this, &MainWindow::onCardDetected);
+    connect(reader, &CardReader::authenticationFailed, this, &MainWindow::onAuthenticationFailed);
+    connect(reader, &CardReader::readProgress, this, &MainWindow::onReadProgress);
+    connect(reader, &CardReader::scanComplete, this, &MainWindow::onScanComplete);
+
+    // Read, sign and send run as separate stages so the next card is read
+    // while the previous tap is still on the wire
+    pipeline = new TapPipeline(scanWorker, &apiClient, config.pipelineDepth, this);
+    connect(pipeline, &TapPipeline::tapRead, this, &MainWindow::onTapRead, Qt::QueuedConnection);
+    connect(pipeline, &TapPipeline::tapCompleted, this, &MainWindow::onTapCompleted, Qt::QueuedConnection);
+
+    // Coupler boot and key parsing overlap while the window is already up.
+    // Neither object is touched from this thread until readyToTap.
+    connect(startup, &Startup::stageFinished, this, &MainWindow::onStartupStageFinished);
+    connect(startup, &Startup::readyToTap, this, &MainWindow::onReadyToTap);
+    updateStatusText("Starting...");
+
+    CardReader *cardReader = reader;
+    ApiClient *client = &apiClient;
+    startup->run(Startup::StageReader, [cardReader]
+                 { return cardReader->initialize(); });
+    startup->run(Startup::StageKeys, [client]
+                 { return client->initialize(); });
 }
 
 MainWindow::~MainWindow()
 {
-    reader.shutdown();
+    // Stop flag + interrupted poll wait: the reader thread exits within a poll
+    if (scanWorker)
+        scanWorker->stop();
+    if (pipeline)
+        pipeline->stop();
+    configWatcher.stop();
+
+    // A coupler still booting gives up at its next poll
+    startup->wait();
+    readerThread.quit();
+    readerThread.wait();
+    if (scanWorker)
+    {
+        reader->shutdown();
+        delete scanWorker;
+    }
+    Log::stop();
     delete ui;
 }
 
 void MainWindow::showScanScreen()
 {
-    Config &config = Config::instance();
+    Config::Snapshot config;
     ui->stackedWidget->setCurrentWidget(ui->pageScan);
-    updateStatusText(config.msgScanning);
+    updateStatusText(config->msgScanning);
 }
 
 void MainWindow::showProcessingScreen()
 {
-    Config &config = Config::instance();
+    Config::Snapshot config;
     ui->stackedWidget->setCurrentWidget(ui->pageProcessing);
-    updateStatusText(config.msgProcessing);
+    updateStatusText(config->msgProcessing);
 }
 
 void MainWindow::showErrorScreen(const QString &message)
@@ -102,7 +140,33 @@ void MainWindow::updateStatusText(const QString &text)
 void MainWindow::resetToScanScreen()
 {
     showScanScreen();
-    QTimer::singleShot(500, this, &MainWindow::startScanning);
+}
+
+void MainWindow::onStartupStageFinished(int stage, bool ok)
+{
+    if (ok)
+        return;
+
+    if (stage == Startup::StageReader)
+        showErrorScreen("Failed to initialize card reader!");
+    else if (stage == Startup::StageKeys)
+        showErrorScreen("Failed to initialize API client!");
+}
+
+void MainWindow::onReadyToTap(qint64 elapsedMs)
+{
+    qDebug() << "Ready to tap" << elapsedMs << "ms after start";
+    initialized = true;
+    showScanScreen();
+    startScanning();
+}
+
+void MainWindow::onConfigReloaded(quint64 generation)
+{
+    // Reader and API client switch over at their next tap by themselves,
+    // the log level is process-wide
+    Q_UNUSED(generation);
+    Log::setLevel((Log::Level)Config::Snapshot()->logLevel);
 }
 
 void MainWindow::startScanning()
@@ -114,50 +178,45 @@ void MainWindow::startScanning()
     }
 
     qDebug() << "Starting card scan...";
+    pipeline->start();
+    readerThread.start();
+}
 
-    // Run scan in separate thread to avoid blocking UI
-    QtConcurrent::run([this]()
-                      {
-        CardReader::CardData cardData = reader.scanCard(30); // 30 second timeout
-        
-        if (cardData.success) {
-            // Convert raw data to hex string
-            QString hexData;
-            for (int i = 0; i < cardData.rawData.size(); i++) {
-                hexData += QString("%1").arg((unsigned char)cardData.rawData[i], 2, 16, QChar('0')).toUpper();
-            }
-            
-            qDebug() << "Card UID:" << cardData.cardUid;
-            qDebug() << "Card Data:" << hexData;
-            
-            // Show processing screen
-            QMetaObject::invokeMethod(this, "showProcessingScreen", Qt::QueuedConnection);
-            
-            // Send to API
-            ApiClient::Response apiResp = apiClient.sendCardTap(cardData.cardUid, hexData);
-            
-            if (apiResp.success) {
-                QString successMsg = QString("%1\n\nTransaction: %2")
-                    .arg(apiResp.message)
-                    .arg(apiResp.transactionId);
-                QMetaObject::invokeMethod(this, "showSuccessScreen", Qt::QueuedConnection, 
-                                        Q_ARG(QString, successMsg));
-            } else {
-                Config& config = Config::instance();
-                QString errorMsg = apiResp.message.isEmpty() ? config.msgApiError : apiResp.message;
-                QMetaObject::invokeMethod(this, "showErrorScreen", Qt::QueuedConnection, 
-                                        Q_ARG(QString, errorMsg));
-            }
-        } else {
-            // Timeout or scan failed - restart scanning
-            qDebug() << "Scan failed or timed out, restarting scan...";
-            
-            // Small delay before restarting to let the reader settle
-            QThread::msleep(500);
-            
-            // Restart scanning on the main thread
-            QMetaObject::invokeMethod(this, "startScanning", Qt::QueuedConnection);
-        } });
+void MainWindow::onTapRead(quint64 sequence, QString cardUid)
+{
+    qDebug() << "Tap" << sequence << "queued, card UID:" << cardUid;
+    if (!firstTapSeen)
+    {
+        firstTapSeen = true;
+        qDebug() << "First tap read" << startup->elapsedMs() << "ms after start";
+    }
+    resetTimer->stop();
+    showProcessingScreen();
+}
+
+void MainWindow::onTapCompleted(TapResult result)
+{
+    // Results arrive in tap order, the reader is already on the next card
+    const ApiClient::Response &apiResp = result.response;
+
+    if (apiResp.success)
+    {
+        QString successMsg = QString("%1\n\nTransaction: %2")
+                                 .arg(apiResp.message)
+                                 .arg(apiResp.transactionId);
+        showSuccessScreen(successMsg);
+    }
+    else if (result.queued)
+    {
+        // Server unreachable, the tap is stored and sent later
+        showSuccessScreen(QString("%1\n\nTransaction: %2").arg(apiResp.message).arg(apiResp.transactionId));
+    }
+    else
+    {
+        Config::Snapshot config;
+        QString errorMsg = apiResp.message.isEmpty() ? config->msgApiError : apiResp.message;
+        showErrorScreen(errorMsg);
+    }
 }
 
 void MainWindow::onCardDetected(QString cardType)
@@ -168,8 +227,8 @@ void MainWindow::onCardDetected(QString cardType)
 
 void MainWindow::onAuthenticationFailed()
 {
-    Config &config = Config::instance();
-    showErrorScreen(config.msgAuthFailed);
+    Config::Snapshot config;
+    showErrorScreen(config->msgAuthFailed);
 }
 
 void MainWindow::onReadProgress(QString message)
@@ -188,7 +247,7 @@ void MainWindow::onScanComplete(bool success, QString message)
 
     if (!success)
     {
-        Config &config = Config::instance();
-        showErrorScreen(config.msgReadFailed);
+        Config::Snapshot config;
+        showErrorScreen(config->msgReadFailed);
     }
 }
\ No newline at end of file
@@ -2,9 +2,15 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QThread>
 #include <QTimer>
 #include "card_reader.hpp"
 #include "api_client.hpp"
+#include "config_watcher.hpp"
+#include "metrics_server.hpp"
+#include "scanworker.hpp"
+#include "startup.hpp"
+#include "tap_pipeline.hpp"
 
 QT_BEGIN_NAMESPACE
 namespace Ui
@@ -27,16 +33,28 @@ private slots:
     void onAuthenticationFailed();
     void onReadProgress(QString message);
     void onScanComplete(bool success, QString message);
+    void onTapRead(quint64 sequence, QString cardUid);
+    void onTapCompleted(TapResult result);
     void resetToScanScreen();
+    void onStartupStageFinished(int stage, bool ok);
+    void onReadyToTap(qint64 elapsedMs);
+    void onConfigReloaded(quint64 generation);
 
 private:
     Ui::MainWindow *ui;
-    CardReader reader;
+    Startup *startup;
+    QThread readerThread;
+    ScanWorker *scanWorker;
+    CardReader *reader;
     ApiClient apiClient;
+    MetricsServer metricsServer;
+    ConfigWatcher configWatcher;
+    TapPipeline *pipeline;
     QTimer *scanTimer;
     QTimer *resetTimer;
 
     bool initialized;
+    bool firstTapSeen;
 
     void showScanScreen();
     Q_INVOKABLE void showProcessingScreen();
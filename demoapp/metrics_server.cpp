@@ -0,0 +1,139 @@
+/*******************************************************************************
+ * Metrics Server Implementation
+ *******************************************************************************/
+
+#include "metrics_server.hpp"
+#include "tap_metrics.hpp"
+#include <QDebug>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// A scraper that connects and never sends is dropped after this long
+static const int REQUEST_TIMEOUT_MS = 200;
+
+MetricsServer::MetricsServer() : _listenFd(-1), _running(false)
+{
+}
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+bool MetricsServer::start(const QString &socketPath)
+{
+    if (_running)
+        return true;
+
+    QByteArray path = socketPath.toLocal8Bit();
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.isEmpty() || path.size() >= (int)sizeof(address.sun_path))
+    {
+        qDebug() << "Invalid metrics socket path:" << socketPath;
+        return false;
+    }
+    memcpy(address.sun_path, path.constData(), path.size());
+
+    _listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (_listenFd < 0)
+    {
+        qDebug() << "Failed to create metrics socket:" << strerror(errno);
+        return false;
+    }
+
+    unlink(path.constData());
+    if (bind(_listenFd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(_listenFd, 4) != 0)
+    {
+        qDebug() << "Failed to listen on metrics socket" << socketPath << ":" << strerror(errno);
+        close(_listenFd);
+        _listenFd = -1;
+        return false;
+    }
+
+    _socketPath = socketPath;
+    _running = true;
+    _thread = std::thread(&MetricsServer::serve, this);
+    qDebug() << "Serving tap metrics on" << socketPath;
+    return true;
+}
+
+void MetricsServer::stop()
+{
+    if (!_running)
+        return;
+
+    // Wakes the blocked accept()
+    _running = false;
+    shutdown(_listenFd, SHUT_RDWR);
+    if (_thread.joinable())
+        _thread.join();
+
+    close(_listenFd);
+    _listenFd = -1;
+    unlink(_socketPath.toLocal8Bit().constData());
+}
+
+void MetricsServer::serve()
+{
+    while (_running)
+    {
+        int client = accept4(_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        respond(client);
+        close(client);
+    }
+}
+
+void MetricsServer::respond(int client)
+{
+    // The request itself is not parsed, any path gets the metrics. Waiting
+    // for it keeps HTTP clients from seeing a reset before they sent it.
+    struct pollfd pfd;
+    pfd.fd = client;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, REQUEST_TIMEOUT_MS) > 0)
+    {
+        char request[1024];
+        if (recv(client, request, sizeof(request), MSG_DONTWAIT) < 0)
+            return;
+    }
+
+    QByteArray body;
+    body.reserve(8192);
+    TapMetrics::writePrometheus(body);
+
+    QByteArray response;
+    response.reserve(body.size() + 128);
+    response.append("HTTP/1.0 200 OK\r\n"
+                    "Content-Type: text/plain; version=0.0.4\r\n"
+                    "Content-Length: ");
+    response.append(QByteArray::number(body.size()));
+    response.append("\r\n\r\n");
+    response.append(body);
+
+    const char *data = response.constData();
+    int left = response.size();
+    while (left > 0)
+    {
+        ssize_t sent = send(client, data, left, MSG_NOSIGNAL);
+        if (sent <= 0)
+        {
+            if (sent < 0 && errno == EINTR)
+                continue;
+            return;
+        }
+        data += sent;
+        left -= (int)sent;
+    }
+}
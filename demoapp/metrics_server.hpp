@@ -0,0 +1,38 @@
+/*******************************************************************************
+ * Metrics Server - Prometheus text exposition on a local Unix socket
+ *
+ *   curl --unix-socket /run/demoapp/metrics.sock http://localhost/metrics
+ *
+ * Every connection gets one HTTP/1.0 response with the current tap metrics
+ * and is closed. Runs on its own thread, nothing is exposed on the network.
+ *******************************************************************************/
+
+#ifndef METRICS_SERVER_HPP
+#define METRICS_SERVER_HPP
+
+#include <QString>
+#include <atomic>
+#include <thread>
+
+class MetricsServer
+{
+public:
+    MetricsServer();
+    ~MetricsServer();
+
+    // Replaces a stale socket file left by a previous run
+    bool start(const QString &socketPath);
+    void stop();
+    bool isRunning() const { return _running; }
+
+private:
+    void serve();
+    void respond(int client);
+
+    QString _socketPath;
+    int _listenFd;
+    std::thread _thread;
+    std::atomic<bool> _running;
+};
+
+#endif // METRICS_SERVER_HPP
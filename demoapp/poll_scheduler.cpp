@@ -0,0 +1,125 @@
+/*******************************************************************************
+ * Poll Scheduler Implementation
+ *******************************************************************************/
+
+#include "poll_scheduler.hpp"
+#include <QMutexLocker>
+#include <ctime>
+#include <algorithm>
+
+PollScheduler::PollScheduler() : _interrupted(false)
+{
+    configure(Settings());
+}
+
+PollScheduler::PollScheduler(const Settings &settings) : _interrupted(false)
+{
+    configure(settings);
+}
+
+void PollScheduler::configure(const Settings &settings)
+{
+    _settings = settings;
+    if (_settings.maxIntervalMs < _settings.minIntervalMs)
+        _settings.maxIntervalMs = _settings.minIntervalMs;
+    if (_settings.backoff < 1.0)
+        _settings.backoff = 1.0;
+
+    _intervalMs = _settings.minIntervalMs;
+    _lastGapMs = 0;
+    _lastActivityMs = -1;
+    _clock.start();
+    resetStats();
+}
+
+unsigned int PollScheduler::onPoll(bool cardPresent)
+{
+    _stats.polls++;
+
+    if (cardPresent)
+    {
+        _stats.detections++;
+        _stats.detectionLatencySumMs += _lastGapMs;
+        _stats.detectionLatencyMaxMs = std::max(_stats.detectionLatencyMaxMs, _lastGapMs);
+        onActivity();
+        _lastGapMs = 0;
+        return 0;
+    }
+
+    bool recent = _lastActivityMs >= 0 &&
+                  _clock.elapsed() - _lastActivityMs < (qint64)_settings.activeWindowMs;
+    if (recent)
+        _intervalMs = _settings.minIntervalMs;
+    else
+        _intervalMs = std::min((double)_settings.maxIntervalMs, _intervalMs * _settings.backoff);
+
+    _lastGapMs = (unsigned int)_intervalMs;
+    return _lastGapMs;
+}
+
+void PollScheduler::onActivity()
+{
+    _lastActivityMs = _clock.elapsed();
+    _intervalMs = _settings.minIntervalMs;
+}
+
+void PollScheduler::wait(unsigned int milliseconds)
+{
+    if (milliseconds == 0)
+        return;
+
+    QMutexLocker lock(&_waitMutex);
+    if (_interrupted)
+        return;
+    _stats.sleptMs += milliseconds;
+    _wakeUp.wait(&_waitMutex, milliseconds);
+}
+
+void PollScheduler::interrupt()
+{
+    QMutexLocker lock(&_waitMutex);
+    _interrupted = true;
+    _wakeUp.wakeAll();
+}
+
+void PollScheduler::clearInterrupt()
+{
+    QMutexLocker lock(&_waitMutex);
+    _interrupted = false;
+}
+
+void PollScheduler::resetStats()
+{
+    _stats = Stats();
+    _statsStartMs = _clock.elapsed();
+    _cpuStartUs = threadCpuUs();
+}
+
+qint64 PollScheduler::threadCpuUs()
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+        return 0;
+    return (qint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+QString PollScheduler::report(quint64 serialCommands) const
+{
+    qint64 wallMs = std::max<qint64>(1, _clock.elapsed() - _statsStartMs);
+    qint64 cpuUs = threadCpuUs() - _cpuStartUs;
+    double avgLatency = _stats.detections ? (double)_stats.detectionLatencySumMs / _stats.detections : 0.0;
+
+    // Detection latency is bounded by the gap before the detecting poll,
+    // a card arriving uniformly in that gap waits half of it on average.
+    return QString("polls=%1 (%2/s) serialCmds=%3 cpu=%4% slept=%5ms "
+                   "detections=%6 detectLatency avg=%7ms max=%8ms interval=%9ms")
+        .arg(_stats.polls)
+        .arg(_stats.polls * 1000.0 / wallMs, 0, 'f', 1)
+        .arg(serialCommands)
+        .arg(cpuUs / (10.0 * wallMs), 0, 'f', 2)
+        .arg(_stats.sleptMs)
+        .arg(_stats.detections)
+        .arg(avgLatency / 2.0, 0, 'f', 1)
+        .arg(_stats.detectionLatencyMaxMs)
+        .arg((unsigned int)_intervalMs);
+}
@@ -0,0 +1,78 @@
+/*******************************************************************************
+ * Poll Scheduler - adaptive card presence polling
+ *
+ * Polls tightly right after a card was seen and backs off geometrically while
+ * the field stays empty, bounded by [minIntervalMs, maxIntervalMs].
+ *******************************************************************************/
+
+#ifndef POLL_SCHEDULER_HPP
+#define POLL_SCHEDULER_HPP
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+#include <QWaitCondition>
+
+class PollScheduler
+{
+public:
+    struct Settings
+    {
+        unsigned int minIntervalMs = 10;    // Sleep right after activity
+        unsigned int maxIntervalMs = 150;   // Upper bound while idle
+        unsigned int activeWindowMs = 3000; // Stay at min this long after activity
+        double backoff = 1.5;               // Growth factor per idle poll
+    };
+
+    struct Stats
+    {
+        quint64 polls = 0;
+        quint64 detections = 0;
+        quint64 sleptMs = 0;
+        quint64 detectionLatencySumMs = 0; // Sum of the gaps preceding each detection
+        unsigned int detectionLatencyMaxMs = 0;
+    };
+
+    PollScheduler();
+    explicit PollScheduler(const Settings &settings);
+
+    void configure(const Settings &settings);
+    const Settings &settings() const { return _settings; }
+
+    // Call after every poll. Returns the number of milliseconds to sleep
+    // before the next poll (0 when a card was found).
+    unsigned int onPoll(bool cardPresent);
+
+    // Record activity without a poll (e.g. a tap just finished)
+    void onActivity();
+
+    // Sleep for the current interval, returns early once interrupted
+    void wait(unsigned int milliseconds);
+
+    // Wake up a pending wait() from another thread. Later waits return
+    // immediately until clearInterrupt() is called.
+    void interrupt();
+    void clearInterrupt();
+
+    const Stats &stats() const { return _stats; }
+    void resetStats();
+    QString report(quint64 serialCommands) const;
+
+private:
+    static qint64 threadCpuUs();
+
+    Settings _settings;
+    Stats _stats;
+    double _intervalMs;
+    unsigned int _lastGapMs;
+    qint64 _lastActivityMs;
+    qint64 _statsStartMs;
+    qint64 _cpuStartUs;
+    QElapsedTimer _clock;
+
+    QMutex _waitMutex;
+    QWaitCondition _wakeUp;
+    bool _interrupted;
+};
+
+#endif // POLL_SCHEDULER_HPP
@@ -0,0 +1,109 @@
+/*******************************************************************************
+ * Read Plan Implementation
+ *******************************************************************************/
+
+#include "read_plan.hpp"
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+int ReadPlan::blockCount() const
+{
+    int count = 0;
+    foreach (const Sector &s, sectors)
+        count += s.lastBlock - s.firstBlock + 1;
+    return count;
+}
+
+ReadPlan ReadPlan::parse(const QStringList &entries, const uint8_t *defaultKey, int sectorCount)
+{
+    ReadPlan plan;
+
+    foreach (const QString &entry, entries)
+    {
+        QStringList parts = entry.trimmed().split(':');
+        if (parts.isEmpty() || parts[0].isEmpty())
+            continue;
+
+        bool ok = false;
+        Sector s;
+        s.sector = parts[0].toInt(&ok);
+        if (!ok || s.sector < 0 || s.sector >= sectorCount)
+        {
+            qDebug() << "Read plan: invalid sector in" << entry;
+            continue;
+        }
+
+        bool duplicate = false;
+        foreach (const Sector &other, plan.sectors)
+            duplicate = duplicate || other.sector == s.sector;
+        if (duplicate)
+        {
+            qDebug() << "Read plan: sector" << s.sector << "listed twice, ignoring" << entry;
+            continue;
+        }
+
+        // Data blocks only, the trailer holds the keys
+        int first = firstBlockOfSector(s.sector);
+        int last = trailerOfSector(s.sector) - 1;
+        s.firstBlock = first;
+        s.lastBlock = last;
+
+        if (parts.size() > 1 && !parts[1].isEmpty())
+        {
+            QStringList range = parts[1].split('-');
+            bool lastOk = true;
+            s.firstBlock = range[0].toInt(&ok);
+            s.lastBlock = range.size() > 1 ? range[1].toInt(&lastOk) : s.firstBlock;
+            if (!ok || !lastOk || range.size() > 2)
+            {
+                qDebug() << "Read plan: invalid block range in" << entry;
+                continue;
+            }
+        }
+
+        if (s.firstBlock < first || s.lastBlock > last || s.firstBlock > s.lastBlock)
+        {
+            qDebug() << "Read plan: block range outside the data blocks of sector" << s.sector << "in" << entry;
+            s.firstBlock = qMax(s.firstBlock, first);
+            s.lastBlock = qMin(s.lastBlock, last);
+            if (s.firstBlock > s.lastBlock)
+                continue;
+        }
+
+        memcpy(s.key, defaultKey, 6);
+        if (parts.size() > 2 && !parts[2].isEmpty())
+        {
+            // Not the default key either, a wrong key only shows up as an
+            // auth failure at the tap
+            QByteArray key = QByteArray::fromHex(parts[2].toLatin1());
+            if (key.size() != 6 || parts[2].trimmed().size() != 12)
+            {
+                qDebug() << "Read plan: malformed key in" << entry;
+                continue;
+            }
+            memcpy(s.key, key.constData(), 6);
+        }
+
+        plan.sectors.append(s);
+    }
+
+    // Output buffer is laid out in ascending sector order
+    std::sort(plan.sectors.begin(), plan.sectors.end(), [](const Sector &a, const Sector &b)
+              { return a.sector < b.sector; });
+
+    int offset = 0;
+    for (int i = 0; i < plan.sectors.size(); i++)
+    {
+        plan.sectors[i].offset = offset;
+        offset += (plan.sectors[i].lastBlock - plan.sectors[i].firstBlock + 1) * 16;
+        plan.order.append(i);
+    }
+
+    // Execute sectors sharing a key back to back so each key is loaded once
+    const QVector<Sector> &sectors = plan.sectors;
+    std::stable_sort(plan.order.begin(), plan.order.end(), [&sectors](int a, int b)
+                     { return memcmp(sectors[a].key, sectors[b].key, 6) < 0; });
+
+    return plan;
+}
@@ -0,0 +1,44 @@
+/*******************************************************************************
+ * Read Plan - declarative list of MIFARE Classic sectors to read per card type
+ *
+ * A plan entry is written "sector[:first-last][:key]" in card_config.ini:
+ *   plan=3:12-14, 4, 8:32-33:A0A1A2A3A4A5
+ * Blocks are absolute block numbers, a sector without a range reads all of its
+ * data blocks, and sector trailers are always skipped.
+ *******************************************************************************/
+
+#ifndef READ_PLAN_HPP
+#define READ_PLAN_HPP
+
+#include <QStringList>
+#include <QVector>
+#include <cstdint>
+
+struct ReadPlan
+{
+    struct Sector
+    {
+        int sector;
+        int firstBlock;
+        int lastBlock;
+        uint8_t key[6];
+        int offset; // Byte offset of the first block in the output buffer
+    };
+
+    QVector<Sector> sectors; // Ascending sector order
+    QVector<int> order;      // Execution order, grouped by key
+
+    bool isEmpty() const { return sectors.isEmpty(); }
+
+    // Total number of data blocks the plan reads
+    int blockCount() const;
+
+    static ReadPlan parse(const QStringList &entries, const uint8_t *defaultKey, int sectorCount);
+
+    // MIFARE Classic layout: 32 sectors of 4 blocks, then 8 sectors of 16 blocks (4K)
+    static int firstBlockOfSector(int sector) { return sector < 32 ? sector * 4 : 128 + (sector - 32) * 16; }
+    static int blocksInSector(int sector) { return sector < 32 ? 4 : 16; }
+    static int trailerOfSector(int sector) { return firstBlockOfSector(sector) + blocksInSector(sector) - 1; }
+};
+
+#endif // READ_PLAN_HPP
@@ -0,0 +1,277 @@
+/*******************************************************************************
+ * Request Template Implementation
+ *******************************************************************************/
+
+#include "request_template.hpp"
+#include "config.hpp"
+#include <cmath>
+#include <cstring>
+#include <ctime>
+
+// "yyyy-MM-dd HH:mm:ss"
+static const int TIME_LENGTH = 19;
+
+// Longest amount QByteArray::number(amount, 'g', 6) gives, e.g. -1.23457e+308
+static const int MAX_AMOUNT_LENGTH = 32;
+
+// Decimal digits of a qint64
+static const int MAX_DIGITS = 20;
+
+// Writes value's digits ending at end, returns where they start
+static char *writeDigits(char *end, quint64 value)
+{
+    do
+    {
+        *--end = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    return end;
+}
+
+static void appendNumber(QByteArray &out, qint64 value)
+{
+    char buffer[MAX_DIGITS + 1];
+    char *end = buffer + sizeof(buffer);
+    char *start = writeDigits(end, value < 0 ? 0 - (quint64)value : (quint64)value);
+    if (value < 0)
+        *--start = '-';
+    out.append(start, (int)(end - start));
+}
+
+// As QString::arg(double) writes it: %g with 6 significant digits
+static void appendAmount(QByteArray &out, double amount)
+{
+    if (!std::signbit(amount) && amount < 1e6 && amount == std::floor(amount))
+        appendNumber(out, (qint64)amount);
+    else
+        out.append(QByteArray::number(amount, 'g', 6));
+}
+
+// Local time of timestampMs, formatted once per second and thread
+static const char *localTime(qint64 timestampMs)
+{
+    struct Cache
+    {
+        qint64 second;
+        char text[TIME_LENGTH + 1];
+    };
+    static thread_local Cache cache = {-1, {0}};
+
+    qint64 second = timestampMs >= 0 ? timestampMs / 1000 : (timestampMs - 999) / 1000;
+    if (second != cache.second)
+    {
+        time_t seconds = (time_t)second;
+        struct tm local;
+        localtime_r(&seconds, &local);
+        strftime(cache.text, sizeof(cache.text), "%Y-%m-%d %H:%M:%S", &local);
+        cache.second = second;
+    }
+    return cache.text;
+}
+
+static QByteArray escaped(const QString &text)
+{
+    QByteArray out;
+    RequestTemplate::appendEscaped(out, text);
+    return out;
+}
+
+RequestTemplate::RequestTemplate()
+    : _staticSize(0), _headers(nullptr)
+{
+}
+
+RequestTemplate::RequestTemplate(const RequestTemplate &other)
+    : _staticSize(0), _headers(nullptr)
+{
+    *this = other;
+}
+
+// The curl_slist is rebuilt, each copy owns its own
+RequestTemplate &RequestTemplate::operator=(const RequestTemplate &other)
+{
+    if (this == &other)
+        return *this;
+    for (int i = 0; i < PART_COUNT; i++)
+        _parts[i] = other._parts[i];
+    _staticSize = other._staticSize;
+    _url = other._url;
+    _batchUrl = other._batchUrl;
+    _headerLines = other._headerLines;
+    buildHeaders();
+    return *this;
+}
+
+RequestTemplate::~RequestTemplate()
+{
+    curl_slist_free_all(_headers);
+}
+
+void RequestTemplate::compile(const Config &config)
+{
+    _parts[BeforeAmount] = "{\"amount\": ";
+    _parts[BeforeCardData] = ",\"cardData\": \"";
+    _parts[BeforeCardNumber] = "\",\"fareMediaCode\": \"" + escaped(config.fareMediaCode) + "\",\"cardNumber\": \"";
+    _parts[BeforeEntryTime] = "\",\"entryTime\": \"";
+    _parts[BeforeRequestTime] = "\",\"stationCode\": \"" + escaped(config.stationCode) + "\",\"tapChannel\": \"" +
+                                escaped(config.tapChannel) + "\",\"cardTypeId\": " +
+                                QByteArray::number(config.cardTypeId) + ",\"requestTime\": \"";
+    _parts[BeforeTransactionId] = "\",\"reservedField1\": \"\",\"reservedField2\": \"\",\"reservedField3\": \"\","
+                                  "\"transactionId\": \"afcs-tom";
+    _parts[End] = "\"}";
+
+    _staticSize = 0;
+    for (int i = 0; i < PART_COUNT; i++)
+        _staticSize += _parts[i].size();
+
+    _url = config.apiUrl.toUtf8();
+    _batchUrl = config.batchUrl.isEmpty() ? _url + "/batch" : config.batchUrl.toUtf8();
+
+    _headerLines.clear();
+    _headerLines << "Content-Type: application/json"
+                 << "Accept: application/json"
+                 << "Device: " + config.deviceName.toUtf8()
+                 << "Afcs-Code: " + config.deviceCode.toUtf8()
+                 << "Version-Number: " + config.deviceVersion.toUtf8()
+                 << "Agent-Code: " + config.agentCode.toUtf8()
+                 << "Cashier-Code: " + config.cashierName.toUtf8();
+    buildHeaders();
+}
+
+void RequestTemplate::buildHeaders()
+{
+    // curl copies each line, the list is shared by every request until the
+    // next compile() or assignment
+    curl_slist_free_all(_headers);
+    _headers = nullptr;
+    for (int i = 0; i < _headerLines.size(); i++)
+        _headers = curl_slist_append(_headers, _headerLines[i].constData());
+}
+
+void RequestTemplate::fill(QByteArray &out, const QString &cardNumber, const QString &cardData, double amount,
+                           qint64 timestampMs) const
+{
+    // Escaping writes at most 6 bytes per UTF-16 unit (\u001f)
+    int bound = _staticSize + MAX_AMOUNT_LENGTH + 6 * (cardNumber.size() + cardData.size()) + 2 * TIME_LENGTH +
+                MAX_DIGITS;
+    out.resize(0);
+    if (out.capacity() < bound)
+        out.reserve(bound);
+
+    const char *time = localTime(timestampMs);
+
+    out.append(_parts[BeforeAmount]);
+    appendAmount(out, amount);
+    out.append(_parts[BeforeCardData]);
+    appendEscaped(out, cardData);
+    out.append(_parts[BeforeCardNumber]);
+    appendEscaped(out, cardNumber);
+    out.append(_parts[BeforeEntryTime]);
+    out.append(time, TIME_LENGTH);
+    out.append(_parts[BeforeRequestTime]);
+    out.append(time, TIME_LENGTH);
+    out.append(_parts[BeforeTransactionId]);
+    appendNumber(out, timestampMs);
+    out.append(_parts[End]);
+}
+
+void RequestTemplate::wrap(QByteArray &out, const QByteArray &data, const QByteArray &signature)
+{
+    static const char before[] = "{\"data\": ";
+    static const char between[] = ", \"signature\": \"";
+    static const char after[] = "\"}";
+
+    out.resize(0);
+    out.reserve(data.size() + signature.size() + (int)(sizeof(before) + sizeof(between) + sizeof(after)));
+    out.append(before, (int)sizeof(before) - 1);
+    out.append(data);
+    out.append(between, (int)sizeof(between) - 1);
+    out.append(signature);
+    out.append(after, (int)sizeof(after) - 1);
+}
+
+QString RequestTemplate::transactionId(qint64 timestampMs)
+{
+    return QLatin1String("afcs-tom") + QString::number(timestampMs);
+}
+
+void RequestTemplate::appendEscaped(QByteArray &out, const QString &text)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    const ushort *p = text.utf16();
+    const ushort *end = p + text.size();
+    while (p < end)
+    {
+        // Runs of plain ASCII are copied whole
+        const ushort *run = p;
+        while (run < end && *run >= 0x20 && *run < 0x80 && *run != '"' && *run != '\\')
+            run++;
+        if (run > p)
+        {
+            int length = (int)(run - p);
+            int at = out.size();
+            out.resize(at + length);
+            char *dst = out.data() + at;
+            for (int i = 0; i < length; i++)
+                dst[i] = (char)p[i];
+            p = run;
+            continue;
+        }
+
+        uint code = *p++;
+        if (code == '"' || code == '\\')
+        {
+            char pair[2] = {'\\', (char)code};
+            out.append(pair, 2);
+        }
+        else if (code < 0x20)
+        {
+            char escape = code == '\b' ? 'b' : code == '\f' ? 'f' : code == '\n' ? 'n' : code == '\r' ? 'r' :
+                          code == '\t' ? 't' : 0;
+            if (escape)
+            {
+                char pair[2] = {'\\', escape};
+                out.append(pair, 2);
+            }
+            else
+            {
+                char unicode[6] = {'\\', 'u', '0', '0', hex[code >> 4], hex[code & 0xF]};
+                out.append(unicode, 6);
+            }
+        }
+        else
+        {
+            // Surrogate pairs join up, a lone half becomes U+FFFD
+            if (code >= 0xD800 && code < 0xDC00 && p < end && *p >= 0xDC00 && *p < 0xE000)
+                code = 0x10000 + ((code - 0xD800) << 10) + (*p++ - 0xDC00);
+            else if (code >= 0xD800 && code < 0xE000)
+                code = 0xFFFD;
+
+            char bytes[4];
+            int length;
+            if (code < 0x800)
+            {
+                bytes[0] = (char)(0xC0 | (code >> 6));
+                bytes[1] = (char)(0x80 | (code & 0x3F));
+                length = 2;
+            }
+            else if (code < 0x10000)
+            {
+                bytes[0] = (char)(0xE0 | (code >> 12));
+                bytes[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+                bytes[2] = (char)(0x80 | (code & 0x3F));
+                length = 3;
+            }
+            else
+            {
+                bytes[0] = (char)(0xF0 | (code >> 18));
+                bytes[1] = (char)(0x80 | ((code >> 12) & 0x3F));
+                bytes[2] = (char)(0x80 | ((code >> 6) & 0x3F));
+                bytes[3] = (char)(0x80 | (code & 0x3F));
+                length = 4;
+            }
+            out.append(bytes, length);
+        }
+    }
+}
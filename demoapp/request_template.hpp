@@ -0,0 +1,83 @@
+/*******************************************************************************
+ * Request Template - tap request payload and headers compiled from Config
+ *
+ *   compile(config) ──> static JSON parts, URLs, device headers, curl_slist
+ *   fill(out, card, amount, time) ──> data object: parts + escaped fields
+ *
+ * Everything that only depends on Config is rendered once. A tap copies the
+ * static parts and writes its own fields straight into the output buffer as
+ * UTF-8: the card strings JSON-escaped, the amount and the transaction ID as
+ * digits, the time through a per-thread cache that formats once a second.
+ * The result is byte for byte the data object the server expects:
+ *
+ *   {"amount": 750,"cardData": "..","fareMediaCode": "..","cardNumber": "..",
+ *    "entryTime": "..","stationCode": "..","tapChannel": "..","cardTypeId": 1,
+ *    "requestTime": "..","reservedField1": "","reservedField2": "",
+ *    "reservedField3": "","transactionId": "afcs-tom<epoch ms>"}
+ *******************************************************************************/
+
+#ifndef REQUEST_TEMPLATE_HPP
+#define REQUEST_TEMPLATE_HPP
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <curl/curl.h>
+
+class Config;
+
+class RequestTemplate
+{
+public:
+    RequestTemplate();
+    RequestTemplate(const RequestTemplate &other);
+    RequestTemplate &operator=(const RequestTemplate &other);
+    ~RequestTemplate();
+
+    void compile(const Config &config);
+
+    // Replaces the contents of out, which keeps its capacity for the next tap
+    void fill(QByteArray &out, const QString &cardNumber, const QString &cardData, double amount,
+              qint64 timestampMs) const;
+
+    // {"data": <data>, "signature": "<signature>"} into out
+    static void wrap(QByteArray &out, const QByteArray &data, const QByteArray &signature);
+
+    static QString transactionId(qint64 timestampMs);
+
+    const QByteArray &url() const { return _url; }
+    const QByteArray &batchUrl() const { return _batchUrl; }
+
+    // Request headers with the device identity, valid until the next compile()
+    // or assignment
+    const QList<QByteArray> &headerLines() const { return _headerLines; }
+    curl_slist *headers() const { return _headers; }
+
+    // Appends text as the inside of a JSON string
+    static void appendEscaped(QByteArray &out, const QString &text);
+
+private:
+    // Static runs between the per-tap fields, in payload order
+    enum Part
+    {
+        BeforeAmount,
+        BeforeCardData,
+        BeforeCardNumber, // Includes fareMediaCode
+        BeforeEntryTime,
+        BeforeRequestTime, // Includes stationCode, tapChannel and cardTypeId
+        BeforeTransactionId,
+        End,
+        PART_COUNT
+    };
+
+    void buildHeaders();
+
+    QByteArray _parts[PART_COUNT];
+    int _staticSize;
+    QByteArray _url;
+    QByteArray _batchUrl;
+    QList<QByteArray> _headerLines;
+    curl_slist *_headers;
+};
+
+#endif // REQUEST_TEMPLATE_HPP
@@ -0,0 +1,107 @@
+/*******************************************************************************
+ * Response Auditor Implementation
+ *******************************************************************************/
+
+#include "response_auditor.hpp"
+#include "log.hpp"
+#include "tap_metrics.hpp"
+#include <QDateTime>
+#include <QElapsedTimer>
+
+ResponseAuditor::ResponseAuditor(SignatureHelper *verifier)
+    : _verifier(verifier), _running(false), _pending(0)
+{
+}
+
+ResponseAuditor::~ResponseAuditor()
+{
+    stop();
+}
+
+void ResponseAuditor::start(int queueDepth)
+{
+    _queue.setCapacity(queueDepth);
+    if (_running)
+        return;
+
+    _queue.reopen();
+    _running = true;
+    _thread = std::thread(&ResponseAuditor::run, this);
+}
+
+void ResponseAuditor::stop()
+{
+    if (!_running)
+        return;
+
+    _running = false;
+    _queue.close();
+    if (_thread.joinable())
+        _thread.join();
+}
+
+bool ResponseAuditor::submit(const QString &transactionId, const QByteArray &data, const QByteArray &signature)
+{
+    Record record;
+    record.timeMs = QDateTime::currentMSecsSinceEpoch();
+    record.transactionId = transactionId;
+    record.data = data;
+    record.signature = signature;
+
+    // Counted before the push so the audit thread never sees it negative
+    _pending++;
+    if (!_running || !_queue.tryPush(record))
+    {
+        _pending--;
+        TapMetrics::increment(TapMetrics::VerifyDropped);
+        LOG_WARNING("Audit queue full, response of transaction {} is not verified", transactionId);
+        return false;
+    }
+
+    TapMetrics::setGauge(TapMetrics::VerifyPending, _pending);
+    return true;
+}
+
+void ResponseAuditor::recordFailure(const QString &transactionId, const QByteArray &data, const QByteArray &signature)
+{
+    Record record;
+    record.timeMs = QDateTime::currentMSecsSinceEpoch();
+    record.transactionId = transactionId;
+    record.data = data;
+    record.signature = signature;
+    addFailure(record);
+}
+
+QVector<ResponseAuditor::Record> ResponseAuditor::failures() const
+{
+    QMutexLocker lock(&_failuresMutex);
+    return _failures;
+}
+
+void ResponseAuditor::addFailure(const Record &record)
+{
+    TapMetrics::increment(TapMetrics::VerifyFailures);
+    LOG_ERROR("Response signature of transaction {} did not verify, data: {}", record.transactionId, record.data);
+
+    QMutexLocker lock(&_failuresMutex);
+    if (_failures.size() >= MAX_FAILURES)
+        _failures.remove(0);
+    _failures.append(record);
+}
+
+void ResponseAuditor::run()
+{
+    // Drains the queue after close() so no received response goes unchecked
+    Record record;
+    while (_queue.pop(record))
+    {
+        QElapsedTimer timer;
+        timer.start();
+        bool valid = _verifier->verifySignature(record.data, record.signature);
+        TapMetrics::record(TapMetrics::VerifySignature, timer.nsecsElapsed() / 1000);
+        TapMetrics::setGauge(TapMetrics::VerifyPending, --_pending);
+
+        if (!valid)
+            addFailure(record);
+    }
+}
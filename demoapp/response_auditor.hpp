@@ -0,0 +1,75 @@
+/*******************************************************************************
+ * Response Auditor - response signature verification off the critical path
+ *
+ *   send stage ──tryPush──> queue ──> audit thread: verifySignature()
+ *                                          │ failure
+ *                                          └──> failure log + alarm metric
+ *
+ * The tap result is shown as soon as the response is parsed; the signature is
+ * checked afterwards. A failure cannot undo that tap, so it is kept in a
+ * bounded failure log, logged as an error and counted in
+ * demoapp_signature_verify_failures_total for alerting. Deployments that must
+ * reject unverified responses set [Certificate] verifyMode=blocking instead.
+ *******************************************************************************/
+
+#ifndef RESPONSE_AUDITOR_HPP
+#define RESPONSE_AUDITOR_HPP
+
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <thread>
+#include "bounded_queue.hpp"
+#include "signature_helper.hpp"
+
+class ResponseAuditor
+{
+public:
+    // A received response, queued for verification or kept as a failure
+    struct Record
+    {
+        qint64 timeMs = 0; // Epoch ms the response was received
+        QString transactionId;
+        QByteArray data;      // Signed "data" object, as received
+        QByteArray signature; // Base64
+    };
+
+    // verifier must outlive the auditor
+    explicit ResponseAuditor(SignatureHelper *verifier);
+    ~ResponseAuditor();
+
+    // Responses beyond queueDepth waiting for verification are dropped
+    void start(int queueDepth);
+
+    // Verifies what is still queued, then joins the audit thread
+    void stop();
+
+    // Never blocks the caller. Returns false if the response was dropped
+    // because the queue is full or the auditor is not running.
+    bool submit(const QString &transactionId, const QByteArray &data, const QByteArray &signature);
+
+    // For blocking verification done by the caller, same log and alarm
+    void recordFailure(const QString &transactionId, const QByteArray &data, const QByteArray &signature);
+
+    // Most recent failures, oldest first
+    QVector<Record> failures() const;
+
+private:
+    static const int MAX_FAILURES = 64;
+
+    void run();
+    void addFailure(const Record &record);
+
+    SignatureHelper *_verifier;
+    BoundedQueue<Record> _queue;
+    std::thread _thread;
+    std::atomic<bool> _running;
+    std::atomic<int> _pending;
+
+    mutable QMutex _failuresMutex;
+    QVector<Record> _failures;
+};
+
+#endif // RESPONSE_AUDITOR_HPP
@@ -0,0 +1,453 @@
+/*******************************************************************************
+ * Response Parser Implementation
+ *******************************************************************************/
+
+#include "response_parser.hpp"
+#include <cstring>
+
+// A typical signed tap response, grown past only by batches
+static const int INITIAL_CAPACITY = 4096;
+
+static inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static inline bool isLiteralChar(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '-' || c == '+' ||
+           c == '.';
+}
+
+static inline int hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+ResponseParser::ResponseParser()
+{
+    reset();
+}
+
+void ResponseParser::reset()
+{
+    // resize() keeps a reserved capacity, clear() would free it
+    _body.resize(0);
+    _state = ExpectValue;
+    _depth = 0;
+    _stringRole = Other;
+    _key.resize(0);
+    _unicode = 0;
+    _unicodeDigits = 0;
+    _highSurrogate = 0;
+    _isObject = false;
+    _dataStart = -1;
+    _dataEnd = -1;
+    _signature.resize(0);
+    _dataFields = Fields();
+    _results.resize(0);
+    _hasResults = false;
+}
+
+bool ResponseParser::feed(const char *chunk, int size)
+{
+    // Reserved once, reset() keeps it from then on
+    int from = _body.size();
+    if (from == 0 && _body.capacity() < INITIAL_CAPACITY)
+        _body.reserve(INITIAL_CAPACITY);
+    _body.append(chunk, size);
+    scan(from);
+    return _state != Error;
+}
+
+bool ResponseParser::parse(const QByteArray &body)
+{
+    reset();
+    _body = body;
+    scan(0);
+    return _state != Error;
+}
+
+QByteArray ResponseParser::span(int start, int end) const
+{
+    if (start < 0 || end <= start || end > _body.size())
+        return QByteArray();
+    return QByteArray::fromRawData(_body.constData() + start, end - start);
+}
+
+// Role of the value starting now, from its parent and key
+ResponseParser::Role ResponseParser::roleOf(bool isObject) const
+{
+    if (_depth == 0)
+        return isObject ? Root : Other;
+
+    const Frame &parent = _stack[_depth - 1];
+    if (!parent.isObject)
+        return parent.role == Results && isObject ? Item : Other;
+
+    switch (parent.role)
+    {
+    case Root:
+        if (_key == "data")
+            return isObject ? Data : Other;
+        if (_key == "signature")
+            return isObject ? Other : Signature;
+        return Other;
+    case Data:
+    case Item:
+        if (parent.role == Data && _key == "results")
+            return isObject ? Other : Results;
+        if (_key == "fareMediaTap")
+            return isObject ? FareMediaTap : Other;
+        if (isObject)
+            return Other;
+        if (_key == "status")
+            return Status;
+        if (_key == "statusCode")
+            return StatusCode;
+        if (_key == "message")
+            return Message;
+        if (_key == "transactionId")
+            return TransactionId;
+        return Other;
+    default:
+        return Other;
+    }
+}
+
+// Where the string being read goes, null to skip it
+QByteArray *ResponseParser::target()
+{
+    if (_stringRole == KeyName)
+        return &_key;
+    if (_stringRole == Signature)
+        return &_signature;
+    if (_stringRole == Other || _depth == 0)
+        return nullptr;
+
+    Fields *fields = _stack[_depth - 1].role == Item ? &_results.last() : &_dataFields;
+    switch (_stringRole)
+    {
+    case Status:
+        return &fields->status;
+    case StatusCode:
+        return &fields->statusCode;
+    case Message:
+        return &fields->message;
+    case TransactionId:
+        return &fields->transactionId;
+    default:
+        return nullptr;
+    }
+}
+
+void ResponseParser::appendUtf8(uint code)
+{
+    QByteArray *out = target();
+    if (!out)
+        return;
+
+    char bytes[4];
+    int length;
+    if (code < 0x80)
+    {
+        bytes[0] = (char)code;
+        length = 1;
+    }
+    else if (code < 0x800)
+    {
+        bytes[0] = (char)(0xC0 | (code >> 6));
+        bytes[1] = (char)(0x80 | (code & 0x3F));
+        length = 2;
+    }
+    else if (code < 0x10000)
+    {
+        bytes[0] = (char)(0xE0 | (code >> 12));
+        bytes[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+        bytes[2] = (char)(0x80 | (code & 0x3F));
+        length = 3;
+    }
+    else
+    {
+        bytes[0] = (char)(0xF0 | (code >> 18));
+        bytes[1] = (char)(0x80 | ((code >> 12) & 0x3F));
+        bytes[2] = (char)(0x80 | ((code >> 6) & 0x3F));
+        bytes[3] = (char)(0x80 | (code & 0x3F));
+        length = 4;
+    }
+    out->append(bytes, length);
+}
+
+// A high surrogate whose low half did not follow becomes U+FFFD
+void ResponseParser::flushSurrogate()
+{
+    if (!_highSurrogate)
+        return;
+    _highSurrogate = 0;
+    appendUtf8(0xFFFD);
+}
+
+bool ResponseParser::beginValue(char c, int offset)
+{
+    if (c == '{' || c == '[')
+    {
+        if (_depth == MAX_DEPTH)
+            return false;
+
+        bool isObject = c == '{';
+        Frame &frame = _stack[_depth];
+        frame.isObject = isObject;
+        frame.role = roleOf(isObject);
+        frame.start = offset;
+        if (frame.role == Root)
+        {
+            _isObject = true;
+        }
+        else if (frame.role == Data)
+        {
+            _dataStart = offset;
+        }
+        else if (frame.role == Results)
+        {
+            _hasResults = true;
+            _results.resize(0);
+        }
+        else if (frame.role == Item)
+        {
+            _results.append(Fields());
+        }
+        _depth++;
+        _state = isObject ? ExpectFirstKey : ExpectFirstValue;
+        return true;
+    }
+
+    if (c == '"')
+    {
+        _stringRole = roleOf(false);
+        QByteArray *out = target();
+        if (out)
+            out->resize(0);
+        _highSurrogate = 0;
+        _state = InString;
+        return true;
+    }
+
+    // Numbers, true, false and null are skipped, not checked
+    if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n')
+    {
+        _state = InLiteral;
+        return true;
+    }
+    return false;
+}
+
+void ResponseParser::endValue()
+{
+    _state = _depth == 0 ? Done : ExpectCommaOrEnd;
+}
+
+void ResponseParser::endContainer(int offset)
+{
+    const Frame &frame = _stack[--_depth];
+    if (frame.role == Data)
+    {
+        _dataEnd = offset + 1;
+    }
+    else if (frame.role == FareMediaTap)
+    {
+        Fields &fields = _stack[_depth - 1].role == Item ? _results.last() : _dataFields;
+        fields.fareMediaTapStart = frame.start;
+        fields.fareMediaTapEnd = offset + 1;
+    }
+    endValue();
+}
+
+void ResponseParser::scan(int from)
+{
+    const char *p = _body.constData();
+    int size = _body.size();
+    for (int i = from; i < size; i++)
+    {
+        char c = p[i];
+        switch (_state)
+        {
+        case InString:
+        {
+            // Anything but the next \u escape ends a pending surrogate pair
+            if (c != '\\')
+                flushSurrogate();
+
+            // Plain runs are copied (or skipped) whole
+            int end = i;
+            while (end < size && p[end] != '"' && p[end] != '\\' && (uchar)p[end] >= 0x20)
+                end++;
+            if (end > i)
+            {
+                QByteArray *out = target();
+                if (out)
+                    out->append(p + i, end - i);
+                i = end - 1;
+                continue;
+            }
+            if (c == '"')
+            {
+                if (_stringRole == KeyName)
+                    _state = ExpectColon;
+                else
+                    endValue();
+            }
+            else if (c == '\\')
+            {
+                _state = InEscape;
+            }
+            else
+            {
+                _state = Error; // Unescaped control character
+            }
+            break;
+        }
+
+        case InEscape:
+        {
+            char decoded = 0;
+            switch (c)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                decoded = c;
+                break;
+            case 'b':
+                decoded = '\b';
+                break;
+            case 'f':
+                decoded = '\f';
+                break;
+            case 'n':
+                decoded = '\n';
+                break;
+            case 'r':
+                decoded = '\r';
+                break;
+            case 't':
+                decoded = '\t';
+                break;
+            case 'u':
+                _unicode = 0;
+                _unicodeDigits = 0;
+                _state = InUnicode;
+                continue;
+            default:
+                _state = Error;
+                continue;
+            }
+            flushSurrogate();
+            QByteArray *out = target();
+            if (out)
+                out->append(decoded);
+            _state = InString;
+            break;
+        }
+
+        case InUnicode:
+        {
+            int digit = hexValue(c);
+            if (digit < 0)
+            {
+                _state = Error;
+                break;
+            }
+            _unicode = (_unicode << 4) | (uint)digit;
+            if (++_unicodeDigits < 4)
+                break;
+
+            _state = InString;
+            if (_unicode >= 0xD800 && _unicode < 0xDC00)
+            {
+                // High surrogate, its pair follows as another \u escape
+                flushSurrogate();
+                _highSurrogate = _unicode;
+                break;
+            }
+            if (_unicode >= 0xDC00 && _unicode < 0xE000 && _highSurrogate)
+            {
+                appendUtf8(0x10000 + ((_highSurrogate - 0xD800) << 10) + (_unicode - 0xDC00));
+                _highSurrogate = 0;
+                break;
+            }
+            flushSurrogate();
+            appendUtf8(_unicode >= 0xD800 && _unicode < 0xE000 ? 0xFFFD : _unicode);
+            break;
+        }
+
+        case InLiteral:
+            if (isLiteralChar(c))
+                break;
+            // The character after the literal belongs to the container
+            endValue();
+            i--;
+            break;
+
+        case ExpectValue:
+        case ExpectFirstValue:
+            if (isSpace(c))
+                break;
+            if (_state == ExpectFirstValue && c == ']')
+                endContainer(i);
+            else if (!beginValue(c, i))
+                _state = Error;
+            break;
+
+        case ExpectFirstKey:
+        case ExpectKey:
+            if (isSpace(c))
+                break;
+            if (c == '"')
+            {
+                _key.resize(0);
+                _highSurrogate = 0;
+                _stringRole = KeyName;
+                _state = InString;
+            }
+            else if (_state == ExpectFirstKey && c == '}')
+            {
+                endContainer(i);
+            }
+            else
+            {
+                _state = Error;
+            }
+            break;
+
+        case ExpectColon:
+            if (isSpace(c))
+                break;
+            _state = c == ':' ? ExpectValue : Error;
+            break;
+
+        case ExpectCommaOrEnd:
+        {
+            if (isSpace(c))
+                break;
+            bool inObject = _stack[_depth - 1].isObject;
+            if (c == ',')
+                _state = inObject ? ExpectKey : ExpectValue;
+            else if (c == (inObject ? '}' : ']'))
+                endContainer(i);
+            else
+                _state = Error;
+            break;
+        }
+
+        case Done:
+        case Error:
+            return;
+        }
+    }
+}
@@ -0,0 +1,152 @@
+/*******************************************************************************
+ * Response Parser - single-pass JSON scan of API responses, fed per chunk
+ *
+ *   curl write callback ──feed(chunk)──> body buffer + state machine
+ *                                          ├─> "data" byte span (signed text)
+ *                                          ├─> "signature"
+ *                                          └─> status, statusCode, message,
+ *                                              transactionId, fareMediaTap span
+ *
+ * Works on the UTF-8 bytes as they arrive, each byte is looked at once. The
+ * span of the "data" value is kept as offsets into the body, so the signature
+ * is checked against exactly the bytes the server sent. Only the few string
+ * fields above are copied out (unescaped). Batch responses carry the fields
+ * per element of "data"."results" instead.
+ *
+ * Anything after the top-level object (chunked encoding leftovers) is ignored.
+ * The buffer is kept between responses, reset() only rewinds it.
+ *******************************************************************************/
+
+#ifndef RESPONSE_PARSER_HPP
+#define RESPONSE_PARSER_HPP
+
+#include <QByteArray>
+#include <QVector>
+
+class ResponseParser
+{
+public:
+    // Fields of one tap result, the data object or a batch element
+    struct Fields
+    {
+        QByteArray status;
+        QByteArray statusCode;
+        QByteArray message;
+        QByteArray transactionId;
+        int fareMediaTapStart = -1; // Byte span of the fareMediaTap value
+        int fareMediaTapEnd = -1;
+    };
+
+    ResponseParser();
+
+    // Forgets the previous response, keeps the buffer's capacity
+    void reset();
+
+    // Appends a chunk and scans it. Returns false once the body is not
+    // valid JSON; further chunks are still stored.
+    bool feed(const char *chunk, int size);
+
+    // Scans a complete body, sharing its data instead of copying it
+    bool parse(const QByteArray &body);
+
+    // The top-level value was closed
+    bool isComplete() const { return _state == Done; }
+    // The top-level value is an object
+    bool isObject() const { return _isObject; }
+    bool hasError() const { return _state == Error; }
+
+    const QByteArray &body() const { return _body; }
+
+    // The "data" value as sent, without a copy; empty when there was none.
+    // Valid until the next reset(), feed() or parse().
+    QByteArray data() const { return span(_dataStart, _dataEnd); }
+    const QByteArray &signature() const { return _signature; }
+
+    // Fields found directly in "data"
+    const Fields &dataFields() const { return _dataFields; }
+
+    // Batch responses: one entry per object in "data"."results", in order.
+    // hasResults() tells an empty list from a missing one.
+    bool hasResults() const { return _hasResults; }
+    const QVector<Fields> &results() const { return _results; }
+
+    // The fareMediaTap object of fields, without a copy
+    QByteArray fareMediaTap(const Fields &fields) const
+    {
+        return span(fields.fareMediaTapStart, fields.fareMediaTapEnd);
+    }
+
+private:
+    enum State
+    {
+        ExpectValue,
+        ExpectFirstKey, // After '{': a key or '}'
+        ExpectKey,      // After ',' in an object
+        ExpectColon,
+        ExpectFirstValue, // After '[': a value or ']'
+        ExpectCommaOrEnd,
+        InString,
+        InEscape,
+        InUnicode,
+        InLiteral,
+        Done,
+        Error
+    };
+
+    // What a container or string is, by where it sits in the response
+    enum Role
+    {
+        Other,
+        Root,
+        Data,
+        Results,
+        Item,
+        FareMediaTap,
+        KeyName,
+        Signature,
+        Status,
+        StatusCode,
+        Message,
+        TransactionId
+    };
+
+    struct Frame
+    {
+        bool isObject;
+        Role role;
+        int start; // Offset of the opening bracket
+    };
+
+    static const int MAX_DEPTH = 32;
+
+    void scan(int from);
+    bool beginValue(char c, int offset);
+    void endValue();
+    void endContainer(int offset);
+    Role roleOf(bool isObject) const;
+    QByteArray *target();
+    void appendUtf8(uint code);
+    void flushSurrogate();
+    QByteArray span(int start, int end) const;
+
+    QByteArray _body;
+    State _state;
+    Frame _stack[MAX_DEPTH];
+    int _depth;
+
+    Role _stringRole;     // Of the string being read
+    QByteArray _key;      // Last key read, unescaped
+    uint _unicode;        // \uXXXX being read
+    int _unicodeDigits;
+    uint _highSurrogate;  // Of a pair, 0 if none pending
+
+    bool _isObject;
+    int _dataStart;
+    int _dataEnd;
+    QByteArray _signature;
+    Fields _dataFields;
+    QVector<Fields> _results;
+    bool _hasResults;
+};
+
+#endif // RESPONSE_PARSER_HPP
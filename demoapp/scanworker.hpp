@@ -2,34 +2,90 @@
 #define SCANWORKER_HPP
 
 #include <QObject>
+#include <QSemaphore>
 #include <QThread>
+#include <atomic>
 #include "card_reader.hpp"
+#include "spsc_queue.hpp"
 
+// Owns the CardReader (and through it the coupler) and runs the scan loop on
+// a dedicated, long-lived reader thread. Cards go to a single consumer through
+// a lock-free queue; the semaphores only count free and used slots.
 class ScanWorker : public QObject
 {
     Q_OBJECT
 public:
-    explicit ScanWorker(CardReader *reader, QObject *parent = nullptr)
-        : QObject(parent), reader(reader) {}
-    CardReader *reader;
-    bool stopRequested = false;
+    explicit ScanWorker(int queueDepth, QObject *parent = nullptr)
+        : QObject(parent), _queue(qMax(1, queueDepth)), _free(qMax(1, queueDepth)),
+          _used(0), _stopRequested(false)
+    {
+        qRegisterMetaType<CardReader::CardData>("CardReader::CardData");
+    }
+
+    CardReader *reader() { return &_reader; }
+
+    // Consumer side: blocks until a card was read or the worker is stopped
+    bool takeCard(CardReader::CardData &card)
+    {
+        _used.acquire();
+        if (_stopRequested || !_queue.pop(card))
+        {
+            // Keep the wake-up for any later call
+            _used.release();
+            return false;
+        }
+        _free.release();
+        return true;
+    }
+
+    // Thread-safe, returns immediately. The scan loop exits at its next poll.
+    void stop()
+    {
+        _stopRequested = true;
+        _reader.requestStop();
+        _free.release();
+        _used.release();
+    }
+
+    bool isStopping() const { return _stopRequested; }
 
 public slots:
     void startScanning()
     {
-        while (!stopRequested)
+        _reader.clearStopRequest();
+
+        while (!_stopRequested)
         {
-            CardReader::CardData data = reader->scanCard(5);
-            if (data.success)
-                emit cardDetected(data);
-            QThread::msleep(200);
+            // A failed card is not read again until it leaves the field, so
+            // this does not spin on a bad card left on the reader
+            CardReader::CardData data = _reader.scanCard(SCAN_TIMEOUT_SECONDS);
+            if (!data.success)
+                continue;
+
+            // Back-pressure: wait for the consumer to free a slot
+            _free.acquire();
+            if (_stopRequested || !_queue.push(data))
+                break;
+            _used.release();
+            emit cardDetected(data);
         }
+
+        emit finished();
     }
-    void stop() { stopRequested = true; }
 
 signals:
     void cardDetected(CardReader::CardData cardData);
     void scanProgress(QString message);
+    void finished();
+
+private:
+    CardReader _reader;
+    SpscQueue<CardReader::CardData> _queue;
+    QSemaphore _free;
+    QSemaphore _used;
+    std::atomic<bool> _stopRequested;
+
+    static const unsigned int SCAN_TIMEOUT_SECONDS = 30;
 };
 
 #endif // SCANWORKER_HPP
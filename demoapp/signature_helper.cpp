@@ -1,26 +1,140 @@
 #include "signature_helper.hpp"
+#include "codec.hpp"
+#include "log.hpp"
 #include <QFile>
 #include <QDebug>
 #include <openssl/sha.h>
 #include <openssl/bio.h>
-#include <openssl/buffer.h>
+#include <openssl/ec.h>
+#include <openssl/objects.h>
 #include <openssl/x509.h>
 #include <cstring>
 
-EVP_PKEY *privateKey;
-EVP_PKEY *publicKey;
-SignatureHelper::SignatureHelper() : privateKey(nullptr), publicKey(nullptr)
+// Ed25519 arrived in OpenSSL 1.1.1
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+#define SIGNATURE_HAVE_ED25519 1
+#endif
+
+namespace
+{
+    // Scratch contexts of the calling thread, templates are copied into these
+    struct ThreadContexts
+    {
+        EVP_MD_CTX *sign;
+        EVP_MD_CTX *verify;
+
+        ThreadContexts() : sign(EVP_MD_CTX_new()), verify(EVP_MD_CTX_new()) {}
+        ~ThreadContexts()
+        {
+            EVP_MD_CTX_free(sign);
+            EVP_MD_CTX_free(verify);
+        }
+    };
+
+    thread_local ThreadContexts threadContexts;
+}
+
+SignatureHelper::SignatureHelper()
+    : privateKey(nullptr), publicKey(nullptr), _signScheme(SchemeNone), _verifyScheme(SchemeNone),
+      _signTemplate(nullptr), _verifyTemplate(nullptr), _maxSignatureSize(0)
 {
 }
 
 SignatureHelper::~SignatureHelper()
 {
+    EVP_MD_CTX_free(_signTemplate);
+    EVP_MD_CTX_free(_verifyTemplate);
     if (privateKey)
         EVP_PKEY_free(privateKey);
     if (publicKey)
         EVP_PKEY_free(publicKey);
 }
 
+SignatureHelper::Scheme SignatureHelper::parseScheme(const QString &algorithm)
+{
+    if (algorithm.compare("SHA1withRSA", Qt::CaseInsensitive) == 0)
+        return Sha1WithRsa;
+    if (algorithm.compare("SHA256withRSA", Qt::CaseInsensitive) == 0)
+        return Sha256WithRsa;
+    if (algorithm.compare("SHA256withECDSA", Qt::CaseInsensitive) == 0)
+        return Sha256WithEcdsa;
+#ifdef SIGNATURE_HAVE_ED25519
+    if (algorithm.compare("Ed25519", Qt::CaseInsensitive) == 0)
+        return Ed25519;
+#endif
+    return SchemeNone;
+}
+
+const char *SignatureHelper::schemeName(Scheme scheme)
+{
+    switch (scheme)
+    {
+    case Sha1WithRsa:
+        return "SHA1withRSA";
+    case Sha256WithRsa:
+        return "SHA256withRSA";
+    case Sha256WithEcdsa:
+        return "SHA256withECDSA";
+    case Ed25519:
+        return "Ed25519";
+    default:
+        return "none";
+    }
+}
+
+// ES256 is P-256 only, other 256-bit curves (secp256k1, brainpoolP256r1) do
+// not qualify
+static bool isP256(EVP_PKEY *key)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    char group[64];
+    size_t length = 0;
+    return EVP_PKEY_get_group_name(key, group, sizeof(group), &length) == 1 &&
+           OBJ_sn2nid(group) == NID_X9_62_prime256v1;
+#else
+    const EC_KEY *ec = EVP_PKEY_get0_EC_KEY(key);
+    return ec && EC_GROUP_get_curve_name(EC_KEY_get0_group(ec)) == NID_X9_62_prime256v1;
+#endif
+}
+
+bool SignatureHelper::keyMatchesScheme(EVP_PKEY *key, Scheme scheme)
+{
+    switch (scheme)
+    {
+    case Sha1WithRsa:
+    case Sha256WithRsa:
+        return EVP_PKEY_base_id(key) == EVP_PKEY_RSA;
+    case Sha256WithEcdsa:
+        return EVP_PKEY_base_id(key) == EVP_PKEY_EC && isP256(key);
+#ifdef SIGNATURE_HAVE_ED25519
+    case Ed25519:
+        return EVP_PKEY_base_id(key) == EVP_PKEY_ED25519;
+#endif
+    default:
+        return false;
+    }
+}
+
+// Digest and key bound once, calls copy the result instead of initializing
+EVP_MD_CTX *SignatureHelper::createTemplate(EVP_PKEY *key, Scheme scheme, bool sign)
+{
+    const EVP_MD *md = scheme == Sha1WithRsa ? EVP_sha1() : EVP_sha256();
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    EVP_PKEY_CTX *pctx = nullptr;
+    int ok = sign ? EVP_DigestSignInit(ctx, &pctx, md, nullptr, key)
+                  : EVP_DigestVerifyInit(ctx, &pctx, md, nullptr, key);
+    if (ok == 1 && (scheme == Sha1WithRsa || scheme == Sha256WithRsa))
+        ok = EVP_PKEY_CTX_set_rsa_padding(pctx, RSA_PKCS1_PADDING);
+
+    if (ok != 1)
+    {
+        qDebug() << "Failed to set up" << schemeName(scheme) << (sign ? "signing" : "verifying") << "context";
+        EVP_MD_CTX_free(ctx);
+        return nullptr;
+    }
+    return ctx;
+}
+
 EVP_PKEY *SignatureHelper::loadPKCS12(const QString &pfxPath, const QString &password)
 {
     QFile file(pfxPath);
@@ -97,213 +211,221 @@ EVP_PKEY *SignatureHelper::loadPublicKeyFromPEM(const QString &pemPath)
     return pkey;
 }
 
-bool SignatureHelper::loadPrivateCertificate(const QString &pfxPath, const QString &password)
+bool SignatureHelper::loadPrivateCertificate(const QString &pfxPath, const QString &password,
+                                             const QString &algorithm)
 {
+    Scheme scheme = parseScheme(algorithm);
+    if (scheme == SchemeNone)
+    {
+        qDebug() << "Unsupported signing algorithm:" << algorithm;
+        return false;
+    }
+
     EVP_PKEY *pkey = loadPKCS12(pfxPath, password);
     if (!pkey)
     {
         qDebug() << "Failed to load private certificate";
         return false;
     }
+    if (!keyMatchesScheme(pkey, scheme))
+    {
+        qDebug() << "Private key does not fit" << algorithm;
+        EVP_PKEY_free(pkey);
+        return false;
+    }
+
+    EVP_MD_CTX *ctx = nullptr;
+    if (scheme != Ed25519 && !(ctx = createTemplate(pkey, scheme, true)))
+    {
+        EVP_PKEY_free(pkey);
+        return false;
+    }
+
+    EVP_MD_CTX_free(_signTemplate);
     if (privateKey)
         EVP_PKEY_free(privateKey);
     privateKey = pkey;
-    qDebug() << "Private certificate loaded successfully";
+    _signTemplate = ctx;
+    _signScheme = scheme;
+    _maxSignatureSize = EVP_PKEY_size(pkey);
+    qDebug() << "Private certificate loaded successfully," << schemeName(scheme);
     return true;
 }
 
-bool SignatureHelper::loadPublicCertificate(const QString &pemPath)
+bool SignatureHelper::loadPublicCertificate(const QString &pemPath, const QString &algorithm)
 {
+    Scheme scheme = parseScheme(algorithm);
+    if (scheme == SchemeNone)
+    {
+        qDebug() << "Unsupported verification algorithm:" << algorithm;
+        return false;
+    }
+
     EVP_PKEY *pkey = loadPublicKeyFromPEM(pemPath);
     if (!pkey)
     {
         qDebug() << "Failed to load public certificate";
         return false;
     }
+    if (!keyMatchesScheme(pkey, scheme))
+    {
+        qDebug() << "Public key does not fit" << algorithm;
+        EVP_PKEY_free(pkey);
+        return false;
+    }
+
+    EVP_MD_CTX *ctx = nullptr;
+    if (scheme != Ed25519 && !(ctx = createTemplate(pkey, scheme, false)))
+    {
+        EVP_PKEY_free(pkey);
+        return false;
+    }
 
+    EVP_MD_CTX_free(_verifyTemplate);
     if (publicKey)
         EVP_PKEY_free(publicKey);
 
     publicKey = pkey;
-    qDebug() << "Public certificate loaded successfully";
+    _verifyTemplate = ctx;
+    _verifyScheme = scheme;
+    qDebug() << "Public certificate loaded successfully," << schemeName(scheme);
     return true;
 }
 
-QString SignatureHelper::toBase64(const unsigned char *data, int length)
+QByteArray SignatureHelper::toBase64(const unsigned char *data, int length)
 {
-    BIO *b64 = BIO_new(BIO_f_base64());
-    BIO *bio = BIO_new(BIO_s_mem());
-    bio = BIO_push(b64, bio);
-
-    BIO_set_flags(bio, BIO_FLAGS_BASE64_NO_NL);
-    BIO_write(bio, data, length);
-    BIO_flush(bio);
-
-    BUF_MEM *bufferPtr;
-    BIO_get_mem_ptr(bio, &bufferPtr);
-
-    QString result = QString::fromLatin1(bufferPtr->data, bufferPtr->length);
-    BIO_free_all(bio);
-
-    return result;
+    QByteArray encoded(Codec::base64Length(length), Qt::Uninitialized);
+    Codec::toBase64(data, length, encoded.data());
+    return encoded;
 }
 
-QByteArray SignatureHelper::fromBase64(const QString &base64)
+QByteArray SignatureHelper::fromBase64(const QByteArray &input)
 {
-    QByteArray input = base64.toLatin1();
-
-    BIO *b64 = BIO_new(BIO_f_base64());
-    BIO *bio = BIO_new_mem_buf(input.data(), input.length());
-    bio = BIO_push(b64, bio);
-
-    BIO_set_flags(bio, BIO_FLAGS_BASE64_NO_NL);
+    QByteArray output(Codec::base64DecodedMaxLength(input.size()), Qt::Uninitialized);
 
-    QByteArray output;
-    output.resize(input.length());
-
-    int decodedLength = BIO_read(bio, output.data(), output.size());
-    BIO_free_all(bio);
-
-    output.resize(decodedLength);
+    // Line breaks and spaces are skipped, anything else invalid gives an empty result
+    int decodedLength = Codec::fromBase64(input.constData(), input.size(), (uint8_t *)output.data());
+    output.resize(qMax(0, decodedLength));
     return output;
 }
 
-QString SignatureHelper::signData(const QString &data, const QString &algorithm)
+QString SignatureHelper::signData(const QString &data)
 {
-    if (!privateKey)
-    {
-        qDebug() << "Private key not loaded";
-        return QString();
-    }
+    return QString::fromLatin1(signData(data.toUtf8()));
+}
 
-    // Determine the digest algorithm
-    const EVP_MD *md = nullptr;
-    if (algorithm.compare("SHA1withRSA", Qt::CaseInsensitive) == 0)
-        md = EVP_sha1();
-    else if (algorithm.compare("SHA256withRSA", Qt::CaseInsensitive) == 0)
-        md = EVP_sha256();
-    else
+QByteArray SignatureHelper::signData(const QByteArray &dataBytes)
+{
+    if (!privateKey)
     {
-        qDebug() << "Unsupported signing algorithm:" << algorithm;
-        return QString();
+        LOG_ERROR("Private key not loaded");
+        return QByteArray();
     }
 
-    QByteArray dataBytes = data.toUtf8();
-    unsigned char *sig = nullptr;
-    size_t sigLen = 0;
-
-    EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
-    if (!mdctx)
-    {
-        qDebug() << "EVP_MD_CTX_new failed";
-        return QString();
-    }
+    EVP_MD_CTX *mdctx = threadContexts.sign;
 
-    if (EVP_DigestSignInit(mdctx, nullptr, md, nullptr, privateKey) != 1)
+    // RSA-4096 and smaller sign into the stack
+    unsigned char stackSig[512];
+    QByteArray heapSig;
+    unsigned char *sig = stackSig;
+    if (_maxSignatureSize > sizeof(stackSig))
     {
-        qDebug() << "EVP_DigestSignInit failed";
-        EVP_MD_CTX_free(mdctx);
-        return QString();
+        heapSig.resize((int)_maxSignatureSize);
+        sig = (unsigned char *)heapSig.data();
     }
+    size_t sigLen = _maxSignatureSize;
 
-    if (EVP_DigestSignUpdate(mdctx, dataBytes.data(), dataBytes.size()) != 1)
+#ifdef SIGNATURE_HAVE_ED25519
+    if (_signScheme == Ed25519)
     {
-        qDebug() << "EVP_DigestSignUpdate failed";
-        EVP_MD_CTX_free(mdctx);
-        return QString();
+        // EdDSA hashes the message twice, it only signs in one shot and its
+        // context cannot be copied: reset and re-initialize the thread's
+        if (EVP_MD_CTX_reset(mdctx) != 1 || EVP_DigestSignInit(mdctx, nullptr, nullptr, nullptr, privateKey) != 1 ||
+            EVP_DigestSign(mdctx, sig, &sigLen, (const unsigned char *)dataBytes.constData(), dataBytes.size()) != 1)
+        {
+            LOG_ERROR("Ed25519 signing failed");
+            return QByteArray();
+        }
+        return toBase64(sig, (int)sigLen);
     }
+#endif
 
-    // Get required signature length
-    if (EVP_DigestSignFinal(mdctx, nullptr, &sigLen) != 1)
+    if (EVP_MD_CTX_copy_ex(mdctx, _signTemplate) != 1)
     {
-        qDebug() << "EVP_DigestSignFinal (length) failed";
-        EVP_MD_CTX_free(mdctx);
-        return QString();
+        LOG_ERROR("EVP_MD_CTX_copy_ex failed");
+        return QByteArray();
     }
 
-    sig = (unsigned char *)OPENSSL_malloc(sigLen);
-    if (!sig)
+    if (EVP_DigestSignUpdate(mdctx, dataBytes.constData(), dataBytes.size()) != 1)
     {
-        qDebug() << "OPENSSL_malloc failed";
-        EVP_MD_CTX_free(mdctx);
-        return QString();
+        LOG_ERROR("EVP_DigestSignUpdate failed");
+        return QByteArray();
     }
 
     if (EVP_DigestSignFinal(mdctx, sig, &sigLen) != 1)
     {
-        qDebug() << "EVP_DigestSignFinal failed";
-        OPENSSL_free(sig);
-        EVP_MD_CTX_free(mdctx);
-        return QString();
+        LOG_ERROR("EVP_DigestSignFinal failed");
+        return QByteArray();
     }
 
-    QString signature = toBase64(sig, (int)sigLen);
-
-    OPENSSL_free(sig);
-    EVP_MD_CTX_free(mdctx);
-
-    return signature;
+    return toBase64(sig, (int)sigLen);
 }
 
 bool SignatureHelper::verifySignature(const QString &data, const QString &signature)
+{
+    return verifySignature(data.toUtf8(), signature.toLatin1());
+}
+
+bool SignatureHelper::verifySignature(const QByteArray &dataBytes, const QByteArray &signature)
 {
     if (!publicKey)
     {
-        qDebug() << "Public key not loaded";
+        LOG_ERROR("Public key not loaded");
         return false;
     }
 
-    qDebug() << "=== RESPONSE SIGNATURE VERIFICATION DEBUG ===";
-    QByteArray dataBytes = data.toUtf8();
-    qDebug() << "Data bytes length:" << dataBytes.length();
-    qDebug() << "First 100 chars:" << data.left(100);
-    qDebug() << "Last 100 chars:" << data.right(100);
+    QByteArray sigBytes = fromBase64(signature);
+    LOG_TRACE("Verifying {} data bytes against a {} byte signature, first 100 chars: {}, last 100 chars: {}",
+              dataBytes.length(), sigBytes.size(), dataBytes.left(100), dataBytes.right(100));
 
-    // Clean Base64 signature
-    QString cleanSignature = signature;
-    cleanSignature.remove('\n').remove('\r').remove(' ');
-    QByteArray sigBytes = fromBase64(cleanSignature);
-    qDebug() << "Signature bytes length:" << sigBytes.size();
+    EVP_MD_CTX *mdctx = threadContexts.verify;
+    int ret;
 
-    EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
-    if (!mdctx)
+#ifdef SIGNATURE_HAVE_ED25519
+    if (_verifyScheme == Ed25519)
     {
-        qDebug() << "EVP_MD_CTX_new failed";
-        return false;
+        ret = EVP_MD_CTX_reset(mdctx) == 1 && EVP_DigestVerifyInit(mdctx, nullptr, nullptr, nullptr, publicKey) == 1
+                  ? EVP_DigestVerify(mdctx, (const unsigned char *)sigBytes.constData(), sigBytes.size(),
+                                     (const unsigned char *)dataBytes.constData(), dataBytes.size())
+                  : -1;
     }
-
-    EVP_PKEY_CTX *pctx = nullptr;
-    // Use SHA-1 because server signs with SHA1withRSA
-    if (EVP_DigestVerifyInit(mdctx, &pctx, EVP_sha1(), nullptr, publicKey) != 1)
-    {
-        qDebug() << "EVP_DigestVerifyInit failed";
-        EVP_MD_CTX_free(mdctx);
-        return false;
-    }
-
-    // Use PKCS#1 v1.5 padding (default for SHA1withRSA)
-    EVP_PKEY_CTX_set_rsa_padding(pctx, RSA_PKCS1_PADDING);
-
-    if (EVP_DigestVerifyUpdate(mdctx, dataBytes.data(), dataBytes.size()) != 1)
+    else
+#endif
     {
-        qDebug() << "EVP_DigestVerifyUpdate failed";
-        EVP_MD_CTX_free(mdctx);
-        return false;
+        if (EVP_MD_CTX_copy_ex(mdctx, _verifyTemplate) != 1)
+        {
+            LOG_ERROR("EVP_MD_CTX_copy_ex failed");
+            return false;
+        }
+
+        if (EVP_DigestVerifyUpdate(mdctx, dataBytes.constData(), dataBytes.size()) != 1)
+        {
+            LOG_ERROR("EVP_DigestVerifyUpdate failed");
+            return false;
+        }
+
+        ret = EVP_DigestVerifyFinal(mdctx, (const unsigned char *)sigBytes.constData(), sigBytes.size());
     }
 
-    int ret = EVP_DigestVerifyFinal(mdctx, (const unsigned char *)sigBytes.data(), sigBytes.size());
-
     if (ret != 1)
     {
         unsigned long err = ERR_get_error();
         char errBuf[256];
         ERR_error_string_n(err, errBuf, sizeof(errBuf));
-        qDebug() << "EVP_DigestVerifyFinal failed with return code:" << ret;
-        qDebug() << "OpenSSL error:" << errBuf;
+        LOG_DEBUG("{} verification failed with return code {}: {}", schemeName(_verifyScheme), ret, errBuf);
     }
 
-    EVP_MD_CTX_free(mdctx);
-    qDebug() << "Signature verification result:" << (ret == 1 ? "VALID" : "INVALID");
+    LOG_DEBUG("Signature verification result: {}", ret == 1 ? "VALID" : "INVALID");
 
     return (ret == 1);
-}
\ No newline at end of file
+}
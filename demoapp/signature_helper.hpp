@@ -8,26 +8,60 @@
 #include <openssl/err.h>
 #include <openssl/pkcs12.h>
 
+// Signs requests and verifies responses with one scheme each, resolved when
+// the key is loaded. The digest and key setup is done once into a template
+// context; each call copies it into a context owned by the calling thread, so
+// signing and verifying are safe from any thread once the keys are loaded.
 class SignatureHelper
 {
 public:
+    enum Scheme
+    {
+        SchemeNone = 0,
+        Sha1WithRsa,     // "SHA1withRSA", PKCS#1 v1.5
+        Sha256WithRsa,   // "SHA256withRSA", PKCS#1 v1.5
+        Sha256WithEcdsa, // "SHA256withECDSA", P-256, DER signature
+        Ed25519          // "Ed25519", pure EdDSA
+    };
+
     SignatureHelper();
     ~SignatureHelper();
 
-    bool loadPrivateCertificate(const QString &pfxPath, const QString &password);
-    bool loadPublicCertificate(const QString &pfxPath);
+    // algorithm is a Java-style name as above, the key must match it
+    bool loadPrivateCertificate(const QString &pfxPath, const QString &password,
+                                const QString &algorithm = "SHA1withRSA");
+    bool loadPublicCertificate(const QString &pemPath, const QString &algorithm = "SHA1withRSA");
+
+    QString signData(const QString &data);
 
-    QString signData(const QString &data, const QString &algorithm);
+    // data is the UTF-8 text to sign, returns the base64 signature
+    QByteArray signData(const QByteArray &data);
     bool verifySignature(const QString &data, const QString &signature);
 
+    // As received: data is the signed UTF-8 text, signature its base64
+    bool verifySignature(const QByteArray &data, const QByteArray &signature);
+
+    Scheme signScheme() const { return _signScheme; }
+    Scheme verifyScheme() const { return _verifyScheme; }
+
+    static Scheme parseScheme(const QString &algorithm);
+    static const char *schemeName(Scheme scheme);
+
 private:
     EVP_PKEY *privateKey;
     EVP_PKEY *publicKey;
+    Scheme _signScheme;
+    Scheme _verifyScheme;
+    EVP_MD_CTX *_signTemplate;   // Null for Ed25519, which cannot be copied
+    EVP_MD_CTX *_verifyTemplate;
+    size_t _maxSignatureSize;
 
     EVP_PKEY *loadPKCS12(const QString &pfxPath, const QString &password);
     EVP_PKEY *loadPublicKeyFromPEM(const QString &pemPath);
-    QString toBase64(const unsigned char *data, int length);
-    QByteArray fromBase64(const QString &base64);
+    static bool keyMatchesScheme(EVP_PKEY *key, Scheme scheme);
+    static EVP_MD_CTX *createTemplate(EVP_PKEY *key, Scheme scheme, bool sign);
+    QByteArray toBase64(const unsigned char *data, int length);
+    QByteArray fromBase64(const QByteArray &base64);
 };
 
-#endif // SIGNATURE_HELPER_HPP
\ No newline at end of file
+#endif // SIGNATURE_HELPER_HPP
@@ -0,0 +1,715 @@
+/*******************************************************************************
+ * Simulated Coupler Implementation
+ *******************************************************************************/
+
+#include "simulated_coupler.hpp"
+#include "ultralight_reader.hpp"
+#include <QFile>
+#include <QSettings>
+#include <QStringList>
+#include <QDebug>
+#include <algorithm>
+#include <unistd.h>
+#include <cstring>
+
+static const char *COMMAND_KEYS[SimulatedCoupler::CmdCount] = {
+    "search", "loadKey", "authenticate", "readBlock", "exchange"};
+
+SimulatedCoupler::SimulatedCoupler()
+    : _current(0), _enterMs(0), _presence(0), _authPresence(0), _authSector(-1), _activatesIsoDep(true),
+      _exchangeByteUs(0), _tclByteUs(0), _divisorReceive(1), _divisorSend(1), _readyDelayMs(0), _loop(true), _open(false), _rng(1)
+{
+    for (int i = 0; i < CmdCount; i++)
+    {
+        _latencyUs[i] = 0;
+        _failureRate[i] = 0.0;
+    }
+}
+
+bool SimulatedCoupler::open()
+{
+    _clock.start();
+    _current = 0;
+    _enterMs = _cards.isEmpty() ? 0 : _cards[0].arrivalMs;
+    _presence = 1;
+    _authSector = -1;
+    _keySlots.clear();
+    _tcl = TclState();
+    _ats.clear();
+    _divisorReceive = _divisorSend = 1;
+    _open = true;
+
+    qDebug() << "Simulated coupler opened with" << _cards.size() << "scripted cards";
+    return true;
+}
+
+void SimulatedCoupler::close()
+{
+    _open = false;
+}
+
+bool SimulatedCoupler::loadScript(const QString &path)
+{
+    if (!QFile::exists(path))
+    {
+        qDebug() << "Simulator script not found:" << path;
+        return false;
+    }
+
+    QSettings settings(path, QSettings::IniFormat);
+
+    settings.beginGroup("Simulator");
+    _readyDelayMs = settings.value("readyDelayMs", 0).toInt();
+    _loop = settings.value("loop", true).toBool();
+    _activatesIsoDep = settings.value("activatesIsoDep", true).toBool();
+    _rng.seed(settings.value("seed", 1).toUInt());
+    settings.endGroup();
+
+    // Per-command RF latency in microseconds
+    settings.beginGroup("Latency");
+    for (int i = 0; i < CmdCount; i++)
+        _latencyUs[i] = settings.value(COMMAND_KEYS[i], 0).toUInt();
+    _exchangeByteUs = settings.value("exchangePerByte", 0).toUInt();
+    _tclByteUs = settings.value("tclPerByte", 0).toUInt();
+    settings.endGroup();
+
+    // Per-command probability of a transport error
+    settings.beginGroup("Failures");
+    for (int i = 0; i < CmdCount; i++)
+        _failureRate[i] = settings.value(COMMAND_KEYS[i], 0.0).toDouble();
+    settings.endGroup();
+
+    // Cards are played in the order of their [CardN] group number
+    QStringList groups;
+    foreach (const QString &group, settings.childGroups())
+    {
+        if (group.startsWith("Card"))
+            groups.append(group);
+    }
+    std::sort(groups.begin(), groups.end(), [](const QString &a, const QString &b)
+              { return a.mid(4).toInt() < b.mid(4).toInt(); });
+
+    _cards.clear();
+    foreach (const QString &group, groups)
+    {
+        settings.beginGroup(group);
+        Card card;
+        card.arrivalMs = settings.value("arrivalMs", 1000).toInt();
+        card.dwellMs = settings.value("dwellMs", 500).toInt();
+        card.com = (uint8_t)settings.value("com", 5).toUInt();
+        card.atr = QByteArray::fromHex(settings.value("atr").toString().toLatin1());
+        card.memory = QByteArray::fromHex(settings.value("memory").toString().toLatin1());
+        card.keyA = QByteArray::fromHex(settings.value("keyA", "FFFFFFFFFFFF").toString().toLatin1());
+        card.blockSize = settings.value("blockSize", 4).toInt();
+        card.blockCount = settings.value("blockCount", 28).toInt();
+        card.maxBlocksPerRead = settings.value("maxBlocksPerRead", 32).toInt();
+        card.ats = QByteArray::fromHex(settings.value("ats", "0575778102").toString().toLatin1());
+        card.aid = QByteArray::fromHex(settings.value("aid", "D2760000850101").toString().toLatin1());
+        card.wtx = settings.value("wtx", 0).toInt();
+        card.version = QByteArray::fromHex(settings.value("version").toString().toLatin1());
+        foreach (const QString &key, settings.childKeys())
+        {
+            // key<N>=<12 hex chars> overrides key A for sector N
+            bool ok = false;
+            int sector = key.startsWith("key") ? key.mid(3).toInt(&ok) : -1;
+            if (ok)
+                card.sectorKeys[sector] = QByteArray::fromHex(settings.value(key).toString().toLatin1());
+        }
+        settings.endGroup();
+
+        addCard(card);
+    }
+
+    qDebug() << "Simulator script loaded:" << path << "-" << _cards.size() << "cards";
+    return true;
+}
+
+void SimulatedCoupler::addCard(const Card &card)
+{
+    Card c = card;
+    if (c.memory.isEmpty())
+        fillDefaultMemory(c);
+    _cards.append(c);
+}
+
+void SimulatedCoupler::clearCards()
+{
+    _cards.clear();
+    _current = 0;
+}
+
+void SimulatedCoupler::setLatency(Command cmd, unsigned int microseconds)
+{
+    _latencyUs[cmd] = microseconds;
+}
+
+void SimulatedCoupler::setFailureRate(Command cmd, double probability)
+{
+    _failureRate[cmd] = probability;
+}
+
+bool SimulatedCoupler::setBitRate(int ds, int dr)
+{
+    _divisorReceive = qBound(1, ds, 8);
+    _divisorSend = qBound(1, dr, 8);
+    return true;
+}
+
+int SimulatedCoupler::sectorOfBlock(int block)
+{
+    // MIFARE Classic 4K: 32 sectors of 4 blocks, then 8 sectors of 16 blocks
+    return block < 128 ? block / 4 : 32 + (block - 128) / 16;
+}
+
+bool SimulatedCoupler::isUltralight(const Card &card) const
+{
+    return card.com == 5 && card.atr.size() > 1 && (uint8_t)card.atr[1] == 0x04;
+}
+
+QByteArray SimulatedCoupler::sectorKey(const Card &card, int sector) const
+{
+    return card.sectorKeys.value(sector, card.keyA);
+}
+
+void SimulatedCoupler::fillDefaultMemory(Card &card)
+{
+    if (card.com == 9)
+    {
+        card.memory.resize(card.blockSize * card.blockCount);
+        for (int i = 0; i < card.memory.size(); i++)
+            card.memory[i] = (char)(0x15 + i);
+        return;
+    }
+
+    if (card.com == 8)
+    {
+        card.memory.resize(600);
+        for (int i = 0; i < card.memory.size(); i++)
+            card.memory[i] = (char)(0x40 + i);
+        return;
+    }
+
+    if (card.com != 5 || card.atr.size() < 2)
+        return;
+
+    uint8_t sak = (uint8_t)card.atr[1];
+    int size = sak == 0x08 ? 1024 : sak == 0x09 ? 4096 : sak == 0x04 ? 64 : 0;
+    if (sak == 0x04 && card.version.size() >= 8)
+        size = qMax(4, UltralightReader::pagesForStorageSize((uint8_t)card.version[6])) * 4;
+    uint8_t seed = card.atr.isEmpty() ? 0 : (uint8_t)card.atr[0];
+
+    card.memory.resize(size);
+    for (int i = 0; i < size; i++)
+        card.memory[i] = (char)(seed + i);
+
+    if (sak == 0x04)
+        return;
+
+    // Sector trailers: key A, default access bits, key B
+    static const uint8_t ACCESS[4] = {0xFF, 0x07, 0x80, 0x69};
+    for (int block = 0; block * 16 < size; block++)
+    {
+        bool trailer = block < 128 ? (block % 4 == 3) : ((block - 128) % 16 == 15);
+        if (!trailer)
+            continue;
+
+        char *p = card.memory.data() + block * 16;
+        QByteArray key = card.sectorKeys.value(sectorOfBlock(block), card.keyA);
+        memset(p, 0xFF, 16);
+        memcpy(p, key.constData(), qMin(6, key.size()));
+        memcpy(p + 6, ACCESS, sizeof(ACCESS));
+    }
+}
+
+const SimulatedCoupler::Card *SimulatedCoupler::cardInField()
+{
+    qint64 now = _clock.elapsed();
+
+    while (_current < _cards.size())
+    {
+        const Card &card = _cards[_current];
+        qint64 leaveMs = _enterMs + card.dwellMs;
+
+        if (now < _enterMs)
+            return nullptr;
+        if (now < leaveMs)
+            return &card;
+
+        // Card has left the field, schedule the next one
+        _current++;
+        if (_current >= _cards.size())
+        {
+            if (!_loop)
+                return nullptr;
+            _current = 0;
+        }
+        _enterMs = leaveMs + _cards[_current].arrivalMs;
+        _presence++;
+    }
+
+    return nullptr;
+}
+
+bool SimulatedCoupler::simulate(Command cmd)
+{
+    if (_latencyUs[cmd] > 0)
+        usleep(_latencyUs[cmd]);
+
+    if (_failureRate[cmd] <= 0.0)
+        return true;
+
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    return dist(_rng) >= _failureRate[cmd];
+}
+
+bool SimulatedCoupler::doSearchCard(const CardSearchMask &mask, uint8_t forget, uint8_t timeout,
+                                    uint8_t *com, uint16_t *atrLen, uint8_t *atr)
+{
+    Q_UNUSED(mask);
+    Q_UNUSED(forget);
+
+    *com = COM_NO_CARD;
+    *atrLen = 0;
+    _ats.clear();
+
+    if (!_open || !simulate(CmdSearch))
+        return false;
+
+    // Coupler still booting
+    if (_clock.elapsed() < _readyDelayMs)
+        return false;
+
+    const Card *card = cardInField();
+    if (!card && timeout > 0)
+    {
+        // Timeout is in 10 ms units, wake up early if a card is due
+        qint64 deadline = _clock.elapsed() + timeout * 10;
+        qint64 wakeAt = _current < _cards.size() ? qMin(deadline, _enterMs) : deadline;
+        qint64 wait = wakeAt - _clock.elapsed();
+        if (wait > 0)
+            usleep(wait * 1000);
+        card = cardInField();
+    }
+
+    if (!card)
+        return true;
+
+    *com = card->com;
+    *atrLen = (uint16_t)card->atr.size();
+    memcpy(atr, card->atr.constData(), card->atr.size());
+    if (_activatesIsoDep && card->com == COM_ISO14443_4)
+        isoDepActivate(*card);
+    return true;
+}
+
+bool SimulatedCoupler::doLoadReaderKey(uint8_t keyIndex, const uint8_t *key, uint8_t *status)
+{
+    *status = 0xFF;
+    if (!_open || !simulate(CmdLoadKey))
+        return false;
+
+    _keySlots[keyIndex] = QByteArray((const char *)key, 6);
+    *status = 0;
+    return true;
+}
+
+bool SimulatedCoupler::doAuthenticate(uint8_t sector, uint8_t keyType, uint8_t keyIndex,
+                                      uint8_t *cardType, uint8_t *serialNumber, uint8_t *status)
+{
+    *status = 0xFF;
+    if (!_open || !simulate(CmdAuthenticate))
+        return false;
+
+    const Card *card = cardInField();
+    if (!card || isUltralight(*card) || card->com != 5)
+    {
+        _authSector = -1;
+        return true;
+    }
+
+    // Only key A is scripted, key B is left at the transport default
+    QByteArray expected = keyType == 0x0A ? sectorKey(*card, sector) : QByteArray(6, (char)0xFF);
+    if (!_keySlots.contains(keyIndex) || _keySlots.value(keyIndex) != expected)
+    {
+        _authSector = -1;
+        *status = 1;
+        return true;
+    }
+
+    *cardType = card->atr.size() > 1 ? (uint8_t)card->atr[1] : 0;
+    memcpy(serialNumber, card->atr.constData(), qMin(7, card->atr.size()));
+    _authSector = sector;
+    _authPresence = _presence;
+    *status = 0;
+    return true;
+}
+
+bool SimulatedCoupler::doReadBlock(uint8_t block, uint8_t *data, uint8_t *status)
+{
+    *status = 0xFF;
+    if (!_open || !simulate(CmdReadBlock))
+        return false;
+
+    const Card *card = cardInField();
+    if (!card || card->memory.isEmpty())
+        return true;
+
+    if (isUltralight(*card))
+    {
+        // READ returns four pages and rolls over at the end of memory
+        int size = card->memory.size();
+        for (int i = 0; i < 16; i++)
+            data[i] = (uint8_t)card->memory[(block * 4 + i) % size];
+        *status = 0;
+        return true;
+    }
+
+    if (_authSector != sectorOfBlock(block) || _authPresence != _presence ||
+        (block + 1) * 16 > card->memory.size())
+    {
+        *status = 1;
+        return true;
+    }
+
+    memcpy(data, card->memory.constData() + block * 16, 16);
+    *status = 0;
+    return true;
+}
+
+bool SimulatedCoupler::doTransceive(const uint8_t *tx, uint16_t txLen, uint8_t *rx, uint16_t *rxLen)
+{
+    uint16_t rxSize = *rxLen;
+    *rxLen = 0;
+    if (!_open || !simulate(CmdExchange))
+        return false;
+
+    const Card *card = cardInField();
+    if (!card || txLen == 0)
+        return false;
+
+    uint16_t len = 0;
+    if (card->com == 9)
+        len = iso15693Respond(*card, tx, txLen, rx, rxSize);
+    else if (card->com == COM_ISO14443_4)
+        len = _activatesIsoDep ? isoDepRespond(*card, tx, txLen, rx, rxSize) : tclRespond(*card, tx, txLen, rx);
+    else if (isUltralight(*card))
+        len = ultralightRespond(*card, tx, txLen, rx, rxSize);
+
+    // No answer from the card is a transport timeout
+    if (len == 0 || len > rxSize)
+        return false;
+
+    if (card->com != 9 && _tclByteUs > 0)
+        usleep(_tclByteUs * txLen / _divisorSend + _tclByteUs * len / _divisorReceive);
+    else if (card->com == 9 && _exchangeByteUs > 0)
+        usleep(_exchangeByteUs * (txLen + len));
+    *rxLen = len;
+    return true;
+}
+
+uint16_t SimulatedCoupler::iso15693Respond(const Card &card, const uint8_t *tx, uint16_t txLen,
+                                           uint8_t *rx, uint16_t rxSize)
+{
+    // Request: flags, command, [UID when addressed], parameters
+    if (txLen < 2 || rxSize < 2)
+        return 0;
+
+    uint8_t flags = tx[0];
+    uint8_t cmd = tx[1];
+    bool addressed = (flags & 0x04) == 0 && (flags & 0x20) != 0;
+    int p = 2 + (addressed ? 8 : 0);
+    QByteArray uid = card.atr.left(8);
+
+    if (addressed && (txLen < p || memcmp(tx + 2, uid.constData(), qMin(8, uid.size())) != 0))
+        return 0;
+
+    int blockCount = card.blockSize > 0 ? card.memory.size() / card.blockSize : 0;
+    uint16_t n = 0;
+
+    if (cmd == 0x01) // Inventory
+    {
+        rx[n++] = 0x00;
+        rx[n++] = 0x00; // DSFID
+        memcpy(rx + n, uid.constData(), uid.size());
+        return n + uid.size();
+    }
+
+    if (cmd == 0x2B) // Get System Information
+    {
+        rx[n++] = 0x00;
+        rx[n++] = 0x04; // Memory size present
+        memcpy(rx + n, uid.constData(), uid.size());
+        n += uid.size();
+        rx[n++] = (uint8_t)(blockCount - 1);
+        rx[n++] = (uint8_t)((card.blockSize - 1) & 0x1F);
+        return n;
+    }
+
+    if (cmd == 0x20 || cmd == 0x23) // Read Single / Read Multiple Blocks
+    {
+        int first = txLen > p ? tx[p] : 0;
+        int count = cmd == 0x23 ? (txLen > p + 1 ? tx[p + 1] + 1 : 1) : 1;
+
+        if (cmd == 0x23 && count > card.maxBlocksPerRead)
+        {
+            rx[0] = 0x01; // Error flag
+            rx[1] = card.maxBlocksPerRead == 0 ? 0x01 : 0x0F; // Not supported / unknown error
+            return 2;
+        }
+        if (first + count > blockCount || 1 + count * card.blockSize > rxSize)
+        {
+            rx[0] = 0x01;
+            rx[1] = 0x10; // Block not available
+            return 2;
+        }
+
+        rx[n++] = 0x00;
+        memcpy(rx + n, card.memory.constData() + first * card.blockSize, count * card.blockSize);
+        return n + count * card.blockSize;
+    }
+
+    rx[0] = 0x01;
+    rx[1] = 0x01; // Command not supported
+    return 2;
+}
+
+uint16_t SimulatedCoupler::ultralightRespond(const Card &card, const uint8_t *tx, uint16_t txLen,
+                                             uint8_t *rx, uint16_t rxSize)
+{
+    // Original Ultralights NAK both commands, the coupler reports a timeout
+    if (card.version.size() < 8)
+        return 0;
+
+    if (tx[0] == 0x60) // GET_VERSION
+    {
+        memcpy(rx, card.version.constData(), 8);
+        return 8;
+    }
+
+    if (tx[0] == 0x3A && txLen >= 3) // FAST_READ start end
+    {
+        int pages = card.memory.size() / 4;
+        int count = tx[2] - tx[1] + 1;
+        if (tx[1] > tx[2] || tx[2] >= pages || count * 4 > rxSize)
+            return 0;
+        memcpy(rx, card.memory.constData() + tx[1] * 4, count * 4);
+        return (uint16_t)(count * 4);
+    }
+
+    return 0;
+}
+
+// Highest of the divisors 2, 4 and 8 set in a 3-bit ATS TA field
+static int fastestDivisor(uint8_t bits)
+{
+    return bits & 0x04 ? 8 : bits & 0x02 ? 4 : bits & 0x01 ? 2 : 1;
+}
+
+// What SearchCardExt does with SEARCH_OPT_MAX_SPEED: RATS, then PPS to the
+// fastest rate the ATS offers
+void SimulatedCoupler::isoDepActivate(const Card &card)
+{
+    _tcl = TclState();
+    _tcl.presence = _presence;
+    _tcl.active = true;
+    _ats = card.ats;
+
+    uint8_t ta = _ats.size() > 2 && (_ats[1] & 0x10) ? (uint8_t)_ats[2] : 0;
+    if (ta & 0x80)
+    {
+        _divisorReceive = _divisorSend = fastestDivisor((ta >> 4) & ta & 0x07);
+    }
+    else
+    {
+        _divisorReceive = fastestDivisor((ta >> 4) & 0x07);
+        _divisorSend = fastestDivisor(ta & 0x07);
+    }
+
+    // RATS and ATS at 106 kbit/s
+    if (_tclByteUs > 0)
+        usleep(_tclByteUs * (2 + _ats.size()));
+}
+
+// The coupler runs the block protocol: tx is the whole APDU and rx the whole
+// response, chaining and S(WTX) stay between coupler and card
+uint16_t SimulatedCoupler::isoDepRespond(const Card &card, const uint8_t *tx, uint16_t txLen, uint8_t *rx,
+                                         uint16_t rxSize)
+{
+    if (!_tcl.active || _tcl.presence != _presence)
+        return 0;
+
+    QByteArray response = apduRespond(card, QByteArray((const char *)tx, txLen));
+    if (response.size() > rxSize)
+        return 0;
+
+    // One block round trip per waiting time extension
+    if (card.wtx > 0 && _latencyUs[CmdExchange] > 0)
+        usleep(card.wtx * _latencyUs[CmdExchange]);
+
+    memcpy(rx, response.constData(), response.size());
+    return (uint16_t)response.size();
+}
+
+uint16_t SimulatedCoupler::tclRespond(const Card &card, const uint8_t *tx, uint16_t txLen, uint8_t *rx)
+{
+    static const int FSD_TABLE[9] = {16, 24, 32, 40, 48, 64, 96, 128, 256};
+
+    if (_tcl.presence != _presence)
+    {
+        _tcl = TclState();
+        _tcl.presence = _presence;
+        _divisorReceive = _divisorSend = 1;
+    }
+
+    uint8_t pcb = tx[0];
+
+    // Layer 3 until RATS
+    if (!_tcl.active)
+    {
+        if (pcb != 0xE0 || txLen < 2)
+            return 0;
+        _tcl.active = true;
+        _tcl.fsd = FSD_TABLE[qMin(tx[1] >> 4, 8)];
+        memcpy(rx, card.ats.constData(), card.ats.size());
+        return (uint16_t)card.ats.size();
+    }
+
+    if (pcb == 0xD0 && txLen >= 3) // PPS, the reader switches through setBitRate()
+    {
+        rx[0] = 0xD0;
+        return 1;
+    }
+
+    if ((pcb & 0xE2) == 0x02) // I-block
+    {
+        _tcl.blockNumber = pcb & 0x01;
+        _tcl.command.append((const char *)tx + 1, txLen - 1);
+        if (pcb & 0x10)
+        {
+            rx[0] = 0xA2 | _tcl.blockNumber;
+            _tcl.lastFrame = QByteArray((const char *)rx, 1);
+            return 1;
+        }
+
+        _tcl.response = apduRespond(card, _tcl.command);
+        _tcl.command.clear();
+        _tcl.responseOffset = 0;
+        _tcl.wtxLeft = card.wtx;
+        return tclNextFrame(rx);
+    }
+
+    if ((pcb & 0xE6) == 0xA2) // R-block
+    {
+        if (pcb & 0x10)
+        {
+            // R(NAK) for our block: repeat it, otherwise the block was lost
+            if ((pcb & 0x01) == _tcl.blockNumber && !_tcl.lastFrame.isEmpty())
+            {
+                memcpy(rx, _tcl.lastFrame.constData(), _tcl.lastFrame.size());
+                return (uint16_t)_tcl.lastFrame.size();
+            }
+            rx[0] = 0xA2 | _tcl.blockNumber;
+            return 1;
+        }
+
+        // R(ACK) asks for the next chained response block
+        _tcl.blockNumber = pcb & 0x01;
+        return tclNextFrame(rx);
+    }
+
+    if ((pcb & 0xF7) == 0xF2) // S(WTX) reply
+        return tclNextFrame(rx);
+
+    if ((pcb & 0xF7) == 0xC2) // S(DESELECT)
+    {
+        _tcl.active = false;
+        rx[0] = 0xC2;
+        return 1;
+    }
+
+    return 0;
+}
+
+uint16_t SimulatedCoupler::tclNextFrame(uint8_t *rx)
+{
+    uint16_t n;
+    if (_tcl.wtxLeft > 0)
+    {
+        _tcl.wtxLeft--;
+        rx[0] = 0xF2;
+        rx[1] = 0x01;
+        n = 2;
+    }
+    else
+    {
+        // PCB + INF + CRC within the reader frame size
+        int chunk = qMin(_tcl.fsd - 3, _tcl.response.size() - _tcl.responseOffset);
+        bool more = _tcl.responseOffset + chunk < _tcl.response.size();
+        rx[0] = 0x02 | _tcl.blockNumber | (more ? 0x10 : 0x00);
+        memcpy(rx + 1, _tcl.response.constData() + _tcl.responseOffset, chunk);
+        _tcl.responseOffset += chunk;
+        n = (uint16_t)(1 + chunk);
+    }
+
+    _tcl.lastFrame = QByteArray((const char *)rx, n);
+    return n;
+}
+
+QByteArray SimulatedCoupler::apduRespond(const Card &card, const QByteArray &apdu)
+{
+    if (apdu.size() < 4)
+        return QByteArray::fromHex("6700");
+
+    uint8_t ins = (uint8_t)apdu[1];
+    uint8_t p1 = (uint8_t)apdu[2];
+    uint8_t p2 = (uint8_t)apdu[3];
+    int lc = apdu.size() > 5 ? (uint8_t)apdu[4] : 0;
+
+    if (ins == 0xA4) // SELECT
+    {
+        if (apdu.size() < 5 + lc)
+            return QByteArray::fromHex("6700");
+
+        QByteArray data = apdu.mid(5, lc);
+        if (p1 == 0x04)
+        {
+            _tcl.selected = data == card.aid;
+            _tcl.fileSelected = false;
+            return QByteArray::fromHex(_tcl.selected ? "9000" : "6A82");
+        }
+        if (p1 == 0x00 && _tcl.selected && lc == 2)
+        {
+            // The application holds a single file, the card memory
+            _tcl.fileSelected = true;
+            return QByteArray::fromHex("9000");
+        }
+        return QByteArray::fromHex("6A82");
+    }
+
+    if (ins == 0xB0) // READ BINARY
+    {
+        if (!_tcl.fileSelected)
+            return QByteArray::fromHex("6986");
+
+        int offset = ((p1 & 0x7F) << 8) | p2;
+        int le = apdu.size() == 5 && apdu[4] != 0 ? (uint8_t)apdu[4] : 256;
+        if (offset >= card.memory.size())
+            return QByteArray::fromHex("6B00");
+
+        int n = qMin(le, card.memory.size() - offset);
+        QByteArray response = card.memory.mid(offset, n);
+        response.append(QByteArray::fromHex(n < le ? "6282" : "9000"));
+        return response;
+    }
+
+    return QByteArray::fromHex("6D00");
+}
+
+void SimulatedCoupler::doReset()
+{
+    _authSector = -1;
+    _keySlots.clear();
+    _tcl = TclState();
+    _ats.clear();
+    _divisorReceive = _divisorSend = 1;
+}
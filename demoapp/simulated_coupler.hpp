@@ -0,0 +1,149 @@
+/*******************************************************************************
+ * Simulated Coupler - scripted software field for host builds and benchmarks
+ *
+ * Cards enter and leave the field on a wall-clock timeline. Each command can be
+ * given an RF latency and a failure probability so scanCard() timings on a
+ * Linux box are comparable with the real reader.
+ *******************************************************************************/
+
+#ifndef SIMULATED_COUPLER_HPP
+#define SIMULATED_COUPLER_HPP
+
+#include "coupler_backend.hpp"
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QString>
+#include <QVector>
+#include <random>
+
+class SimulatedCoupler : public CouplerBackend
+{
+public:
+    enum Command
+    {
+        CmdSearch = 0,
+        CmdLoadKey,
+        CmdAuthenticate,
+        CmdReadBlock,
+        CmdExchange,
+        CmdCount
+    };
+
+    struct Card
+    {
+        int arrivalMs = 0;  // Delay after the previous card left the field
+        int dwellMs = 1000; // Time spent in the field
+        uint8_t com = 5;
+        QByteArray atr;
+        QByteArray memory;               // Card image, 16-byte blocks
+        QByteArray keyA;                 // Default key A for every sector
+        QMap<int, QByteArray> sectorKeys; // Per-sector key A overrides
+
+        // ISO15693 tags
+        int blockSize = 4;
+        int blockCount = 28;
+        int maxBlocksPerRead = 32; // Read Multiple Blocks limit, 0 = unsupported
+
+        // Ultralight EV1 / NTAG GET_VERSION answer, empty = original Ultralight
+        QByteArray version;
+
+        // ISO14443-4 cards: memory is the file behind the application
+        QByteArray ats;
+        QByteArray aid;
+        int wtx = 0; // S(WTX) requests before each response
+    };
+
+    SimulatedCoupler();
+
+    const char *name() const override { return "simulator"; }
+    bool open() override;
+    void close() override;
+
+    bool loadScript(const QString &path);
+    void addCard(const Card &card);
+    void clearCards();
+    void setLatency(Command cmd, unsigned int microseconds);
+    void setExchangeByteTime(unsigned int microseconds) { _exchangeByteUs = microseconds; }
+    void setTclByteTime(unsigned int microseconds) { _tclByteUs = microseconds; }
+    void setFailureRate(Command cmd, double probability);
+    void setReadyDelay(int milliseconds) { _readyDelayMs = milliseconds; }
+    void setLoop(bool loop) { _loop = loop; }
+    void setSeed(unsigned int seed) { _rng.seed(seed); }
+
+    // Like the device coupler by default: the search activates ISO14443-4
+    // cards and transceive() takes APDUs. false exposes raw T=CL frames.
+    void setActivatesIsoDep(bool activates) { _activatesIsoDep = activates; }
+    bool activatesIsoDep() const override { return _activatesIsoDep; }
+    QByteArray isoDepAts() const override { return _ats; }
+
+    int maxBitRateDivisor() const override { return 8; }
+    bool setBitRate(int ds, int dr) override;
+
+protected:
+    bool doSearchCard(const CardSearchMask &mask, uint8_t forget, uint8_t timeout,
+                      uint8_t *com, uint16_t *atrLen, uint8_t *atr) override;
+    bool doLoadReaderKey(uint8_t keyIndex, const uint8_t *key, uint8_t *status) override;
+    bool doAuthenticate(uint8_t sector, uint8_t keyType, uint8_t keyIndex,
+                        uint8_t *cardType, uint8_t *serialNumber, uint8_t *status) override;
+    bool doReadBlock(uint8_t block, uint8_t *data, uint8_t *status) override;
+    bool doTransceive(const uint8_t *tx, uint16_t txLen, uint8_t *rx, uint16_t *rxLen) override;
+    void doReset() override;
+
+private:
+    const Card *cardInField();
+    bool simulate(Command cmd);
+    QByteArray sectorKey(const Card &card, int sector) const;
+    bool isUltralight(const Card &card) const;
+    uint16_t iso15693Respond(const Card &card, const uint8_t *tx, uint16_t txLen, uint8_t *rx, uint16_t rxSize);
+    uint16_t ultralightRespond(const Card &card, const uint8_t *tx, uint16_t txLen, uint8_t *rx, uint16_t rxSize);
+    void isoDepActivate(const Card &card);
+    uint16_t isoDepRespond(const Card &card, const uint8_t *tx, uint16_t txLen, uint8_t *rx, uint16_t rxSize);
+    uint16_t tclRespond(const Card &card, const uint8_t *tx, uint16_t txLen, uint8_t *rx);
+    uint16_t tclNextFrame(uint8_t *rx);
+    QByteArray apduRespond(const Card &card, const QByteArray &apdu);
+    static int sectorOfBlock(int block);
+    static void fillDefaultMemory(Card &card);
+
+    QVector<Card> _cards;
+    int _current;         // Index of the card currently scheduled
+    qint64 _enterMs;      // When the current card enters the field
+    quint64 _presence;    // Bumped every time a new card enters the field
+    quint64 _authPresence;
+    int _authSector;
+
+    // ISO14443-4 card state, reset when a new card enters the field
+    struct TclState
+    {
+        quint64 presence = 0;
+        bool active = false;
+        int fsd = 256;
+        uint8_t blockNumber = 1; // Card starts at 1, the reader at 0
+        QByteArray command;      // Chained command being received
+        QByteArray response;     // Response being sent
+        int responseOffset = 0;
+        int wtxLeft = 0;
+        QByteArray lastFrame;    // Repeated on R(NAK)
+        bool selected = false;
+        bool fileSelected = false;
+    };
+    TclState _tcl;
+    bool _activatesIsoDep;
+    QByteArray _ats; // Reported by the last search that activated a card
+
+    QMap<uint8_t, QByteArray> _keySlots;
+    unsigned int _latencyUs[CmdCount];
+    unsigned int _exchangeByteUs; // Air time per frame byte
+    unsigned int _tclByteUs;      // ISO14443 air time per byte at 106 kbit/s
+    int _divisorReceive;
+    int _divisorSend;
+    double _failureRate[CmdCount];
+    int _readyDelayMs;
+    bool _loop;
+    bool _open;
+
+    QElapsedTimer _clock;
+    std::mt19937 _rng;
+};
+
+#endif // SIMULATED_COUPLER_HPP
@@ -0,0 +1,61 @@
+/*******************************************************************************
+ * SPSC Queue - lock-free single producer / single consumer ring buffer
+ *
+ * push() is only called from one thread and pop() from one other thread.
+ * Neither call blocks, callers pair the queue with their own wake-up.
+ *******************************************************************************/
+
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(size_t capacity)
+        : _slots(capacity + 1), _head(0), _tail(0) {}
+
+    size_t capacity() const { return _slots.size() - 1; }
+
+    // Producer side. Returns false when the queue is full.
+    bool push(const T &item)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        size_t next = increment(tail);
+        if (next == _head.load(std::memory_order_acquire))
+            return false;
+        _slots[tail] = item;
+        _tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false when the queue is empty.
+    bool pop(T &item)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire))
+            return false;
+        item = _slots[head];
+        _slots[head] = T();
+        _head.store(increment(head), std::memory_order_release);
+        return true;
+    }
+
+    bool isEmpty() const
+    {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+private:
+    size_t increment(size_t index) const { return index + 1 == _slots.size() ? 0 : index + 1; }
+
+    std::vector<T> _slots;
+    alignas(64) std::atomic<size_t> _head; // Next slot to pop, owned by the consumer
+    alignas(64) std::atomic<size_t> _tail; // Next slot to push, owned by the producer
+};
+
+#endif // SPSC_QUEUE_HPP
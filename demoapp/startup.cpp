@@ -0,0 +1,97 @@
+/*******************************************************************************
+ * Startup Implementation
+ *******************************************************************************/
+
+#include "startup.hpp"
+#include <QDebug>
+
+Startup::Startup(QObject *parent)
+    : QObject(parent), _readyEmitted(false)
+{
+    _clock.start();
+    for (int i = 0; i < STAGE_COUNT; i++)
+        _states[i] = Pending;
+}
+
+Startup::~Startup()
+{
+    wait();
+}
+
+const char *Startup::stageName(Stage stage)
+{
+    switch (stage)
+    {
+    case StageConfig:
+        return "config";
+    case StageReader:
+        return "reader";
+    case StageKeys:
+        return "keys";
+    default:
+        return "?";
+    }
+}
+
+void Startup::run(Stage stage, Task task)
+{
+    _states[stage] = Running;
+    _threads.push_back(std::thread([this, stage, task]
+                                   {
+                                       QElapsedTimer timer;
+                                       timer.start();
+                                       bool ok = task();
+                                       QMetaObject::invokeMethod(this, "finish", Qt::QueuedConnection,
+                                                                 Q_ARG(int, stage), Q_ARG(bool, ok),
+                                                                 Q_ARG(qint64, timer.elapsed())); }));
+}
+
+void Startup::complete(Stage stage, bool ok, qint64 durationMs)
+{
+    finish(stage, ok, durationMs);
+}
+
+void Startup::wait()
+{
+    for (size_t i = 0; i < _threads.size(); i++)
+    {
+        if (_threads[i].joinable())
+            _threads[i].join();
+    }
+    _threads.clear();
+}
+
+bool Startup::isReady() const
+{
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+        if (_states[i] != Ready)
+            return false;
+    }
+    return true;
+}
+
+bool Startup::hasFailed() const
+{
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+        if (_states[i] == Failed)
+            return true;
+    }
+    return false;
+}
+
+void Startup::finish(int stage, bool ok, qint64 durationMs)
+{
+    _states[stage] = ok ? Ready : Failed;
+    qDebug() << "Startup:" << stageName((Stage)stage) << (ok ? "ready" : "FAILED") << "in" << durationMs
+             << "ms," << _clock.elapsed() << "ms after start";
+    emit stageFinished(stage, ok);
+
+    if (!_readyEmitted && isReady())
+    {
+        _readyEmitted = true;
+        qDebug() << "Startup: ready to tap" << _clock.elapsed() << "ms after start";
+        emit readyToTap(_clock.elapsed());
+    }
+}
@@ -0,0 +1,78 @@
+/*******************************************************************************
+ * Startup - staged initialization with a readiness state machine
+ *
+ *   Config ──┬──> Reader (coupler open, ready to poll) ──┐
+ *            └──> Keys (PKCS#12 and public certificate) ─┴──> ready to tap
+ *
+ * Slow stages run in parallel on their own threads while the UI is already
+ * up. Results come back through the event loop, so every state change happens
+ * on the thread that owns the Startup object. Times are measured from
+ * construction: create it before anything else to track boot-to-first-tap.
+ *******************************************************************************/
+
+#ifndef STARTUP_HPP
+#define STARTUP_HPP
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <functional>
+#include <thread>
+#include <vector>
+
+class Startup : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Stage
+    {
+        StageConfig = 0,
+        StageReader,
+        StageKeys,
+        STAGE_COUNT
+    };
+
+    enum State
+    {
+        Pending = 0,
+        Running,
+        Ready,
+        Failed
+    };
+
+    typedef std::function<bool()> Task;
+
+    explicit Startup(QObject *parent = nullptr);
+    ~Startup();
+
+    // Runs task on a new thread, the result arrives as stageFinished()
+    void run(Stage stage, Task task);
+
+    // Records a stage the caller ran itself on the owning thread
+    void complete(Stage stage, bool ok, qint64 durationMs);
+
+    // Joins the stage threads; make their tasks return first (e.g.
+    // CardReader::requestStop()) or this blocks until they finish
+    void wait();
+
+    State state(Stage stage) const { return _states[stage]; }
+    bool isReady() const;
+    bool hasFailed() const;
+    qint64 elapsedMs() const { return _clock.elapsed(); }
+
+    static const char *stageName(Stage stage);
+
+signals:
+    void stageFinished(int stage, bool ok);
+    void readyToTap(qint64 elapsedMs);
+
+private:
+    Q_INVOKABLE void finish(int stage, bool ok, qint64 durationMs);
+
+    QElapsedTimer _clock;
+    State _states[STAGE_COUNT];
+    std::vector<std::thread> _threads;
+    bool _readyEmitted;
+};
+
+#endif // STARTUP_HPP
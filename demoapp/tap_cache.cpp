@@ -0,0 +1,108 @@
+/*******************************************************************************
+ * Tap Cache Implementation
+ *******************************************************************************/
+
+#include "tap_cache.hpp"
+#include <QMutexLocker>
+
+TapCache::TapCache(int capacity, qint64 ttlMs)
+    : _entries(qMax(1, capacity)), _ttlMs(ttlMs), _hits(0), _misses(0)
+{
+    _clock.start();
+}
+
+quint64 TapCache::hash(const char *data, int length)
+{
+    // FNV-1a 64
+    quint64 h = 14695981039346656037ULL;
+    for (int i = 0; i < length; i++)
+    {
+        h ^= (uchar)data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+quint64 TapCache::uidHash(const QString &cardUid)
+{
+    // Hash the UTF-16 code units directly, no conversion
+    return hash((const char *)cardUid.constData(), cardUid.size() * (int)sizeof(QChar));
+}
+
+TapCache::Entry *TapCache::find(quint64 uidHash, quint64 imageHash, qint64 now)
+{
+    for (int i = 0; i < _entries.size(); i++)
+    {
+        Entry &e = _entries[i];
+        if (e.seenMs < 0)
+            continue;
+        if (now - e.seenMs > _ttlMs)
+        {
+            e.seenMs = -1;
+            continue;
+        }
+        if (e.uidHash == uidHash && e.imageHash == imageHash)
+            return &e;
+    }
+    return nullptr;
+}
+
+bool TapCache::lookup(const QString &cardUid, const QByteArray &image, Entry *previous)
+{
+    qint64 now = _clock.elapsed();
+    QMutexLocker lock(&_mutex);
+    Entry *e = find(uidHash(cardUid), hash(image.constData(), image.size()), now);
+
+    if (!e)
+    {
+        _misses++;
+        return false;
+    }
+
+    e->seenMs = now;
+    if (previous)
+        *previous = *e;
+    _hits++;
+    return true;
+}
+
+void TapCache::insert(const QString &cardUid, const QByteArray &image, quint64 sequence)
+{
+    quint64 uidHash = TapCache::uidHash(cardUid);
+    quint64 imageHash = hash(image.constData(), image.size());
+    qint64 now = _clock.elapsed();
+
+    QMutexLocker lock(&_mutex);
+    Entry *slot = find(uidHash, imageHash, now);
+    for (int i = 0; !slot && i < _entries.size(); i++)
+    {
+        if (_entries[i].seenMs < 0)
+            slot = &_entries[i];
+    }
+
+    // Every slot is taken: evict the least recently seen card
+    if (!slot)
+    {
+        slot = &_entries[0];
+        for (int i = 1; i < _entries.size(); i++)
+        {
+            if (_entries[i].seenMs < slot->seenMs)
+                slot = &_entries[i];
+        }
+    }
+
+    slot->uidHash = uidHash;
+    slot->imageHash = imageHash;
+    slot->seenMs = now;
+    slot->sequence = sequence;
+}
+
+void TapCache::remove(quint64 sequence)
+{
+    QMutexLocker lock(&_mutex);
+    for (int i = 0; i < _entries.size(); i++)
+    {
+        if (_entries[i].seenMs >= 0 && _entries[i].sequence == sequence)
+            _entries[i].seenMs = -1;
+    }
+}
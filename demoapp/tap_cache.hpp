@@ -0,0 +1,60 @@
+/*******************************************************************************
+ * Tap Cache - duplicate tap suppression
+ *
+ * Remembers recently processed cards by UID hash and card image hash in a
+ * fixed number of slots. A card seen again within the TTL with the same image
+ * is a repeat (e.g. left on the reader) and never reaches signing or HTTP.
+ *******************************************************************************/
+
+#ifndef TAP_CACHE_HPP
+#define TAP_CACHE_HPP
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <atomic>
+
+class TapCache
+{
+public:
+    struct Entry
+    {
+        quint64 uidHash = 0;
+        quint64 imageHash = 0;
+        qint64 seenMs = -1;   // Last time the card was seen, -1 = free slot
+        quint64 sequence = 0; // Tap that was actually processed
+    };
+
+    TapCache(int capacity, qint64 ttlMs);
+
+    // Returns true and fills *previous when the card is a repeat. The TTL
+    // slides: a card left on the reader stays suppressed.
+    bool lookup(const QString &cardUid, const QByteArray &image, Entry *previous);
+
+    // Record a tap about to be sent, evicting the least recently seen slot if full
+    void insert(const QString &cardUid, const QByteArray &image, quint64 sequence);
+
+    // Forget a tap that never reached the server so the passenger can tap
+    // again right away
+    void remove(quint64 sequence);
+
+    quint64 hits() const { return _hits; }
+    quint64 misses() const { return _misses; }
+
+    static quint64 hash(const char *data, int length);
+    static quint64 uidHash(const QString &cardUid);
+
+private:
+    Entry *find(quint64 uidHash, quint64 imageHash, qint64 now);
+
+    QMutex _mutex;           // Prepare stage looks up, send stage removes
+    QVector<Entry> _entries; // Fixed size, allocated once
+    qint64 _ttlMs;
+    QElapsedTimer _clock;
+    std::atomic<quint64> _hits;
+    std::atomic<quint64> _misses;
+};
+
+#endif // TAP_CACHE_HPP
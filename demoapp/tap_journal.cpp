@@ -0,0 +1,434 @@
+/*******************************************************************************
+ * Tap Journal Implementation
+ *******************************************************************************/
+
+#include "tap_journal.hpp"
+#include "log.hpp"
+#include "tap_metrics.hpp"
+#include <QDebug>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const quint32 HEADER_MAGIC = 0x484a5454; // "TTJH"
+static const quint32 RECORD_MAGIC = 0x524a5454; // "TTJR"
+static const quint32 WRAP_MAGIC = 0x574a5454;   // "TTJW", rest of the lap unused
+static const quint32 VERSION = 1;
+
+// Header slots in separate sectors, records from the first page boundary on
+static const qint64 SLOT_SIZE = 512;
+static const qint64 DATA_START = 4096;
+static const qint64 MIN_DATA_SIZE = 64 * 1024;
+
+struct TapJournal::Header
+{
+    quint32 magic;
+    quint32 version;
+    quint64 generation;
+    quint64 capacity;
+    quint64 head;
+    quint64 headSequence;
+    quint32 crc; // Of the fields above
+    quint32 reserved;
+};
+
+struct TapJournal::RecordHeader
+{
+    quint32 magic;
+    quint32 length;
+    quint64 sequence;
+    quint32 crc; // Of the fields above and the payload
+    quint32 reserved;
+};
+
+static qint64 align8(qint64 size)
+{
+    return (size + 7) & ~(qint64)7;
+}
+
+// CRC-32 (IEEE), table-driven; a few microseconds for a signed tap
+static quint32 crc32(const void *data, size_t length, quint32 crc = 0)
+{
+    static quint32 table[256];
+    static bool ready = []
+    {
+        for (quint32 i = 0; i < 256; i++)
+        {
+            quint32 c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return true;
+    }();
+    Q_UNUSED(ready);
+
+    const uchar *p = (const uchar *)data;
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++)
+        crc = table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+TapJournal::TapJournal()
+    : _fd(-1), _map(nullptr), _capacity(0), _syncIntervalMs(0), _head(0), _tail(0), _syncedHead(0),
+      _headSequence(0), _nextSequence(0), _count(0), _generation(0), _headChanged(false), _unsynced(false),
+      _running(false)
+{
+}
+
+TapJournal::~TapJournal()
+{
+    close();
+}
+
+bool TapJournal::open(const QString &path, qint64 capacityBytes, int syncIntervalMs)
+{
+    if (_map)
+        return true;
+
+    _fd = ::open(path.toLocal8Bit().constData(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (_fd < 0)
+    {
+        qDebug() << "Failed to open tap journal" << path << ":" << strerror(errno);
+        return false;
+    }
+
+    struct stat st;
+    bool existing = fstat(_fd, &st) == 0 && st.st_size >= DATA_START + MIN_DATA_SIZE;
+    qint64 capacity = existing ? (qint64)st.st_size : qMax(capacityBytes, DATA_START + MIN_DATA_SIZE);
+    capacity &= ~(DATA_START - 1);
+
+    // Blocks are reserved up front: a full disk must fail here, not raise
+    // SIGBUS on a later store into the mapping
+    int error = existing ? 0 : posix_fallocate(_fd, 0, capacity);
+    void *map = error == 0 ? mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, 0)
+                           : MAP_FAILED;
+    if (map == MAP_FAILED)
+    {
+        qDebug() << "Failed to map tap journal" << path << ":" << strerror(error ? error : errno);
+        ::close(_fd);
+        _fd = -1;
+        return false;
+    }
+
+    _map = (uchar *)map;
+    _capacity = capacity;
+    _syncIntervalMs = qMax(1, syncIntervalMs);
+    _path = path;
+
+    QMutexLocker lock(&_mutex);
+    if (existing && recover())
+    {
+        qDebug() << "Tap journal" << path << "recovered with" << (int)_count << "unsent taps";
+    }
+    else
+    {
+        if (existing)
+            qDebug() << "Tap journal" << path << "has no valid header, starting empty";
+        initialize(existing);
+    }
+    updateMetrics();
+
+    _running = true;
+    _syncThread = std::thread(&TapJournal::syncLoop, this);
+    return true;
+}
+
+void TapJournal::startDrain(const Sender &sender, int retryMinMs, int retryMaxMs)
+{
+    if (!_map || _drainThread.joinable())
+        return;
+
+    retryMinMs = qMax(1, retryMinMs);
+    _drainThread = std::thread(&TapJournal::drainLoop, this, sender, retryMinMs, qMax(retryMinMs, retryMaxMs));
+}
+
+void TapJournal::close()
+{
+    if (!_map)
+        return;
+
+    {
+        QMutexLocker lock(&_mutex);
+        _running = false;
+        _appended.wakeAll();
+        _wake.wakeAll();
+    }
+
+    // A delivery in flight finishes first
+    if (_drainThread.joinable())
+        _drainThread.join();
+    if (_syncThread.joinable())
+        _syncThread.join();
+    sync();
+
+    qDebug() << "Tap journal closed with" << (int)_count << "unsent taps";
+    munmap(_map, _capacity);
+    ::close(_fd);
+    _map = nullptr;
+    _fd = -1;
+}
+
+bool TapJournal::append(const QByteArray &record)
+{
+    TapMetrics::PhaseTimer timer(TapMetrics::JournalAppend);
+    qint64 size = align8(sizeof(RecordHeader) + record.size());
+
+    QMutexLocker lock(&_mutex);
+    if (!_map)
+        return false;
+
+    // Records that do not fit before the end start the next lap. Space from
+    // the synced head on is kept even when already sent: after a crash the
+    // records are read from there.
+    qint64 pos = _tail;
+    bool wrap = pos + size > _capacity;
+    if (wrap)
+        pos = DATA_START;
+    bool fits = _tail >= _syncedHead ? !wrap || pos + size < _syncedHead : !wrap && pos + size < _syncedHead;
+    if (!fits)
+    {
+        TapMetrics::increment(TapMetrics::JournalFull);
+        return false;
+    }
+
+    if (wrap && _tail + (qint64)sizeof(RecordHeader) <= _capacity)
+        memcpy(_map + _tail, &WRAP_MAGIC, sizeof(WRAP_MAGIC));
+
+    RecordHeader header;
+    header.magic = RECORD_MAGIC;
+    header.length = record.size();
+    header.sequence = _nextSequence++;
+    header.reserved = 0;
+    header.crc = crc32(record.constData(), record.size(), crc32(&header, offsetof(RecordHeader, crc)));
+    memcpy(_map + pos + sizeof(header), record.constData(), record.size());
+    memcpy(_map + pos, &header, sizeof(header));
+
+    if (_count == 0)
+    {
+        _head = pos;
+        _headSequence = header.sequence;
+        _headChanged = true;
+    }
+    _tail = pos + size;
+    _count++;
+    _unsynced = true;
+    updateMetrics();
+    TapMetrics::increment(TapMetrics::JournalAppended);
+
+    _appended.wakeOne();
+    return true;
+}
+
+void TapJournal::initialize(bool wipe)
+{
+    // Old records must not line up with the new sequence numbers
+    if (wipe)
+        memset(_map + DATA_START, 0, _capacity - DATA_START);
+
+    _head = _tail = _syncedHead = DATA_START;
+    _headSequence = _nextSequence = 1;
+    _count = 0;
+    _generation = 0;
+    writeHeader();
+    writeHeader();
+    msync(_map, _capacity, MS_SYNC);
+}
+
+bool TapJournal::recover()
+{
+    // Newest slot that checks out
+    Header best;
+    bool found = false;
+    for (int slot = 0; slot < 2; slot++)
+    {
+        Header header;
+        memcpy(&header, _map + slot * SLOT_SIZE, sizeof(header));
+        if (header.magic != HEADER_MAGIC || header.version != VERSION || header.capacity != (quint64)_capacity ||
+            header.head < (quint64)DATA_START || header.head >= (quint64)_capacity ||
+            header.crc != crc32(&header, offsetof(Header, crc)))
+            continue;
+        if (!found || header.generation > best.generation)
+            best = header;
+        found = true;
+    }
+    if (!found)
+        return false;
+
+    _generation = best.generation;
+    _head = _syncedHead = best.head;
+    _headSequence = best.headSequence;
+
+    // Consecutive records from the head on, at most one lap
+    qint64 pos = _head;
+    quint64 sequence = _headSequence;
+    int count = 0;
+    bool wrapped = false;
+    while (true)
+    {
+        quint32 magic = 0;
+        if (pos + (qint64)sizeof(RecordHeader) <= _capacity)
+            memcpy(&magic, _map + pos, sizeof(magic));
+        if (pos + (qint64)sizeof(RecordHeader) > _capacity || magic == WRAP_MAGIC)
+        {
+            if (wrapped)
+                break;
+            wrapped = true;
+            pos = DATA_START;
+            continue;
+        }
+
+        RecordHeader header;
+        memcpy(&header, _map + pos, sizeof(header));
+        qint64 size = align8(sizeof(header) + (qint64)header.length);
+        if (header.magic != RECORD_MAGIC || header.sequence != sequence || pos + size > (wrapped ? _head : _capacity) ||
+            header.crc != crc32(_map + pos + sizeof(header), header.length, crc32(&header, offsetof(RecordHeader, crc))))
+            break;
+
+        pos += size;
+        sequence++;
+        count++;
+    }
+
+    // A torn last record is simply not there
+    _count = count;
+    _nextSequence = sequence;
+    _tail = count > 0 ? pos : _head;
+    if (count > 0)
+        _head = nextHead(_head);
+    _headChanged = false;
+    _unsynced = false;
+    return true;
+}
+
+void TapJournal::writeHeader()
+{
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = HEADER_MAGIC;
+    header.version = VERSION;
+    header.generation = ++_generation;
+    header.capacity = _capacity;
+    header.head = _head;
+    header.headSequence = _headSequence;
+    header.crc = crc32(&header, offsetof(Header, crc));
+
+    // The other slot keeps the previous header until this one is on disk
+    memcpy(_map + (_generation % 2) * SLOT_SIZE, &header, sizeof(header));
+    _headChanged = false;
+}
+
+void TapJournal::peek(QByteArray &record)
+{
+    RecordHeader header;
+    memcpy(&header, _map + _head, sizeof(header));
+    record = QByteArray((const char *)_map + _head + sizeof(header), header.length);
+}
+
+void TapJournal::pop()
+{
+    RecordHeader header;
+    memcpy(&header, _map + _head, sizeof(header));
+    _count--;
+    _headSequence++;
+    _head = _count > 0 ? nextHead(_head + align8(sizeof(header) + (qint64)header.length)) : _tail;
+    _headChanged = true;
+    _unsynced = true;
+    updateMetrics();
+}
+
+qint64 TapJournal::nextHead(qint64 offset) const
+{
+    quint32 magic = 0;
+    if (offset + (qint64)sizeof(RecordHeader) <= _capacity)
+        memcpy(&magic, _map + offset, sizeof(magic));
+    if (offset + (qint64)sizeof(RecordHeader) > _capacity || magic == WRAP_MAGIC)
+        return DATA_START;
+    return offset;
+}
+
+qint64 TapJournal::usedBytes() const
+{
+    if (_count == 0)
+        return 0;
+    return _tail > _head ? _tail - _head : _capacity - _head + _tail - DATA_START;
+}
+
+void TapJournal::updateMetrics()
+{
+    TapMetrics::setGauge(TapMetrics::JournalPending, _count);
+    TapMetrics::setGauge(TapMetrics::JournalBytes, usedBytes());
+}
+
+void TapJournal::sync()
+{
+    QMutexLocker lock(&_mutex);
+    if (!_unsynced)
+        return;
+    _unsynced = false;
+
+    // Records first, a synced header never points at records that are not
+    lock.unlock();
+    msync(_map + DATA_START, _capacity - DATA_START, MS_SYNC);
+    lock.relock();
+    if (!_headChanged)
+        return;
+
+    writeHeader();
+    qint64 head = _head;
+    lock.unlock();
+    msync(_map, DATA_START, MS_SYNC);
+    lock.relock();
+    _syncedHead = head;
+}
+
+void TapJournal::syncLoop()
+{
+    // One msync per interval however many taps were appended in between
+    while (true)
+    {
+        {
+            QMutexLocker lock(&_mutex);
+            if (!_running)
+                break;
+            _wake.wait(&_mutex, _syncIntervalMs);
+        }
+        sync();
+    }
+}
+
+void TapJournal::drainLoop(Sender sender, int retryMinMs, int retryMaxMs)
+{
+    int retryMs = retryMinMs;
+    QByteArray record;
+    while (true)
+    {
+        {
+            QMutexLocker lock(&_mutex);
+            while (_running && _count == 0)
+                _appended.wait(&_mutex);
+            if (!_running)
+                return;
+            peek(record);
+        }
+
+        if (sender(record))
+        {
+            QMutexLocker lock(&_mutex);
+            pop();
+            retryMs = retryMinMs;
+            continue;
+        }
+
+        LOG_DEBUG("Tap journal delivery failed, {} taps pending, next try in {} ms", (int)_count, retryMs);
+        QMutexLocker lock(&_mutex);
+        if (_running)
+            _wake.wait(&_mutex, retryMs);
+        retryMs = qMin(retryMs * 2, retryMaxMs);
+    }
+}
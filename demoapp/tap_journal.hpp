@@ -0,0 +1,107 @@
+/*******************************************************************************
+ * Tap Journal - crash-safe store-and-forward of signed tap requests
+ *
+ *   send stage ──append()──> mmap ring ──> drain thread ──> sender (HTTP)
+ *                                │
+ *                                └──> sync thread: msync every syncIntervalMs
+ *
+ * A tap the server could not be reached for is appended as its signed request
+ * body and sent later, in order, by the drain thread. append() copies into a
+ * memory-mapped file and returns; the sync thread flushes what was appended
+ * since its last pass, so a power loss costs at most syncIntervalMs of taps.
+ *
+ * File layout, fixed size, preallocated so the journal never grows on disk:
+ *   [header slot 0][header slot 1] ... [records, used as a ring]
+ * A record is {magic, length, sequence, crc32} + payload, 8-byte aligned.
+ * Header slots alternate and carry the oldest unsent record; recovery scans
+ * from there while the magic, CRC and consecutive sequence numbers hold.
+ * A record whose removal was not synced yet is sent again after a crash, so
+ * delivery is at least once: the server tells repeats by transactionId.
+ *******************************************************************************/
+
+#ifndef TAP_JOURNAL_HPP
+#define TAP_JOURNAL_HPP
+
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+#include <QWaitCondition>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+class TapJournal
+{
+public:
+    // Returns true once the server has the record, false to retry it later
+    typedef std::function<bool(const QByteArray &record)> Sender;
+
+    TapJournal();
+    ~TapJournal();
+
+    // Maps the journal, creating it with capacityBytes if missing, and
+    // recovers the records a previous run left unsent. An existing journal
+    // keeps its size. The sync thread starts here.
+    bool open(const QString &path, qint64 capacityBytes, int syncIntervalMs);
+
+    // Delivers the pending records in order through sender, waiting
+    // retryMinMs after a failure and doubling up to retryMaxMs
+    void startDrain(const Sender &sender, int retryMinMs, int retryMaxMs);
+
+    // Stops both threads and flushes, unsent records stay for the next run.
+    // A delivery in flight is waited for.
+    void close();
+
+    bool isOpen() const { return _map != nullptr; }
+
+    // Never waits on the disk or the network. Returns false when the record
+    // does not fit next to the unsent ones.
+    bool append(const QByteArray &record);
+
+    // Records not delivered yet
+    int pending() const { return _count; }
+
+private:
+    struct Header;
+    struct RecordHeader;
+
+    // Called with _mutex held
+    void initialize(bool wipe);
+    bool recover();
+    void writeHeader();
+    void peek(QByteArray &record);
+    void pop();
+    qint64 nextHead(qint64 offset) const;
+    qint64 usedBytes() const;
+    void updateMetrics();
+
+    void sync();
+    void syncLoop();
+    void drainLoop(Sender sender, int retryMinMs, int retryMaxMs);
+
+    QString _path;
+    int _fd;
+    uchar *_map;
+    qint64 _capacity;
+    int _syncIntervalMs;
+
+    QMutex _mutex;            // Ring state below and the mapped file
+    QWaitCondition _appended; // Drain thread, records to send
+    QWaitCondition _wake;     // Sync thread and retry waits, on close()
+    qint64 _head;             // Oldest unsent record
+    qint64 _tail;             // Where the next record goes
+    qint64 _syncedHead;       // Head of the last synced header, nothing
+                              // from there to the tail may be overwritten
+    quint64 _headSequence;
+    quint64 _nextSequence;
+    std::atomic<int> _count;
+    quint64 _generation;      // Of the newest header slot
+    bool _headChanged;        // Header not written since the head moved
+    bool _unsynced;           // Appended or popped since the last msync
+
+    std::atomic<bool> _running;
+    std::thread _syncThread;
+    std::thread _drainThread;
+};
+
+#endif // TAP_JOURNAL_HPP
@@ -0,0 +1,118 @@
+/*******************************************************************************
+ * Tap Metrics Implementation
+ *******************************************************************************/
+
+#include "tap_metrics.hpp"
+#include <atomic>
+#include <cstdio>
+
+static const char *const PHASE_NAMES[TapMetrics::PHASE_COUNT] = {
+    "detect", "key_load", "authenticate", "read_block", "build_payload", "sign", "http",
+    "http_dns", "http_connect", "http_tls", "http_first_byte", "parse_response", "verify_signature",
+    "journal_append", "http_warm_up", "tap"};
+
+static const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+static LatencyHistogram histograms[TapMetrics::PHASE_COUNT];
+
+struct NamedMetric
+{
+    const char *name;
+    const char *help;
+};
+
+static const NamedMetric COUNTERS[TapMetrics::COUNTER_COUNT] = {
+    {"demoapp_signature_verify_failures_total",
+     "Responses whose signature did not verify. Any increase is an alarm."},
+    {"demoapp_signature_verify_dropped_total", "Responses left unverified because the audit queue was full."},
+    {"demoapp_journal_appended_total", "Taps stored in the offline journal while the server was unreachable."},
+    {"demoapp_journal_replayed_total", "Stored taps delivered to the server since."},
+    {"demoapp_journal_rejected_total", "Stored taps the server refused, dropped from the journal."},
+    {"demoapp_journal_full_total", "Taps lost because the offline journal was full."},
+    {"demoapp_http_tap_connects_total", "Tap requests that had to open a connection to the API."},
+    {"demoapp_http_tap_reused_total", "Tap requests sent on an already open connection."}};
+
+static const NamedMetric GAUGES[TapMetrics::GAUGE_COUNT] = {
+    {"demoapp_signature_verify_pending", "Responses waiting for background verification."},
+    {"demoapp_journal_pending", "Taps in the offline journal waiting to be sent."},
+    {"demoapp_journal_bytes", "Offline journal space taken by unsent taps."}};
+
+static std::atomic<quint64> counters[TapMetrics::COUNTER_COUNT];
+static std::atomic<qint64> gauges[TapMetrics::GAUGE_COUNT];
+
+const char *TapMetrics::phaseName(Phase phase)
+{
+    return PHASE_NAMES[phase];
+}
+
+void TapMetrics::record(Phase phase, qint64 us)
+{
+    histograms[phase].record(us > 0 ? (uint64_t)us : 0);
+}
+
+const LatencyHistogram &TapMetrics::histogram(Phase phase)
+{
+    return histograms[phase];
+}
+
+void TapMetrics::increment(Counter counter)
+{
+    counters[counter].fetch_add(1, std::memory_order_relaxed);
+}
+
+quint64 TapMetrics::counter(Counter counter)
+{
+    return counters[counter].load(std::memory_order_relaxed);
+}
+
+void TapMetrics::setGauge(Gauge gauge, qint64 value)
+{
+    gauges[gauge].store(value, std::memory_order_relaxed);
+}
+
+static void appendMetric(QByteArray &out, const NamedMetric &metric, const char *type, double value)
+{
+    char text[256];
+    int n = snprintf(text, sizeof(text), "# HELP %s %s\n# TYPE %s %s\n%s %.9g\n", metric.name, metric.help,
+                     metric.name, type, metric.name, value);
+    out.append(text, n);
+}
+
+static void appendSample(QByteArray &out, const char *metric, const char *phase, const char *quantile, double value)
+{
+    char line[160];
+    int n;
+    if (quantile)
+        n = snprintf(line, sizeof(line), "%s{phase=\"%s\",quantile=\"%s\"} %.9g\n", metric, phase, quantile, value);
+    else
+        n = snprintf(line, sizeof(line), "%s{phase=\"%s\"} %.9g\n", metric, phase, value);
+    out.append(line, n);
+}
+
+void TapMetrics::writePrometheus(QByteArray &out)
+{
+    out.append("# HELP demoapp_tap_phase_seconds Latency of each tap phase.\n"
+               "# TYPE demoapp_tap_phase_seconds summary\n");
+    for (int i = 0; i < PHASE_COUNT; i++)
+    {
+        const LatencyHistogram &h = histograms[i];
+        for (double q : QUANTILES)
+        {
+            char label[8];
+            snprintf(label, sizeof(label), "%g", q);
+            appendSample(out, "demoapp_tap_phase_seconds", PHASE_NAMES[i], label, h.quantileUs(q) / 1e6);
+        }
+        appendSample(out, "demoapp_tap_phase_seconds_sum", PHASE_NAMES[i], nullptr, h.sumUs() / 1e6);
+        appendSample(out, "demoapp_tap_phase_seconds_count", PHASE_NAMES[i], nullptr, (double)h.count());
+    }
+
+    out.append("# HELP demoapp_tap_phase_max_seconds Slowest sample of each tap phase.\n"
+               "# TYPE demoapp_tap_phase_max_seconds gauge\n");
+    for (int i = 0; i < PHASE_COUNT; i++)
+        appendSample(out, "demoapp_tap_phase_max_seconds", PHASE_NAMES[i], nullptr, histograms[i].maxUs() / 1e6);
+
+    for (int i = 0; i < COUNTER_COUNT; i++)
+        appendMetric(out, COUNTERS[i], "counter", (double)counters[i].load(std::memory_order_relaxed));
+    for (int i = 0; i < GAUGE_COUNT; i++)
+        appendMetric(out, GAUGES[i], "gauge", (double)gauges[i].load(std::memory_order_relaxed));
+}
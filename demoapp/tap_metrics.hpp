@@ -0,0 +1,94 @@
+/*******************************************************************************
+ * Tap Metrics - per-phase latency histograms of a tap
+ *
+ *   detect ─ key_load ─ authenticate ─ read_block ... (reader thread)
+ *   build_payload ─ sign                               (prepare stage)
+ *   http (dns, connect, tls, ttfb) ─ parse ─ verify    (send stage)
+ *   journal_append                                     (send stage, offline)
+ *   http_warm_up                                       (send stage, idle)
+ *
+ * One LatencyHistogram per phase, recorded from whichever thread runs the
+ * phase and rendered as a Prometheus summary by MetricsServer.
+ *******************************************************************************/
+
+#ifndef TAP_METRICS_HPP
+#define TAP_METRICS_HPP
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include "latency_histogram.hpp"
+
+namespace TapMetrics
+{
+    enum Phase
+    {
+        Detect,         // SearchCardExt that found the card
+        KeyLoad,        // Key loaded into the volatile reader slot
+        Authenticate,   // Per sector
+        ReadBlock,      // Per block
+        BuildPayload,   // Request JSON, signing excluded
+        Sign,           // signData
+        Http,           // Tap request posted to response in
+        HttpDns,        // Name lookup
+        HttpConnect,    // TCP connect after the lookup
+        HttpTls,        // TLS handshake, https only
+        HttpFirstByte,  // Request sent to first response byte
+        ParseResponse,  // JSON parse and data extraction
+        VerifySignature,
+        JournalAppend,  // Offline tap into the journal
+        HttpWarmUp,     // Background connect a later tap does not pay for
+        Tap,            // Card read to result
+        PHASE_COUNT
+    };
+
+    // Deferred response signature verification (ResponseAuditor), the
+    // offline tap journal (TapJournal) and connection reuse
+    enum Counter
+    {
+        VerifyFailures,  // Responses whose signature did not verify, alarms
+        VerifyDropped,   // Responses not verified, the audit queue was full
+        JournalAppended, // Taps stored while the server was unreachable
+        JournalReplayed, // Stored taps the server has received since
+        JournalRejected, // Stored taps the server refused, not retried
+        JournalFull,     // Taps lost because the journal was full
+        HttpConnects,    // Tap requests that had to open a connection
+        HttpReused,      // Tap requests sent on an open connection
+        COUNTER_COUNT
+    };
+
+    enum Gauge
+    {
+        VerifyPending,  // Responses waiting for verification
+        JournalPending, // Stored taps not sent yet
+        JournalBytes,   // Journal space they take
+        GAUGE_COUNT
+    };
+
+    const char *phaseName(Phase phase);
+
+    void record(Phase phase, qint64 us);
+    const LatencyHistogram &histogram(Phase phase);
+
+    void increment(Counter counter);
+    quint64 counter(Counter counter);
+    void setGauge(Gauge gauge, qint64 value);
+
+    // Appends all phases, counters and gauges in the Prometheus text format
+    void writePrometheus(QByteArray &out);
+
+    // Records the time since construction when it goes out of scope
+    class PhaseTimer
+    {
+    public:
+        explicit PhaseTimer(Phase phase) : _phase(phase) { _timer.start(); }
+        ~PhaseTimer() { record(_phase, _timer.nsecsElapsed() / 1000); }
+
+        qint64 elapsedUs() const { return _timer.nsecsElapsed() / 1000; }
+
+    private:
+        Phase _phase;
+        QElapsedTimer _timer;
+    };
+}
+
+#endif // TAP_METRICS_HPP
@@ -0,0 +1,354 @@
+/*******************************************************************************
+ * Tap Pipeline Implementation
+ *******************************************************************************/
+
+#include "tap_pipeline.hpp"
+#include "codec.hpp"
+#include "config.hpp"
+#include "log.hpp"
+#include "tap_metrics.hpp"
+#include <QDebug>
+
+TapPipeline::TapPipeline(ScanWorker *source, ApiClient *apiClient, int depth, QObject *parent)
+    : QObject(parent), _source(source), _apiClient(apiClient),
+      _sendQueue(qMax(depth, Config::Snapshot()->batchMaxTaps)),
+      _tapCache(Config::Snapshot()->debounceMaxEntries, Config::Snapshot()->debounceTtlMs),
+      _shortCircuitRepeats(Config::Snapshot()->debounceShortCircuit),
+      _batchMaxTaps(Config::Snapshot()->batchMaxTaps), _batchWindowMs(Config::Snapshot()->batchWindowMs),
+      _warmCheckMs(Config::Snapshot()->apiWarmCheckMs), _maxRequests(Config::Snapshot()->apiMaxConnections),
+      _requestsInFlight(0), _running(false), _sequence(0)
+{
+    qRegisterMetaType<TapResult>("TapResult");
+}
+
+TapPipeline::~TapPipeline()
+{
+    stop();
+}
+
+void TapPipeline::start()
+{
+    if (_running)
+        return;
+
+    qDebug() << "Starting tap pipeline";
+    _sendQueue.reopen();
+    openJournal();
+    _running = true;
+
+    _prepareThread = std::thread(&TapPipeline::prepareStage, this);
+    _sendThread = std::thread(&TapPipeline::sendStage, this);
+}
+
+void TapPipeline::stop()
+{
+    if (!_running)
+        return;
+
+    qDebug() << "Stopping tap pipeline";
+    _running = false;
+
+    // The reader returns at its next poll, downstream stages drain and exit
+    _source->stop();
+    _prepareThread.join();
+    _sendQueue.close();
+    _sendThread.join();
+    _journal.close();
+}
+
+// Delivery of a stored tap by the journal's drain thread. Any answer below
+// 500 settles it: a 4xx will not be accepted on a retry either.
+static bool replayStoredTap(ApiClient *apiClient, const QByteArray &body)
+{
+    ApiClient::Response response = apiClient->replay(body);
+    if (response.statusCode == 0 || response.statusCode >= 500)
+        return false;
+
+    if (response.statusCode >= 400)
+    {
+        TapMetrics::increment(TapMetrics::JournalRejected);
+        LOG_WARNING("Server refused stored tap {} (HTTP {}): {}", response.transactionId, response.statusCode,
+                    response.message);
+    }
+    else
+    {
+        TapMetrics::increment(TapMetrics::JournalReplayed);
+        LOG_INFO("Stored tap {} delivered: {}", response.transactionId, response.message);
+    }
+    return true;
+}
+
+void TapPipeline::openJournal()
+{
+    Config::Snapshot snapshot;
+    const Config &config = *snapshot;
+    if (config.journalPath.isEmpty() ||
+        !_journal.open(config.journalPath, (qint64)config.journalMaxKB * 1024, config.journalSyncIntervalMs))
+        return;
+
+    ApiClient *apiClient = _apiClient;
+    _journal.startDrain([apiClient](const QByteArray &body) { return replayStoredTap(apiClient, body); },
+                        config.journalRetryMinMs, config.journalRetryMaxMs);
+}
+
+void TapPipeline::prepareStage()
+{
+    CardReader::CardData card;
+    while (_source->takeCard(card))
+    {
+        // Card left on the reader: drop it before any signing or HTTP work
+        TapCache::Entry previous;
+        if (_tapCache.lookup(card.cardUid, card.rawData, &previous))
+        {
+            LOG_INFO("Repeat of tap {} for card {} - hits: {} misses: {}", previous.sequence, card.cardUid,
+                     _tapCache.hits(), _tapCache.misses());
+            if (_shortCircuitRepeats)
+            {
+                TapResult result;
+                result.sequence = previous.sequence;
+                result.duplicate = true;
+                result.queued = false;
+                result.card = card;
+                result.response.success = false;
+                result.response.statusCode = 0;
+                result.response.message = Config::Snapshot()->msgDuplicate;
+                result.prepareMs = result.sendMs = result.totalMs = 0;
+                emit tapCompleted(result);
+            }
+            continue;
+        }
+
+        Job job;
+        job.clock.start();
+        job.sequence = ++_sequence;
+        job.card = card;
+
+        LOG_INFO("Tap {} read, card UID: {}", job.sequence, card.cardUid);
+        emit tapRead(job.sequence, card.cardUid);
+
+        // Encode into a buffer reused across taps
+        const QByteArray &raw = job.card.rawData;
+        _hexBuffer.resize(Codec::hexLength(raw.size()));
+        Codec::toHex((const uint8_t *)raw.constData(), raw.size(), _hexBuffer.data());
+        // Batched taps share one signature made by the send stage
+        if (batching())
+            job.request = _apiClient->buildCardTap(job.card.cardUid, QString::fromLatin1(_hexBuffer));
+        else
+            job.request = _apiClient->prepareCardTap(job.card.cardUid, QString::fromLatin1(_hexBuffer));
+        job.prepareMs = job.clock.elapsed();
+        _tapCache.insert(card.cardUid, card.rawData, job.sequence);
+
+        if (!_sendQueue.push(job))
+            break;
+    }
+}
+
+static ApiClient::Response queuedResponse(const ApiClient::Request &request)
+{
+    ApiClient::Response response;
+    response.success = false;
+    response.statusCode = 0;
+    response.message = Config::Snapshot()->msgQueued;
+    response.transactionId = request.transactionId;
+    return response;
+}
+
+bool TapPipeline::batching() const
+{
+    return _batchMaxTaps > 1 && _apiClient->batchSupported();
+}
+
+void TapPipeline::sendStage()
+{
+    Job job;
+    QVector<Job> jobs;
+    _apiClient->keepWarm();
+    for (;;)
+    {
+        // A tap waits here for a free connection rather than inside curl
+        waitToSend();
+
+        // Between taps, reopen the connection the server closed so the next
+        // tap does not pay for the connect. Not while stored taps show the
+        // server is away, the journal is retrying it already.
+        if (!_sendQueue.popFor(job, _warmCheckMs))
+        {
+            if (_sendQueue.isClosed())
+                break;
+            if (_journal.pending() == 0)
+                _apiClient->keepWarm();
+            continue;
+        }
+
+        // With batching, collect until the batch is full or its window closes
+        jobs.clear();
+        jobs.append(job);
+        QElapsedTimer window;
+        window.start();
+        while (batching() && jobs.size() < _batchMaxTaps)
+        {
+            qint64 left = _batchWindowMs - window.elapsed();
+            if (left <= 0 || !_sendQueue.popFor(job, (int)left))
+                break;
+            jobs.append(job);
+        }
+        send(jobs);
+    }
+
+    // Responses still on the way complete before the stage ends, and no
+    // callback touches the pipeline after it
+    QMutexLocker lock(&_sentMutex);
+    while (!_sent.isEmpty() || _requestsInFlight > 0)
+        _sentChanged.wait(&_sentMutex);
+}
+
+void TapPipeline::waitToSend()
+{
+    // Taps done behind a slow one count too, they cannot complete before it
+    QMutexLocker lock(&_sentMutex);
+    while (_requestsInFlight >= _maxRequests || _sent.size() >= _maxRequests * qMax(1, _batchMaxTaps))
+        _sentChanged.wait(&_sentMutex);
+}
+
+void TapPipeline::send(QVector<Job> &jobs)
+{
+    // Behind stored taps: keep their order and do not wait on the network
+    bool backlog = _journal.pending() > 0;
+    QVector<Sent *> live;
+    QVector<ApiClient::Request> requests;
+    for (int i = 0; i < jobs.size(); i++)
+    {
+        Sent *sent = new Sent;
+        sent->job = jobs[i];
+        sent->sendStart = jobs[i].clock.elapsed();
+        sent->done = false;
+        sent->queued = backlog && journal(sent->job);
+        {
+            QMutexLocker lock(&_sentMutex);
+            _sent.append(sent);
+        }
+
+        if (sent->queued)
+        {
+            settle(sent, queuedResponse(sent->job.request), true);
+            continue;
+        }
+        live.append(sent);
+        requests.append(sent->job.request);
+    }
+    if (live.isEmpty())
+        return;
+
+    {
+        QMutexLocker lock(&_sentMutex);
+        _requestsInFlight++;
+    }
+
+    // Called back on the HTTP engine thread, the journal fallback included
+    bool posted;
+    if (live.size() == 1)
+    {
+        Sent *sent = live[0];
+        posted = _apiClient->sendAsync(requests[0], [this, sent](const ApiClient::Response &response)
+                                       {
+                                           settle(sent, response);
+                                           requestDone(); });
+    }
+    else
+    {
+        posted = _apiClient->sendBatchAsync(requests, [this, live](const QVector<ApiClient::Response> &responses)
+                                            {
+                                                for (int i = 0; i < live.size(); i++)
+                                                    settle(live[i], responses[i]);
+                                                requestDone(); });
+        LOG_DEBUG("Sent a batch of {} taps", requests.size());
+    }
+
+    if (!posted)
+    {
+        ApiClient::Response response;
+        response.success = false;
+        response.statusCode = 0;
+        response.message = "HTTP engine not running";
+        for (int i = 0; i < live.size(); i++)
+            settle(live[i], response);
+        requestDone();
+    }
+}
+
+void TapPipeline::settle(Sent *sent, const ApiClient::Response &response, bool queued)
+{
+    QMutexLocker lock(&_sentMutex);
+    sent->response = response;
+    sent->queued = queued;
+    sent->done = true;
+
+    // Taps complete in read order, whichever thread settles the oldest one
+    while (!_sent.isEmpty() && _sent.first()->done)
+    {
+        Sent *head = _sent.takeFirst();
+        if (head->queued)
+            complete(head->job, head->response, head->sendStart, true);
+        else
+            deliver(head->job, head->response, head->sendStart);
+        delete head;
+    }
+    _sentChanged.wakeAll();
+}
+
+void TapPipeline::requestDone()
+{
+    QMutexLocker lock(&_sentMutex);
+    _requestsInFlight--;
+    _sentChanged.wakeAll();
+}
+
+bool TapPipeline::journal(Job &job)
+{
+    if (!_journal.isOpen())
+        return false;
+
+    // Batched taps are stored as single signed requests
+    if (job.request.body.isEmpty())
+        _apiClient->signRequest(job.request);
+    if (!_journal.append(job.request.body))
+    {
+        LOG_WARNING("Tap journal full, tap {} is not stored", job.sequence);
+        return false;
+    }
+    LOG_INFO("Tap {} stored, {} taps waiting for the server", job.sequence, _journal.pending());
+    return true;
+}
+
+void TapPipeline::deliver(Job &job, const ApiClient::Response &response, qint64 sendStart)
+{
+    // Server not reached: store the tap instead of failing it
+    if (response.statusCode == 0 && journal(job))
+        complete(job, queuedResponse(job.request), sendStart, true);
+    else
+        complete(job, response, sendStart);
+}
+
+void TapPipeline::complete(const Job &job, const ApiClient::Response &response, qint64 sendStart, bool queued)
+{
+    TapResult result;
+    result.sequence = job.sequence;
+    result.duplicate = false;
+    result.queued = queued;
+    result.card = job.card;
+    result.response = response;
+    result.prepareMs = job.prepareMs;
+    result.totalMs = job.clock.elapsed();
+    result.sendMs = result.totalMs - sendStart;
+    TapMetrics::record(TapMetrics::Tap, job.clock.nsecsElapsed() / 1000);
+
+    // Only a tap that never reached the server and was not stored may be
+    // retried straight away. A decline stays cached like a success, a card
+    // left on the reader would otherwise be sent again and again.
+    if (!result.response.success && result.response.statusCode == 0 && !queued)
+        _tapCache.remove(result.sequence);
+
+    LOG_INFO("Tap {} done in {} ms (prepare {} ms, send {} ms)", result.sequence, result.totalMs,
+             result.prepareMs, result.sendMs);
+    emit tapCompleted(result);
+}
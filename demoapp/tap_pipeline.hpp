@@ -0,0 +1,131 @@
+/*******************************************************************************
+ * Tap Pipeline - card read, payload signing and HTTP as separate stages
+ *
+ *   ScanWorker ──spsc──> prepare stage ──queue──> send stage ──> UI
+ *
+ * The card read stage is the ScanWorker reader thread. The read and prepare
+ * stages handle one tap at a time. The send stage hands taps to the API
+ * without waiting, up to [API] maxConnections requests at once, and with
+ * [Batch] maxTaps > 1 collects taps into one batch request. Responses come
+ * back on the HTTP engine thread in any order, taps still complete in the
+ * order they were read. Queues are bounded by [Pipeline] depth (at least
+ * maxTaps): when the API falls behind the reader stops taking new cards.
+ *
+ * Taps the server could not be reached for, and taps read while earlier ones
+ * are still waiting, go to the offline TapJournal and complete as queued.
+ * While no tap is waiting the send stage keeps the API connection open.
+ *******************************************************************************/
+
+#ifndef TAP_PIPELINE_HPP
+#define TAP_PIPELINE_HPP
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <thread>
+#include "api_client.hpp"
+#include "bounded_queue.hpp"
+#include "card_reader.hpp"
+#include "scanworker.hpp"
+#include "tap_cache.hpp"
+#include "tap_journal.hpp"
+
+struct TapResult
+{
+    quint64 sequence;
+    bool duplicate;   // Repeat of a recent tap, never sent
+    bool queued;      // In the offline journal, sent once the server is back
+    CardReader::CardData card;
+    ApiClient::Response response;
+    qint64 prepareMs; // Card read to signed payload
+    qint64 sendMs;    // HTTP round trip + verification
+    qint64 totalMs;   // Card read to result
+};
+
+Q_DECLARE_METATYPE(TapResult)
+
+class TapPipeline : public QObject
+{
+    Q_OBJECT
+
+public:
+    TapPipeline(ScanWorker *source, ApiClient *apiClient, int depth, QObject *parent = nullptr);
+    ~TapPipeline();
+
+    void start();
+
+    // Stops the source worker too, the reader thread itself is left to its owner
+    void stop();
+    bool isRunning() const { return _running; }
+
+    // Hit/miss counters of the duplicate tap cache
+    const TapCache &tapCache() const { return _tapCache; }
+
+    // Taps waiting in the offline journal
+    int journalPending() const { return _journal.pending(); }
+
+signals:
+    // Emitted from the pipeline threads, connect with a queued connection
+    void tapRead(quint64 sequence, QString cardUid);
+    void tapCompleted(TapResult result);
+
+private:
+    struct Job
+    {
+        quint64 sequence;
+        CardReader::CardData card;
+        ApiClient::Request request;
+        QElapsedTimer clock;
+        qint64 prepareMs;
+    };
+
+    // A tap handed to the send stage, completed once it and every tap read
+    // before it have their response
+    struct Sent
+    {
+        Job job;
+        qint64 sendStart;
+        bool done;
+        bool queued;
+        ApiClient::Response response;
+    };
+
+    void prepareStage();
+    void sendStage();
+    void send(QVector<Job> &jobs);
+    void waitToSend();
+    void settle(Sent *sent, const ApiClient::Response &response, bool queued = false);
+    void requestDone();
+    bool batching() const;
+    void openJournal();
+    bool journal(Job &job);
+    void deliver(Job &job, const ApiClient::Response &response, qint64 sendStart);
+    void complete(const Job &job, const ApiClient::Response &response, qint64 sendStart, bool queued = false);
+
+    ScanWorker *_source;
+    ApiClient *_apiClient;
+    BoundedQueue<Job> _sendQueue;
+    TapCache _tapCache;
+    TapJournal _journal;
+    bool _shortCircuitRepeats;
+    int _batchMaxTaps; // [Batch] maxTaps, 1 = no batching
+    int _batchWindowMs;
+    int _warmCheckMs;  // [API] warmCheckMs, idle send stage checks the connection
+    int _maxRequests;  // [API] maxConnections
+
+    // Send stage and HTTP engine thread
+    QMutex _sentMutex;
+    QWaitCondition _sentChanged;
+    QList<Sent *> _sent;    // In read order
+    int _requestsInFlight;
+    std::thread _prepareThread;
+    std::thread _sendThread;
+    std::atomic<bool> _running;
+    quint64 _sequence;
+    QByteArray _hexBuffer; // Prepare stage only
+};
+
+#endif // TAP_PIPELINE_HPP
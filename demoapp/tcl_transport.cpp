@@ -0,0 +1,290 @@
+/*******************************************************************************
+ * T=CL Transport Implementation
+ *******************************************************************************/
+
+#include "tcl_transport.hpp"
+#include "log.hpp"
+#include <cstring>
+
+// Protocol control bytes, without CID or NAD
+static const uint8_t RATS = 0xE0;
+static const uint8_t PPSS = 0xD0;
+static const uint8_t PCB_I = 0x02;
+static const uint8_t PCB_CHAIN = 0x10;
+static const uint8_t PCB_R_ACK = 0xA2;
+static const uint8_t PCB_R_NAK = 0xB2;
+static const uint8_t PCB_S_DESELECT = 0xC2;
+static const uint8_t PCB_S_WTX = 0xF2;
+
+// FSDI 8: we accept 256 byte frames
+static const uint8_t RATS_PARAM = 0x80;
+
+static const int FSC_TABLE[9] = {16, 24, 32, 40, 48, 64, 96, 128, 256};
+
+static bool isIBlock(uint8_t pcb) { return (pcb & 0xE2) == PCB_I; }
+static bool isRAck(uint8_t pcb) { return (pcb & 0xF6) == PCB_R_ACK; }
+static bool isWtx(uint8_t pcb) { return (pcb & 0xF7) == PCB_S_WTX; }
+
+// Highest of 2, 4 and 8 set in a 3-bit ATS TA field (bit 0 = 2) within limit
+static int highestDivisor(uint8_t bits, int limit)
+{
+    for (int i = 2; i >= 0; i--)
+    {
+        if ((bits & (1 << i)) && (2 << i) <= limit)
+            return 2 << i;
+    }
+    return 1;
+}
+
+// DS (card to reader) and DR (reader to card) the ATS TA byte offers within
+// limit. Bit 8 asks for the same divisor in both directions.
+static void offeredDivisors(uint8_t ta, int limit, int *ds, int *dr)
+{
+    *ds = *dr = 1;
+    if (limit <= 1 || (ta & 0x77) == 0)
+        return;
+
+    if (ta & 0x80)
+    {
+        *ds = *dr = highestDivisor((ta >> 4) & ta & 0x07, limit);
+    }
+    else
+    {
+        *ds = highestDivisor((ta >> 4) & 0x07, limit);
+        *dr = highestDivisor(ta & 0x07, limit);
+    }
+}
+
+static uint8_t divisorIndex(int divisor)
+{
+    return divisor >= 8 ? 3 : divisor >= 4 ? 2 : divisor >= 2 ? 1 : 0;
+}
+
+TclTransport::TclTransport(CouplerBackend *backend, int maxBitRateKbps)
+    : _backend(backend), _couplerFraming(false), _maxDivisor(qBound(1, maxBitRateKbps / 106, 8)), _fsc(32), _fsd(BUFFER_SIZE),
+      _divisorSend(1), _divisorReceive(1), _blockNumber(0), _lastFrames(0), _wtxCount(0), _retransmissions(0)
+{
+}
+
+bool TclTransport::fail(const QString &message)
+{
+    _error = message;
+    LOG_WARNING("{}", message);
+    return false;
+}
+
+bool TclTransport::activate()
+{
+    _blockNumber = 0;
+    _error.clear();
+    _divisorSend = _divisorReceive = 1;
+    _couplerFraming = _backend->activatesIsoDep();
+
+    if (_couplerFraming)
+    {
+        // RATS and PPS already went out with the search, a second RATS would
+        // go unanswered. The coupler picks the rate up to its own limit.
+        QByteArray ats = _backend->isoDepAts();
+        if (ats.isEmpty())
+            return fail("ISO14443-4 card not activated by the coupler");
+        uint8_t ta = parseAts((const uint8_t *)ats.constData(), ats.size());
+        offeredDivisors(ta, _backend->maxBitRateDivisor(), &_divisorReceive, &_divisorSend);
+    }
+    else
+    {
+        _tx[0] = RATS;
+        _tx[1] = RATS_PARAM;
+        uint16_t rxLen = BUFFER_SIZE;
+        if (!_backend->transceive(_tx, 2, _rx, &rxLen) || rxLen < 1 || _rx[0] > rxLen)
+            return fail("ISO14443-4 RATS failed");
+        negotiateBitRate(parseAts(_rx, rxLen));
+    }
+
+    LOG_DEBUG("ISO14443-4 active: FSC {} FSD {} bit rate {} kbit/s{}", _fsc, _fsd, bitRateKbps(),
+              _couplerFraming ? ", framed by the coupler" : "");
+    return true;
+}
+
+// ATS: TL, T0, [TA], [TB], [TC], historical bytes. Sets the FSC and returns
+// TA, 0 when absent.
+uint8_t TclTransport::parseAts(const uint8_t *ats, int length)
+{
+    uint8_t tl = qMin((int)ats[0], length);
+    uint8_t ta = 0;
+    _fsc = FSC_TABLE[2];
+    if (tl > 1)
+    {
+        uint8_t t0 = ats[1];
+        _fsc = FSC_TABLE[qMin(t0 & 0x0F, 8)];
+        if ((t0 & 0x10) && tl > 2)
+            ta = ats[2];
+        // TB (FWI, SFGI) is applied by the coupler, TC is unused without CID/NAD
+    }
+    return ta;
+}
+
+void TclTransport::negotiateBitRate(uint8_t ta)
+{
+    int ds, dr;
+    offeredDivisors(ta, qMin(_maxDivisor, _backend->maxBitRateDivisor()), &ds, &dr);
+    if (ds == 1 && dr == 1)
+        return;
+
+    _tx[0] = PPSS;
+    _tx[1] = 0x11; // PPS1 follows
+    _tx[2] = (uint8_t)((divisorIndex(ds) << 2) | divisorIndex(dr));
+    uint16_t rxLen = BUFFER_SIZE;
+    if (!_backend->transceive(_tx, 3, _rx, &rxLen) || rxLen < 1 || _rx[0] != PPSS)
+    {
+        LOG_DEBUG("ISO14443-4 PPS refused, staying at 106 kbit/s");
+        return;
+    }
+
+    if (!_backend->setBitRate(ds, dr))
+    {
+        LOG_WARNING("Coupler could not switch to the negotiated bit rate");
+        return;
+    }
+
+    _divisorReceive = ds;
+    _divisorSend = dr;
+}
+
+bool TclTransport::exchangeBlock(uint16_t txLen, uint16_t *rxLen)
+{
+    const uint8_t *frame = _tx;
+    uint16_t frameLen = txLen;
+    uint8_t control[2];
+    int retries = 0;
+    int wtx = 0;
+
+    while (true)
+    {
+        *rxLen = BUFFER_SIZE;
+        _lastFrames++;
+
+        if (!_backend->transceive(frame, frameLen, _rx, rxLen) || *rxLen == 0)
+        {
+            // Lost frame: R(NAK) makes the card repeat its last block
+            if (++retries > MAX_RETRIES)
+                return fail("ISO14443-4 card not responding");
+            _retransmissions++;
+            control[0] = PCB_R_NAK | _blockNumber;
+            frame = control;
+            frameLen = 1;
+            continue;
+        }
+
+        uint8_t pcb = _rx[0];
+        if (isWtx(pcb))
+        {
+            // Card needs more time, grant the multiplier it asked for
+            if (++wtx > MAX_WTX)
+                return fail("ISO14443-4 card keeps requesting waiting time");
+            _wtxCount++;
+            control[0] = pcb;
+            control[1] = *rxLen > 1 ? (_rx[1] & 0x3F) : 1;
+            frame = control;
+            frameLen = 2;
+            continue;
+        }
+
+        // R(ACK) with the other block number after our R(NAK): the card never
+        // received the block, send it again
+        if (frame == control && control[0] == (PCB_R_NAK | _blockNumber) && isRAck(pcb) &&
+            (pcb & 0x01) != _blockNumber)
+        {
+            if (++retries > MAX_RETRIES)
+                return fail("ISO14443-4 block not received by the card");
+            frame = _tx;
+            frameLen = txLen;
+            continue;
+        }
+
+        return true;
+    }
+}
+
+bool TclTransport::transmit(const uint8_t *apdu, int length, QByteArray &response)
+{
+    response.clear();
+    _lastFrames = 0;
+    _error.clear();
+
+    if (_couplerFraming)
+    {
+        // Chaining, WTX and retransmissions happen inside the coupler
+        _lastFrames = 1;
+        response.resize(MAX_RESPONSE);
+        uint16_t rxLen = MAX_RESPONSE;
+        if (!_backend->transceive(apdu, (uint16_t)length, (uint8_t *)response.data(), &rxLen))
+        {
+            response.clear();
+            return fail("ISO14443-4 card not responding");
+        }
+        response.resize(rxLen);
+    }
+    else if (!transmitBlocks(apdu, length, response))
+    {
+        return false;
+    }
+
+    if (response.size() < 2)
+        return fail("ISO14443-4 response without status word");
+    return true;
+}
+
+bool TclTransport::transmitBlocks(const uint8_t *apdu, int length, QByteArray &response)
+{
+    int maxInf = _fsc - FRAME_OVERHEAD;
+    int sent = 0;
+    uint16_t rxLen = 0;
+
+    // Command chaining: every block but the last is acknowledged with R(ACK)
+    do
+    {
+        int chunk = qMin(maxInf, length - sent);
+        bool more = sent + chunk < length;
+        _tx[0] = PCB_I | _blockNumber | (more ? PCB_CHAIN : 0);
+        memcpy(_tx + 1, apdu + sent, chunk);
+        sent += chunk;
+
+        if (!exchangeBlock(1 + chunk, &rxLen))
+            return false;
+
+        if (more)
+        {
+            if (!isRAck(_rx[0]) || (_rx[0] & 0x01) != _blockNumber)
+                return fail("ISO14443-4 chained command not acknowledged");
+            _blockNumber ^= 1;
+        }
+    } while (sent < length);
+
+    // Response chaining: acknowledge until a block without the chaining bit
+    while (true)
+    {
+        if (!isIBlock(_rx[0]))
+            return fail(QString("ISO14443-4 unexpected block %1").arg(_rx[0], 2, 16, QChar('0')));
+
+        _blockNumber ^= 1;
+        response.append((const char *)_rx + 1, rxLen - 1);
+        if (!(_rx[0] & PCB_CHAIN))
+            break;
+
+        _tx[0] = PCB_R_ACK | _blockNumber;
+        if (!exchangeBlock(1, &rxLen))
+            return false;
+    }
+    return true;
+}
+
+void TclTransport::deselect()
+{
+    if (_couplerFraming)
+        return;
+
+    _tx[0] = PCB_S_DESELECT;
+    uint16_t rxLen = BUFFER_SIZE;
+    if (!_backend->transceive(_tx, 1, _rx, &rxLen) || rxLen < 1 || _rx[0] != PCB_S_DESELECT)
+        LOG_DEBUG("ISO14443-4 deselect not confirmed");
+}
@@ -0,0 +1,86 @@
+/*******************************************************************************
+ * T=CL Transport - ISO14443-4 block protocol over the coupler
+ *
+ * Activates the card with RATS and PPS at the highest bit rate both sides
+ * support, then carries APDUs in I-blocks: command chaining when an APDU is
+ * larger than the card frame size (FSC), response chaining acknowledged with
+ * R(ACK), S(WTX) answered transparently and R(NAK) recovery of lost frames.
+ *
+ * A coupler that activates the card during the search and runs the block
+ * protocol itself (CouplerBackend::activatesIsoDep()) gets the APDUs as they
+ * are; FSC and bit rate are then only read from the ATS it reports.
+ *******************************************************************************/
+
+#ifndef TCL_TRANSPORT_HPP
+#define TCL_TRANSPORT_HPP
+
+#include <QByteArray>
+#include <QString>
+#include "coupler_backend.hpp"
+
+class TclTransport
+{
+public:
+    // maxBitRateKbps caps the PPS choice (106, 212, 424 or 848)
+    TclTransport(CouplerBackend *backend, int maxBitRateKbps);
+
+    // RATS, then PPS when the card and the coupler can go faster than 106.
+    // Only reads the ATS when the coupler has activated the card.
+    bool activate();
+
+    // Send one command APDU, response holds the data and SW1 SW2
+    bool transmit(const uint8_t *apdu, int length, QByteArray &response);
+    bool transmit(const QByteArray &apdu, QByteArray &response)
+    {
+        return transmit((const uint8_t *)apdu.constData(), apdu.size(), response);
+    }
+
+    // S(DESELECT), the card goes to HALT. Left to the coupler when it runs
+    // the block protocol.
+    void deselect();
+
+    // Largest APDU response (data + SW) that comes back in a single frame
+    int maxResponseInFrame() const { return _fsd - FRAME_OVERHEAD; }
+
+    int fsc() const { return _fsc; }
+    int fsd() const { return _fsd; }
+    int bitRateKbps() const { return 106 * _divisorReceive; }
+    int lastFrames() const { return _lastFrames; } // Of the last transmit(), 1 per APDU on coupler framing
+    int wtxCount() const { return _wtxCount; }
+    int retransmissions() const { return _retransmissions; }
+    const QString &error() const { return _error; }
+
+private:
+    // Coupler strips the CRC, buffers hold PCB + INF
+    static const int BUFFER_SIZE = 256;
+    // PCB + CRC, no CID or NAD is used
+    static const int FRAME_OVERHEAD = 3;
+    static const int MAX_WTX = 64;
+    static const int MAX_RETRIES = 2;
+    // Short APDU response: 256 data bytes + SW1 SW2
+    static const int MAX_RESPONSE = 258;
+
+    uint8_t parseAts(const uint8_t *ats, int length);
+    bool exchangeBlock(uint16_t txLen, uint16_t *rxLen);
+    bool transmitBlocks(const uint8_t *apdu, int length, QByteArray &response);
+    bool fail(const QString &message);
+    void negotiateBitRate(uint8_t ta);
+
+    CouplerBackend *_backend;
+    bool _couplerFraming; // Coupler activated the card and frames the APDUs
+    int _maxDivisor;
+    int _fsc;
+    int _fsd;
+    int _divisorSend;    // PCD -> PICC (DR)
+    int _divisorReceive; // PICC -> PCD (DS)
+    uint8_t _blockNumber;
+    int _lastFrames;
+    int _wtxCount;
+    int _retransmissions;
+    QString _error;
+
+    uint8_t _tx[BUFFER_SIZE];
+    uint8_t _rx[BUFFER_SIZE];
+};
+
+#endif // TCL_TRANSPORT_HPP
@@ -0,0 +1,146 @@
+/*******************************************************************************
+ * Codec Tests - SIMD kernels against the scalar path, decode round trips
+ *
+ * Lengths run from the empty input past two 48-byte NEON base64 blocks, so
+ * every vector kernel meets each of its tail lengths, at unaligned offsets.
+ *******************************************************************************/
+
+#include "codec.hpp"
+#include "test_suite.hpp"
+#include <QByteArray>
+#include <QTest>
+
+static const int MAX_LENGTH = 130;
+static const int MAX_OFFSET = 3;
+
+// Deterministic bytes, all 256 values show up
+static QByteArray pattern(int length)
+{
+    QByteArray bytes(length + MAX_OFFSET, Qt::Uninitialized);
+    uint32_t state = 0x12345678;
+    for (int i = 0; i < bytes.size(); i++)
+    {
+        state = state * 1103515245 + 12345;
+        bytes[i] = (char)(state >> 16);
+    }
+    return bytes;
+}
+
+class CodecTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void hexMatchesScalar();
+    void hexRoundTrip();
+    void fromHexEitherCase();
+    void fromHexRejectsInvalid();
+    void base64MatchesScalar();
+    void base64RoundTrip();
+    void fromBase64SkipsWhitespace();
+    void fromBase64RejectsInvalid();
+};
+
+void CodecTests::hexMatchesScalar()
+{
+    for (int length = 0; length <= MAX_LENGTH; length++)
+    {
+        QByteArray bytes = pattern(length);
+        for (int offset = 0; offset <= MAX_OFFSET; offset++)
+        {
+            const uint8_t *in = (const uint8_t *)bytes.constData() + offset;
+            QByteArray codec(Codec::hexLength(length), Qt::Uninitialized);
+            QByteArray scalar(Codec::hexLength(length), Qt::Uninitialized);
+            Codec::toHex(in, length, codec.data());
+            Codec::toHexScalar(in, length, scalar.data());
+            QCOMPARE(codec, scalar);
+            QCOMPARE(codec, bytes.mid(offset, length).toHex().toUpper());
+        }
+    }
+}
+
+void CodecTests::hexRoundTrip()
+{
+    for (int length = 0; length <= MAX_LENGTH; length++)
+    {
+        QByteArray bytes = pattern(length).left(length);
+        QByteArray hex(Codec::hexLength(length), Qt::Uninitialized);
+        Codec::toHex((const uint8_t *)bytes.constData(), length, hex.data());
+
+        QByteArray decoded(length, Qt::Uninitialized);
+        QCOMPARE(Codec::fromHex(hex.constData(), hex.size(), (uint8_t *)decoded.data()), length);
+        QCOMPARE(decoded, bytes);
+    }
+}
+
+void CodecTests::fromHexEitherCase()
+{
+    uint8_t out[4];
+    QCOMPARE(Codec::fromHex("aBcD0f9E", 8, out), 4);
+    QCOMPARE((int)out[0], 0xAB);
+    QCOMPARE((int)out[1], 0xCD);
+    QCOMPARE((int)out[2], 0x0F);
+    QCOMPARE((int)out[3], 0x9E);
+}
+
+void CodecTests::fromHexRejectsInvalid()
+{
+    uint8_t out[4];
+    QCOMPARE(Codec::fromHex("ABC", 3, out), -1);
+    QCOMPARE(Codec::fromHex("0G", 2, out), -1);
+    QCOMPARE(Codec::fromHex("A B ", 4, out), -1);
+}
+
+void CodecTests::base64MatchesScalar()
+{
+    for (int length = 0; length <= MAX_LENGTH; length++)
+    {
+        QByteArray bytes = pattern(length);
+        for (int offset = 0; offset <= MAX_OFFSET; offset++)
+        {
+            const uint8_t *in = (const uint8_t *)bytes.constData() + offset;
+            QByteArray codec(Codec::base64Length(length), Qt::Uninitialized);
+            QByteArray scalar(Codec::base64Length(length), Qt::Uninitialized);
+            QCOMPARE(Codec::toBase64(in, length, codec.data()), Codec::base64Length(length));
+            QCOMPARE(Codec::toBase64Scalar(in, length, scalar.data()), Codec::base64Length(length));
+            QCOMPARE(codec, scalar);
+            QCOMPARE(codec, bytes.mid(offset, length).toBase64());
+        }
+    }
+}
+
+void CodecTests::base64RoundTrip()
+{
+    for (int length = 0; length <= MAX_LENGTH; length++)
+    {
+        QByteArray bytes = pattern(length).left(length);
+        QByteArray text(Codec::base64Length(length), Qt::Uninitialized);
+        Codec::toBase64((const uint8_t *)bytes.constData(), length, text.data());
+
+        QByteArray decoded(Codec::base64DecodedMaxLength(text.size()), Qt::Uninitialized);
+        int written = Codec::fromBase64(text.constData(), text.size(), (uint8_t *)decoded.data());
+        QCOMPARE(written, length);
+        QCOMPARE(decoded.left(written), bytes);
+    }
+}
+
+void CodecTests::fromBase64SkipsWhitespace()
+{
+    QByteArray text("AQID\nBA==\r\n");
+    uint8_t out[Codec::base64DecodedMaxLength(11)];
+    QCOMPARE(Codec::fromBase64(text.constData(), text.size(), out), 4);
+    QCOMPARE(QByteArray((const char *)out, 4), QByteArray::fromHex("01020304"));
+}
+
+void CodecTests::fromBase64RejectsInvalid()
+{
+    uint8_t out[16];
+    QCOMPARE(Codec::fromBase64("AQ!D", 4, out), -1);
+    QCOMPARE(Codec::fromBase64("A", 1, out), -1);
+    QCOMPARE(Codec::fromBase64("A===", 4, out), -1);
+    QCOMPARE(Codec::fromBase64("AQ==AQID", 8, out), -1);
+}
+
+TEST_CLASS(CodecTests)
+
+#include "codec_tests.moc"
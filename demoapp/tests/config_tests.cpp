@@ -0,0 +1,165 @@
+/*******************************************************************************
+ * Config Tests - snapshot publishing, pinning and reclamation
+ *
+ * The current snapshot is process-wide, each test publishes its own before
+ * looking at it. Config::retiredSnapshots() shows what publish() could not
+ * free: it must hold exactly the pinned snapshots and drop to zero at the
+ * first publish() after the last pin went away.
+ *******************************************************************************/
+
+#include "config.hpp"
+#include "test_suite.hpp"
+#include <QTest>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+static Config stationConfig(const QString &stationCode)
+{
+    Config config;
+    config.stationCode = stationCode;
+    return config;
+}
+
+class ConfigTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void publishReplacesSnapshot();
+    void pinKeepsSnapshotAlive();
+    void nestedPinsShareSnapshot();
+    void pinOnAnotherThread();
+    void readersDuringPublishes();
+};
+
+void ConfigTests::publishReplacesSnapshot()
+{
+    quint64 first = Config::publish(stationConfig("A"));
+    quint64 second = Config::publish(stationConfig("B"));
+    QCOMPARE(second, first + 1);
+
+    Config::Snapshot snapshot;
+    QCOMPARE(snapshot->generation, second);
+    QCOMPARE(snapshot->stationCode, QString("B"));
+    QCOMPARE(Config::retiredSnapshots(), 0);
+}
+
+void ConfigTests::pinKeepsSnapshotAlive()
+{
+    Config::publish(stationConfig("old"));
+    {
+        Config::Snapshot pinned;
+        quint64 generation = pinned->generation;
+
+        Config::publish(stationConfig("new"));
+        QCOMPARE(Config::retiredSnapshots(), 1);
+        QCOMPARE(pinned->stationCode, QString("old"));
+        QCOMPARE(pinned->generation, generation);
+
+        // The unpinned snapshot in between goes at once, the pinned one stays
+        Config::publish(stationConfig("newer"));
+        QCOMPARE(Config::retiredSnapshots(), 1);
+        QCOMPARE(pinned->stationCode, QString("old"));
+    }
+
+    Config::publish(stationConfig("newest"));
+    QCOMPARE(Config::retiredSnapshots(), 0);
+}
+
+void ConfigTests::nestedPinsShareSnapshot()
+{
+    Config::publish(stationConfig("outer"));
+    Config::Snapshot outer;
+    Config::publish(stationConfig("inner"));
+    {
+        // A whole tap sees one snapshot, even across a reload
+        Config::Snapshot inner;
+        QCOMPARE(&*inner, &*outer);
+        QCOMPARE(inner->stationCode, QString("outer"));
+    }
+
+    // Releasing the inner pin does not release the outer one
+    Config::publish(stationConfig("later"));
+    QCOMPARE(Config::retiredSnapshots(), 1);
+    QCOMPARE(outer->stationCode, QString("outer"));
+}
+
+void ConfigTests::pinOnAnotherThread()
+{
+    Config::publish(stationConfig("before"));
+
+    std::atomic<int> step(0);
+    QString seen;
+    std::thread reader([&]
+                       {
+                           Config::Snapshot snapshot;
+                           step = 1;
+                           while (step.load() != 2)
+                               std::this_thread::yield();
+                           seen = snapshot->stationCode;
+                       });
+    while (step.load() != 1)
+        std::this_thread::yield();
+
+    // Checked once the thread is joined, a failed check returns early
+    Config::publish(stationConfig("after"));
+    int retired = Config::retiredSnapshots();
+    step = 2;
+    reader.join();
+    QCOMPARE(retired, 1);
+    QCOMPARE(seen, QString("before"));
+
+    // The reader thread ended, its slot no longer holds anything
+    Config::publish(stationConfig("done"));
+    QCOMPARE(Config::retiredSnapshots(), 0);
+}
+
+void ConfigTests::readersDuringPublishes()
+{
+    // Each snapshot's cardTypeId is set to the generation it gets, a reader
+    // seeing them differ read a freed or torn snapshot
+    Config first;
+    first.cardTypeId = (int)(Config::Snapshot()->generation + 1);
+    Config::publish(first);
+
+    std::atomic<bool> running(true);
+    std::atomic<int> mismatches(0);
+    std::atomic<quint64> pins(0);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; i++)
+    {
+        readers.push_back(std::thread([&]
+                                      {
+                                          while (running.load())
+                                          {
+                                              Config::Snapshot snapshot;
+                                              if ((quint64)snapshot->cardTypeId != snapshot->generation)
+                                                  mismatches++;
+                                              pins++;
+                                          }
+                                      }));
+    }
+
+    int misnumbered = 0;
+    for (int i = 0; i < 2000; i++)
+    {
+        Config config;
+        config.cardTypeId = (int)(Config::Snapshot()->generation + 1);
+        if (Config::publish(config) != (quint64)config.cardTypeId)
+            misnumbered++;
+    }
+    running = false;
+    for (size_t i = 0; i < readers.size(); i++)
+        readers[i].join();
+
+    QCOMPARE(misnumbered, 0);
+    QCOMPARE(mismatches.load(), 0);
+    QVERIFY(pins.load() > 0);
+    Config::publish(Config());
+    QCOMPARE(Config::retiredSnapshots(), 0);
+}
+
+TEST_CLASS(ConfigTests)
+
+#include "config_tests.moc"
@@ -0,0 +1,233 @@
+/*******************************************************************************
+ * Journal Tests - TapJournal delivery order and crash recovery
+ *
+ * The journal file is reopened by a second TapJournal, which recovers it the
+ * way a restart after a crash or power loss would. Offsets below follow the
+ * file layout in tap_journal.hpp: records start at the first 4 KB page, each
+ * a 24-byte header and its payload, 8-byte aligned.
+ *******************************************************************************/
+
+#include "tap_journal.hpp"
+#include "test_suite.hpp"
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QScopedPointer>
+#include <QTemporaryDir>
+#include <QTest>
+
+static const qint64 CAPACITY = 68 * 1024; // The smallest journal, 64 KB of records
+static const qint64 DATA_START = 4096;
+static const qint64 RECORD_HEADER = 24;
+static const int SYNC_INTERVAL_MS = 10;
+
+// Records the drain thread delivers, the server always accepts
+class Collector
+{
+public:
+    TapJournal::Sender sender()
+    {
+        return [this](const QByteArray &record)
+        {
+            QMutexLocker lock(&_mutex);
+            _records.append(record);
+            return true;
+        };
+    }
+
+    int count()
+    {
+        QMutexLocker lock(&_mutex);
+        return _records.size();
+    }
+
+    QList<QByteArray> records()
+    {
+        QMutexLocker lock(&_mutex);
+        return _records;
+    }
+
+private:
+    QMutex _mutex;
+    QList<QByteArray> _records;
+};
+
+// Distinct records of a fixed size, so their offsets are known
+static QByteArray record(int index, int size)
+{
+    return QByteArray::number(index).leftJustified(size, '.');
+}
+
+class JournalTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void deliversInOrder();
+    void recoversUnsentRecords();
+    void dropsTornRecord();
+    void recoversAfterWrapAround();
+    void refusesRecordsWhenFull();
+
+private:
+    QString path() const { return _dir->filePath("tap_journal.bin"); }
+
+    QScopedPointer<QTemporaryDir> _dir;
+};
+
+void JournalTests::init()
+{
+    _dir.reset(new QTemporaryDir);
+    QVERIFY(_dir->isValid());
+}
+
+void JournalTests::deliversInOrder()
+{
+    TapJournal journal;
+    QVERIFY(journal.open(path(), CAPACITY, SYNC_INTERVAL_MS));
+    for (int i = 0; i < 20; i++)
+        QVERIFY(journal.append(record(i, 100)));
+    QCOMPARE(journal.pending(), 20);
+
+    Collector collector;
+    journal.startDrain(collector.sender(), 1, 1);
+    QTRY_COMPARE(collector.count(), 20);
+    QTRY_COMPARE(journal.pending(), 0);
+    for (int i = 0; i < 20; i++)
+        QCOMPARE(collector.records()[i], record(i, 100));
+    journal.close();
+}
+
+void JournalTests::recoversUnsentRecords()
+{
+    {
+        TapJournal journal;
+        QVERIFY(journal.open(path(), CAPACITY, SYNC_INTERVAL_MS));
+        for (int i = 0; i < 5; i++)
+            QVERIFY(journal.append(record(i, 100)));
+        journal.close();
+    }
+
+    TapJournal journal;
+    QVERIFY(journal.open(path(), CAPACITY, SYNC_INTERVAL_MS));
+    QCOMPARE(journal.pending(), 5);
+
+    // New records go after the recovered ones
+    QVERIFY(journal.append(record(5, 100)));
+    Collector collector;
+    journal.startDrain(collector.sender(), 1, 1);
+    QTRY_COMPARE(collector.count(), 6);
+    for (int i = 0; i < 6; i++)
+        QCOMPARE(collector.records()[i], record(i, 100));
+    journal.close();
+}
+
+void JournalTests::dropsTornRecord()
+{
+    const int size = 100;
+    const qint64 stride = (RECORD_HEADER + size + 7) & ~7;
+    {
+        TapJournal journal;
+        QVERIFY(journal.open(path(), CAPACITY, SYNC_INTERVAL_MS));
+        for (int i = 0; i < 3; i++)
+            QVERIFY(journal.append(record(i, size)));
+        journal.close();
+    }
+
+    // Power lost while the third record was written: its payload is only
+    // half on disk
+    {
+        QFile file(path());
+        QVERIFY(file.open(QIODevice::ReadWrite));
+        QVERIFY(file.seek(DATA_START + 2 * stride + RECORD_HEADER + size / 2));
+        QCOMPARE(file.write(QByteArray(size / 2, '\0')), (qint64)size / 2);
+        file.close();
+    }
+
+    TapJournal journal;
+    QVERIFY(journal.open(path(), CAPACITY, SYNC_INTERVAL_MS));
+    QCOMPARE(journal.pending(), 2);
+
+    // The torn record's space is taken by the next one
+    QVERIFY(journal.append(record(3, size)));
+    Collector collector;
+    journal.startDrain(collector.sender(), 1, 1);
+    QTRY_COMPARE(collector.count(), 3);
+    QCOMPARE(collector.records()[0], record(0, size));
+    QCOMPARE(collector.records()[1], record(1, size));
+    QCOMPARE(collector.records()[2], record(3, size));
+    journal.close();
+
+    // Nothing of the torn record comes back after another restart
+    TapJournal reopened;
+    QVERIFY(reopened.open(path(), CAPACITY, SYNC_INTERVAL_MS));
+    QCOMPARE(reopened.pending(), 0);
+    reopened.close();
+}
+
+void JournalTests::recoversAfterWrapAround()
+{
+    // 1 KB records, 64 of them fill the ring
+    const int size = 1024 - RECORD_HEADER;
+    {
+        TapJournal journal;
+        QVERIFY(journal.open(path(), CAPACITY, SYNC_INTERVAL_MS));
+        for (int i = 0; i < 60; i++)
+            QVERIFY(journal.append(record(i, size)));
+        Collector collector;
+        journal.startDrain(collector.sender(), 1, 1);
+        QTRY_COMPARE(journal.pending(), 0);
+        journal.close();
+    }
+
+    // Four records fit before the end of the file, the rest wrap around
+    // onto the delivered ones of the first lap
+    {
+        TapJournal journal;
+        QVERIFY(journal.open(path(), CAPACITY, SYNC_INTERVAL_MS));
+        QCOMPARE(journal.pending(), 0);
+        for (int i = 0; i < 10; i++)
+            QVERIFY(journal.append(record(100 + i, size)));
+        journal.close();
+    }
+
+    TapJournal journal;
+    QVERIFY(journal.open(path(), CAPACITY, SYNC_INTERVAL_MS));
+    QCOMPARE(journal.pending(), 10);
+    Collector collector;
+    journal.startDrain(collector.sender(), 1, 1);
+    QTRY_COMPARE(collector.count(), 10);
+    for (int i = 0; i < 10; i++)
+        QCOMPARE(collector.records()[i], record(100 + i, size));
+    journal.close();
+}
+
+void JournalTests::refusesRecordsWhenFull()
+{
+    const int size = 1024 - RECORD_HEADER;
+    int stored = 0;
+    {
+        TapJournal journal;
+        QVERIFY(journal.open(path(), CAPACITY, SYNC_INTERVAL_MS));
+        while (stored < 100 && journal.append(record(stored, size)))
+            stored++;
+        QCOMPARE(stored, 64);
+        QCOMPARE(journal.pending(), stored);
+        journal.close();
+    }
+
+    // The refused records did not overwrite the stored ones
+    TapJournal journal;
+    QVERIFY(journal.open(path(), CAPACITY, SYNC_INTERVAL_MS));
+    QCOMPARE(journal.pending(), stored);
+    Collector collector;
+    journal.startDrain(collector.sender(), 1, 1);
+    QTRY_COMPARE(collector.count(), stored);
+    QCOMPARE(collector.records().last(), record(stored - 1, size));
+    journal.close();
+}
+
+TEST_CLASS(JournalTests)
+
+#include "journal_tests.moc"
@@ -0,0 +1,128 @@
+/*******************************************************************************
+ * Read Plan Tests - [ReadPlan] entry parsing
+ *
+ * A rejected entry must be left out of the plan entirely, never read with a
+ * default in place of the part that did not parse.
+ *******************************************************************************/
+
+#include "read_plan.hpp"
+#include "test_suite.hpp"
+#include <QByteArray>
+#include <QTest>
+
+static const uint8_t DEFAULT_KEY[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+static const int SECTORS_1K = 16;
+
+static QByteArray keyOf(const ReadPlan::Sector &sector)
+{
+    return QByteArray((const char *)sector.key, 6).toHex().toUpper();
+}
+
+class ReadPlanTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void parsesEntries();
+    void rejectsBadEntry_data();
+    void rejectsBadEntry();
+    void clipsRangeToDataBlocks();
+    void groupsSectorsByKey();
+};
+
+void ReadPlanTests::parsesEntries()
+{
+    QStringList entries;
+    entries << "8:32-33:a0a1a2a3a4a5" << " 3:12-14 " << "4";
+    ReadPlan plan = ReadPlan::parse(entries, DEFAULT_KEY, SECTORS_1K);
+
+    QCOMPARE(plan.sectors.size(), 3);
+    QCOMPARE(plan.sectors[0].sector, 3);
+    QCOMPARE(plan.sectors[0].firstBlock, 12);
+    QCOMPARE(plan.sectors[0].lastBlock, 14);
+    QCOMPARE(keyOf(plan.sectors[0]), QByteArray("FFFFFFFFFFFF"));
+    QCOMPARE(plan.sectors[0].offset, 0);
+
+    // A bare sector reads its data blocks, the trailer is skipped
+    QCOMPARE(plan.sectors[1].sector, 4);
+    QCOMPARE(plan.sectors[1].firstBlock, 16);
+    QCOMPARE(plan.sectors[1].lastBlock, 18);
+    QCOMPARE(plan.sectors[1].offset, 3 * 16);
+
+    QCOMPARE(plan.sectors[2].sector, 8);
+    QCOMPARE(plan.sectors[2].firstBlock, 32);
+    QCOMPARE(plan.sectors[2].lastBlock, 33);
+    QCOMPARE(keyOf(plan.sectors[2]), QByteArray("A0A1A2A3A4A5"));
+    QCOMPARE(plan.sectors[2].offset, 6 * 16);
+
+    QCOMPARE(plan.blockCount(), 8);
+}
+
+void ReadPlanTests::rejectsBadEntry_data()
+{
+    QTest::addColumn<QString>("entry");
+
+    QTest::newRow("not a number") << "x";
+    QTest::newRow("negative sector") << "-1";
+    QTest::newRow("sector past the card") << "16";
+    QTest::newRow("range not a number") << "5:a-b";
+    QTest::newRow("range with three parts") << "5:20-21-22";
+    QTest::newRow("range outside the sector") << "5:4-6";
+    QTest::newRow("only the trailer") << "5:23";
+    QTest::newRow("key too short") << "5:20-21:A0A1A2";
+    QTest::newRow("key too long") << "5:20-21:A0A1A2A3A4A5A6";
+    QTest::newRow("key not hex") << "5:20-21:ZZZZZZZZZZZZ";
+    QTest::newRow("key with a space") << "5:20-21:A0 A1A2A3A4A5";
+    QTest::newRow("key with a stray character") << "5:20-21:A0A1A2A3A4A5G";
+}
+
+void ReadPlanTests::rejectsBadEntry()
+{
+    QFETCH(QString, entry);
+
+    // Next to a good entry, which must still be read
+    QStringList entries;
+    entries << "3:12-14" << entry;
+    ReadPlan plan = ReadPlan::parse(entries, DEFAULT_KEY, SECTORS_1K);
+
+    QCOMPARE(plan.sectors.size(), 1);
+    QCOMPARE(plan.sectors[0].sector, 3);
+    QCOMPARE(plan.order.size(), 1);
+}
+
+void ReadPlanTests::clipsRangeToDataBlocks()
+{
+    // Block 11 belongs to sector 2 and block 15 is the trailer
+    QStringList entries;
+    entries << "3:11-15" << "3:13";
+    ReadPlan plan = ReadPlan::parse(entries, DEFAULT_KEY, SECTORS_1K);
+
+    // The second entry is a duplicate of sector 3
+    QCOMPARE(plan.sectors.size(), 1);
+    QCOMPARE(plan.sectors[0].firstBlock, 12);
+    QCOMPARE(plan.sectors[0].lastBlock, 14);
+}
+
+void ReadPlanTests::groupsSectorsByKey()
+{
+    QStringList entries;
+    entries << "1:4-4:B0B1B2B3B4B5" << "2:8-8" << "3:12-12:B0B1B2B3B4B5" << "4:16-16";
+    ReadPlan plan = ReadPlan::parse(entries, DEFAULT_KEY, SECTORS_1K);
+
+    // Layout stays in sector order, execution runs each key's sectors back to back
+    QCOMPARE(plan.sectors.size(), 4);
+    QCOMPARE(plan.order.size(), 4);
+    for (int i = 1; i < plan.order.size(); i++)
+    {
+        const ReadPlan::Sector &previous = plan.sectors[plan.order[i - 1]];
+        const ReadPlan::Sector &sector = plan.sectors[plan.order[i]];
+        if (keyOf(previous) == keyOf(sector))
+            QVERIFY(sector.sector > previous.sector);
+    }
+    QCOMPARE(keyOf(plan.sectors[plan.order[0]]), keyOf(plan.sectors[plan.order[1]]));
+    QCOMPARE(keyOf(plan.sectors[plan.order[2]]), keyOf(plan.sectors[plan.order[3]]));
+}
+
+TEST_CLASS(ReadPlanTests)
+
+#include "read_plan_tests.moc"
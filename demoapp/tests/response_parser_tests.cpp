@@ -0,0 +1,220 @@
+/*******************************************************************************
+ * Response Parser Tests - chunked feed() against parse() of the whole body
+ *
+ * curl hands the body over in arbitrary chunks, so every split of a response
+ * must give what one parse() of it gives, with escapes and surrogate pairs
+ * cut anywhere.
+ *******************************************************************************/
+
+#include "response_parser.hpp"
+#include "test_suite.hpp"
+#include <QByteArray>
+#include <QTest>
+
+static const char RESPONSE[] =
+    "{\"data\": {\"status\":\"AS\",\"statusCode\":\"2101\","
+    "\"message\":\"Caf\\u00e9 \\ud83d\\ude00 \\\"ok\\\"\\n\","
+    "\"transactionId\":\"afcs-tom1714550400000\",\"fareMediaTap\":{\"cardNumber\":\"04080A1B2C3D4E\","
+    "\"balance\":12500,\"fare\":750,\"valid\":true,\"note\":null}},"
+    "\"signature\":\"c2lnbmF0dXJl\"}";
+
+static const char BATCH_RESPONSE[] =
+    "{\"data\":{\"results\":[{\"status\":\"AS\",\"statusCode\":\"2101\",\"message\":\"\\ud83d\\ude00\","
+    "\"transactionId\":\"t1\",\"fareMediaTap\":{\"fare\":750}},{\"status\":\"FA\",\"statusCode\":\"4001\","
+    "\"message\":\"Declined\",\"transactionId\":\"t2\"}]},\"signature\":\"c2ln\"}\r\n";
+
+// U+00E9 and U+1F600 in UTF-8
+static const char MESSAGE[] = "Caf\xC3\xA9 \xF0\x9F\x98\x80 \"ok\"\n";
+
+static void compareFields(const ResponseParser::Fields &actual, const ResponseParser::Fields &expected)
+{
+    QCOMPARE(actual.status, expected.status);
+    QCOMPARE(actual.statusCode, expected.statusCode);
+    QCOMPARE(actual.message, expected.message);
+    QCOMPARE(actual.transactionId, expected.transactionId);
+    QCOMPARE(actual.fareMediaTapStart, expected.fareMediaTapStart);
+    QCOMPARE(actual.fareMediaTapEnd, expected.fareMediaTapEnd);
+}
+
+static void compareParsers(const ResponseParser &actual, const ResponseParser &expected)
+{
+    QCOMPARE(actual.isComplete(), expected.isComplete());
+    QCOMPARE(actual.hasError(), expected.hasError());
+    QCOMPARE(actual.isObject(), expected.isObject());
+    QCOMPARE(actual.data(), expected.data());
+    QCOMPARE(actual.signature(), expected.signature());
+    compareFields(actual.dataFields(), expected.dataFields());
+    QCOMPARE(actual.hasResults(), expected.hasResults());
+    QCOMPARE(actual.results().size(), expected.results().size());
+    for (int i = 0; i < expected.results().size(); i++)
+        compareFields(actual.results()[i], expected.results()[i]);
+}
+
+// A string value of "data" with the given JSON-escaped content
+static QByteArray messageOf(const QByteArray &escaped)
+{
+    ResponseParser parser;
+    QByteArray body = "{\"data\":{\"message\":\"" + escaped + "\"}}";
+    if (!parser.parse(body) || !parser.isComplete())
+        return QByteArray("<parse error>");
+    return parser.dataFields().message;
+}
+
+class ResponseParserTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void parsesWholeBody();
+    void byteByByteMatchesWhole_data();
+    void byteByByteMatchesWhole();
+    void everySplitMatchesWhole_data();
+    void everySplitMatchesWhole();
+    void resetForgetsPreviousResponse();
+    void loneSurrogates_data();
+    void loneSurrogates();
+    void rejectsInvalidJson_data();
+    void rejectsInvalidJson();
+};
+
+void ResponseParserTests::parsesWholeBody()
+{
+    ResponseParser parser;
+    QVERIFY(parser.parse(QByteArray(RESPONSE)));
+    QVERIFY(parser.isComplete());
+    QVERIFY(parser.isObject());
+
+    const ResponseParser::Fields &fields = parser.dataFields();
+    QCOMPARE(fields.status, QByteArray("AS"));
+    QCOMPARE(fields.statusCode, QByteArray("2101"));
+    QCOMPARE(fields.message, QByteArray(MESSAGE));
+    QCOMPARE(fields.transactionId, QByteArray("afcs-tom1714550400000"));
+    QCOMPARE(parser.signature(), QByteArray("c2lnbmF0dXJl"));
+
+    // The signed span is the "data" value exactly as sent
+    QByteArray body(RESPONSE);
+    int start = body.indexOf("{\"status\"");
+    int end = body.indexOf(",\"signature\"");
+    QCOMPARE(parser.data(), body.mid(start, end - start));
+    QVERIFY(parser.fareMediaTap(fields).startsWith("{\"cardNumber\""));
+    QVERIFY(parser.fareMediaTap(fields).endsWith("\"note\":null}"));
+    QVERIFY(!parser.hasResults());
+}
+
+void ResponseParserTests::byteByByteMatchesWhole_data()
+{
+    QTest::addColumn<QByteArray>("body");
+
+    QTest::newRow("single") << QByteArray(RESPONSE);
+    QTest::newRow("batch") << QByteArray(BATCH_RESPONSE);
+}
+
+void ResponseParserTests::byteByByteMatchesWhole()
+{
+    QFETCH(QByteArray, body);
+
+    ResponseParser whole;
+    QVERIFY(whole.parse(body));
+
+    ResponseParser fed;
+    for (int i = 0; i < body.size(); i++)
+        QVERIFY(fed.feed(body.constData() + i, 1));
+    compareParsers(fed, whole);
+    QCOMPARE(fed.body(), body);
+}
+
+void ResponseParserTests::everySplitMatchesWhole_data()
+{
+    byteByByteMatchesWhole_data();
+}
+
+void ResponseParserTests::everySplitMatchesWhole()
+{
+    QFETCH(QByteArray, body);
+
+    ResponseParser whole;
+    QVERIFY(whole.parse(body));
+
+    // One parser reused across responses, as ApiClient does
+    ResponseParser fed;
+    for (int split = 0; split <= body.size(); split++)
+    {
+        fed.reset();
+        fed.feed(body.constData(), split);
+        fed.feed(body.constData() + split, body.size() - split);
+        compareParsers(fed, whole);
+    }
+}
+
+void ResponseParserTests::resetForgetsPreviousResponse()
+{
+    ResponseParser parser;
+    QVERIFY(parser.parse(QByteArray(BATCH_RESPONSE)));
+    QCOMPARE(parser.results().size(), 2);
+    QCOMPARE(parser.results()[1].message, QByteArray("Declined"));
+
+    // Cut inside a surrogate pair, the next response must not inherit it
+    QByteArray torn("{\"data\":{\"message\":\"\\ud83d");
+    parser.reset();
+    parser.feed(torn.constData(), torn.size());
+    QVERIFY(!parser.isComplete());
+
+    parser.reset();
+    QVERIFY(parser.parse(QByteArray(RESPONSE)));
+    QVERIFY(!parser.hasResults());
+    QCOMPARE(parser.dataFields().message, QByteArray(MESSAGE));
+}
+
+void ResponseParserTests::loneSurrogates_data()
+{
+    QTest::addColumn<QByteArray>("escaped");
+    QTest::addColumn<QByteArray>("expected");
+
+    QByteArray replacement("\xEF\xBF\xBD");
+    QTest::newRow("pair") << QByteArray("\\ud83d\\ude00") << QByteArray("\xF0\x9F\x98\x80");
+    QTest::newRow("high at the end") << QByteArray("a\\ud83d") << "a" + replacement;
+    QTest::newRow("high then text") << QByteArray("\\ud83dx") << replacement + "x";
+    QTest::newRow("high then escape") << QByteArray("\\ud83d\\n") << replacement + "\n";
+    QTest::newRow("high then BMP") << QByteArray("\\ud83d\\u0041") << replacement + "A";
+    QTest::newRow("two highs") << QByteArray("\\ud83d\\ud83d\\ude00") << replacement + "\xF0\x9F\x98\x80";
+    QTest::newRow("low alone") << QByteArray("\\ude00b") << replacement + "b";
+}
+
+void ResponseParserTests::loneSurrogates()
+{
+    QFETCH(QByteArray, escaped);
+    QFETCH(QByteArray, expected);
+
+    QCOMPARE(messageOf(escaped), expected);
+}
+
+void ResponseParserTests::rejectsInvalidJson_data()
+{
+    QTest::addColumn<QByteArray>("body");
+
+    QTest::newRow("bad escape") << QByteArray("{\"data\":{\"message\":\"\\x\"}}");
+    QTest::newRow("bad unicode") << QByteArray("{\"data\":{\"message\":\"\\u12G4\"}}");
+    QTest::newRow("control character") << QByteArray("{\"data\":{\"message\":\"a\nb\"}}");
+    QTest::newRow("missing colon") << QByteArray("{\"data\" {}}");
+    QTest::newRow("unbalanced") << QByteArray("{\"data\":{]}");
+}
+
+void ResponseParserTests::rejectsInvalidJson()
+{
+    QFETCH(QByteArray, body);
+
+    ResponseParser whole;
+    QVERIFY(!whole.parse(body));
+    QVERIFY(whole.hasError());
+
+    ResponseParser fed;
+    bool ok = true;
+    for (int i = 0; i < body.size(); i++)
+        ok = fed.feed(body.constData() + i, 1) && ok;
+    QVERIFY(!ok);
+    QVERIFY(fed.hasError());
+}
+
+TEST_CLASS(ResponseParserTests)
+
+#include "response_parser_tests.moc"
@@ -0,0 +1,73 @@
+/*******************************************************************************
+ * Test Suite Implementation
+ *******************************************************************************/
+
+#include "test_suite.hpp"
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTest>
+#include <QVector>
+#include <cstdio>
+#include <memory>
+
+namespace
+{
+    struct Entry
+    {
+        const char *name;
+        TestSuite::Factory factory;
+    };
+
+    // Filled by static initializers, before main()
+    QVector<Entry> &registry()
+    {
+        static QVector<Entry> entries;
+        return entries;
+    }
+}
+
+TestSuite::Registration::Registration(const char *name, Factory factory)
+{
+    Entry entry;
+    entry.name = name;
+    entry.factory = factory;
+    registry().append(entry);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Leading class names select, QtTest gets the program name and the rest
+    QStringList selected;
+    int first = 1;
+    for (; first < argc && argv[first][0] != '-'; first++)
+    {
+        bool known = false;
+        for (int i = 0; i < registry().size() && !known; i++)
+            known = qstrcmp(registry()[i].name, argv[first]) == 0;
+        if (!known)
+        {
+            fprintf(stderr, "Unknown test class %s\n", argv[first]);
+            return 1;
+        }
+        selected << QString::fromLatin1(argv[first]);
+    }
+
+    QStringList arguments;
+    arguments << QString::fromLocal8Bit(argv[0]);
+    for (int i = first; i < argc; i++)
+        arguments << QString::fromLocal8Bit(argv[i]);
+
+    int failed = 0;
+    for (int i = 0; i < registry().size(); i++)
+    {
+        const Entry &entry = registry()[i];
+        if (!selected.isEmpty() && !selected.contains(QString::fromLatin1(entry.name)))
+            continue;
+        std::unique_ptr<QObject> test(entry.factory());
+        if (QTest::qExec(test.get(), arguments) != 0)
+            failed++;
+    }
+    return failed;
+}
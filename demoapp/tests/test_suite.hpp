@@ -0,0 +1,36 @@
+/*******************************************************************************
+ * Test Suite - registry of the host unit tests
+ *
+ *   class CodecTests : public QObject
+ *   {
+ *       Q_OBJECT
+ *   private slots:
+ *       void hexMatchesScalar();
+ *   };
+ *   TEST_CLASS(CodecTests)
+ *
+ * main() runs every registered class through QTest::qExec, or only the ones
+ * named first on the command line; the remaining arguments go to QtTest. The
+ * exit code is the number of classes with a failure.
+ *******************************************************************************/
+
+#ifndef TEST_SUITE_HPP
+#define TEST_SUITE_HPP
+
+#include <QObject>
+#include <functional>
+
+namespace TestSuite
+{
+    typedef std::function<QObject *()> Factory;
+
+    struct Registration
+    {
+        Registration(const char *name, Factory factory);
+    };
+}
+
+#define TEST_CLASS(Class)                                                                \
+    static TestSuite::Registration Class##Registration(#Class, []() -> QObject * { return new Class; });
+
+#endif // TEST_SUITE_HPP
@@ -0,0 +1,27 @@
+#----------------------------------------------------------------------------------
+# Host unit tests of the demoapp core (QtTest), all classes in one executable:
+#
+#   tests [<TestClass>...] [QtTest options]
+#----------------------------------------------------------------------------------
+
+TARGET      = tests
+TEMPLATE    = app
+QT         -= gui
+QT         += testlib
+CONFIG     += console testcase
+CONFIG     -= app_bundle
+
+include(../core.pri)
+
+# Static core library built by ../core.pro in the parent build directory
+LIBS           = -L$$OUT_PWD/.. -ldemoapp_core $$LIBS
+PRE_TARGETDEPS += $$OUT_PWD/../libdemoapp_core.a
+
+SOURCES    += test_suite.cpp \
+    codec_tests.cpp \
+    config_tests.cpp \
+    journal_tests.cpp \
+    read_plan_tests.cpp \
+    response_parser_tests.cpp
+
+HEADERS    += test_suite.hpp
@@ -0,0 +1,176 @@
+/*******************************************************************************
+ * Ultralight Reader Implementation
+ *******************************************************************************/
+
+#include "ultralight_reader.hpp"
+#include "log.hpp"
+#include <QElapsedTimer>
+#include <cstring>
+
+static const uint8_t CMD_GET_VERSION = 0x60;
+static const uint8_t CMD_FAST_READ = 0x3A;
+
+// GET_VERSION storage size byte -> part and user memory
+struct UltralightPart
+{
+    uint8_t storageSize;
+    uint8_t productType; // 0x03 Ultralight, 0x04 NTAG
+    int userBytes;
+    const char *name;
+};
+
+static const UltralightPart PARTS[] = {
+    {0x0B, 0x03, 48, "MIFARE Ultralight EV1 (MF0UL11)"},
+    {0x0E, 0x03, 128, "MIFARE Ultralight EV1 (MF0UL21)"},
+    {0x0F, 0x04, 144, "NTAG213"},
+    {0x11, 0x04, 504, "NTAG215"},
+    {0x13, 0x04, 888, "NTAG216"},
+};
+
+UltralightReader::UltralightReader(CouplerBackend *backend, int maxPagesPerRead, bool fastRead)
+    : _backend(backend), _maxPagesPerRead(qBound(4, maxPagesPerRead, RX_BUFFER_SIZE / 4)), _fastRead(fastRead)
+{
+    memset(_version, 0, sizeof(_version));
+}
+
+int UltralightReader::pagesForStorageSize(uint8_t storageSize)
+{
+    // Pages 0-3 hold the UID, lock bytes and OTP, user memory follows
+    for (size_t i = 0; i < sizeof(PARTS) / sizeof(PARTS[0]); i++)
+    {
+        if (PARTS[i].storageSize == storageSize)
+            return 4 + PARTS[i].userBytes / 4;
+    }
+
+    // Unlisted part: bits 7-1 give 2^n bytes, rounded down when bit 0 is set
+    int exponent = storageSize >> 1;
+    if (exponent < 4 || exponent > 10)
+        return 0;
+    return 4 + (1 << exponent) / 4;
+}
+
+bool UltralightReader::getVersion(Result &result)
+{
+    uint16_t rxLen = RX_BUFFER_SIZE;
+    result.commands++;
+    if (!_backend->transceive(&CMD_GET_VERSION, 1, _rx, &rxLen) || rxLen < 8)
+        return false;
+
+    memcpy(_version, _rx, 8);
+    result.product = "Ultralight family";
+    for (size_t i = 0; i < sizeof(PARTS) / sizeof(PARTS[0]); i++)
+    {
+        if (PARTS[i].storageSize == _version[6] && PARTS[i].productType == _version[2])
+            result.product = PARTS[i].name;
+    }
+    return true;
+}
+
+bool UltralightReader::reselect()
+{
+    // A refused command leaves the tag idle, wake it up again
+    CardSearchMask search;
+    search.mifare = true;
+    search.isoA = true;
+    uint8_t com;
+    uint16_t atrLen;
+    uint8_t atr[RX_BUFFER_SIZE];
+    return _backend->searchCard(search, 1, 1, &com, &atrLen, atr) && com != CouplerBackend::COM_NO_CARD;
+}
+
+bool UltralightReader::fastRead(int first, int last, char *out, Result &result)
+{
+    const uint8_t tx[3] = {CMD_FAST_READ, (uint8_t)first, (uint8_t)last};
+    int expected = (last - first + 1) * 4;
+    uint16_t rxLen = RX_BUFFER_SIZE;
+
+    result.commands++;
+    if (!_backend->transceive(tx, sizeof(tx), _rx, &rxLen) || rxLen < expected)
+        return false;
+
+    memcpy(out, _rx, expected);
+    return true;
+}
+
+bool UltralightReader::readPages(int first, int last, char *out, Result &result)
+{
+    uint8_t data[16];
+    uint8_t status;
+    QElapsedTimer timer;
+    timer.start();
+    int commands = 0;
+
+    // READ returns four pages and rolls over, keep only what is asked for
+    for (int page = first; page <= last; page += 4)
+    {
+        result.commands++;
+        commands++;
+        if (!_backend->readBlock(page, data, &status) || status != 0)
+        {
+            result.error = QString("Failed to read pages %1-%2").arg(page).arg(page + 3);
+            return false;
+        }
+        memcpy(out + (page - first) * 4, data, qMin(16, (last - page + 1) * 4));
+    }
+
+    result.readCommandUs = timer.nsecsElapsed() / 1000 / qMax(1, commands);
+    return true;
+}
+
+bool UltralightReader::read(Result &result)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    result.product = "MIFARE Ultralight";
+    result.pages = ULTRALIGHT_PAGES;
+
+    bool hasVersion = getVersion(result);
+    if (hasVersion)
+    {
+        int pages = pagesForStorageSize(_version[6]);
+        if (pages > 0)
+            result.pages = pages;
+    }
+    else if (!reselect())
+    {
+        result.error = "Ultralight lost after GET_VERSION";
+        return false;
+    }
+
+    result.legacyCommands = (result.pages + 3) / 4;
+    result.data.resize(result.pages * 4);
+    char *out = result.data.data();
+    int page = 0;
+
+    // FAST_READ exists on every part that answers GET_VERSION
+    if (hasVersion && _fastRead)
+    {
+        while (page < result.pages)
+        {
+            int last = qMin(page + _maxPagesPerRead, result.pages) - 1;
+            if (!fastRead(page, last, out + page * 4, result))
+            {
+                LOG_DEBUG("FAST_READ of pages {}-{} refused, using READ", page, last);
+                if (!reselect())
+                {
+                    result.error = "Ultralight lost after FAST_READ";
+                    result.data.clear();
+                    return false;
+                }
+                break;
+            }
+            page = last + 1;
+        }
+    }
+
+    if (page < result.pages && !readPages(page, result.pages - 1, out + page * 4, result))
+    {
+        result.data.clear();
+        return false;
+    }
+
+    result.elapsedUs = timer.nsecsElapsed() / 1000;
+    LOG_DEBUG("{} : {} pages in {} commands, {} us", result.product, result.pages, result.commands, result.elapsedUs);
+    return true;
+}
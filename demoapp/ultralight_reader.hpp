@@ -0,0 +1,57 @@
+/*******************************************************************************
+ * Ultralight Reader - MIFARE Ultralight / NTAG memory dump
+ *
+ * GET_VERSION identifies the exact part and its user memory size, then
+ * FAST_READ returns pages 0 to the end of user memory in as few commands as
+ * the frame size allows. Parts without GET_VERSION are original Ultralights
+ * (16 pages); parts without FAST_READ fall back to READ, four pages at a time.
+ *******************************************************************************/
+
+#ifndef ULTRALIGHT_READER_HPP
+#define ULTRALIGHT_READER_HPP
+
+#include <QByteArray>
+#include <QString>
+#include "coupler_backend.hpp"
+
+class UltralightReader
+{
+public:
+    struct Result
+    {
+        QByteArray data; // Pages 0 .. last user page
+        QString product;
+        QString error;
+        int pages = 0;
+        int commands = 0;         // RF commands used, GET_VERSION included
+        int legacyCommands = 0;   // READ commands the four-page loop needs
+        qint64 readCommandUs = 0; // Average READ time when READ was used
+        qint64 elapsedUs = 0;
+    };
+
+    // fastRead = false forces the READ loop (comparison baseline)
+    UltralightReader(CouplerBackend *backend, int maxPagesPerRead, bool fastRead);
+
+    bool read(Result &result);
+
+    // Pages from 0 to the last user page for a GET_VERSION storage size
+    // byte, 0 when unknown
+    static int pagesForStorageSize(uint8_t storageSize);
+    static const int ULTRALIGHT_PAGES = 16;
+
+private:
+    static const int RX_BUFFER_SIZE = 256;
+
+    bool getVersion(Result &result);
+    bool reselect();
+    bool fastRead(int first, int last, char *out, Result &result);
+    bool readPages(int first, int last, char *out, Result &result);
+
+    CouplerBackend *_backend;
+    int _maxPagesPerRead;
+    bool _fastRead;
+    uint8_t _version[8];
+    uint8_t _rx[RX_BUFFER_SIZE];
+};
+
+#endif // ULTRALIGHT_READER_HPP